@@ -0,0 +1,122 @@
+#include <signal.h>
+#include <syslog.h>
+
+#include <tacf.hpp>
+#include <tacfBroker.hpp>
+#include <tacfUbootEnv.hpp>
+
+#include <chrono>
+#include <optional>
+
+/**
+ * Tacf variant for the long lived broker daemon. The D-Bus connection is
+ * kept between logins, and so is the serial number which is only refreshed
+ * once it is older than the refresh interval. Field mode is read from the
+ * U-Boot environment on every login, like the in process fallback of the PAM
+ * module does, so that turning it on takes effect at once.
+ */
+class BrokerTacf : public Tacf
+{
+  public:
+    using Tacf::Tacf;
+
+  private:
+    static constexpr auto refreshInterval = std::chrono::seconds(60);
+
+    mutable std::optional<sdbusplus::bus::bus> bus;
+    mutable std::string serial;
+    mutable std::chrono::steady_clock::time_point serialTime;
+    mutable bool serialValid = false;
+
+    /** @brief A helper function to check if a cached value is usable */
+    static bool isFresh(bool valid, std::chrono::steady_clock::time_point time)
+    {
+        return valid &&
+               std::chrono::steady_clock::now() - time < refreshInterval;
+    }
+
+    virtual TacfDbus dbus() const override
+    {
+        if (!bus)
+        {
+            try
+            {
+                bus.emplace(sdbusplus::bus::new_system());
+            }
+            catch (const std::exception& e)
+            {
+                return TacfDbus();
+            }
+        }
+        return TacfDbus(*bus);
+    }
+
+    virtual int retrieveSerial(std::string& value) const override
+    {
+        if (!isFresh(serialValid, serialTime))
+        {
+            // Lookup failures are reported as the unset serial number, so
+            // only cache a value that was actually read. A failure may be
+            // down to a stale connection, so connect again next time.
+            Tacf::retrieveSerial(serial);
+            serialValid = serialNumberUnset != serial;
+            serialTime  = std::chrono::steady_clock::now();
+            if (!serialValid)
+            {
+                bus.reset();
+            }
+        }
+        value = serial;
+
+        return tacfSuccess;
+    }
+
+    virtual int retrieveFieldMode(bool& value) const override
+    {
+        if (TacfUbootEnv().readFieldMode(value))
+        {
+            syslog(LOG_ERR, "Unable to read u-boot environment");
+            value = true;
+            return tacfSystemError;
+        }
+
+        return tacfSuccess;
+    }
+};
+
+int main()
+{
+    openlog("ibm-acf-brokerd", LOG_PID, LOG_AUTH);
+
+    // Clients that go away early must not terminate the daemon.
+    signal(SIGPIPE, SIG_IGN);
+
+    TacfBroker broker;
+    int fd = -1;
+    if (broker.listen(fd))
+    {
+        syslog(LOG_ERR, "Unable to create broker socket");
+        return EXIT_FAILURE;
+    }
+
+    BrokerTacf tacf{
+        [](std::string msg) { syslog(LOG_WARNING, "%s", msg.c_str()); }};
+
+    // Requests are handled one at a time, which also bounds the CPU spent on
+    // password hashing by concurrent logins. The password hash of a client
+    // that hung up or stopped waiting is abandoned so the next one is served.
+    while (true)
+    {
+        broker.serve(fd, [&tacf](const char* password,
+                                 std::chrono::seconds ticketLifetime,
+                                 const TacfAdmission::Limits& admission,
+                                 std::chrono::steady_clock::time_point deadline,
+                                 const TacfCancelToken& cancel) {
+            tacf.setTicketLifetime(ticketLifetime);
+            tacf.setAdmission(admission);
+            return tacf.authenticate(password, deadline, cancel);
+        });
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -3,8 +3,13 @@
 #include <syslog.h>
 
 #include <tacf.hpp>
+#include <tacfBroker.hpp>
+#include <tacfUbootEnv.hpp>
 
+#include <algorithm>
+#include <chrono>
 #include <filesystem>
+#include <limits>
 
 // RUN_UNIT_TESTS should only be enabled when running
 // meson unit tests, otherwise this shoudn't be enabled
@@ -73,6 +78,84 @@ bool readBinaryFile(const std::string fileNameParm,
     return true;
 }
 
+// Module arguments.
+struct ModuleOptions
+{
+    std::chrono::seconds ticketLifetime{0};
+    TacfAdmission::Limits admission;
+};
+
+// Read the module arguments.
+// Returns:
+//    The ticket_ttl=<seconds> value, zero if not given or not valid, and the
+//    max_hashes=<n>, max_queued=<n>, hash_rate=<per minute> and
+//    hash_burst=<n> password check admission limits, the defaults if not
+//    given or not valid.
+ModuleOptions readOptions(pam_handle_t* pamh, int argc, const char** argv)
+{
+    ModuleOptions options;
+    for (int i = 0; i < argc; i++)
+    {
+        const char* value = strchr(argv[i], '=');
+        std::string name(argv[i], value ? value - argv[i] : strlen(argv[i]));
+        if (!value++)
+        {
+            pam_syslog(pamh, LOG_ERR, "Unknown option: %s\n", argv[i]);
+            continue;
+        }
+
+        char* end             = nullptr;
+        unsigned long number  = strtoul(value, &end, 10);
+        bool valid            = *value && !*end && '-' != *value;
+        unsigned long limit   = std::numeric_limits<unsigned>::max();
+        unsigned* destination = nullptr;
+        if ("ticket_ttl" == name)
+        {
+            limit = Tacf::ticketLifetimeMax.count();
+        }
+        else if ("max_hashes" == name)
+        {
+            destination = &options.admission.concurrent;
+            valid       = valid && number;
+        }
+        else if ("max_queued" == name)
+        {
+            destination = &options.admission.queued;
+        }
+        else if ("hash_rate" == name)
+        {
+            destination = &options.admission.rate;
+        }
+        else if ("hash_burst" == name)
+        {
+            destination = &options.admission.burst;
+            valid       = valid && number;
+        }
+        else
+        {
+            pam_syslog(pamh, LOG_ERR, "Unknown option: %s\n", argv[i]);
+            continue;
+        }
+
+        if (!valid)
+        {
+            pam_syslog(pamh, LOG_ERR, "Invalid %s: %s\n", name.c_str(),
+                       value);
+            continue;
+        }
+        number = std::min(number, limit);
+        if (destination)
+        {
+            *destination = number;
+        }
+        else
+        {
+            options.ticketLifetime = std::chrono::seconds(number);
+        }
+    }
+    return options;
+}
+
 #ifdef RUN_UNIT_TESTS
 int fieldModeEnabled = 1;
 string mSerialNumber = "UNSET";
@@ -91,44 +174,16 @@ void setSerialNumberProperty(const string& obj)
 #else
 int readFieldMode(pam_handle_t* pamh)
 {
-    FILE* pipe = popen("fw_printenv -n fieldmode 2>&1", "r");
-    if (!pipe)
-    {
-        pam_syslog(pamh, LOG_ERR, "popen failed\n");
-        return PAM_SYSTEM_ERR;
-    }
-    std::array<char, 512> buffer;
-    std::stringstream result;
-    while (fgets(buffer.data(), buffer.size(), pipe) != nullptr)
-    {
-        result << buffer.data();
-    }
-    int stat = pclose(pipe);
-    if (WIFEXITED(stat))
+    // Read the U-Boot environment directly, same result as fw_printenv.
+    bool enabled = true;
+    if (TacfUbootEnv().readFieldMode(enabled))
     {
-        // Handle expected results
-        int rc = WEXITSTATUS(stat);
-        if (rc == 0)
-        {
-            // fw_printenv exited normally with rc=0
-            if (0 == strcmp(result.str().c_str(), "true\n"))
-            {
-                return 1; // fieldmode=true
-            }
-            return 0; // any other value means fieldmode=false
-        }
-        // fw_printenv exited normally with nonzero rc
-        if (0 == strcmp(result.str().c_str(),
-                        "## Error: \"fieldmode\" not defined\n"))
-        {
-            return 0; // fieldmode not set means fieldmode=false
-        }
+        // Something unexpected happened.  Either the configuration or the
+        // environment could not be read or no copy had a valid CRC.
+        pam_syslog(pamh, LOG_ERR, "Unable to read u-boot environment\n");
+        return -1; // This should never happen
     }
-    // Something unexpected happened.  Either fw_printenv exited abnormally,
-    // or gave unexpected results, or something else unexpected happened.
-    pam_syslog(pamh, LOG_ERR, "pclose failed stat=0x%X, message=%s\n", stat,
-               result.str().c_str());
-    return -1; // This should never happen
+    return enabled ? 1 : 0;
 }
 #endif
 
@@ -164,16 +219,32 @@ PAM_EXTERN int pam_sm_authenticate(pam_handle_t* pamh, int flags, int argc,
         return PAM_AUTH_ERR;
     }
 
-    // Specify logging and get field mode overrides.
-    Tacf tacf{
-        [](void* pamh, std::string msg) {
-            pam_syslog((pam_handle_t*)pamh, LOG_WARNING, "%s", msg.c_str());
-        },
-        [](void* pamh) -> int { return readFieldMode((pam_handle_t*)pamh); },
-        pamh};
+    // Prefer the broker daemon, it keeps the verified ACF, password ticket
+    // and system state across logins. Fall back to authenticating in process if it is not
+    // available. Either way the password hashes running at once on the
+    // system are bounded.
+    auto options        = readOptions(pamh, argc, argv);
+    auto ticketLifetime = options.ticketLifetime;
+    int rc              = Tacf::tacfSystemError;
+    if (TacfBroker().authenticate(password, ticketLifetime, options.admission,
+                                  rc))
+    {
+        // Specify logging and get field mode overrides.
+        Tacf tacf{
+            [](void* pamh, std::string msg) {
+                pam_syslog((pam_handle_t*)pamh, LOG_WARNING, "%s",
+                           msg.c_str());
+            },
+            [](void* pamh) -> int {
+                return readFieldMode((pam_handle_t*)pamh);
+            },
+            pamh};
 
-    // And authenticate user with password.
-    int rc = tacf.authenticate(password);
+        // And authenticate user with password. The process ends with the
+        // login, so a password ticket would never be reused.
+        tacf.setAdmission(options.admission);
+        rc = tacf.authenticate(password);
+    }
     if (Tacf::tacfSuccess == rc)
     {
         return PAM_SUCCESS;
@@ -190,7 +261,20 @@ PAM_EXTERN int pam_sm_authenticate(pam_handle_t* pamh, int flags, int argc,
         pam_syslog(pamh, LOG_WARNING, "ACF service auth failed 0x%X: %s", rc,
                    errMsg.c_str());
     }
-    return Tacf::tacfAuthError == rc ? PAM_AUTH_ERR : PAM_SYSTEM_ERR;
+    // Attempts beyond the rate limit are refused outright, attempts finding
+    // the queue full or waiting too long fail like a wrong password.
+    switch (rc)
+    {
+        case Tacf::tacfAuthError:
+        case Tacf::tacfBusy:
+            return PAM_AUTH_ERR;
+
+        case Tacf::tacfRateLimited:
+            return PAM_MAXTRIES;
+
+        default:
+            return PAM_SYSTEM_ERR;
+    }
 }
 
 PAM_EXTERN int pam_sm_setcred(pam_handle_t* pamh, int flags, int argc,
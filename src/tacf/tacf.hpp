@@ -1,16 +1,26 @@
 #pragma once
 
+#include "tacfAdmission.hpp"
+#include "tacfCache.hpp"
 #include "tacfCelogin.hpp"
 #include "tacfDbus.hpp"
+#include "tacfDeadline.hpp"
+#include "tacfKeyring.hpp"
 #include "tacfSpw.hpp"
+#include "tacfTicket.hpp"
 #include "targetedAcf.hpp"
 
 #include <ce_logger.hpp>
 
+#include <algorithm>
 #include <array>
+#include <chrono>
 #include <cstdint>
+#include <cstring>
 #include <fstream>
+#include <future>
 #include <iterator>
+#include <optional>
 #include <string>
 #include <vector>
 constexpr auto invalidReplayId = TacfCelogin::invalidReplayId;
@@ -105,6 +115,69 @@ class Tacf : TargetedAcf
         return rc;
     }
 
+    /**
+     * Authenticate against an ACF using a password on a worker thread. The
+     * password hash is stopped once the deadline has passed or the token is
+     * cancelled, which fails the authentication with tacfTimeout or
+     * tacfCancelled. The token and this object must outlive the returned
+     * future, and no other authentication may use this object until the
+     * future is ready.
+     * @brief Authenticate using password, bounded and asynchronous.
+     *
+     * @param password  A pointer to a password used for authentication.
+     * @param deadline  The time after which the password hash is stopped.
+     * @param cancel    The token stopping the password hash when cancelled.
+     *
+     * @return The future result, a non-zero error value or zero on success.
+     */
+    std::future<int>
+        authenticateAsync(const char* password,
+                          std::chrono::steady_clock::time_point deadline,
+                          const TacfCancelToken& cancel)
+    {
+        if (!password)
+        {
+            return readyResult(tacfAuthError);
+        }
+
+        try
+        {
+            return std::async(
+                std::launch::async,
+                [this, secret = std::string(password), deadline,
+                 &cancel]() mutable {
+                    TacfDeadline limit(deadline, cancel);
+                    int rc = authenticate(secret.c_str(), limit);
+                    explicit_bzero(secret.data(), secret.size());
+                    return rc;
+                });
+        }
+        catch (const std::system_error& e)
+        {
+            log("acfv2 worker error");
+            return readyResult(tacfSystemError);
+        }
+    }
+
+    /**
+     * Authenticate against an ACF using a password on a worker thread and
+     * wait for the result.
+     * @brief Authenticate using password, bounded.
+     *
+     * @param password  A pointer to a password used for authentication.
+     * @param deadline  The time after which the password hash is stopped.
+     * @param cancel    The token stopping the password hash when cancelled.
+     *
+     * @return A non-zero error value or zero on success, tacfTimeout or
+     *         tacfCancelled if the password hash was stopped.
+     */
+    int authenticate(const char* password,
+                     std::chrono::steady_clock::time_point deadline,
+                     const TacfCancelToken& cancel)
+    {
+        return authenticateAsync(password, deadline, cancel).get();
+    }
+
     /**
      * Install ACF and retrieve expiration data.
      * @brief Install ACF.
@@ -152,10 +225,44 @@ class Tacf : TargetedAcf
         return rc;
     }
 
+    /**
+     * Allow a successful service password check to be reused for a short
+     * time, which skips the password hash on repeated logins. The ticket is
+     * only kept in the memory of this object, so it is only useful to a long
+     * lived process such as the broker daemon. Disabled by default.
+     * @brief Set password ticket lifetime.
+     *
+     * @param lifetime  The ticket lifetime, zero disables tickets.
+     */
+    void setTicketLifetime(std::chrono::seconds lifetime)
+    {
+        ticketLifetime = std::clamp(lifetime, std::chrono::seconds(0),
+                                    ticketLifetimeMax);
+    }
+
+    /**
+     * Bound the password hashes running at once, and their rate, across all
+     * processes. Logins that do not hash a password, such as those reusing a
+     * ticket, are not counted. Not bounded by default.
+     * @brief Set password check admission limits.
+     *
+     * @param limits    The admission limits, see TacfAdmission.
+     */
+    void setAdmission(const TacfAdmission::Limits& limits)
+    {
+        admissionLimits = limits;
+    }
+
+    static constexpr auto ticketLifetimeMax = std::chrono::seconds(300);
+
     static constexpr int tacfSuccess     = 0;
     static constexpr int tacfFail        = 1;
     static constexpr int tacfSystemError = 0x10001;
     static constexpr int tacfAuthError   = 0x10002;
+    static constexpr int tacfTimeout     = 0x10003;
+    static constexpr int tacfCancelled   = 0x10004;
+    static constexpr int tacfBusy        = 0x10005;
+    static constexpr int tacfRateLimited = 0x10006;
 
   private:
     /** @brief Optional logging support to register */
@@ -164,6 +271,127 @@ class Tacf : TargetedAcf
     field_mode_function_pam fieldModePam = nullptr;
     void* pamHandle                      = nullptr;
 
+    /** @brief Public keys, kept parsed between calls */
+    TacfKeyring keys;
+
+    /** @brief Password ticket lifetime, zero when disabled */
+    std::chrono::seconds ticketLifetime{0};
+
+    /** @brief Password ticket of the verified ACF, kept in memory only */
+    TacfTicket ticket;
+
+    /** @brief Password check admission limits, unset when not bounded */
+    std::optional<TacfAdmission::Limits> admissionLimits;
+
+    /** @brief Control of the password hash, null when it is not bounded */
+    const CeLogin::PasswordHashControl* hashControl = nullptr;
+
+    /** @brief Deadline of the authentication, null when it is not bounded */
+    const TacfDeadline* hashLimit = nullptr;
+
+    /** @brief A helper function to authenticate within a deadline */
+    int authenticate(const char* password, const TacfDeadline& limit)
+    {
+        hashControl = &limit.control();
+        hashLimit   = &limit;
+        int rc      = authenticate(password);
+        hashControl = nullptr;
+        hashLimit   = nullptr;
+
+        // The hash control error is not passed through every path, so go by
+        // whether the deadline stopped the hash.
+        if (tacfSuccess != rc)
+        {
+            switch (limit.reason())
+            {
+                case TacfDeadline::Reason::timeout:
+                    log("acfv2 authenticate timeout");
+                    return tacfTimeout;
+                case TacfDeadline::Reason::cancelled:
+                    log("acfv2 authenticate cancelled");
+                    return tacfCancelled;
+                default:
+                    break;
+            }
+        }
+        return rc;
+    }
+
+    /** @brief A helper function to return a result without a worker */
+    static std::future<int> readyResult(int rc)
+    {
+        std::promise<int> result;
+        result.set_value(rc);
+        return result.get_future();
+    }
+
+    /**
+     * Admit a password hash if admission is bounded. The slot is held until
+     * the admission object is destroyed. The wait for a slot ends at the
+     * deadline of the authentication or when it is cancelled. Should the
+     * shared state not be available the password is hashed anyway.
+     * @brief Admit a password hash.
+     *
+     * @param admission The admission object to populate.
+     *
+     * @return tacfSuccess, or tacfRateLimited or tacfBusy if refused.
+     */
+    int admitHash(std::optional<TacfAdmission>& admission) const
+    {
+        if (!admissionLimits)
+        {
+            return tacfSuccess;
+        }
+
+        admission.emplace(*admissionLimits);
+        int rc = hashLimit ? admission->admit(hashLimit->until(),
+                                              &hashLimit->token())
+                           : admission->admit();
+        switch (rc)
+        {
+            case TacfAdmission::admissionAdmitted:
+                return tacfSuccess;
+
+            case TacfAdmission::admissionRateLimited:
+                logAdmission(*admission, "rate limited");
+                return tacfRateLimited;
+
+            case TacfAdmission::admissionBusy:
+                logAdmission(*admission, "busy");
+                return tacfBusy;
+
+            default:
+                log("acfv2 admission unavailable");
+                return tacfSuccess;
+        }
+    }
+
+    /** @brief A helper function to log a refused password hash */
+    void logAdmission(TacfAdmission& admission, const char* reason) const
+    {
+        TacfAdmission::Counters counters{};
+        admission.readCounters(counters);
+        log("acfv2 admission %s (admitted %llu queued %llu shed busy %llu "
+            "shed rate %llu)",
+            reason, (unsigned long long)counters.admitted,
+            (unsigned long long)counters.queued,
+            (unsigned long long)counters.shedBusy,
+            (unsigned long long)counters.shedRate);
+    }
+
+    /** @brief A helper function to issue a password ticket if enabled */
+    void issueTicket(const TacfCache::Key& key,
+                     const CeLogin::AcfAuthRecord& record, uint64_t replayId,
+                     const char* password)
+    {
+        if (ticketLifetime.count() &&
+            ticket.issue(key, replayId, record.mExpirationTime, password,
+                         ticketLifetime))
+        {
+            log("acfv2 ticket error");
+        }
+    }
+
     /**
      * Process an ACF. Depending on the action requested and the type of
      * ACF presented this operation will result in one or more of the
@@ -213,56 +441,149 @@ class Tacf : TargetedAcf
         TacfCelogin authProvider;
         int authRc = CeLogin::CeLoginRc::Failure;
 
-        for (auto pathname : keyring)
+        // Only logins that hash a password are admitted.
+        std::optional<TacfAdmission> admission;
+        int admitRc = tacfSuccess;
+
+        // A previously verified service ACF only needs the password checked.
+        TacfCache cache;
+        TacfCache::Key cacheKey;
+        bool cacheable =
+            TargetedAcf::TargetedAcfAction::Authenticate == action &&
+            !cache.makeKey(acfFilePath, acf, acfSize, serial, keyring,
+                           cacheKey);
+        if (cacheable)
         {
-            // Skip key if file does not exist or is empty.
-            std::vector<uint8_t> pubkey;
-            if (readFile(pathname, pubkey) || pubkey.empty())
+            CeLogin::AcfAuthRecord record;
+            if (ticketLifetime.count() &&
+                !ticket.check(cacheKey, replayId, password))
             {
-                continue;
+                return tacfSuccess;
             }
-
-            int authRc;
-            uint64_t expireTime = 0;
-
-            // If action is verify.
-            if (TargetedAcf::TargetedAcfAction::Verify == action)
+            if (!cache.lookup(cacheKey, record))
             {
-                // Verify ACF.
-                authRc = authProvider.verify(acf, acfSize, pubkey.data(),
-                                             pubkey.size(), serial, expireTime,
-                                             expires);
+                admitRc = admitHash(admission);
+                if (tacfSuccess != admitRc)
+                {
+                    return admitRc;
+                }
+
+                // Report failure the same way as the uncached path.
+                if (CeLogin::CeLoginRc::Success ==
+                    authProvider.authenticate(record, password, replayId,
+                                              hashControl))
+                {
+                    issueTicket(cacheKey, record, replayId, password);
+                    return tacfSuccess;
+                }
+                return authRc;
             }
-            // Or if action is install.
-            else if (TargetedAcf::TargetedAcfAction::Install == action)
-            {
-                CeLogin::AcfType ceLoginAcfType =
-                    CeLogin::AcfType::AcfType_Invalid;
+        }
 
-                // Install ACF.
-                authRc = authProvider.install(acf, acfSize, pubkey.data(),
-                                              pubkey.size(), serial, auth,
-                                              ceLoginAcfType, expireTime,
-                                              expires, replayId, acfUserFields);
+        // Key files that do not exist or are empty are skipped. The key that
+        // verified this ACF before is tried first.
+        if (keys.load(keyring))
+        {
+            log("acfv2 keyring error");
+        }
 
-                // Convert from celogin ACF type to targeted ACF type.
-                type = translateAcfType(ceLoginAcfType);
-            }
-            else
+        TacfKeyring::KeyId hintId;
+        bool hinted = !cache.lookupKeyId(acf, acfSize, hintId) &&
+                      !keys.prefer(hintId);
+
+        // The keys are tried in a single call, so the ACF is only decoded
+        // once.
+        const auto& loaded = keys.loaded();
+        if (loaded.empty())
+        {
+            return authRc;
+        }
+        CeLogin::CeLoginVerifier& verifier = keys.verifier();
+
+        int rc;
+        size_t keyIndex     = loaded.size();
+        uint64_t expireTime = 0;
+
+        // If action is verify.
+        if (TargetedAcf::TargetedAcfAction::Verify == action)
+        {
+            // Verify ACF.
+            rc = authProvider.verify(acf, acfSize, verifier, serial,
+                                     expireTime, expires, keyIndex);
+        }
+        // Or if action is install.
+        else if (TargetedAcf::TargetedAcfAction::Install == action)
+        {
+            CeLogin::AcfType ceLoginAcfType = CeLogin::AcfType::AcfType_Invalid;
+
+            // Install ACF.
+            rc = authProvider.install(acf, acfSize, verifier, serial, auth,
+                                      ceLoginAcfType, expireTime, expires,
+                                      replayId, acfUserFields, keyIndex);
+
+            // Convert from celogin ACF type to targeted ACF type.
+            type = translateAcfType(ceLoginAcfType);
+        }
+        else
+        {
+            // Otherwise authenticate with password.
+            CeLogin::AcfAuthRecord record;
+            rc = authProvider.authRecord(acf, acfSize, verifier, serial,
+                                         record, keyIndex);
+            if (CeLogin::CeLoginRc::Success == rc)
             {
-                // Otherwise authenticate with password.
-                authRc = authProvider.authenticate(acf, acfSize, pubkey.data(),
-                                                   pubkey.size(), password,
-                                                   serial, replayId);
+                // Share the verified ACF with later logins.
+                if (cacheable && cache.store(cacheKey, record))
+                {
+                    log("acfv2 cache store error");
+                }
+                admitRc = admitHash(admission);
+                rc      = CeLogin::CeLoginRc::Failure;
+                if (tacfSuccess == admitRc)
+                {
+                    rc = authProvider.authenticate(record, password, replayId,
+                                                   hashControl);
+                }
+                if (cacheable && CeLogin::CeLoginRc::Success == rc)
+                {
+                    issueTicket(cacheKey, record, replayId, password);
+                }
             }
-
-            // If action successful.
-            if (CeLogin::CeLoginRc::Success == authRc)
+            else if (CeLogin::CeLoginRc::UnsupportedAcfType == rc &&
+                     keyIndex < loaded.size())
             {
-                // Return success.
-                return tacfSuccess;
+                admitRc = admitHash(admission);
+                rc      = CeLogin::CeLoginRc::Failure;
+                if (tacfSuccess == admitRc)
+                {
+                    rc = authProvider.authenticate(
+                        acf, acfSize, loaded[keyIndex].pkey.get(), password,
+                        serial, replayId, hashControl);
+                }
             }
         }
+
+        // Remember which key matched the ACF signature.
+        if (keyIndex < loaded.size() &&
+            !(hinted && hintId == loaded[keyIndex].id) &&
+            cache.storeKeyId(acf, acfSize, loaded[keyIndex].id))
+        {
+            log("acfv2 cache key hint error");
+        }
+
+        // A refused password check is reported as such.
+        if (tacfSuccess != admitRc)
+        {
+            return admitRc;
+        }
+
+        // If action successful.
+        if (CeLogin::CeLoginRc::Success == rc)
+        {
+            // Return success.
+            return tacfSuccess;
+        }
+
         // Or return error code.
         return authRc;
     }
@@ -277,7 +598,7 @@ class Tacf : TargetedAcf
      */
     virtual int retrieveReplayId(uint64_t& id) final override
     {
-        if (TacfDbus().readReplayId(id))
+        if (dbus().readReplayId(id))
         {
             log("acfv2 retrieve replay error");
             id = invalidReplayId;
@@ -353,6 +674,8 @@ class Tacf : TargetedAcf
     virtual void removeAcf() override
     {
         std::remove(acfFilePath);
+        TacfCache().invalidate();
+        ticket.invalidate();
     }
 
     /**
@@ -378,6 +701,8 @@ class Tacf : TargetedAcf
             case acfTypeService:
             {
                 rc = writeFile(acf, size, acfFilePath);
+                TacfCache().invalidate();
+                ticket.invalidate();
 
                 // Enable the service user account using dbus interface.
                 TacfDbus().enableUser(serviceName);
@@ -449,6 +774,18 @@ class Tacf : TargetedAcf
         return tacfSuccess;
     }
 
+  protected:
+    /**
+     * The D-Bus interface used to read the system state on every login.
+     * @brief Get D-Bus interface.
+     *
+     * @return The D-Bus interface, which connects for every read.
+     */
+    virtual TacfDbus dbus() const
+    {
+        return TacfDbus();
+    }
+
     /**
      * Retrieve the serial number of the system.
      * @brief retrieve serial number.
@@ -459,7 +796,7 @@ class Tacf : TargetedAcf
      */
     virtual int retrieveSerial(std::string& serial) const
     {
-        if (TacfDbus().retrieveSerialNumber(serial))
+        if (dbus().retrieveSerialNumber(serial))
         {
             log("acfv2 retrieve serial error");
             serial = serialNumberUnset;
@@ -506,7 +843,7 @@ class Tacf : TargetedAcf
             }
         }
         // Otherwise use default method.
-        else if (TacfDbus().retrieveFieldMode(fieldMode))
+        else if (dbus().retrieveFieldMode(fieldMode))
         {
             log("acfv2 retrieve field error");
             return tacfSystemError;
@@ -515,6 +852,7 @@ class Tacf : TargetedAcf
         return tacfSuccess;
     }
 
+  private:
     /**
      * Read a file in into a vector of bytes.
      * @brief Read a binary file.
@@ -0,0 +1,399 @@
+#pragma once
+
+#include "tacfDeadline.hpp"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+/**
+ * TacfAdmission class bounding the service password checks running at once
+ * across all processes.
+ *
+ * Every login runs its own PBKDF2 password hash, so a burst of attempts can
+ * occupy every core of the BMC. Before hashing a password a process has to
+ * be admitted, which takes a token from a bucket refilled at a fixed rate, if
+ * one is set, and then one of a limited number of slots. An attempt finding
+ * every slot taken waits in a bounded queue for a slot to free up.
+ *
+ * The bucket and the counters live in a POSIX shared memory object. Slots and
+ * queue places are open file description locks on single bytes of that
+ * object, so the kernel gives them back when a process exits while holding
+ * one.
+ */
+class TacfAdmission
+{
+    /*
+     * @brief Implementation specific value definitions.
+     */
+    static constexpr auto admissionName        = "/ibmacf-admission";
+    static constexpr uint32_t admissionMagic   = 0x4d444154; // "TADM"
+    static constexpr uint32_t admissionVersion = 1;
+    static constexpr unsigned slotsMax         = 16;
+    static constexpr unsigned queuedMax        = 64;
+    static constexpr uint64_t tokenScale       = 1000;
+    static constexpr auto pollInterval         = std::chrono::milliseconds(20);
+
+  public:
+    /**
+     * @brief Admission limits, zero rate disables the token bucket.
+     */
+    struct Limits
+    {
+        unsigned concurrent = 2;   // password checks running at once
+        unsigned queued     = 8;   // attempts waiting for a slot
+        unsigned rate       = 0;   // tokens added per minute
+        unsigned burst      = 10;  // tokens the bucket holds
+        std::chrono::seconds queueWait{10};
+    };
+
+    /**
+     * @brief Attempt counters kept across all processes.
+     */
+    struct Counters
+    {
+        uint64_t admitted;    // attempts given a slot
+        uint64_t queued;      // attempts that waited for a slot
+        uint64_t shedBusy;    // attempts rejected, queue full or wait over
+        uint64_t shedRate;    // attempts rejected, token bucket empty
+    };
+
+    /*
+     * @brief Result values of admit.
+     */
+    static constexpr int admissionAdmitted    = 0;
+    static constexpr int admissionBusy        = 1;
+    static constexpr int admissionRateLimited = 2;
+    static constexpr int admissionError       = 3;
+
+    /**
+     * @param limits    The limits applied by this process.
+     * @param name      The name of the shared memory object.
+     */
+    explicit TacfAdmission(const Limits& limits,
+                           const std::string& name = admissionName) :
+        limits(limits), name(name)
+    {
+        this->limits.concurrent = std::clamp(limits.concurrent, 1u, slotsMax);
+        this->limits.queued     = std::min(limits.queued, queuedMax);
+    }
+
+    TacfAdmission(const TacfAdmission&)            = delete;
+    TacfAdmission& operator=(const TacfAdmission&) = delete;
+
+    ~TacfAdmission()
+    {
+        release();
+    }
+
+    /**
+     * Wait for a slot to check a password. The slot is held until release
+     * is called or the object is destroyed. The wait in the queue ends at
+     * the deadline of the authentication if that comes first, or as soon as
+     * the authentication is cancelled.
+     * @brief Admit a password check.
+     *
+     * @param deadline  The time after which the check is no longer wanted.
+     * @param cancel    A pointer to the token cancelling the check, if any.
+     *
+     * @return admissionAdmitted, admissionBusy if the queue is full, the
+     *         wait timed out or the check was cancelled, admissionRateLimited
+     *         if no token was left or admissionError if the shared state is
+     *         not available.
+     */
+    int admit(std::chrono::steady_clock::time_point deadline =
+                  std::chrono::steady_clock::time_point::max(),
+              const TacfCancelToken* cancel = nullptr)
+    {
+        if (slot >= 0)
+        {
+            return admissionAdmitted;
+        }
+        if (open())
+        {
+            return admissionError;
+        }
+
+        // A check that is no longer wanted does not use up a token.
+        auto stopped = [&]() { return cancel && cancel->cancelled(); };
+        if (stopped() || std::chrono::steady_clock::now() >= deadline)
+        {
+            count(&Counters::shedBusy);
+            return admissionBusy;
+        }
+
+        if (!takeToken())
+        {
+            count(&Counters::shedRate);
+            return admissionRateLimited;
+        }
+
+        if (takeSlot())
+        {
+            count(&Counters::admitted);
+            return admissionAdmitted;
+        }
+
+        // Every slot is taken, wait in the queue if there is room.
+        int place = lockAny(queueBase(), limits.queued);
+        if (place < 0)
+        {
+            count(&Counters::shedBusy);
+            return admissionBusy;
+        }
+        count(&Counters::queued);
+
+        auto now      = std::chrono::steady_clock::now();
+        auto end      = std::min(now + limits.queueWait, deadline);
+        bool admitted = false;
+        while (!admitted && !stopped() && now < end)
+        {
+            std::this_thread::sleep_until(std::min(now + pollInterval, end));
+            admitted = !stopped() && takeSlot();
+            now      = std::chrono::steady_clock::now();
+        }
+        unlockByte(queueBase() + place);
+
+        count(admitted ? &Counters::admitted : &Counters::shedBusy);
+        return admitted ? admissionAdmitted : admissionBusy;
+    }
+
+    /**
+     * Give back the slot taken by admit, if any.
+     * @brief Release admission.
+     */
+    void release()
+    {
+        if (slot >= 0)
+        {
+            unlockByte(slotBase() + slot);
+            slot = -1;
+        }
+        if (state)
+        {
+            munmap(state, sizeof(State));
+            state = nullptr;
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    /**
+     * Retrieve the counters of all processes.
+     * @brief Read counters.
+     *
+     * @param counters  The counter values to populate.
+     *
+     * @return A non-zero error value or zero on success.
+     */
+    int readCounters(Counters& counters)
+    {
+        if (open())
+        {
+            return 1;
+        }
+        flock(fd, LOCK_SH);
+        counters = state->counters;
+        flock(fd, LOCK_UN);
+        return 0;
+    }
+
+  private:
+    /**
+     * @brief Layout of the shared memory object.
+     */
+    struct State
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t tokens;     // tokens left, in 1/tokenScale units
+        uint64_t refilled;   // boot time of the last refill, nanoseconds
+        Counters counters;
+    };
+
+    static_assert(std::is_trivially_copyable_v<State>);
+
+    Limits limits;
+    std::string name;
+    int fd       = -1;
+    int slot     = -1;
+    State* state = nullptr;
+
+    /** @brief Offset of the first slot lock byte */
+    static off_t slotBase()
+    {
+        return sizeof(State);
+    }
+
+    /** @brief Offset of the first queue place lock byte */
+    static off_t queueBase()
+    {
+        return slotBase() + slotsMax;
+    }
+
+    /** @brief A helper function to get nanoseconds since boot */
+    static uint64_t bootTime()
+    {
+        timespec now;
+        clock_gettime(CLOCK_BOOTTIME, &now);
+        return now.tv_sec * 1'000'000'000ull + now.tv_nsec;
+    }
+
+    /**
+     * Open and map the shared memory object, creating it if needed.
+     * @brief Open shared state.
+     *
+     * @return A non-zero error value or zero on success.
+     */
+    int open()
+    {
+        if (state)
+        {
+            return 0;
+        }
+
+        fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC,
+                      S_IRUSR | S_IWUSR);
+        if (fd < 0)
+        {
+            return 1;
+        }
+
+        int rc = 1;
+        struct stat shmStat;
+        if (!flock(fd, LOCK_EX))
+        {
+            // Only trust an object created by this user that nobody else
+            // can write.
+            if (!fstat(fd, &shmStat) && geteuid() == shmStat.st_uid &&
+                !(shmStat.st_mode & 077) &&
+                (sizeof(State) == static_cast<size_t>(shmStat.st_size) ||
+                 !ftruncate(fd, sizeof(State))))
+            {
+                void* addr = mmap(nullptr, sizeof(State),
+                                  PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                if (MAP_FAILED != addr)
+                {
+                    state = static_cast<State*>(addr);
+                    if (admissionMagic != state->magic ||
+                        admissionVersion != state->version)
+                    {
+                        memset(state, 0, sizeof(State));
+                        state->magic    = admissionMagic;
+                        state->version  = admissionVersion;
+                        state->tokens   = limits.burst * tokenScale;
+                        state->refilled = bootTime();
+                    }
+                    rc = 0;
+                }
+            }
+            flock(fd, LOCK_UN);
+        }
+
+        if (rc)
+        {
+            close(fd);
+            fd = -1;
+        }
+        return rc;
+    }
+
+    /** @brief A helper function to increment a shared counter */
+    void count(uint64_t Counters::*counter)
+    {
+        flock(fd, LOCK_EX);
+        state->counters.*counter += 1;
+        flock(fd, LOCK_UN);
+    }
+
+    /** @brief A helper function to take a token from the bucket */
+    bool takeToken()
+    {
+        if (!limits.rate)
+        {
+            return true;
+        }
+
+        flock(fd, LOCK_EX);
+
+        // Refill for the time passed since the last refill.
+        uint64_t now      = bootTime();
+        uint64_t elapsed  = now > state->refilled ? now - state->refilled : 0;
+        uint64_t added    = elapsed / 1'000'000 * limits.rate * tokenScale /
+                         60'000;
+        uint64_t capacity = uint64_t{limits.burst} * tokenScale;
+        if (added)
+        {
+            state->tokens   = std::min(state->tokens + added, capacity);
+            state->refilled = now;
+        }
+        state->tokens = std::min(state->tokens, capacity);
+
+        bool taken = state->tokens >= tokenScale;
+        if (taken)
+        {
+            state->tokens -= tokenScale;
+        }
+
+        flock(fd, LOCK_UN);
+        return taken;
+    }
+
+    /** @brief A helper function to take a free slot */
+    bool takeSlot()
+    {
+        slot = lockAny(slotBase(), limits.concurrent);
+        return slot >= 0;
+    }
+
+    /**
+     * Lock the first free byte of a range without waiting.
+     * @brief Lock a free byte.
+     *
+     * @param base      The offset of the first byte.
+     * @param count     The number of bytes in the range.
+     *
+     * @return The index of the locked byte or -1 if all were locked.
+     */
+    int lockAny(off_t base, unsigned count)
+    {
+        for (unsigned i = 0; i < count; i++)
+        {
+            struct flock lock = {};
+            lock.l_type       = F_WRLCK;
+            lock.l_whence     = SEEK_SET;
+            lock.l_start      = base + i;
+            lock.l_len        = 1;
+            if (!fcntl(fd, F_OFD_SETLK, &lock))
+            {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    /** @brief A helper function to unlock a byte locked by lockAny */
+    void unlockByte(off_t offset)
+    {
+        struct flock lock = {};
+        lock.l_type       = F_UNLCK;
+        lock.l_whence     = SEEK_SET;
+        lock.l_start      = offset;
+        lock.l_len        = 1;
+        fcntl(fd, F_OFD_SETLK, &lock);
+    }
+};
@@ -0,0 +1,391 @@
+#pragma once
+
+#include "tacfAdmission.hpp"
+#include "tacfDeadline.hpp"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+
+/**
+ * TacfBroker class for delegating ACF authentication to a local daemon.
+ *
+ * The daemon keeps the verified ACF, keyring and system state warm across
+ * logins. Clients send the password over a root only unix socket and receive
+ * the Tacf return code. Any failure to reach the daemon is reported to the
+ * caller so that it can fall back to authenticating in process.
+ */
+class TacfBroker
+{
+    /*
+     * @brief Implementation specific value definitions.
+     */
+    static constexpr auto brokerDir         = "/run/ibm-acf";
+    static constexpr auto brokerSocket      = "broker.sock";
+    static constexpr uint32_t brokerMagic   = 0x52424154; // "TABR"
+    static constexpr uint32_t brokerVersion = 4;
+    static constexpr size_t passwordMaxLen  = 512;
+    static constexpr int timeoutSeconds     = 10;
+    static constexpr int listenBacklog      = 16;
+
+    /**
+     * @brief Message sent by the client.
+     */
+    struct Request
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t ticketLifetime;
+        uint32_t maxHashes;
+        uint32_t maxQueued;
+        uint32_t hashRate;
+        uint32_t hashBurst;
+        int64_t deadline; // steady clock time the client gives up, in ns
+        char password[passwordMaxLen + 1];
+    };
+
+    /**
+     * @brief Message returned by the daemon.
+     */
+    struct Response
+    {
+        uint32_t magic;
+        uint32_t version;
+        int32_t rc;
+    };
+
+  public:
+    /**
+     * @param directory The directory holding the broker socket.
+     */
+    explicit TacfBroker(const std::string& directory = brokerDir) :
+        directory(directory), socketPath(directory + "/" + brokerSocket)
+    {}
+
+    /** @brief Daemon handler returning the Tacf code for a request */
+    using Handler =
+        std::function<int(const char*, std::chrono::seconds,
+                          const TacfAdmission::Limits&,
+                          std::chrono::steady_clock::time_point,
+                          const TacfCancelToken&)>;
+
+    /**
+     * Authenticate a password using the broker daemon.
+     * @brief Delegate authentication.
+     *
+     * @param password  A pointer to a password used for authentication.
+     * @param lifetime  The password ticket lifetime, zero disables tickets.
+     * @param limits    The password check admission limits.
+     * @param rc        The Tacf return code provided by the daemon.
+     *
+     * @return A non-zero error value if the daemon could not be used or zero
+     *         if rc was populated.
+     */
+    int authenticate(const char* password, std::chrono::seconds lifetime,
+                     const TacfAdmission::Limits& limits, int& rc) const
+    {
+        if (!password || strlen(password) > passwordMaxLen)
+        {
+            return 1;
+        }
+
+        int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+        {
+            return 1;
+        }
+
+        sockaddr_un addr = socketAddress();
+        Request request  = {brokerMagic,
+                            brokerVersion,
+                            static_cast<uint32_t>(lifetime.count()),
+                            limits.concurrent,
+                            limits.queued,
+                            limits.rate,
+                            limits.burst,
+                            0,
+                            {}};
+        Response response;
+        strcpy(request.password, password);
+
+        // Only trust an answer from a daemon running as root. The answer is
+        // waited for until the receive timeout, which the daemon is told.
+        int result = 1;
+        if (!setTimeout(fd) && !connect(fd, (sockaddr*)&addr, sizeof(addr)) &&
+            isTrustedPeer(fd))
+        {
+            request.deadline = toNanoseconds(
+                std::chrono::steady_clock::now() +
+                std::chrono::seconds(timeoutSeconds));
+            if (!sendMessage(fd, request) && !receiveMessage(fd, response) &&
+                brokerMagic == response.magic &&
+                brokerVersion == response.version)
+            {
+                rc     = response.rc;
+                result = 0;
+            }
+        }
+
+        explicit_bzero(&request, sizeof(request));
+        close(fd);
+
+        return result;
+    }
+
+    /**
+     * Create the listening socket of the broker daemon.
+     * @brief Listen for clients.
+     *
+     * @param fd    The listening socket file descriptor to populate.
+     *
+     * @return A non-zero error value or zero on success.
+     */
+    int listen(int& fd) const
+    {
+        if (mkdir(directory.c_str(), S_IRWXU) && EEXIST != errno)
+        {
+            return 1;
+        }
+
+        fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+        {
+            return 1;
+        }
+
+        // Remove a socket left behind by a previous instance.
+        unlink(socketPath.c_str());
+
+        sockaddr_un addr = socketAddress();
+        if (bind(fd, (sockaddr*)&addr, sizeof(addr)) ||
+            chmod(socketPath.c_str(), S_IRUSR | S_IWUSR) ||
+            ::listen(fd, listenBacklog))
+        {
+            close(fd);
+            fd = -1;
+            return 1;
+        }
+
+        return 0;
+    }
+
+    /**
+     * Accept and answer a single client request. A client that gave up
+     * waiting while queued behind other clients is not answered.
+     * @brief Serve a client.
+     *
+     * @param fd            The listening socket file descriptor.
+     * @param authenticate  Handler returning the Tacf code for a password,
+     *                      password ticket lifetime and password check
+     *                      admission limits. It is given the time by which
+     *                      the answer is needed, and a token cancelled once
+     *                      the client hangs up.
+     *
+     * @return A non-zero error value or zero on success.
+     */
+    int serve(int fd, const Handler& authenticate) const
+    {
+        int client = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0)
+        {
+            return 1;
+        }
+
+        Request request;
+        int result = 1;
+
+        // A stalled client must not hold up other logins.
+        if (!setTimeout(client) && isTrustedPeer(client) &&
+            !receiveMessage(client, request) && brokerMagic == request.magic &&
+            brokerVersion == request.version)
+        {
+            request.password[passwordMaxLen] = '\0';
+
+            // Answer a little before the client gives up waiting. The client
+            // started waiting when it sent the request, which may have been
+            // a while ago if other clients were served first.
+            auto now      = std::chrono::steady_clock::now();
+            auto deadline = std::min(now + std::chrono::seconds(timeoutSeconds),
+                                     fromNanoseconds(request.deadline)) -
+                            deadlineMargin;
+            TacfAdmission::Limits limits;
+            limits.concurrent = request.maxHashes;
+            limits.queued     = request.maxQueued;
+            limits.rate       = request.hashRate;
+            limits.burst      = request.hashBurst;
+
+            if (deadline > now)
+            {
+                TacfCancelToken cancel;
+                int rc;
+                {
+                    HangupWatch watch(client, cancel);
+                    rc = authenticate(
+                        request.password,
+                        std::chrono::seconds(request.ticketLifetime), limits,
+                        deadline, cancel);
+                }
+
+                Response response = {brokerMagic, brokerVersion, rc};
+
+                result = sendMessage(client, response);
+            }
+        }
+
+        explicit_bzero(&request, sizeof(request));
+        close(client);
+
+        return result;
+    }
+
+  private:
+    static constexpr auto deadlineMargin = std::chrono::seconds(1);
+
+    std::string directory;
+    std::string socketPath;
+
+    /**
+     * Watches a client on a separate thread while its request is handled,
+     * and cancels the token if the client hangs up.
+     * @brief Client hangup watch.
+     */
+    class HangupWatch
+    {
+      public:
+        HangupWatch(int client, TacfCancelToken& cancel) :
+            wake(eventfd(0, EFD_CLOEXEC))
+        {
+            // Without a wake up event the request is simply not cancelled.
+            if (wake < 0)
+            {
+                return;
+            }
+            try
+            {
+                watcher = std::jthread(watch, client, wake, std::ref(cancel));
+            }
+            catch (const std::system_error& e)
+            {}
+        }
+
+        HangupWatch(const HangupWatch&)            = delete;
+        HangupWatch& operator=(const HangupWatch&) = delete;
+
+        ~HangupWatch()
+        {
+            // Should the event fail the watcher still stops at the client
+            // timeout.
+            if (watcher.joinable())
+            {
+                eventfd_write(wake, 1);
+                watcher.join();
+            }
+            if (wake >= 0)
+            {
+                close(wake);
+            }
+        }
+
+      private:
+        int wake;
+        std::jthread watcher;
+
+        /** @brief Wait for the client to hang up or the wake up event */
+        static void watch(int client, int wake, TacfCancelToken& cancel)
+        {
+            pollfd fds[] = {{client, POLLRDHUP, 0}, {wake, POLLIN, 0}};
+            int rc;
+            do
+            {
+                rc = poll(fds, 2, timeoutSeconds * 1000);
+            } while (rc < 0 && EINTR == errno);
+
+            if (rc > 0 && (fds[0].revents & (POLLRDHUP | POLLHUP | POLLERR)))
+            {
+                cancel.cancel();
+            }
+        }
+    };
+
+    /** @brief A helper function to send a complete message */
+    template <typename T>
+    static int sendMessage(int fd, const T& message)
+    {
+        ssize_t len = send(fd, &message, sizeof(T), MSG_NOSIGNAL);
+        return sizeof(T) != static_cast<size_t>(len);
+    }
+
+    /** @brief A helper function to receive a complete message */
+    template <typename T>
+    static int receiveMessage(int fd, T& message)
+    {
+        ssize_t len = recv(fd, &message, sizeof(T), 0);
+        return sizeof(T) != static_cast<size_t>(len);
+    }
+
+    /** @brief A helper function to get the broker socket address */
+    sockaddr_un socketAddress() const
+    {
+        sockaddr_un addr = {};
+        addr.sun_family  = AF_UNIX;
+        strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+        return addr;
+    }
+
+    /** @brief A helper function to pass a steady clock time to the daemon */
+    static int64_t toNanoseconds(std::chrono::steady_clock::time_point time)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   time.time_since_epoch())
+            .count();
+    }
+
+    /** @brief A helper function to read a steady clock time from a client */
+    static std::chrono::steady_clock::time_point
+        fromNanoseconds(int64_t nanoseconds)
+    {
+        return std::chrono::steady_clock::time_point(
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::nanoseconds(nanoseconds)));
+    }
+
+    /** @brief A helper function to bound blocking socket operations */
+    static int setTimeout(int fd)
+    {
+        timeval timeout = {timeoutSeconds, 0};
+        return setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+                          sizeof(timeout)) ||
+               setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout,
+                          sizeof(timeout));
+    }
+
+    /**
+     * Check the other end is owned by root, or by the user of this process
+     * which could do anything the other end can anyway.
+     * @brief Check peer credentials.
+     *
+     * @param fd    The connected socket file descriptor.
+     *
+     * @return True if the other end can be trusted.
+     */
+    static bool isTrustedPeer(int fd)
+    {
+        ucred cred;
+        socklen_t len = sizeof(cred);
+        return !getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) &&
+               (0 == cred.uid || geteuid() == cred.uid);
+    }
+};
@@ -0,0 +1,418 @@
+#pragma once
+
+#include "tacfKeyring.hpp"
+
+#include <CeLogin.h>
+#include <fcntl.h>
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/**
+ * TacfCache class for sharing a verified service ACF between processes.
+ *
+ * A login through sshd runs in a new process for every connection, so the
+ * verified ACF is kept in a POSIX shared memory object rather than in the
+ * process. The entry is keyed by the ACF file identity (inode, mtime, size)
+ * and by a digest over the ACF contents, the system serial number and the
+ * public keys that were eligible to verify it. Any change to one of those
+ * makes the entry a miss and the ACF is verified again.
+ *
+ * A separate object remembers which public key verified the most recently
+ * seen ACFs, so that any ACF operation only has to verify the signature once.
+ */
+class TacfCache
+{
+    /*
+     * @brief Implementation specific value definitions.
+     */
+    static constexpr auto cacheName        = "/ibmacf-cache";
+    static constexpr auto keyHintName      = "/ibmacf-keyids";
+    static constexpr uint32_t cacheMagic   = 0x46434154; // "TACF"
+    static constexpr uint32_t cacheVersion = 3;
+    static constexpr size_t keyHintCount   = 8;
+
+  public:
+    /**
+     * @param name      The name of the shared memory object holding the entry.
+     * @param hintName  The name of the shared memory object holding the key
+     *                  hints.
+     */
+    explicit TacfCache(const std::string& name     = cacheName,
+                       const std::string& hintName = keyHintName) :
+        name(name), hintName(hintName)
+    {}
+
+    /**
+     * @brief Identity of a verified ACF.
+     */
+    struct Key
+    {
+        uint64_t dev;
+        uint64_t ino;
+        uint64_t mtimeSec;
+        uint64_t mtimeNsec;
+        uint64_t size;
+        uint8_t digest[SHA512_DIGEST_LENGTH];
+
+        bool operator==(const Key&) const = default;
+    };
+
+    /**
+     * Build the cache key for an ACF that was read from a file.
+     * @brief Make cache key.
+     *
+     * @param pathname  The path and name of the ACF file.
+     * @param acf       A pointer to the ACF read from the file.
+     * @param acfSize   The size of the ACF.
+     * @param serial    The system serial number.
+     * @param keyring   The public key files eligible to verify the ACF.
+     * @param key       The key value to populate.
+     *
+     * @return A non-zero error value or zero on success.
+     */
+    int makeKey(const std::string& pathname, const uint8_t* acf,
+                size_t acfSize, const std::string& serial,
+                const std::vector<std::string>& keyring, Key& key) const
+    {
+        struct stat acfStat;
+        if (!acf || !acfSize || stat(pathname.c_str(), &acfStat))
+        {
+            return 1;
+        }
+
+        memset(&key, 0, sizeof(key));
+        key.dev       = acfStat.st_dev;
+        key.ino       = acfStat.st_ino;
+        key.mtimeSec  = acfStat.st_mtim.tv_sec;
+        key.mtimeNsec = acfStat.st_mtim.tv_nsec;
+        key.size      = acfStat.st_size;
+
+        EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+        if (!ctx)
+        {
+            return 1;
+        }
+
+        int rc = 1;
+        if (1 == EVP_DigestInit_ex(ctx, EVP_sha512(), nullptr) &&
+            1 == EVP_DigestUpdate(ctx, acf, acfSize) &&
+            1 == EVP_DigestUpdate(ctx, serial.data(), serial.size() + 1))
+        {
+            rc = 0;
+
+            // A replaced or removed key file must invalidate the entry.
+            for (const auto& keyPath : keyring)
+            {
+                struct stat keyStat;
+                uint64_t keyId[4] = {};
+                if (!stat(keyPath.c_str(), &keyStat))
+                {
+                    keyId[0] = keyStat.st_ino;
+                    keyId[1] = keyStat.st_mtim.tv_sec;
+                    keyId[2] = keyStat.st_mtim.tv_nsec;
+                    keyId[3] = keyStat.st_size;
+                }
+                if (1 != EVP_DigestUpdate(ctx, keyPath.c_str(),
+                                          keyPath.size() + 1) ||
+                    1 != EVP_DigestUpdate(ctx, keyId, sizeof(keyId)))
+                {
+                    rc = 1;
+                    break;
+                }
+            }
+        }
+
+        if (!rc && 1 != EVP_DigestFinal_ex(ctx, key.digest, nullptr))
+        {
+            rc = 1;
+        }
+        EVP_MD_CTX_free(ctx);
+
+        return rc;
+    }
+
+    /**
+     * Retrieve the verified ACF record matching a key.
+     * @brief Lookup cache entry.
+     *
+     * @param key       The key of the ACF being authenticated.
+     * @param record    The verified ACF record to populate.
+     *
+     * @return A non-zero error value or zero on success.
+     */
+    int lookup(const Key& key, CeLogin::AcfAuthRecord& record) const
+    {
+        return accessEntry(O_RDONLY, LOCK_SH, [&](Entry& entry) {
+            if (!isMatch(entry, key))
+            {
+                return 1;
+            }
+            record = entry.record;
+            return 0;
+        });
+    }
+
+    /**
+     * Store a verified ACF record replacing any existing entry.
+     * @brief Store cache entry.
+     *
+     * @param key       The key of the verified ACF.
+     * @param record    The verified ACF record.
+     *
+     * @return A non-zero error value or zero on success.
+     */
+    int store(const Key& key, const CeLogin::AcfAuthRecord& record) const
+    {
+        return accessEntry(O_RDWR | O_CREAT, LOCK_EX, [&](Entry& entry) {
+            entry.magic   = cacheMagic;
+            entry.version = cacheVersion;
+            entry.key     = key;
+            entry.record  = record;
+            return 0;
+        });
+    }
+
+    /**
+     * Retrieve the identifier of the public key that verified an ACF.
+     * @brief Lookup key hint.
+     *
+     * @param acf       A pointer to an ASN1 encoded binary ACF.
+     * @param acfSize   The size of the ASN1 encoded binary ACF.
+     * @param keyId     The key identifier to populate.
+     *
+     * @return A non-zero error value or zero on success.
+     */
+    int lookupKeyId(const uint8_t* acf, size_t acfSize,
+                    TacfKeyring::KeyId& keyId) const
+    {
+        uint8_t digest[SHA256_DIGEST_LENGTH];
+        if (!acf || !SHA256(acf, acfSize, digest))
+        {
+            return 1;
+        }
+
+        return accessObject<KeyHints>(
+            hintName.c_str(), O_RDONLY, LOCK_SH, [&](KeyHints& hints) {
+                if (cacheMagic != hints.magic ||
+                    cacheVersion != hints.version)
+                {
+                    return 1;
+                }
+                for (const auto& hint : hints.hints)
+                {
+                    if (!memcmp(hint.acfDigest, digest, sizeof(digest)))
+                    {
+                        keyId = hint.keyId;
+                        return 0;
+                    }
+                }
+                return 1;
+            });
+    }
+
+    /**
+     * Remember the identifier of the public key that verified an ACF. The
+     * oldest hint is replaced once the table is full.
+     * @brief Store key hint.
+     *
+     * @param acf       A pointer to an ASN1 encoded binary ACF.
+     * @param acfSize   The size of the ASN1 encoded binary ACF.
+     * @param keyId     The identifier of the key that verified the ACF.
+     *
+     * @return A non-zero error value or zero on success.
+     */
+    int storeKeyId(const uint8_t* acf, size_t acfSize,
+                   const TacfKeyring::KeyId& keyId) const
+    {
+        uint8_t digest[SHA256_DIGEST_LENGTH];
+        if (!acf || !SHA256(acf, acfSize, digest))
+        {
+            return 1;
+        }
+
+        return accessObject<KeyHints>(
+            hintName.c_str(), O_RDWR | O_CREAT, LOCK_EX, [&](KeyHints& hints) {
+                if (cacheMagic != hints.magic ||
+                    cacheVersion != hints.version)
+                {
+                    memset(&hints, 0, sizeof(hints));
+                    hints.magic   = cacheMagic;
+                    hints.version = cacheVersion;
+                }
+
+                // Update the hint of a known ACF in place.
+                KeyHint* hint = std::find_if(
+                    std::begin(hints.hints), std::end(hints.hints),
+                    [&digest](const KeyHint& known) {
+                        return !memcmp(known.acfDigest, digest, sizeof(digest));
+                    });
+                if (std::end(hints.hints) == hint)
+                {
+                    hint       = &hints.hints[hints.next % keyHintCount];
+                    hints.next = (hints.next + 1) % keyHintCount;
+                }
+
+                memcpy(hint->acfDigest, digest, sizeof(digest));
+                hint->keyId = keyId;
+                return 0;
+            });
+    }
+
+    /**
+     * Drop the cached ACF, used when the ACF is installed or removed.
+     * @brief Invalidate cache.
+     */
+    void invalidate() const
+    {
+        shm_unlink(name.c_str());
+    }
+
+  private:
+    /**
+     * @brief Layout of the shared memory object.
+     */
+    struct Entry
+    {
+        uint32_t magic;
+        uint32_t version;
+        Key key;
+        CeLogin::AcfAuthRecord record;
+    };
+
+    /**
+     * @brief Public key that verified an ACF.
+     */
+    struct KeyHint
+    {
+        uint8_t acfDigest[SHA256_DIGEST_LENGTH];
+        TacfKeyring::KeyId keyId;
+    };
+
+    /**
+     * @brief Layout of the key hint shared memory object.
+     */
+    struct KeyHints
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t next;
+        KeyHint hints[keyHintCount];
+    };
+
+    static_assert(std::is_trivially_copyable_v<CeLogin::AcfAuthRecord>);
+    static_assert(std::is_trivially_copyable_v<KeyHints>);
+
+    std::string name;
+    std::string hintName;
+
+    /** @brief A helper function to check an entry is for a key */
+    static bool isMatch(const Entry& entry, const Key& key)
+    {
+        return cacheMagic == entry.magic && cacheVersion == entry.version &&
+               key == entry.key;
+    }
+
+    /** @brief A helper function to access the cache entry */
+    template <typename Operation>
+    int accessEntry(int flags, int lock, Operation operation) const
+    {
+        return accessObject<Entry>(name.c_str(), flags, lock, operation);
+    }
+
+    /**
+     * Open, lock and map a shared memory object and run an operation on
+     * the object it holds.
+     * @brief Access shared memory object.
+     *
+     * @param name      The name of the shared memory object.
+     * @param flags     The shm_open flags, O_CREAT sizes a new object.
+     * @param lock      The flock operation to hold during the access.
+     * @param operation The operation to run on the object.
+     *
+     * @return A non-zero error value or the operation result.
+     */
+    template <typename Object, typename Operation>
+    static int accessObject(const char* name, int flags, int lock,
+                            Operation operation)
+    {
+        int fd = shm_open(name, flags, S_IRUSR | S_IWUSR);
+        if (fd < 0)
+        {
+            return 1;
+        }
+
+        int rc = 1;
+        if (!flock(fd, lock))
+        {
+            struct stat shmStat;
+            if (!(flags & O_CREAT) ||
+                (!fstat(fd, &shmStat) && isTrusted(shmStat) &&
+                 !ftruncate(fd, sizeof(Object))))
+            {
+                Object* object = mapObject<Object>(
+                    fd, (flags & O_RDWR) ? PROT_READ | PROT_WRITE : PROT_READ);
+                if (object)
+                {
+                    rc = operation(*object);
+                    munmap(object, sizeof(Object));
+                }
+            }
+            flock(fd, LOCK_UN);
+        }
+        close(fd);
+
+        return rc;
+    }
+
+    /**
+     * Only trust an object created by this user that nobody else can write.
+     * @brief Check shared memory ownership.
+     *
+     * @param shmStat   The status of the shared memory object.
+     *
+     * @return True if the shared memory object can be trusted.
+     */
+    static bool isTrusted(const struct stat& shmStat)
+    {
+        return geteuid() == shmStat.st_uid && !(shmStat.st_mode & 077);
+    }
+
+    /**
+     * Map the object held by an open shared memory object.
+     * @brief Map shared memory object.
+     *
+     * @param fd    The shared memory file descriptor.
+     * @param prot  The memory protection of the mapping.
+     *
+     * @return A pointer to the mapped object or nullptr on error.
+     */
+    template <typename Object>
+    static Object* mapObject(int fd, int prot)
+    {
+        struct stat shmStat;
+        if (fstat(fd, &shmStat) || !isTrusted(shmStat) ||
+            sizeof(Object) != static_cast<size_t>(shmStat.st_size))
+        {
+            return nullptr;
+        }
+
+        void* addr = mmap(nullptr, sizeof(Object), prot, MAP_SHARED, fd, 0);
+        if (MAP_FAILED == addr)
+        {
+            return nullptr;
+        }
+
+        return static_cast<Object*>(addr);
+    }
+};
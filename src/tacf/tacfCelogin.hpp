@@ -1,12 +1,15 @@
 #pragma once
 
 #include <CeLogin.h>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
 
 #include <ce_logger.hpp>
 
 #include <chrono>
 #include <cstdint>
 #include <iostream>
+#include <memory>
 #include <string>
 /**
  * TacfCelogin class for access control file (ACF) processing.
@@ -33,6 +36,56 @@ class TacfCelogin
                      const uint8_t* pubkey, const uint64_t pubkeySize,
                      const char* password, const std::string& serial,
                      uint64_t& replayId)
+    {
+        PublicKey key = importKey(pubkey, pubkeySize);
+        if (!key)
+        {
+            return CeLogin::CeLoginRc::VerifyAcf_PublicKeyImportFailure;
+        }
+        return authenticate(acf, acfSize, key.get(), password, serial,
+                            replayId);
+    }
+
+    /**
+     * Authenticate against ACF using a password.
+     * @brief ACF authentication, parsed public key.
+     *
+     * @param acf           A pointer to an ASN1 encoded binary ACF.
+     * @param acfSize       The size of the ASN1 encoded binary ACF.
+     * @param pubkey        A parsed public key for validating the ACF.
+     * @param password      Pointer to a password for authentication.
+     * @param serial        Serial number of machine associated with the ACF.
+     * @param replayId      Current and updated replay id value.
+     *
+     * @return A non-zero error value or zero on success.
+     */
+    int authenticate(const uint8_t* acf, const uint64_t acfSize,
+                     EVP_PKEY* pubkey, const char* password,
+                     const std::string& serial, uint64_t& replayId)
+    {
+        return authenticate(acf, acfSize, pubkey, password, serial, replayId,
+                            nullptr);
+    }
+
+    /**
+     * Authenticate against ACF using a password.
+     * @brief ACF authentication, parsed public key, stoppable password hash.
+     *
+     * @param acf           A pointer to an ASN1 encoded binary ACF.
+     * @param acfSize       The size of the ASN1 encoded binary ACF.
+     * @param pubkey        A parsed public key for validating the ACF.
+     * @param password      Pointer to a password for authentication.
+     * @param serial        Serial number of machine associated with the ACF.
+     * @param replayId      Current and updated replay id value.
+     * @param control       Decides whether the password hash goes on, the
+     *                      hash is not stopped if null.
+     *
+     * @return A non-zero error value or zero on success.
+     */
+    int authenticate(const uint8_t* acf, const uint64_t acfSize,
+                     EVP_PKEY* pubkey, const char* password,
+                     const std::string& serial, uint64_t& replayId,
+                     const CeLogin::PasswordHashControl* control)
     {
         uint64_t timestamp = getTimestamp();
 
@@ -40,10 +93,14 @@ class TacfCelogin
 
         // Authenticate with password.
         CeLogin::CeLoginRc authRc =
-            CeLogin::checkAuthorizationAndGetAcfUserFieldsV2(
-                acf, acfSize, password, strlen(password), timestamp, pubkey,
-                pubkeySize, serial.data(), serial.size(), replayId,
-                acfUserFields);
+            control ? CeLogin::checkAuthorizationAndGetAcfUserFieldsV2(
+                          acf, acfSize, password, strlen(password), timestamp,
+                          pubkey, serial.data(), serial.size(), replayId,
+                          acfUserFields, *control)
+                    : CeLogin::checkAuthorizationAndGetAcfUserFieldsV2(
+                          acf, acfSize, password, strlen(password), timestamp,
+                          pubkey, serial.data(), serial.size(), replayId,
+                          acfUserFields);
 
         // Return celogin specific error code.
         if (CeLogin::CeLoginRc::Success != authRc)
@@ -55,6 +112,73 @@ class TacfCelogin
         return authRc;
     }
 
+    /**
+     * Authenticate against a previously verified ACF using a password.
+     * @brief ACF authentication, verified ACF, stoppable password hash.
+     *
+     * @param record        The verified ACF record.
+     * @param password      Pointer to a password for authentication.
+     * @param replayId      Current replay id value.
+     * @param control       Decides whether the password hash goes on, the
+     *                      hash is not stopped if null.
+     *
+     * @return A non-zero error value or zero on success.
+     */
+    int authenticate(const CeLogin::AcfAuthRecord& record,
+                     const char* password, uint64_t replayId,
+                     const CeLogin::PasswordHashControl* control)
+    {
+        uint64_t timestamp = getTimestamp();
+        uint64_t length    = password ? strlen(password) : 0;
+
+        CeLogin::AcfUserFields acfUserFields;
+
+        // Authenticate with password, the signature is already verified.
+        CeLogin::CeLoginRc authRc =
+            control ? CeLogin::checkAuthorizationWithAcfAuthRecordV2(
+                          record, password, length, timestamp, replayId,
+                          acfUserFields, *control)
+                    : CeLogin::checkAuthorizationWithAcfAuthRecordV2(
+                          record, password, length, timestamp, replayId,
+                          acfUserFields);
+
+        // Return celogin specific error code.
+        if (CeLogin::CeLoginRc::Success != authRc)
+        {
+            CE_LOG_DEBUG("Failed to authenticate error code ", authRc);
+        }
+        // Or success.
+        return authRc;
+    }
+
+    /**
+     * Verify a service ACF and retrieve the record used for authentication.
+     * @brief ACF verification for authentication, reusable verifier.
+     *
+     * @param acf           A pointer to an ASN1 encoded binary ACF.
+     * @param acfSize       The size of the ASN1 encoded binary ACF.
+     * @param verifier      The verifier holding the public keys to try.
+     * @param serial        Serial number of machine associated with the ACF.
+     * @param record        The verified ACF record to populate.
+     * @param keyIndex      The index of the key matching the ACF signature to
+     *                      populate, the number of keys if none matched.
+     *
+     * @return A non-zero error value or zero on success.
+     */
+    int authRecord(const uint8_t* acf, const uint64_t acfSize,
+                   CeLogin::CeLoginVerifier& verifier,
+                   const std::string& serial, CeLogin::AcfAuthRecord& record,
+                   size_t& keyIndex)
+    {
+        uint64_t index = verifier.getPublicKeyCount();
+        int rc         = CeLogin::getAcfAuthRecordV2(
+            acf, acfSize, getTimestamp(), verifier, serial.data(),
+            serial.size(), record, index);
+        keyIndex = index;
+
+        return rc;
+    }
+
     /**
      * Install ACF and retrieve a the ACF type, replay id, expiration time. In
      * the case of ACF type admin-reset the ecrypted admin password associated
@@ -81,27 +205,64 @@ class TacfCelogin
                 std::string& expireDate, uint64_t& replayId,
                 CeLogin::AcfUserFields& acfUserFields)
     {
-        uint64_t replayIdNew;
-        uint64_t timestamp = getTimestamp();
-        bool replayIdValid = true;
-
-        // If replay ID is invalid set to genesis
-        if (invalidReplayId == replayId)
+        PublicKey key = importKey(pubkey, pubkeySize);
+        if (!key)
         {
-            replayId      = 0;
-            replayIdValid = false;
+            return CeLogin::CeLoginRc::VerifyAcf_PublicKeyImportFailure;
         }
-
-        // Verify signature and get ACF type.
-        CeLogin::CeLoginRc authRc = CeLogin::verifyACFForBMCUploadV2(
-            acf, acfSize, timestamp, pubkey, pubkeySize, serial.data(),
-            serial.size(), replayId, replayIdNew, type, expires);
-
-        // Restore invalid replay ID
-        if (!replayIdValid)
+        EVP_PKEY* pkey = key.get();
+        CeLogin::CeLoginVerifier verifier;
+        CeLogin::CeLoginRc rc = verifier.setPublicKeys(&pkey, 1);
+        if (CeLogin::CeLoginRc::Success != rc)
         {
-            replayId = invalidReplayId;
+            return rc;
         }
+        size_t keyIndex;
+        return install(acf, acfSize, verifier, serial, auth, type, expires,
+                       expireDate, replayId, acfUserFields, keyIndex);
+    }
+
+    /**
+     * Install ACF and retrieve a the ACF type, replay id, expiration time. In
+     * the case of ACF type admin-reset the ecrypted admin password associated
+     * with the ACF will also be returned.
+     * @brief ACF installation, reusable verifier.
+     *
+     * @param acf           A pointer to an ASN1 encoded binary ACF.
+     * @param acfSize       The size of the ASN1 encoded binary ACF.
+     * @param verifier      The verifier holding the public keys to try.
+     * @param serial        Serial number of machine associated with the ACF.
+     * @param auth          A user auth value to populate.
+     * @param type          The ACF type value to populate.
+     * @param expires       The ACF expiration time to populate.
+     * @param expireDate    The ACF expiration date to populate.
+     * @param replay        Current and updated replay id value.
+     * @param keyIndex      The index of the key matching the ACF signature to
+     *                      populate, the number of keys if none matched.
+     *
+     * @return A non-zero error value or zero on success.
+     */
+    int install(const uint8_t* acf, const uint64_t acfSize,
+                CeLogin::CeLoginVerifier& verifier,
+                const std::string& serial, std::string& auth,
+                CeLogin::AcfType& type, uint64_t& expires,
+                std::string& expireDate, uint64_t& replayId,
+                CeLogin::AcfUserFields& acfUserFields, size_t& keyIndex)
+    {
+        // If replay ID is invalid verify against genesis
+        bool replayIdValid = invalidReplayId != replayId;
+
+        // Verify signature and get every field needed for the install at
+        // once.
+        CeLogin::AcfVerifiedRecord record;
+        uint64_t index            = verifier.getPublicKeyCount();
+        CeLogin::CeLoginRc authRc = CeLogin::getAcfVerifiedRecordV2(
+            acf, acfSize, getTimestamp(), verifier, serial.data(),
+            serial.size(), replayIdValid ? replayId : 0, record, index);
+        keyIndex = index;
+
+        type    = record.mType;
+        expires = record.mExpirationTime;
 
         // Return celogin specific error code.
         if (CeLogin::CeLoginRc::Success != authRc)
@@ -109,70 +270,41 @@ class TacfCelogin
             return authRc;
         }
 
+        acfUserFields = record.mUserFields;
+
         // If ACF was reset-admin type then populate admin auth code.
-        if (CeLogin::AcfType::AcfType_AdminReset == type ||
-            CeLogin::AcfType::AcfType_ResourceDump == type ||
-            CeLogin::AcfType::AcfType_BmcShell == type)
+        if (CeLogin::AcfType::AcfType_AdminReset == type)
         {
-            // Validate ACF and retrieve user field
-            authRc = CeLogin::checkAuthorizationAndGetAcfUserFieldsV2(
-                acf, acfSize, nullptr, 0, timestamp, pubkey, pubkeySize,
-                serial.data(), serial.size(), replayIdNew, acfUserFields);
-
-            // Return celogin specific error code.
-            if (CeLogin::CeLoginRc::Success != authRc)
-            {
-                CE_LOG_DEBUG("Failed to process key ", pubkey, " error code ",
-                             authRc);
-                return authRc;
-            }
-            if (CeLogin::AcfType::AcfType_AdminReset == type)
-            {
-                // Get the encrypted admin password as a string.
-                auth = std::string(
-                    acfUserFields.mTypeSpecificFields.mAdminResetFields
-                        .mAdminAuthCode,
+            // Get the encrypted admin password as a string.
+            auth = std::string(
+                acfUserFields.mTypeSpecificFields.mAdminResetFields
+                    .mAdminAuthCode,
+                acfUserFields.mTypeSpecificFields.mAdminResetFields
+                        .mAdminAuthCode +
                     acfUserFields.mTypeSpecificFields.mAdminResetFields
-                            .mAdminAuthCode +
-                        acfUserFields.mTypeSpecificFields.mAdminResetFields
-                            .mAdminAuthCodeLength);
-            }
+                        .mAdminAuthCodeLength);
         }
 
-        // Get the ACF expiration details.
-        CeLogin::AcfType ceLoginType = CeLogin::AcfType::AcfType_Invalid;
-        CeLogin::AcfVersion version  = CeLogin::CeLoginInvalidVersion;
-        bool hasReplay               = false;
-        CeLogin::CeLogin_Date ceLoginDate;
+        // Get expiration date as string.
+        expireDate = getDate(record.mExpirationDate);
 
-        if (CeLogin::CeLoginRc::Success ==
-            CeLogin::extractACFMetadataV2(acf, acfSize, timestamp, pubkey,
-                                          pubkeySize, serial.data(),
-                                          serial.size(), ceLoginType, expires,
-                                          ceLoginDate, version, hasReplay))
+        // If replay ID required
+        if (record.mReplayIdPresent)
         {
-            // Get expiration date as string.
-            expireDate = getDate(ceLoginDate);
-
-            // If replay ID required
-            if (hasReplay)
+            // And replay ID is valid
+            if (replayIdValid)
+            {
+                // Update the replay ID.
+                replayId = record.mUpdatedReplayId;
+            }
+            else
             {
-                // And replay ID is valid
-                if (replayIdValid)
-                {
-                    // Update the replay ID.
-                    replayId = replayIdNew;
-                }
-                else
-                {
-                    CE_LOG_ERROR("Replay ID invalid");
-                    // Valid replay ID was required.
-                    return CeLogin::CeLoginRc::MissingReplayId;
-                }
+                CE_LOG_ERROR("Replay ID invalid");
+                // Valid replay ID was required.
+                return CeLogin::CeLoginRc::MissingReplayId;
             }
-            return CeLogin::CeLoginRc::Success;
         }
-        return CeLogin::CeLoginRc::Failure;
+        return CeLogin::CeLoginRc::Success;
     }
 
     /**
@@ -193,6 +325,42 @@ class TacfCelogin
                const uint8_t* pubkey, const uint64_t pubkeySize,
                const std::string& serial, uint64_t& expires,
                std::string& expireDate)
+    {
+        PublicKey key = importKey(pubkey, pubkeySize);
+        if (!key)
+        {
+            return CeLogin::CeLoginRc::VerifyAcf_PublicKeyImportFailure;
+        }
+        EVP_PKEY* pkey = key.get();
+        CeLogin::CeLoginVerifier verifier;
+        CeLogin::CeLoginRc rc = verifier.setPublicKeys(&pkey, 1);
+        if (CeLogin::CeLoginRc::Success != rc)
+        {
+            return rc;
+        }
+        size_t keyIndex;
+        return verify(acf, acfSize, verifier, serial, expires, expireDate,
+                      keyIndex);
+    }
+
+    /**
+     * Verify the ACF and the the expiration time.
+     * @brief ACF verification, reusable verifier.
+     *
+     * @param acf           A pointer to an ASN1 encoded binary ACF.
+     * @param acfSize       The size of the ASN1 encoded binary ACF.
+     * @param verifier      The verifier holding the public keys to try.
+     * @param serial        Serial number of machine associated with the ACF.
+     * @param expires       The ACF expiration time to populate.
+     * @param expireDate    The ACF expiration date to populate.
+     * @param keyIndex      The index of the key matching the ACF signature to
+     *                      populate, the number of keys if none matched.
+     *
+     * @return A non-zero error value or zero on success.
+     */
+    int verify(const uint8_t* acf, const uint64_t acfSize,
+               CeLogin::CeLoginVerifier& verifier, const std::string& serial,
+               uint64_t& expires, std::string& expireDate, size_t& keyIndex)
     {
         uint64_t timestamp           = getTimestamp();
         CeLogin::AcfType ceLoginType = CeLogin::AcfType::AcfType_Invalid;
@@ -201,10 +369,11 @@ class TacfCelogin
         CeLogin::CeLogin_Date ceLoginDate;
 
         // Verify the ACF and get ACF expiration details.
+        uint64_t index            = verifier.getPublicKeyCount();
         CeLogin::CeLoginRc authRc = CeLogin::extractACFMetadataV2(
-            acf, acfSize, timestamp, pubkey, pubkeySize, serial.data(),
-            serial.size(), ceLoginType, expires, ceLoginDate, version,
-            hasReplay);
+            acf, acfSize, timestamp, verifier, serial.data(), serial.size(),
+            ceLoginType, expires, ceLoginDate, version, hasReplay, index);
+        keyIndex = index;
 
         // Return celogin specific error code.
         if (CeLogin::CeLoginRc::Success != authRc)
@@ -221,6 +390,28 @@ class TacfCelogin
 
     const static uint64_t invalidReplayId = 0xffffffffffffffff;
 
+    /** @brief A parsed public key */
+    using PublicKey = std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)>;
+
+    /**
+     * Parse a DER encoded SubjectPublicKeyInfo.
+     * @brief Import public key.
+     *
+     * @param pubkey        A Pointer to a DER encoded public key.
+     * @param pubkeySize    The size of the public key.
+     *
+     * @return The parsed public key, empty on error.
+     */
+    static PublicKey importKey(const uint8_t* pubkey, const uint64_t pubkeySize)
+    {
+        if (!pubkey || !pubkeySize)
+        {
+            return PublicKey(nullptr, EVP_PKEY_free);
+        }
+        return PublicKey(d2i_PUBKEY(nullptr, &pubkey, pubkeySize),
+                         EVP_PKEY_free);
+    }
+
   private:
     /** @brief A helper function to get a current timestamp */
     uint64_t getTimestamp()
@@ -4,6 +4,7 @@
 #include <sdbusplus/bus.hpp>
 
 #include <cstdint>
+#include <optional>
 #include <string>
 #include <variant>
 #include <vector>
@@ -13,6 +14,14 @@
 class TacfDbus
 {
   public:
+    TacfDbus() = default;
+
+    /**
+     * @param bus   A connection kept by the caller, used to read properties
+     *              instead of connecting for every read.
+     */
+    explicit TacfDbus(sdbusplus::bus::bus& bus) : keptBus(&bus) {}
+
     /**
      * @brief Types of properties expected to be read.
      */
@@ -359,6 +368,8 @@ class TacfDbus
     }
 
   private:
+    sdbusplus::bus::bus* keptBus = nullptr;
+
     /**
      * Retrieve a property stored as a dbus property.
      * @brief Retrieve a property.
@@ -377,15 +388,22 @@ class TacfDbus
     {
         try
         {
+            // Use the kept connection if there is one.
+            std::optional<sdbusplus::bus::bus> local;
+            if (!keptBus)
+            {
+                local.emplace(sdbusplus::bus::new_default());
+            }
+            auto& connection = keptBus ? *keptBus : *local;
+
             // Craft the dbus method for reading the specified property.
-            auto bus = sdbusplus::bus::new_default();
-            auto method =
-                bus.new_method_call(service.c_str(), path.c_str(),
-                                    "org.freedesktop.DBus.Properties", "Get");
+            auto method = connection.new_method_call(
+                service.c_str(), path.c_str(),
+                "org.freedesktop.DBus.Properties", "Get");
             method.append(interface, property);
 
             // Check if dbus method call returned an error.
-            auto response = bus.call(method);
+            auto response = connection.call(method);
             if (response.is_method_error())
             {
                 return 1;
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <CeLogin.h>
+
+#include <atomic>
+#include <chrono>
+
+/**
+ * TacfCancelToken class for abandoning an authentication in progress.
+ *
+ * The token is cancelled by any thread, typically the one that noticed the
+ * client went away, and is checked by the thread hashing the password.
+ */
+class TacfCancelToken
+{
+  public:
+    /** @brief Ask the authentication using this token to stop */
+    void cancel()
+    {
+        flag.store(true, std::memory_order_relaxed);
+    }
+
+    /** @brief Whether the token was cancelled */
+    bool cancelled() const
+    {
+        return flag.load(std::memory_order_relaxed);
+    }
+
+  private:
+    std::atomic<bool> flag{false};
+};
+
+/**
+ * TacfDeadline class bounding the password hash of an authentication.
+ *
+ * The password hash asks the deadline whether to go on between blocks of
+ * iterations, and is stopped once the deadline has passed or the token was
+ * cancelled. The deadline remembers which of the two stopped it.
+ */
+class TacfDeadline
+{
+  public:
+    /** @brief Why the password hash was stopped */
+    enum class Reason
+    {
+        none,
+        timeout,
+        cancelled,
+    };
+
+    /**
+     * @param deadline  The time after which the password hash is stopped.
+     * @param cancel    The token stopping the password hash when cancelled.
+     */
+    TacfDeadline(std::chrono::steady_clock::time_point deadline,
+                 const TacfCancelToken& cancel) :
+        deadline(deadline), cancel(cancel), hashControl{shouldStop, this}
+    {}
+
+    TacfDeadline(const TacfDeadline&)            = delete;
+    TacfDeadline& operator=(const TacfDeadline&) = delete;
+
+    /** @brief The control to pass to the password hash */
+    const CeLogin::PasswordHashControl& control() const
+    {
+        return hashControl;
+    }
+
+    /** @brief The time after which the password hash is stopped */
+    std::chrono::steady_clock::time_point until() const
+    {
+        return deadline;
+    }
+
+    /** @brief The token stopping the password hash when cancelled */
+    const TacfCancelToken& token() const
+    {
+        return cancel;
+    }
+
+    /** @brief Why the password hash was stopped, none if it was not */
+    Reason reason() const
+    {
+        return stopped;
+    }
+
+  private:
+    std::chrono::steady_clock::time_point deadline;
+    const TacfCancelToken& cancel;
+    CeLogin::PasswordHashControl hashControl;
+    Reason stopped = Reason::none;
+
+    /** @brief Password hash control callback */
+    static bool shouldStop(void* context)
+    {
+        TacfDeadline* self = static_cast<TacfDeadline*>(context);
+        if (self->cancel.cancelled())
+        {
+            self->stopped = Reason::cancelled;
+        }
+        else if (std::chrono::steady_clock::now() >= self->deadline)
+        {
+            self->stopped = Reason::timeout;
+        }
+        return Reason::none != self->stopped;
+    }
+};
@@ -0,0 +1,311 @@
+#pragma once
+
+#include "tacfCelogin.hpp"
+
+#include <fcntl.h>
+#include <openssl/sha.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * TacfKeyring class for the public keys eligible to verify an ACF.
+ *
+ * Each key is identified by the SHA-256 digest of its DER encoded
+ * SubjectPublicKeyInfo, so the key that signed an ACF can be selected
+ * directly instead of trying every key in turn.
+ *
+ * Keys are parsed once and kept for the lifetime of the keyring. The key
+ * directories are watched with inotify and the keys are only read and parsed
+ * again after a key file is added, replaced or removed. The keys are also held
+ * by a verifier, which keeps its verification state for as long as the keys
+ * and their order are unchanged.
+ */
+class TacfKeyring
+{
+  public:
+    using KeyId = std::array<uint8_t, SHA256_DIGEST_LENGTH>;
+
+    /**
+     * @brief A loaded public key.
+     */
+    struct Key
+    {
+        std::string pathname;
+        std::vector<uint8_t> der;
+        KeyId id;
+        TacfCelogin::PublicKey pkey{nullptr, EVP_PKEY_free};
+    };
+
+    TacfKeyring() = default;
+
+    TacfKeyring(const TacfKeyring&)            = delete;
+    TacfKeyring& operator=(const TacfKeyring&) = delete;
+
+    ~TacfKeyring()
+    {
+        closeWatch();
+    }
+
+    /**
+     * Load the public keys, in order of preference. Key files that do not
+     * exist, are empty or cannot be parsed are skipped. Nothing is read if
+     * the same keys were loaded before and no key file changed since. Should
+     * the verifier not take the new keys the previous keys are kept, and the
+     * keys are read again on the next load.
+     * @brief Load public keys.
+     *
+     * @param pathnames The path and name of each public key file.
+     *
+     * @return A non-zero error value or zero on success.
+     */
+    int load(const std::vector<std::string>& pathnames)
+    {
+        if (pathnames == loadedPathnames && !isChanged())
+        {
+            return 0;
+        }
+
+        // Watch before reading so that a change during the read is not lost.
+        if (pathnames != loadedPathnames || watchFd < 0)
+        {
+            watch(pathnames);
+        }
+
+        std::vector<Key> candidates;
+        std::map<KeyId, size_t> candidateIndex;
+        for (const auto& pathname : pathnames)
+        {
+            Key key{pathname, {}, {}};
+            if (readFile(pathname, key.der) || key.der.empty() ||
+                !SHA256(key.der.data(), key.der.size(), key.id.data()))
+            {
+                continue;
+            }
+
+            key.pkey = TacfCelogin::importKey(key.der.data(), key.der.size());
+            if (!key.pkey)
+            {
+                continue;
+            }
+
+            // The same key installed twice only needs to be tried once.
+            if (candidateIndex.emplace(key.id, candidates.size()).second)
+            {
+                candidates.push_back(std::move(key));
+            }
+        }
+
+        int rc = updateVerifier(candidates);
+        if (rc)
+        {
+            // The verifier drops its keys on failure, so hand it the previous
+            // ones again.
+            updateVerifier(keys);
+            loadedPathnames.clear();
+            return rc;
+        }
+        keys.swap(candidates);
+        index.swap(candidateIndex);
+        loadedPathnames = pathnames;
+
+        return 0;
+    }
+
+    /**
+     * Move a key to the front so that it is tried first.
+     * @brief Prefer a key.
+     *
+     * @param id    The identifier of the preferred key.
+     *
+     * @return A non-zero error value if the key is not loaded or the
+     *         verifier did not take the new order, or zero on success.
+     */
+    int prefer(const KeyId& id)
+    {
+        auto found = index.find(id);
+        if (index.end() == found)
+        {
+            return 1;
+        }
+        if (0 == found->second)
+        {
+            return 0;
+        }
+
+        auto first = keys.begin();
+        auto last  = keys.begin() + found->second + 1;
+        std::rotate(first, last - 1, last);
+        int rc = updateVerifier(keys);
+        if (rc)
+        {
+            // Go back to the order the verifier had.
+            std::rotate(first, first + 1, last);
+            updateVerifier(keys);
+            return rc;
+        }
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            index[keys[i].id] = i;
+        }
+
+        return 0;
+    }
+
+    /** @brief The loaded keys, in the order they should be tried */
+    const std::vector<Key>& loaded() const
+    {
+        return keys;
+    }
+
+    /** @brief A verifier for the loaded keys, trying them in the same order */
+    CeLogin::CeLoginVerifier& verifier()
+    {
+        return keyVerifier;
+    }
+
+  private:
+    static constexpr uint32_t watchMask = IN_CLOSE_WRITE | IN_CREATE |
+                                          IN_DELETE | IN_MOVED_FROM |
+                                          IN_MOVED_TO | IN_ATTRIB |
+                                          IN_DELETE_SELF | IN_MOVE_SELF;
+
+    std::vector<Key> keys;
+    std::map<KeyId, size_t> index;
+    std::vector<std::string> loadedPathnames;
+    CeLogin::CeLoginVerifier keyVerifier;
+    int watchFd = -1;
+
+    /**
+     * Watch the directories holding the key files. Without a watch on every
+     * directory the keys are read again on each load.
+     * @brief Watch key directories.
+     *
+     * @param pathnames The path and name of each public key file.
+     */
+    void watch(const std::vector<std::string>& pathnames)
+    {
+        closeWatch();
+
+        watchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (watchFd < 0)
+        {
+            return;
+        }
+
+        std::set<std::string> directories;
+        for (const auto& pathname : pathnames)
+        {
+            directories.insert(
+                std::filesystem::path(pathname).parent_path().string());
+        }
+        for (const auto& directory : directories)
+        {
+            if (inotify_add_watch(watchFd, directory.c_str(), watchMask) < 0)
+            {
+                closeWatch();
+                return;
+            }
+        }
+    }
+
+    /**
+     * Drain the pending inotify events.
+     * @brief Check for key file changes.
+     *
+     * @return True if a key file may have changed since the last load.
+     */
+    bool isChanged()
+    {
+        if (watchFd < 0)
+        {
+            return true;
+        }
+
+        bool changed = false;
+        alignas(inotify_event) char buffer[4096];
+        ssize_t len;
+        while ((len = read(watchFd, buffer, sizeof(buffer))) > 0)
+        {
+            changed = true;
+        }
+
+        // Assume the worst if the watch can no longer be read.
+        if (len < 0 && EAGAIN != errno && EWOULDBLOCK != errno)
+        {
+            closeWatch();
+            return true;
+        }
+
+        // A removed or moved directory is no longer watched, so watch again.
+        if (changed)
+        {
+            closeWatch();
+        }
+
+        return changed;
+    }
+
+    /**
+     * Hand the keys, in order, to the verifier.
+     * @brief Update verifier.
+     *
+     * @param candidates    The keys for the verifier to hold.
+     *
+     * @return A non-zero error value or zero on success.
+     */
+    int updateVerifier(const std::vector<Key>& candidates)
+    {
+        std::vector<EVP_PKEY*> pkeys;
+        for (const auto& key : candidates)
+        {
+            pkeys.push_back(key.pkey.get());
+        }
+
+        // Without keys the verifier is left empty, which fails verification,
+        // so the error that no keys were given is expected.
+        CeLogin::CeLoginRc rc =
+            keyVerifier.setPublicKeys(pkeys.data(), pkeys.size());
+        if (pkeys.empty() || CeLogin::CeLoginRc::Success == rc)
+        {
+            return 0;
+        }
+        return rc;
+    }
+
+    /** @brief A helper function to stop watching the key directories */
+    void closeWatch()
+    {
+        if (watchFd >= 0)
+        {
+            close(watchFd);
+            watchFd = -1;
+        }
+    }
+
+    /** @brief A helper function to read a key file */
+    static int readFile(const std::string& pathname,
+                        std::vector<uint8_t>& buffer)
+    {
+        std::ifstream file(pathname, std::ios::binary);
+        if (!file)
+        {
+            return 1;
+        }
+        buffer.assign(std::istreambuf_iterator<char>(file),
+                      std::istreambuf_iterator<char>());
+
+        return file.bad() ? 1 : 0;
+    }
+};
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "tacfCache.hpp"
+
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+/**
+ * TacfTicket class for reusing a successful service password check.
+ *
+ * The ticket holds an HMAC of the last accepted password and the identity of
+ * the verified ACF, under a key that is drawn at random when the ticket is
+ * created. Neither the key nor the HMAC ever leave the process, so the ticket
+ * is only useful to a long lived process such as the broker daemon, and
+ * nothing readable by others allows offline password guesses.
+ */
+class TacfTicket
+{
+  public:
+    TacfTicket()
+    {
+        keyValid = 1 == RAND_bytes(hmacKey, sizeof(hmacKey));
+    }
+
+    ~TacfTicket()
+    {
+        OPENSSL_cleanse(hmacKey, sizeof(hmacKey));
+        OPENSSL_cleanse(mac, sizeof(mac));
+    }
+
+    TacfTicket(const TacfTicket&)            = delete;
+    TacfTicket& operator=(const TacfTicket&) = delete;
+
+    /**
+     * Remember a successful password check so that the same password is
+     * accepted without PBKDF2 until the ticket lifetime ends or the ACF
+     * expires, whichever comes first. Replaces any previous ticket.
+     * @brief Issue ticket.
+     *
+     * @param key           The cache key of the verified ACF.
+     * @param replayId      The replay id the password was checked against.
+     * @param acfExpiration The expiration time of the verified ACF.
+     * @param password      A pointer to the password that was accepted.
+     * @param lifetime      How long the ticket is accepted for.
+     *
+     * @return A non-zero error value or zero on success.
+     */
+    int issue(const TacfCache::Key& key, uint64_t replayId,
+              uint64_t acfExpiration, const char* password,
+              std::chrono::seconds lifetime)
+    {
+        valid = false;
+        if (!keyValid || computeMac(key, password, mac))
+        {
+            return 1;
+        }
+        acfKey         = key;
+        ticketReplayId = replayId;
+        expiration     = acfExpiration;
+        notAfter       = bootTime() + lifetime;
+        valid          = true;
+        return 0;
+    }
+
+    /**
+     * Check a password against the ticket of a verified ACF.
+     * @brief Check ticket.
+     *
+     * @param key       The cache key of the ACF being authenticated.
+     * @param replayId  The current replay id value.
+     * @param password  A pointer to a password for authentication.
+     *
+     * @return Zero if the ticket accepts the password or non-zero otherwise.
+     */
+    int check(const TacfCache::Key& key, uint64_t replayId,
+              const char* password) const
+    {
+        uint8_t value[SHA512_DIGEST_LENGTH];
+
+        // The ACF may have expired before the ticket.
+        if (!valid || !(key == acfKey) || replayId != ticketReplayId ||
+            bootTime() >= notAfter ||
+            static_cast<uint64_t>(time(nullptr)) > expiration ||
+            computeMac(key, password, value))
+        {
+            return 1;
+        }
+        int rc = CRYPTO_memcmp(value, mac, sizeof(mac)) ? 1 : 0;
+        OPENSSL_cleanse(value, sizeof(value));
+        return rc;
+    }
+
+    /**
+     * Drop the ticket, used when the ACF is installed or removed.
+     * @brief Invalidate ticket.
+     */
+    void invalidate()
+    {
+        valid = false;
+        OPENSSL_cleanse(mac, sizeof(mac));
+    }
+
+  private:
+    uint8_t hmacKey[SHA512_DIGEST_LENGTH];
+    uint8_t mac[SHA512_DIGEST_LENGTH] = {};
+    TacfCache::Key acfKey{};
+    uint64_t ticketReplayId = 0;
+    uint64_t expiration     = 0;
+    std::chrono::nanoseconds notAfter{0};
+    bool keyValid = false;
+    bool valid    = false;
+
+    /** @brief A helper function to get the time since boot */
+    static std::chrono::nanoseconds bootTime()
+    {
+        timespec now;
+        clock_gettime(CLOCK_BOOTTIME, &now);
+        return std::chrono::seconds(now.tv_sec) +
+               std::chrono::nanoseconds(now.tv_nsec);
+    }
+
+    /**
+     * Compute the ticket HMAC of a password for a verified ACF.
+     * @brief Compute ticket HMAC.
+     *
+     * @param key       The cache key of the verified ACF.
+     * @param password  A pointer to the password.
+     * @param value     The HMAC value to populate.
+     *
+     * @return A non-zero error value or zero on success.
+     */
+    int computeMac(const TacfCache::Key& key, const char* password,
+                   uint8_t (&value)[SHA512_DIGEST_LENGTH]) const
+    {
+        if (!password)
+        {
+            return 1;
+        }
+
+        std::vector<uint8_t> data(password, password + strlen(password) + 1);
+        data.insert(data.end(), key.digest, key.digest + sizeof(key.digest));
+
+        unsigned int len = 0;
+        bool ok = HMAC(EVP_sha512(), hmacKey, sizeof(hmacKey), data.data(),
+                       data.size(), value, &len);
+
+        OPENSSL_cleanse(data.data(), data.size());
+        return ok && sizeof(value) == len ? 0 : 1;
+    }
+};
@@ -0,0 +1,340 @@
+#pragma once
+
+#include <endian.h>
+#include <fcntl.h>
+#include <mtd/mtd-user.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * TacfUbootEnv class for reading the U-Boot environment in process.
+ *
+ * Follows the same rules as fw_printenv: the device list comes from
+ * fw_env.config, each copy is protected by a CRC32 and when a redundant copy
+ * is configured the flags byte selects the active copy.
+ *
+ * Unlike fw_printenv, which falls back to its built in default environment
+ * when no copy has a valid CRC, reading fails in that case. The default
+ * environment is not available here, and reporting a variable as not defined
+ * would read as field mode disabled.
+ */
+class TacfUbootEnv
+{
+    /*
+     * @brief Implementation specific value definitions.
+     */
+    static constexpr auto defaultConfigPath = "/etc/fw_env.config";
+    static constexpr size_t maxCopies       = 2;
+    static constexpr uint8_t flagActive     = 1;
+    static constexpr uint8_t flagObsolete   = 0;
+    static constexpr uint8_t flagErased     = 0xff;
+
+  public:
+    static constexpr int envSuccess    = 0;
+    static constexpr int envNotDefined = 1;
+    static constexpr int envError      = 2;
+
+    TacfUbootEnv(const std::string& configPath = defaultConfigPath) :
+        configPath(configPath)
+    {}
+
+    /**
+     * Look up a variable in the active environment copy.
+     * @brief Read an environment variable.
+     *
+     * @param name  The name of the variable.
+     * @param value The value of the variable to populate.
+     *
+     * @return envSuccess if found, envNotDefined if the variable is not set or
+     *         envError if the environment could not be read.
+     */
+    int readVariable(const std::string& name, std::string& value) const
+    {
+        std::vector<uint8_t> data;
+        if (name.empty() || readEnvironment(data))
+        {
+            return envError;
+        }
+
+        // Variables are stored as "name=value\0" terminated by an empty
+        // string.
+        size_t pos = 0;
+        while (pos < data.size() && data[pos])
+        {
+            const char* entry = (const char*)&data[pos];
+            size_t len        = strnlen(entry, data.size() - pos);
+
+            if (len > name.size() && '=' == entry[name.size()] &&
+                !name.compare(0, name.size(), entry, name.size()))
+            {
+                value.assign(entry + name.size() + 1, len - name.size() - 1);
+                return envSuccess;
+            }
+            pos += len + 1;
+        }
+
+        return envNotDefined;
+    }
+
+    /**
+     * Read field mode, which only fieldmode=true enables. Any other value,
+     * or no value at all, means field mode is disabled.
+     * @brief Read field mode.
+     *
+     * @param enabled   The field mode enabled state to populate.
+     *
+     * @return A non-zero error value or zero on success.
+     */
+    int readFieldMode(bool& enabled) const
+    {
+        std::string value;
+        switch (readVariable("fieldmode", value))
+        {
+            case envSuccess:
+                enabled = "true" == value;
+                return 0;
+
+            case envNotDefined:
+                enabled = false;
+                return 0;
+
+            default:
+                return 1;
+        }
+    }
+
+    /**
+     * Pick the active copy when both redundant copies are valid, using the
+     * same flag schemes as fw_printenv.
+     * @brief Select the active copy.
+     *
+     * @param flag0         The flags byte of the primary copy.
+     * @param flag1         The flags byte of the redundant copy.
+     * @param booleanFlags  True for NOR flash, which uses active/obsolete
+     *                      flags rather than a counter.
+     *
+     * @return The index of the active copy.
+     */
+    static size_t selectCopy(uint8_t flag0, uint8_t flag1, bool booleanFlags)
+    {
+        if (booleanFlags)
+        {
+            if (flagActive == flag0 && flagObsolete == flag1)
+            {
+                return 0;
+            }
+            if (flagObsolete == flag0 && flagActive == flag1)
+            {
+                return 1;
+            }
+            // A valid copy whose flag is still erased was written by an
+            // update interrupted before the flag was set.
+            if (flag0 == flag1 || flagErased == flag0)
+            {
+                return 0;
+            }
+            if (flagErased == flag1)
+            {
+                return 1;
+            }
+            return 0;
+        }
+
+        // Incrementing counter, allowing for wrap around.
+        if (0xff == flag0 && 0 == flag1)
+        {
+            return 1;
+        }
+        if ((0xff == flag1 && 0 == flag0) || flag0 >= flag1)
+        {
+            return 0;
+        }
+        return 1;
+    }
+
+  private:
+    /**
+     * @brief Location of one environment copy.
+     */
+    struct EnvDevice
+    {
+        std::string path;
+        off_t offset;
+        size_t size;
+    };
+
+    std::string configPath;
+
+    /**
+     * Parse the configuration file into the list of environment copies.
+     * @brief Read fw_env.config.
+     *
+     * @param devices   The environment copies to populate.
+     *
+     * @return A non-zero error value or zero on success.
+     */
+    int readConfig(std::vector<EnvDevice>& devices) const
+    {
+        std::ifstream config(configPath);
+        if (!config)
+        {
+            return 1;
+        }
+
+        std::string line;
+        while (std::getline(config, line) && devices.size() < maxCopies)
+        {
+            std::istringstream fields(line);
+            std::string path, offset, size;
+            if (!(fields >> path) || '#' == path[0] ||
+                !(fields >> offset >> size))
+            {
+                continue;
+            }
+
+            // Offsets from the end of a block device are not supported.
+            char* offsetEnd   = nullptr;
+            char* sizeEnd     = nullptr;
+            long long envOff  = strtoll(offset.c_str(), &offsetEnd, 0);
+            unsigned long len = strtoul(size.c_str(), &sizeEnd, 0);
+            if (*offsetEnd || *sizeEnd || envOff < 0 ||
+                len <= sizeof(uint32_t) + 1)
+            {
+                return 1;
+            }
+            devices.push_back({path, (off_t)envOff, len});
+        }
+
+        // A redundant copy must be the same size as the primary copy.
+        if (devices.empty() ||
+            (devices.size() > 1 && devices[0].size != devices[1].size))
+        {
+            return 1;
+        }
+
+        return 0;
+    }
+
+    /**
+     * Read the variable data of the active environment copy.
+     * @brief Read the environment.
+     *
+     * @param data  The variable data to populate.
+     *
+     * @return A non-zero error value or zero on success.
+     */
+    int readEnvironment(std::vector<uint8_t>& data) const
+    {
+        std::vector<EnvDevice> devices;
+        if (readConfig(devices))
+        {
+            return 1;
+        }
+
+        // The redundant layout has a flags byte after the CRC.
+        bool redundant    = devices.size() > 1;
+        size_t headerSize = sizeof(uint32_t) + (redundant ? 1 : 0);
+
+        std::array<std::vector<uint8_t>, maxCopies> copies;
+        std::array<bool, maxCopies> valid = {};
+        bool booleanFlags                 = false;
+
+        for (size_t i = 0; i < devices.size(); i++)
+        {
+            bool isNor = false;
+            if (!readCopy(devices[i], copies[i], isNor))
+            {
+                uint32_t crc;
+                memcpy(&crc, copies[i].data(), sizeof(crc));
+                valid[i] = le32toh(crc) ==
+                           crc32(copies[i].data() + headerSize,
+                                 copies[i].size() - headerSize);
+            }
+            booleanFlags = booleanFlags || isNor;
+        }
+
+        size_t current = 0;
+        if (!valid[0] && !valid[1])
+        {
+            return 1;
+        }
+        else if (valid[0] != valid[1])
+        {
+            current = valid[0] ? 0 : 1;
+        }
+        else
+        {
+            current = selectCopy(copies[0][sizeof(uint32_t)],
+                                 copies[1][sizeof(uint32_t)], booleanFlags);
+        }
+
+        data.assign(copies[current].begin() + headerSize,
+                    copies[current].end());
+
+        return 0;
+    }
+
+    /**
+     * Read one environment copy from a device or file.
+     * @brief Read an environment copy.
+     *
+     * @param device    The location of the copy.
+     * @param buffer    The buffer to read the copy into.
+     * @param isNor     Set if the device is NOR flash.
+     *
+     * @return A non-zero error value or zero on success.
+     */
+    static int readCopy(const EnvDevice& device, std::vector<uint8_t>& buffer,
+                        bool& isNor)
+    {
+        int fd = open(device.path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return 1;
+        }
+
+        mtd_info_user info;
+        isNor = !ioctl(fd, MEMGETINFO, &info) &&
+                (MTD_NORFLASH == info.type || MTD_DATAFLASH == info.type);
+
+        buffer.resize(device.size);
+        ssize_t len = pread(fd, buffer.data(), buffer.size(), device.offset);
+        close(fd);
+
+        return len < 0 || (size_t)len != buffer.size();
+    }
+
+    /** @brief A helper function to compute a zlib compatible CRC32 */
+    static uint32_t crc32(const uint8_t* data, size_t size)
+    {
+        static const auto table = [] {
+            std::array<uint32_t, 256> table;
+            for (uint32_t i = 0; i < table.size(); i++)
+            {
+                uint32_t crc = i;
+                for (int bit = 0; bit < 8; bit++)
+                {
+                    crc = (crc >> 1) ^ ((crc & 1) ? 0xedb88320 : 0);
+                }
+                table[i] = crc;
+            }
+            return table;
+        }();
+
+        uint32_t crc = 0xffffffff;
+        for (size_t i = 0; i < size; i++)
+        {
+            crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        }
+        return crc ^ 0xffffffff;
+    }
+};
@@ -5,6 +5,14 @@
 #ifndef _CELOGIN_H
 #define _CELOGIN_H
 
+// Same declarations as OpenSSL, so that a caller can pass a parsed public key
+// without including the OpenSSL headers.
+typedef struct evp_pkey_st EVP_PKEY;
+typedef struct evp_pkey_ctx_st EVP_PKEY_CTX;
+typedef struct evp_md_st EVP_MD;
+typedef struct evp_md_ctx_st EVP_MD_CTX;
+typedef struct asn1_object_st ASN1_OBJECT;
+
 namespace CeLogin
 {
 
@@ -30,6 +38,8 @@ enum
     CeLogin_PBKDF2_Iterations = 100000,
     AdminAuthCodeMaxLen = 256,
     MaxAsciiScriptFileLength = 1024,
+    AcfAuthRecordMaxHashedAuthCodeLength = 256,
+    AcfAuthRecordMaxSaltLength = 128,
 };
 
 enum AcfType
@@ -74,6 +84,8 @@ struct CeLoginRc
         InvalidReplayId = 0x0A,
         ReplayIdPersistenceFailure = 0x0B,
         PowerVMRequestedReplayFailure = 0x0C,
+        ArenaExhausted = 0x0D,
+        PasswordHashStopped = 0x0E,
 
         CreateHsf_PasswordHashFailure = 0x13,
         CreateHsf_JsonHashFailure = 0x14,
@@ -237,6 +249,296 @@ struct AcfUserFields
     } mTypeSpecificFields;
 };
 
+/// Characters inside a buffer owned by the caller, not null terminated
+struct AcfStringView
+{
+    const char* mData;
+    uint64_t mLength;
+};
+
+/// The same fields as AcfUserFields, but the admin auth code and the scripts
+/// are left where they are in the caller's ACF buffer instead of being decoded
+/// into fixed size arrays. They are only valid for as long as that buffer is,
+/// and are still encoded; decodeAcfUserField decodes them when needed. A
+/// script is not limited to MaxAsciiScriptFileLength.
+struct AcfUserFieldsView
+{
+    AcfUserFieldsView()
+    {
+        clear();
+    }
+
+    void clear()
+    {
+        mVersion = CeLoginInvalidVersion;
+        mType = AcfType_Invalid;
+        mExpirationTime = 0;
+        mAuth = ServiceAuth_None;
+        mEncodedField.mData = NULL;
+        mEncodedField.mLength = 0;
+        mBmcTimeout = 0;
+        mIssueBmcDump = false;
+    }
+
+    AcfVersion mVersion;
+    AcfType mType;
+    uint64_t mExpirationTime;
+
+    /// Service and resource dump ACFs only
+    ServiceAuthority mAuth;
+
+    /// Hex encoded admin auth code of an admin reset ACF, or base64 encoded
+    /// script of a resource dump or BMC shell ACF
+    AcfStringView mEncodedField;
+
+    /// BMC shell ACFs only
+    uint64_t mBmcTimeout;
+    bool mIssueBmcDump;
+};
+
+/// Verified and parsed contents of a service ACF. Holds everything required
+/// to check a password without decoding the ACF or verifying its signature
+/// again. The record only contains plain data, so a caller may cache it for
+/// as long as the ACF it was created from is unchanged.
+struct AcfAuthRecord
+{
+    AcfAuthRecord()
+    {
+        clear();
+    }
+
+    void clear()
+    {
+        mVersion = CeLoginInvalidVersion;
+        mType = AcfType_Invalid;
+        mAuth = ServiceAuth_None;
+        mExpirationTime = 0;
+        mReplayIdPresent = false;
+        mReplayId = 0;
+        mIterations = 0;
+        mHashedAuthCodeLength = 0;
+        mAuthCodeSaltLength = 0;
+        memset(mHashedAuthCode, 0x00, sizeof(mHashedAuthCode));
+        memset(mAuthCodeSalt, 0x00, sizeof(mAuthCodeSalt));
+    }
+
+    AcfVersion mVersion;
+    AcfType mType;
+    ServiceAuthority mAuth;
+    uint64_t mExpirationTime;
+    bool mReplayIdPresent;
+    uint64_t mReplayId;
+    uint64_t mIterations;
+    uint8_t mHashedAuthCode[AcfAuthRecordMaxHashedAuthCodeLength];
+    uint64_t mHashedAuthCodeLength;
+    uint8_t mAuthCodeSalt[AcfAuthRecordMaxSaltLength];
+    uint64_t mAuthCodeSaltLength;
+};
+
+/// Everything the BMC needs to know about an ACF at install time, gathered
+/// while the ACF is decoded and its signature verified a single time. Produced
+/// by getAcfVerifiedRecordV2 and meant to be read, not modified.
+struct AcfVerifiedRecord
+{
+    AcfVerifiedRecord()
+    {
+        clear();
+    }
+
+    void clear()
+    {
+        mVersion = CeLoginInvalidVersion;
+        mType = AcfType_Invalid;
+        mExpirationTime = 0;
+        memset(&mExpirationDate, 0x00, sizeof(mExpirationDate));
+        mReplayIdPresent = false;
+        mReplayId = 0;
+        mUpdatedReplayId = 0;
+        mUserFields.clear();
+    }
+
+    AcfVersion mVersion;
+    AcfType mType;
+    uint64_t mExpirationTime;
+    CeLogin_Date mExpirationDate;
+    bool mReplayIdPresent;
+    uint64_t mReplayId;
+    uint64_t mUpdatedReplayId;
+    AcfUserFields mUserFields;
+};
+
+/// Scratch memory supplied by the caller of the arena variants of the V2
+/// interfaces. Everything ce-login needs for a call is carved from the buffer
+/// instead of the heap. What OpenSSL allocates still goes to its own memory
+/// functions. Allocations are carved one after the other, only the most
+/// recent one can be given back, and everything is returned when the arena
+/// is reset at the start of the next call.
+///
+/// The buffer is not owned by the arena, and the first few bytes of a buffer
+/// that is not aligned for any type go unused. An arena holds state that
+/// changes on every call, so it must not be used by more than one thread at a
+/// time.
+class CeLoginArena
+{
+  public:
+    CeLoginArena(void* bufferParm, const uint64_t sizeParm);
+
+    /// @brief Carve an allocation out of the buffer, aligned for any type
+    /// @param[in] sizeParm the number of bytes to allocate
+    /// @return NULL if the rest of the buffer is too small
+    void* allocate(const uint64_t sizeParm);
+
+    /// @brief Give back the most recent allocation made by this arena. Any
+    /// other allocation is only given back by reset().
+    void release(void* ptrParm);
+
+    /// @brief Give back every allocation and clear the exhausted state
+    void reset();
+
+    /// @brief True if the pointer is within the buffer of this arena
+    bool contains(const void* ptrParm) const;
+
+    uint64_t getSize() const
+    {
+        return mSize;
+    }
+
+    /// @brief The bytes of the buffer up to the end of the last allocation
+    uint64_t getUsed() const
+    {
+        return mUsed;
+    }
+
+    /// @brief The most bytes of the buffer in use at any one time
+    uint64_t getHighWater() const
+    {
+        return mHighWater;
+    }
+
+    /// @brief True if an allocation failed since the arena was last reset
+    bool isExhausted() const
+    {
+        return mExhausted;
+    }
+
+  private:
+    // Not copyable, the allocations belong to a single arena
+    CeLoginArena(const CeLoginArena&);
+    CeLoginArena& operator=(const CeLoginArena&);
+
+    uint8_t* mBuffer;
+    uint64_t mSize;
+    uint64_t mUsed;
+    uint64_t mTop;
+    uint64_t mHighWater;
+    bool mExhausted;
+};
+
+/// @brief The size of an arena that is large enough for any call of the V2
+/// interfaces with an ACF of the given length. An ACF whose JSON fits in the
+/// stack storage of a call needs no arena at all, so this may be 0.
+uint64_t getArenaSizeV2(const uint64_t accessControlFileLengthParm);
+
+#ifndef CELOGIN_NO_HEAP
+/// Reusable state for verifying many ACFs against the same public keys. The
+/// digest, the ACF object identifier and a verify context for each key are
+/// set up once. After the first verification with each key, using the
+/// verifier again does not allocate anything in ce-login itself.
+///
+/// A verifier holds state that changes on every call, so it must not be used
+/// by more than one thread at a time. The public keys are not owned by the
+/// verifier and must outlive it. A build without a heap (CELOGIN_NO_HEAP) has
+/// nothing to keep the state in and provides no verifier.
+class CeLoginVerifier
+{
+  public:
+    CeLoginVerifier();
+    ~CeLoginVerifier();
+
+    /// @brief Replace the public keys, in the order they should be tried
+    /// @param[in] publicKeysParm the parsed public keys. None of them may be
+    /// NULL.
+    /// @param[in] publicKeyCountParm the number of public keys
+    /// @return CeLoginRc. On failure the verifier has no public keys.
+    CeLoginRc setPublicKeys(EVP_PKEY* const* publicKeysParm,
+                            const uint64_t publicKeyCountParm);
+
+    uint64_t getPublicKeyCount() const
+    {
+        return mPublicKeyCount;
+    }
+
+    const ASN1_OBJECT* getAcfObject() const
+    {
+        return mAcfObject;
+    }
+
+    /// @brief Verify a signature over a digest with each public key in turn
+    /// @param[in] signatureParm signature data to verify
+    /// @param[in] signatureLengthParm signature data length
+    /// @param[in] digestParm input digest
+    /// @param[in] digestLengthParm input digest length
+    /// @param[out] keyIndexParm index of the key that verified the
+    /// signature, or the number of keys if none did
+    /// @return CeLoginRc
+    CeLoginRc verifySignature(const uint8_t* signatureParm,
+                              const uint64_t signatureLengthParm,
+                              const uint8_t* digestParm,
+                              const uint64_t digestLengthParm,
+                              uint64_t& keyIndexParm);
+
+  private:
+    // Not copyable, the verify contexts are owned by a single verifier
+    CeLoginVerifier(const CeLoginVerifier&);
+    CeLoginVerifier& operator=(const CeLoginVerifier&);
+
+    void clearPublicKeys();
+    EVP_PKEY_CTX* getVerifyCtx(const uint64_t keyIndexParm);
+
+    EVP_PKEY** mPublicKeys;
+    EVP_PKEY_CTX** mVerifyCtxs;
+    uint64_t mPublicKeyCount;
+    const EVP_MD* mDigest;
+    const ASN1_OBJECT* mAcfObject;
+};
+#endif /* CELOGIN_NO_HEAP */
+
+/// @brief An upper bound on the number of bytes decodeAcfUserField writes
+/// for the given view, 0 if it has no encoded field
+uint64_t getAcfUserFieldDecodedSize(const AcfUserFieldsView& userFieldsParm);
+
+/// @brief Decode the admin auth code or the script of a view
+/// @param[in] userFieldsParm a view returned by
+/// checkAuthorizationAndGetAcfUserFieldsViewV2
+/// @param[out] outputParm buffer for the decoded bytes, which are not null
+/// terminated
+/// @param[in] outputSizeParm size of the output buffer, at least
+/// getAcfUserFieldDecodedSize(userFieldsParm)
+/// @param[out] outputLengthParm number of decoded bytes
+/// @return CeLoginRc::UnsupportedAcfType for a service ACF, which has no
+/// encoded field
+CeLoginRc decodeAcfUserField(const AcfUserFieldsView& userFieldsParm,
+                             char* outputParm, const uint64_t outputSizeParm,
+                             uint64_t& outputLengthParm);
+
+/// Lets the caller of a password check stop the password hash part way, such
+/// as when a deadline passes or the client goes away. mShouldStop is called
+/// with mContext on the thread doing the hash, before every block of
+/// PasswordHashCheckIterations iterations. The check fails with
+/// PasswordHashStopped as soon as it returns true.
+struct PasswordHashControl
+{
+    enum
+    {
+        PasswordHashCheckIterations = 1024,
+    };
+
+    bool (*mShouldStop)(void* contextParm);
+    void* mContext;
+};
+
+#ifndef CELOGIN_NO_HEAP
+
 /// @note This function will return failure if called with a V2 ACF
 CeLoginRc getServiceAuthorityV1(
     const uint8_t* accessControlFileParm,
@@ -379,6 +681,382 @@ CeLoginRc checkAuthorizationAndGetAcfUserFieldsV2(
     const char* serialNumberParm, const uint64_t serialNumberLengthParm,
     const uint64_t currentReplayIdParm, AcfUserFields& userFieldsParm);
 
+/** @brief Non copying variant of checkAuthorizationAndGetAcfUserFieldsV2
+ *
+ *  Performs the same validation, but returns the admin auth code or script as
+ * a view into the ACF buffer, still encoded, rather than a decoded copy. The
+ * ACF buffer has to outlive the view. Scripts of any length are accepted.
+ *
+ *  @param userFieldsParm the view to populate on successful execution
+ */
+CeLoginRc checkAuthorizationAndGetAcfUserFieldsViewV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm, const char* passwordParm,
+    const uint64_t passwordLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    const uint64_t currentReplayIdParm, AcfUserFieldsView& userFieldsParm);
+
+/** @brief Validate a service ACF and capture the fields needed to log in
+ *
+ *  This function performs the same signature, expiration and serial number
+ * validation as checkAuthorizationAndGetAcfUserFieldsV2, but instead of
+ * checking a password it returns the parsed fields in an AcfAuthRecord. The
+ * record can then be passed to checkAuthorizationWithAcfAuthRecordV2 for each
+ * login attempt while the ACF is unchanged.
+ *
+ *  @param accessControlFileParm a pointer to the ASN1 encoded binary ACF
+ *  @param accessControlFileLengthParm the byte length of the provided ACF
+ *  @param timeSinceUnixEpochInSecondsParm the current system time encoded as a
+ * unix timestamp
+ *  @param publicKeyParm a pointer to the public key used to vaidate the
+ * signature over the ACF
+ *  @param publicKeyLengthParm the byte length of the provided public key
+ *  @param serialNumberParm a pointer to the serial number of the current system
+ *  @param serialNumberLengthParm the length of the provided serial number
+ *  @param recordParm the AcfAuthRecord to populate
+ *
+ *  @return A CeLoginRc indicating the result. CeLoginRc::UnsupportedAcfType is
+ * returned for any ACF that is not a service ACF.
+ */
+CeLoginRc getAcfAuthRecordV2(const uint8_t* accessControlFileParm,
+                             const uint64_t accessControlFileLengthParm,
+                             const uint64_t timeSinceUnixEpochInSecondsParm,
+                             const uint8_t* publicKeyParm,
+                             const uint64_t publicKeyLengthParm,
+                             const char* serialNumberParm,
+                             const uint64_t serialNumberLengthParm,
+                             AcfAuthRecord& recordParm);
+
+/** @brief Check a password against a previously validated service ACF
+ *
+ *  The record must have been produced by getAcfAuthRecordV2. The expiration
+ * time and replay ID are checked again, since both may have changed since the
+ * record was created. The result is identical to calling
+ * checkAuthorizationAndGetAcfUserFieldsV2 with the ACF the record came from.
+ *
+ *  @param recordParm the record returned by getAcfAuthRecordV2
+ *  @param passwordParm a pointer to the provided password
+ *  @param passwordLengthParm the length of the provided password
+ *  @param timeSinceUnixEpochInSecondsParm the current system time encoded as a
+ * unix timestamp
+ *  @param currentReplayIdParm the current replay ID persisted by the BMC
+ *  @param userFieldsParm an instance of AcfUserFields which contains the data
+ * parsed from the ACF on successful execution.
+ *
+ *  @return A CeLoginRc indicating the result.
+ */
+CeLoginRc checkAuthorizationWithAcfAuthRecordV2(
+    const AcfAuthRecord& recordParm, const char* passwordParm,
+    const uint64_t passwordLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint64_t currentReplayIdParm, AcfUserFields& userFieldsParm);
+
+/** @brief Validate an ACF file once for installation
+ *
+ *  This function combines verifyACFForBMCUploadV2,
+ * checkAuthorizationAndGetAcfUserFieldsV2 (without a password) and
+ * extractACFMetadataV2. The ACF is decoded, its signature verified and its
+ * JSON parsed a single time, and every field needed to install it is returned
+ * in an AcfVerifiedRecord. As with verifyACFForBMCUploadV2, THE CALLER MUST
+ * PERSIST THE RESULTING REPLAY ID ON SUCCESS.
+ *
+ *  @param accessControlFileParm a pointer to the ASN1 encoded binary ACF
+ *  @param accessControlFileLengthParm the byte length of the provided ACF
+ *  @param timeSinceUnixEpochInSecondsParm the current system time encoded as a
+ * unix timestamp
+ *  @param publicKeyParm a pointer to the public key used to vaidate the
+ * signature over the ACF
+ *  @param publicKeyLengthParm the byte length of the provided public key
+ *  @param serialNumberParm a pointer to the serial number of the current system
+ *  @param serialNumberLengthParm the length of the provided serial number
+ *  @param currentReplayIdParm the current replay ID persisted by the BMC
+ *  @param recordParm the AcfVerifiedRecord to populate. mUpdatedReplayId is
+ * the value the BMC is required to persist if the function call succeeds.
+ *
+ *  @return A CeLoginRc indicating the result.
+ */
+CeLoginRc getAcfVerifiedRecordV2(const uint8_t* accessControlFileParm,
+                                 const uint64_t accessControlFileLengthParm,
+                                 const uint64_t timeSinceUnixEpochInSecondsParm,
+                                 const uint8_t* publicKeyParm,
+                                 const uint64_t publicKeyLengthParm,
+                                 const char* serialNumberParm,
+                                 const uint64_t serialNumberLengthParm,
+                                 const uint64_t currentReplayIdParm,
+                                 AcfVerifiedRecord& recordParm);
+
+/** @brief Parsed public key variants of the V2 interfaces
+ *
+ *  These behave exactly like the interfaces above, but take a public key that
+ * the caller imported once (e.g. with d2i_PUBKEY) instead of its DER encoding.
+ * A caller that keeps the key across calls avoids importing it for every ACF
+ * and lets OpenSSL reuse the precomputed RSA values. The key is not freed.
+ *
+ *  @param publicKeyParm the public key used to validate the signature over the
+ * ACF
+ */
+CeLoginRc extractACFMetadataV2(const uint8_t* accessControlFileParm,
+                               const uint64_t accessControlFileLengthParm,
+                               const uint64_t timeSinceUnixEpochInSecondsParm,
+                               EVP_PKEY* publicKeyParm,
+                               const char* serialNumberParm,
+                               const uint64_t serialNumberLengthParm,
+                               AcfType& acfTypeParm,
+                               uint64_t& expirationTimeParm,
+                               CeLogin_Date& expirationDateParm,
+                               AcfVersion& versionParm, bool& hasReplayIdParm);
+
+CeLoginRc verifyACFForBMCUploadV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm, EVP_PKEY* publicKeyParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    const uint64_t currentReplayIdParm, uint64_t& updatedReplayIdParm,
+    AcfType& acfTypeParm, uint64_t& expirationTimeParm);
+
+CeLoginRc checkAuthorizationAndGetAcfUserFieldsV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm, const char* passwordParm,
+    const uint64_t passwordLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm, EVP_PKEY* publicKeyParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    const uint64_t currentReplayIdParm, AcfUserFields& userFieldsParm);
+
+CeLoginRc checkAuthorizationAndGetAcfUserFieldsViewV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm, const char* passwordParm,
+    const uint64_t passwordLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm, EVP_PKEY* publicKeyParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    const uint64_t currentReplayIdParm, AcfUserFieldsView& userFieldsParm);
+
+CeLoginRc getAcfAuthRecordV2(const uint8_t* accessControlFileParm,
+                             const uint64_t accessControlFileLengthParm,
+                             const uint64_t timeSinceUnixEpochInSecondsParm,
+                             EVP_PKEY* publicKeyParm,
+                             const char* serialNumberParm,
+                             const uint64_t serialNumberLengthParm,
+                             AcfAuthRecord& recordParm);
+
+CeLoginRc getAcfVerifiedRecordV2(const uint8_t* accessControlFileParm,
+                                 const uint64_t accessControlFileLengthParm,
+                                 const uint64_t timeSinceUnixEpochInSecondsParm,
+                                 EVP_PKEY* publicKeyParm,
+                                 const char* serialNumberParm,
+                                 const uint64_t serialNumberLengthParm,
+                                 const uint64_t currentReplayIdParm,
+                                 AcfVerifiedRecord& recordParm);
+
+/** @brief Multiple public key variants of the V2 interfaces
+ *
+ *  These behave like the parsed public key interfaces above, but try each of
+ * the provided keys in order. The ACF is decoded and its digest computed only
+ * once, so each additional key costs a single signature check.
+ *
+ *  @param publicKeysParm the public keys that may have signed the ACF, in the
+ * order they should be tried. None of them may be NULL.
+ *  @param publicKeyCountParm the number of provided public keys
+ *  @param keyIndexParm the index of the key that verified the signature, or
+ * publicKeyCountParm if none did. It is set even if the ACF fails a later
+ * check, which means the failure is not caused by the choice of key.
+ */
+CeLoginRc extractACFMetadataV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    EVP_PKEY* const* publicKeysParm, const uint64_t publicKeyCountParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    AcfType& acfTypeParm, uint64_t& expirationTimeParm,
+    CeLogin_Date& expirationDateParm, AcfVersion& versionParm,
+    bool& hasReplayIdParm, uint64_t& keyIndexParm);
+
+CeLoginRc getAcfAuthRecordV2(const uint8_t* accessControlFileParm,
+                             const uint64_t accessControlFileLengthParm,
+                             const uint64_t timeSinceUnixEpochInSecondsParm,
+                             EVP_PKEY* const* publicKeysParm,
+                             const uint64_t publicKeyCountParm,
+                             const char* serialNumberParm,
+                             const uint64_t serialNumberLengthParm,
+                             AcfAuthRecord& recordParm,
+                             uint64_t& keyIndexParm);
+
+CeLoginRc getAcfVerifiedRecordV2(const uint8_t* accessControlFileParm,
+                                 const uint64_t accessControlFileLengthParm,
+                                 const uint64_t timeSinceUnixEpochInSecondsParm,
+                                 EVP_PKEY* const* publicKeysParm,
+                                 const uint64_t publicKeyCountParm,
+                                 const char* serialNumberParm,
+                                 const uint64_t serialNumberLengthParm,
+                                 const uint64_t currentReplayIdParm,
+                                 AcfVerifiedRecord& recordParm,
+                                 uint64_t& keyIndexParm);
+
+/** @brief Verifier variants of the V2 interfaces
+ *
+ *  These behave like the multiple public key interfaces above, trying the
+ * public keys of the verifier in order, but reuse the state kept by the
+ * verifier instead of setting it up again for every ACF.
+ *
+ *  @param verifierParm the verifier holding the public keys that may have
+ * signed the ACF
+ */
+CeLoginRc extractACFMetadataV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    CeLoginVerifier& verifierParm, const char* serialNumberParm,
+    const uint64_t serialNumberLengthParm, AcfType& acfTypeParm,
+    uint64_t& expirationTimeParm, CeLogin_Date& expirationDateParm,
+    AcfVersion& versionParm, bool& hasReplayIdParm, uint64_t& keyIndexParm);
+
+CeLoginRc getAcfAuthRecordV2(const uint8_t* accessControlFileParm,
+                             const uint64_t accessControlFileLengthParm,
+                             const uint64_t timeSinceUnixEpochInSecondsParm,
+                             CeLoginVerifier& verifierParm,
+                             const char* serialNumberParm,
+                             const uint64_t serialNumberLengthParm,
+                             AcfAuthRecord& recordParm,
+                             uint64_t& keyIndexParm);
+
+CeLoginRc getAcfVerifiedRecordV2(const uint8_t* accessControlFileParm,
+                                 const uint64_t accessControlFileLengthParm,
+                                 const uint64_t timeSinceUnixEpochInSecondsParm,
+                                 CeLoginVerifier& verifierParm,
+                                 const char* serialNumberParm,
+                                 const uint64_t serialNumberLengthParm,
+                                 const uint64_t currentReplayIdParm,
+                                 AcfVerifiedRecord& recordParm,
+                                 uint64_t& keyIndexParm);
+
+/// Upload time verification of an ACF that is received in pieces, such as
+/// from the network or a file, without collecting the whole ACF first. begin
+/// is given the buffer the JSON payload is collected in, update each piece of
+/// the ASN1 encoded ACF in order, and finish verifies it with the same checks
+/// and return codes as verifyACFForBMCUploadV2. The payload is hashed as it
+/// arrives. Apart from it, only the fields before and after it are kept, up
+/// to MaxHeaderLength and MaxTrailerLength bytes.
+///
+/// update returns the first error found in what has been received so far, so
+/// that an upload can be rejected before it is complete. finish returns the
+/// same error after its own parameter checks. An ACF with a payload larger
+/// than the buffer fails with GetSevAuth_InvalidAcfLength, and anything
+/// received after the end of the ACF is ignored. A stream must not be used by
+/// more than one thread at a time.
+class AcfUploadStream
+{
+  public:
+    enum
+    {
+        MaxHeaderLength = 512,
+        MaxTrailerLength = 2048,
+    };
+
+    AcfUploadStream();
+    ~AcfUploadStream();
+
+    /// @brief Start receiving an ACF, dropping anything received before
+    /// @param[in] jsonBufferParm where the JSON payload is collected. It is
+    /// not owned by the stream and must be kept until finish is called.
+    /// @param[in] jsonBufferSizeParm the size of the buffer, which is the
+    /// largest payload accepted
+    /// @return CeLoginRc
+    CeLoginRc begin(uint8_t* jsonBufferParm, const uint64_t jsonBufferSizeParm);
+
+    /// @brief Receive the next piece of the ACF
+    /// @param[in] dataParm the piece, which is not kept
+    /// @param[in] dataLengthParm the length of the piece
+    /// @return CeLoginRc
+    CeLoginRc update(const uint8_t* dataParm, const uint64_t dataLengthParm);
+
+    /// @brief Verify the received ACF, see verifyACFForBMCUploadV2 for the
+    /// parameters. The stream has to be started again to receive another ACF.
+    CeLoginRc finish(const uint64_t timeSinceUnixEpochInSecondsParm,
+                     const uint8_t* publicKeyParm,
+                     const uint64_t publicKeyLengthParm,
+                     const char* serialNumberParm,
+                     const uint64_t serialNumberLengthParm,
+                     const uint64_t currentReplayIdParm,
+                     uint64_t& updatedReplayIdParm, AcfType& acfTypeParm,
+                     uint64_t& expirationTimeParm);
+
+    /// @brief Same as finish, with a parsed public key
+    CeLoginRc finish(const uint64_t timeSinceUnixEpochInSecondsParm,
+                     EVP_PKEY* publicKeyParm, const char* serialNumberParm,
+                     const uint64_t serialNumberLengthParm,
+                     const uint64_t currentReplayIdParm,
+                     uint64_t& updatedReplayIdParm, AcfType& acfTypeParm,
+                     uint64_t& expirationTimeParm);
+
+    /// @brief The number of bytes of the ACF received since begin
+    uint64_t getReceivedLength() const
+    {
+        return mReceivedLength;
+    }
+
+  private:
+    // Not copyable, the digest context is owned by a single stream
+    AcfUploadStream(const AcfUploadStream&);
+    AcfUploadStream& operator=(const AcfUploadStream&);
+
+    uint64_t receiveHeader(const uint8_t* dataParm,
+                           const uint64_t dataLengthParm);
+    uint64_t receivePayload(const uint8_t* dataParm,
+                            const uint64_t dataLengthParm);
+    uint64_t receiveTrailer(const uint8_t* dataParm,
+                            const uint64_t dataLengthParm);
+    CeLoginRc finish(const uint64_t timeSinceUnixEpochInSecondsParm,
+                     const uint8_t* publicKeyParm,
+                     const uint64_t publicKeyLengthParm,
+                     CeLoginVerifier* verifierParm,
+                     const char* serialNumberParm,
+                     const uint64_t serialNumberLengthParm,
+                     const uint64_t currentReplayIdParm,
+                     uint64_t& updatedReplayIdParm, AcfType& acfTypeParm,
+                     uint64_t& expirationTimeParm);
+
+    uint8_t mHeader[MaxHeaderLength];
+    uint8_t mTrailer[MaxTrailerLength];
+    uint8_t* mJson;
+    uint64_t mJsonSize;
+    uint64_t mHeaderLength;
+    uint64_t mPayloadLength;
+    uint64_t mPayloadReceived;
+    uint64_t mTrailerLength;
+    uint64_t mTrailerReceived;
+    uint64_t mReceivedLength;
+    EVP_MD_CTX* mDigestCtx;
+    bool mDigestFailed;
+    uint8_t mState;
+    CeLoginRc mRc;
+};
+
+/** @brief Stoppable variants of the password checks
+ *
+ *  These behave like checkAuthorizationAndGetAcfUserFieldsV2 and
+ * checkAuthorizationWithAcfAuthRecordV2, but ask the control whether to go on
+ * while hashing the password and fail with PasswordHashStopped when told to
+ * stop. Checks that fail before the password is hashed are not affected.
+ *
+ *  @param controlParm decides whether the password hash goes on
+ */
+CeLoginRc checkAuthorizationAndGetAcfUserFieldsV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm, const char* passwordParm,
+    const uint64_t passwordLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm, EVP_PKEY* publicKeyParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    const uint64_t currentReplayIdParm, AcfUserFields& userFieldsParm,
+    const PasswordHashControl& controlParm);
+
+CeLoginRc checkAuthorizationWithAcfAuthRecordV2(
+    const AcfAuthRecord& recordParm, const char* passwordParm,
+    const uint64_t passwordLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint64_t currentReplayIdParm, AcfUserFields& userFieldsParm,
+    const PasswordHashControl& controlParm);
+
 #else
 
 /** @brief PowerVM interface for checkAuthorizationAndGetAcfUserFieldsV2
@@ -399,6 +1077,110 @@ CeLoginRc checkAuthorizationAndGetAcfUserFieldsV2ForPowerVM(
 
 #endif /* CELOGIN_POWERVM_TARGET */
 
+#endif /* CELOGIN_NO_HEAP */
+
+/** @brief Arena variants of the V2 interfaces
+ *
+ *  These behave exactly like the interfaces above that take the DER encoding
+ * of the public key, but take their scratch memory from the provided arena
+ * instead of the heap. The arena is reset at the start of every call. A build
+ * with CELOGIN_NO_HEAP only provides these variants, and ce-login itself then
+ * never allocates memory. OpenSSL still allocates through its own memory
+ * functions, which an application can replace with CRYPTO_set_mem_functions
+ * before it first uses OpenSSL.
+ *
+ *  @param arenaParm the scratch memory for the call, of at least
+ * getArenaSizeV2(accessControlFileLengthParm) bytes
+ *
+ *  @return CeLoginRc::ArenaExhausted if the arena is too small, otherwise the
+ * same result as the interface without an arena.
+ */
+CeLoginRc extractACFMetadataV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    AcfType& acfTypeParm, uint64_t& expirationTimeParm,
+    CeLogin_Date& expirationDateParm, AcfVersion& versionParm,
+    bool& hasReplayIdParm, CeLoginArena& arenaParm);
+
+#ifndef CELOGIN_POWERVM_TARGET
+
+CeLoginRc verifyACFForBMCUploadV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    const uint64_t currentReplayIdParm, uint64_t& updatedReplayIdParm,
+    AcfType& acfTypeParm, uint64_t& expirationTimeParm,
+    CeLoginArena& arenaParm);
+
+CeLoginRc checkAuthorizationAndGetAcfUserFieldsV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm, const char* passwordParm,
+    const uint64_t passwordLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    const uint64_t currentReplayIdParm, AcfUserFields& userFieldsParm,
+    CeLoginArena& arenaParm);
+
+CeLoginRc checkAuthorizationAndGetAcfUserFieldsViewV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm, const char* passwordParm,
+    const uint64_t passwordLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    const uint64_t currentReplayIdParm, AcfUserFieldsView& userFieldsParm,
+    CeLoginArena& arenaParm);
+
+CeLoginRc getAcfAuthRecordV2(const uint8_t* accessControlFileParm,
+                             const uint64_t accessControlFileLengthParm,
+                             const uint64_t timeSinceUnixEpochInSecondsParm,
+                             const uint8_t* publicKeyParm,
+                             const uint64_t publicKeyLengthParm,
+                             const char* serialNumberParm,
+                             const uint64_t serialNumberLengthParm,
+                             AcfAuthRecord& recordParm,
+                             CeLoginArena& arenaParm);
+
+/// @note There is no ACF to size the arena for, getArenaSizeV2(0) is enough
+CeLoginRc checkAuthorizationWithAcfAuthRecordV2(
+    const AcfAuthRecord& recordParm, const char* passwordParm,
+    const uint64_t passwordLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint64_t currentReplayIdParm, AcfUserFields& userFieldsParm,
+    CeLoginArena& arenaParm);
+
+CeLoginRc getAcfVerifiedRecordV2(const uint8_t* accessControlFileParm,
+                                 const uint64_t accessControlFileLengthParm,
+                                 const uint64_t timeSinceUnixEpochInSecondsParm,
+                                 const uint8_t* publicKeyParm,
+                                 const uint64_t publicKeyLengthParm,
+                                 const char* serialNumberParm,
+                                 const uint64_t serialNumberLengthParm,
+                                 const uint64_t currentReplayIdParm,
+                                 AcfVerifiedRecord& recordParm,
+                                 CeLoginArena& arenaParm);
+
+#else
+
+CeLoginRc checkAuthorizationAndGetAcfUserFieldsV2ForPowerVM(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm, const char* passwordParm,
+    const uint64_t passwordLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    const uint64_t currentReplayIdParm, uint64_t& updatedReplayIdParm,
+    const bool failValidationIfReplayIdPresentParm,
+    AcfUserFields& userFieldsParm, CeLoginArena& arenaParm);
+
+#endif /* CELOGIN_POWERVM_TARGET */
+
 } // namespace CeLogin
 
 #endif
@@ -8,8 +8,6 @@
 #include <openssl/x509.h>
 #include <string.h>
 
-#include <new>
-
 namespace CeLogin
 {
 const char* AcfProcessingType = "P";
@@ -20,74 +18,22 @@ CeLogin::CeLoginRc
                            uint64_t& expirationTimeParm,
                            const uint64_t timeSinceUnixEpocInSecondsParm)
 {
-    CeLoginRc sRc = CeLoginRc::Success;
-    ASN1_TIME* sAsn1UnixEpoch = ASN1_TIME_new();
-    ASN1_TIME* sAsn1ExpirationTime = ASN1_TIME_new();
-    if (!sAsn1ExpirationTime || !sAsn1UnixEpoch)
-    {
-        sRc = CeLoginRc::DetermineAuth_Asn1TimeAllocFailure;
-    }
-    else
-    {
-        ASN1_TIME* sResult = ASN1_TIME_set(sAsn1UnixEpoch, 0);
-        if (sResult != sAsn1UnixEpoch)
-        {
-            sRc = CeLoginRc::DetermineAuth_GetAsn1UnixEpoch;
-        }
-
-        if (CeLoginRc::Success == sRc)
-        {
-            sRc = getAsn1TimeForExpiration(jsonDataParm->mExpirationDate,
-                                           sAsn1ExpirationTime);
-        }
+    CeLoginRc sRc = getExpirationTimeFromDate(jsonDataParm->mExpirationDate,
+                                              expirationTimeParm);
 
-        // Get the expiration time in seconds since unix epoch. Supports dates
-        // up to 9999-12-31
-        if (CeLoginRc::Success == sRc)
-        {
-            int sDay = 0;
-            int sSec = 0;
-            // ASN1_Time_diff returns 1 on success
-            if (1 == ASN1_TIME_diff(&sDay, &sSec, sAsn1UnixEpoch,
-                                    sAsn1ExpirationTime))
-            {
-                // If these numbers are negative this math fails
-                if (sDay >= 0 && sSec >= 0)
-                {
-                    // Convert days to seconds and add remaining seconds
-                    // Cast to uint64_t to prevent truncation
-                    expirationTimeParm =
-                        ((uint64_t)sDay * 24 * 60 * 60) + (uint64_t)sSec;
-                }
-                else
-                {
-                    sRc = CeLoginRc::
-                        DetermineAuth_Asn1ExpirationToUnixOsslFailure;
-                }
-            }
-            else
-            {
-                sRc = CeLoginRc::DetermineAuth_Asn1ExpirationToUnixFailure;
-            }
-        }
-
-        if (CeLoginRc::Success == sRc)
+    if (CeLoginRc::Success == sRc)
+    {
+        if (timeSinceUnixEpocInSecondsParm > expirationTimeParm)
         {
-            if (timeSinceUnixEpocInSecondsParm > expirationTimeParm)
-            {
-                // The expiration date has passed
-                sRc = CeLoginRc::AcfExpired;
-            }
+            // The expiration date has passed
+            sRc = CeLoginRc::AcfExpired;
         }
     }
 
-    if (sAsn1UnixEpoch)
-        ASN1_TIME_free(sAsn1UnixEpoch);
-    if (sAsn1ExpirationTime)
-        ASN1_TIME_free(sAsn1ExpirationTime);
     return sRc;
 }
 
+#ifndef CELOGIN_NO_HEAP
 CeLogin::CeLoginRc CeLogin::getServiceAuthorityV1(
     const uint8_t* accessControlFileParm,
     const uint64_t accessControlFileLengthParm, const char* passwordParm,
@@ -100,9 +46,13 @@ CeLogin::CeLoginRc CeLogin::getServiceAuthorityV1(
     CeLoginRc sRc = CeLoginRc::Success;
     authorityParm = CeLogin::ServiceAuth_None;
     uint8_t sGeneratedAuthCode[CeLogin_MaxHashedAuthCodeLength];
+    uint8_t sHashedAuthCode[CeLogin_MaxHashedAuthCodeLength];
+    uint64_t sHashedAuthCodeLength = 0;
+    uint8_t sAuthCodeSalt[CeLogin_MaxHashedAuthCodeSaltLength];
+    uint64_t sAuthCodeSaltLength = 0;
 
-    CELoginSequenceV1* sDecodedAsn = NULL;
-    CeLoginJsonData* sJsonData = NULL;
+    CELoginSequenceV1View sDecodedAsn;
+    CeLoginJsonData sJsonData;
 
     if (!accessControlFileParm)
     {
@@ -137,27 +87,13 @@ CeLogin::CeLoginRc CeLogin::getServiceAuthorityV1(
         sRc = CeLoginRc::GetSevAuth_InvalidSerialNumberLength;
     }
 
-    // Allocate on heap to avoid blowing the stack
-    if (CeLoginRc::Success == sRc)
-    {
-        sJsonData = (CeLoginJsonData*)OPENSSL_malloc(sizeof(CeLoginJsonData));
-        if (sJsonData)
-        {
-            new (sJsonData) CeLoginJsonData();
-        }
-        else
-        {
-            sRc = CeLoginRc::JsonDataAllocationFailure;
-        }
-    }
-
     // Stack copy to store the parsed expiration time into. Only pass back
     // the value if the authority has validated as CE or Dev.
     uint64_t sExpirationTime = 0;
 
     if (CeLoginRc::Success == sRc)
     {
-        // Returns a heap allocation of the decoded ANS1 structure.
+        // Decodes the ANS1 structure in place.
         //  - Verify supported OID/signature algorithm
         //  - Verify expected ProcessingType
         //  - Verify signature over SourceFileData
@@ -170,15 +106,15 @@ CeLogin::CeLoginRc CeLogin::getServiceAuthorityV1(
     // authorization)
     if (CeLoginRc::Success == sRc)
     {
-        sRc = decodeJson((const char*)sDecodedAsn->sourceFileData->data,
-                         sDecodedAsn->sourceFileData->length, serialNumberParm,
-                         serialNumberLengthParm, *sJsonData);
+        sRc = decodeJson((const char*)sDecodedAsn.sourceFileData.data,
+                         sDecodedAsn.sourceFileData.length, serialNumberParm,
+                         serialNumberLengthParm, sJsonData);
     }
 
     // This interface only supports V1
     if (CeLoginRc::Success == sRc)
     {
-        if (CeLoginVersion1 != sJsonData->mVersion)
+        if (CeLoginVersion1 != sJsonData.mVersion)
         {
             sRc = CeLoginRc::UnsupportedVersion;
         }
@@ -187,25 +123,38 @@ CeLogin::CeLoginRc CeLogin::getServiceAuthorityV1(
     // Verify that the ACF has not expired (using UTC)
     if (CeLoginRc::Success == sRc)
     {
-        sRc = isTimeExpired(sJsonData, sExpirationTime,
+        sRc = isTimeExpired(&sJsonData, sExpirationTime,
                             timeSinceUnixEpocInSecondsParm);
     }
 
+    if (CeLoginRc::Success == sRc)
+    {
+        sRc = getJsonFieldFromHex(sJsonData, sJsonData.mHashedAuthCode,
+                                  sHashedAuthCode, sizeof(sHashedAuthCode),
+                                  sHashedAuthCodeLength);
+    }
+    if (CeLoginRc::Success == sRc)
+    {
+        sRc = getJsonFieldFromHex(sJsonData, sJsonData.mAuthCodeSalt,
+                                  sAuthCodeSalt, sizeof(sAuthCodeSalt),
+                                  sAuthCodeSaltLength);
+    }
+
     // Hash the provided ACF password
     if (CeLoginRc::Success == sRc)
     {
-        sRc = createPasswordHash(
-            passwordParm, passwordLengthParm, sJsonData->mAuthCodeSalt,
-            sJsonData->mAuthCodeSaltLength, sJsonData->mIterations,
-            sGeneratedAuthCode, sizeof(sGeneratedAuthCode),
-            sJsonData->mHashedAuthCodeLength);
+        sRc = createPasswordHash(passwordParm, passwordLengthParm,
+                                 sAuthCodeSalt, sAuthCodeSaltLength,
+                                 sJsonData.mIterations, sGeneratedAuthCode,
+                                 sizeof(sGeneratedAuthCode),
+                                 sHashedAuthCodeLength);
     }
 
     // Verify password hash matches the ACF hashed auth code
     if (CeLoginRc::Success == sRc)
     {
-        if (0 != CRYPTO_memcmp(sGeneratedAuthCode, sJsonData->mHashedAuthCode,
-                               sJsonData->mHashedAuthCodeLength))
+        if (0 != CRYPTO_memcmp(sGeneratedAuthCode, sHashedAuthCode,
+                               sHashedAuthCodeLength))
         {
             sRc = CeLoginRc::PasswordNotValid;
         }
@@ -213,20 +162,10 @@ CeLogin::CeLoginRc CeLogin::getServiceAuthorityV1(
 
     if (CeLoginRc::Success == sRc)
     {
-        authorityParm = sJsonData->mRequestedAuthority;
+        authorityParm = sJsonData.mRequestedAuthority;
         expirationTimeParm = sExpirationTime;
     }
 
-    if (sDecodedAsn)
-    {
-        CELoginSequenceV1_free(sDecodedAsn);
-    }
-    if (sJsonData)
-    {
-        sJsonData->~CeLoginJsonData();
-        OPENSSL_free(sJsonData);
-    }
-
     return sRc;
 }
 
@@ -241,8 +180,8 @@ CeLogin::CeLoginRc CeLogin::checkServiceAuthorityAcfIntegrityV1(
     CeLoginRc sRc = CeLoginRc::Success;
     authorityParm = CeLogin::ServiceAuth_None;
 
-    CELoginSequenceV1* sDecodedAsn = NULL;
-    CeLoginJsonData* sJsonData = NULL;
+    CELoginSequenceV1View sDecodedAsn;
+    CeLoginJsonData sJsonData;
 
     if (!accessControlFileParm)
     {
@@ -269,27 +208,13 @@ CeLogin::CeLoginRc CeLogin::checkServiceAuthorityAcfIntegrityV1(
         sRc = CeLoginRc::GetSevAuth_InvalidSerialNumberLength;
     }
 
-    // Allocate on heap to avoid blowing the stack
-    if (CeLoginRc::Success == sRc)
-    {
-        sJsonData = (CeLoginJsonData*)OPENSSL_malloc(sizeof(CeLoginJsonData));
-        if (sJsonData)
-        {
-            new (sJsonData) CeLoginJsonData();
-        }
-        else
-        {
-            sRc = CeLoginRc::JsonDataAllocationFailure;
-        }
-    }
-
     // Stack copy to store the parsed expiration time into. Only pass back
     // the value if the authority has validated as CE or Dev.
     uint64_t sExpirationTime = 0;
 
     if (CeLoginRc::Success == sRc)
     {
-        // Returns a heap allocation of the decoded ANS1 structure.
+        // Decodes the ANS1 structure in place.
         //  - Verify supported OID/signature algorithm
         //  - Verify expected ProcessingType
         //  - Verify signature over SourceFileData
@@ -302,15 +227,15 @@ CeLogin::CeLoginRc CeLogin::checkServiceAuthorityAcfIntegrityV1(
     // authorization)
     if (CeLoginRc::Success == sRc)
     {
-        sRc = decodeJson((const char*)sDecodedAsn->sourceFileData->data,
-                         sDecodedAsn->sourceFileData->length, serialNumberParm,
-                         serialNumberLengthParm, *sJsonData);
+        sRc = decodeJson((const char*)sDecodedAsn.sourceFileData.data,
+                         sDecodedAsn.sourceFileData.length, serialNumberParm,
+                         serialNumberLengthParm, sJsonData);
     }
 
     // This interface only supports V1
     if (CeLoginRc::Success == sRc)
     {
-        if (CeLoginVersion1 != sJsonData->mVersion)
+        if (CeLoginVersion1 != sJsonData.mVersion)
         {
             sRc = CeLoginRc::UnsupportedVersion;
         }
@@ -319,23 +244,16 @@ CeLogin::CeLoginRc CeLogin::checkServiceAuthorityAcfIntegrityV1(
     // Verify that the ACF has not expired (using UTC)
     if (CeLoginRc::Success == sRc)
     {
-        sRc = isTimeExpired(sJsonData, sExpirationTime,
+        sRc = isTimeExpired(&sJsonData, sExpirationTime,
                             timeSinceUnixEpocInSecondsParm);
     }
 
     if (CeLoginRc::Success == sRc)
     {
-        authorityParm = sJsonData->mRequestedAuthority;
+        authorityParm = sJsonData.mRequestedAuthority;
         expirationTimeParm = sExpirationTime;
     }
 
-    if (sDecodedAsn)
-        CELoginSequenceV1_free(sDecodedAsn);
-    if (sJsonData)
-    {
-        sJsonData->~CeLoginJsonData();
-        OPENSSL_free(sJsonData);
-    }
-
     return sRc;
 }
+#endif /* CELOGIN_NO_HEAP */
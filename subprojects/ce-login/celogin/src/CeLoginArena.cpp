@@ -0,0 +1,219 @@
+#include "CeLoginJson.h"
+#include "CeLoginUtil.h"
+
+#include <CeLogin.h>
+#include <openssl/crypto.h>
+
+#include <new>
+
+using CeLogin::CeLoginArena;
+using CeLogin::CeLoginRc;
+
+namespace
+{
+enum
+{
+    ArenaAlignment = 16,
+};
+} // namespace
+
+// The arena of the call in progress on this thread, if any, and whether
+// allocations that do not fit in it go to the heap instead of failing
+static thread_local CeLoginArena* sCurrentArena = NULL;
+static thread_local bool sCurrentArenaOverflows = false;
+
+static uint64_t alignArenaSize(const uint64_t sizeParm)
+{
+    return (sizeParm + ArenaAlignment - 1) & ~(uint64_t)(ArenaAlignment - 1);
+}
+
+CeLoginArena::CeLoginArena(void* bufferParm, const uint64_t sizeParm) :
+    mBuffer((uint8_t*)bufferParm), mSize(sizeParm), mUsed(0), mTop(0),
+    mHighWater(0), mExhausted(false)
+{
+    // Skip the start of a buffer that is not aligned
+    const uint64_t sMisalignment = (uintptr_t)mBuffer % ArenaAlignment;
+    if (mBuffer && 0 != sMisalignment)
+    {
+        const uint64_t sSkip = ArenaAlignment - sMisalignment;
+        mBuffer += sSkip;
+        mSize = sSkip < mSize ? mSize - sSkip : 0;
+    }
+}
+
+void* CeLoginArena::allocate(const uint64_t sizeParm)
+{
+    void* sAllocation = NULL;
+
+    if (mBuffer && sizeParm <= mSize &&
+        alignArenaSize(sizeParm) <= mSize - mUsed)
+    {
+        sAllocation = mBuffer + mUsed;
+        mTop = mUsed;
+        mUsed += alignArenaSize(sizeParm);
+        if (mUsed > mHighWater)
+        {
+            mHighWater = mUsed;
+        }
+    }
+    else
+    {
+        mExhausted = true;
+    }
+
+    return sAllocation;
+}
+
+// Only the most recent allocation can be given back, the others stay until
+// the arena is reset
+void CeLoginArena::release(void* ptrParm)
+{
+    if (contains(ptrParm) && (uint8_t*)ptrParm == mBuffer + mTop &&
+        mTop < mUsed)
+    {
+        mUsed = mTop;
+    }
+}
+
+void CeLoginArena::reset()
+{
+    mUsed = 0;
+    mTop = 0;
+    mExhausted = false;
+}
+
+bool CeLoginArena::contains(const void* ptrParm) const
+{
+    return mBuffer && (const uint8_t*)ptrParm >= mBuffer &&
+           (const uint8_t*)ptrParm < mBuffer + mSize;
+}
+
+uint64_t CeLogin::getArenaSizeV2(const uint64_t accessControlFileLengthParm)
+{
+    uint64_t sSize = 0;
+
+    const uint64_t sJsonScratchSize =
+        getJsonScratchSize(accessControlFileLengthParm);
+    if (0 != sJsonScratchSize)
+    {
+        sSize += alignArenaSize(sJsonScratchSize);
+    }
+
+    return sSize;
+}
+
+static void enterArena(CeLoginArena& arenaParm, const bool overflowsParm)
+{
+    arenaParm.reset();
+    sCurrentArena = &arenaParm;
+    sCurrentArenaOverflows = overflowsParm;
+}
+
+static void leaveArena(CeLoginArena* previousParm,
+                       const bool previousOverflowsParm)
+{
+    sCurrentArena = previousParm;
+    sCurrentArenaOverflows = previousOverflowsParm;
+}
+
+CeLogin::ArenaScope::ArenaScope(CeLoginArena& arenaParm) :
+    mPrevious(sCurrentArena), mPreviousOverflows(sCurrentArenaOverflows)
+{
+    enterArena(arenaParm, false);
+}
+
+CeLogin::ArenaScope::~ArenaScope()
+{
+    leaveArena(mPrevious, mPreviousOverflows);
+}
+
+#ifndef CELOGIN_NO_HEAP
+// The call arena of the call in progress on this thread, until the call
+// first needs scratch memory
+static thread_local CeLogin::CallArena* sPendingCallArena = NULL;
+
+// The decoded ACF lives on the stack, what is left to size for is the JSON
+// tokens of an ACF that does not fit in the stack storage of a call
+CeLogin::CallArena::CallArena(const uint64_t acfLengthParm) :
+    mSize(sCurrentArena || sPendingCallArena ? 0
+                                             : getArenaSizeV2(acfLengthParm)),
+    mEntered(false), mBuffer(NULL), mArena(NULL, 0)
+{
+    if (0 != mSize)
+    {
+        sPendingCallArena = this;
+    }
+}
+
+// Without a secure heap OPENSSL_secure_malloc falls back to the regular heap.
+// If that fails as well the arena stays empty and the call uses the heap.
+void CeLogin::CallArena::enter()
+{
+    sPendingCallArena = NULL;
+    mBuffer = (uint8_t*)OPENSSL_secure_malloc(mSize);
+    if (mBuffer)
+    {
+        new (&mArena) CeLoginArena(mBuffer, mSize);
+    }
+    enterArena(mArena, true);
+    mEntered = true;
+}
+
+CeLogin::CallArena::~CallArena()
+{
+    if (this == sPendingCallArena)
+    {
+        sPendingCallArena = NULL;
+    }
+
+    // Only entered when no other arena was in use
+    if (mEntered)
+    {
+        leaveArena(NULL, false);
+
+        // Only the part that was written to needs wiping
+        if (mBuffer)
+        {
+            const uint64_t sSkipped = mSize - mArena.getSize();
+            OPENSSL_secure_clear_free(mBuffer,
+                                      sSkipped + mArena.getHighWater());
+        }
+    }
+}
+#endif /* CELOGIN_NO_HEAP */
+
+void* CeLogin::allocateScratch(const uint64_t sizeParm)
+{
+    void* sAllocation = NULL;
+#ifndef CELOGIN_NO_HEAP
+    if (!sCurrentArena && sPendingCallArena)
+    {
+        sPendingCallArena->enter();
+    }
+#endif
+    if (sCurrentArena)
+    {
+        sAllocation = sCurrentArena->allocate(sizeParm);
+    }
+#ifndef CELOGIN_NO_HEAP
+    if (!sAllocation && (!sCurrentArena || sCurrentArenaOverflows))
+    {
+        sAllocation = OPENSSL_malloc(sizeParm);
+    }
+#endif
+    return sAllocation;
+}
+
+void CeLogin::releaseScratch(void* ptrParm)
+{
+    if (sCurrentArena && sCurrentArena->contains(ptrParm))
+    {
+        sCurrentArena->release(ptrParm);
+    }
+#ifndef CELOGIN_NO_HEAP
+    else
+    {
+        OPENSSL_free(ptrParm);
+    }
+#endif
+}
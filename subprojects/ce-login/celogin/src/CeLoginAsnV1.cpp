@@ -3,6 +3,7 @@
 
 #include <openssl/asn1.h>
 #include <openssl/asn1t.h>
+#include <string.h>
 
 namespace CeLogin
 {
@@ -23,4 +24,302 @@ ASN1_SEQUENCE(CELoginSequenceV1) =
 
         IMPLEMENT_ASN1_FUNCTIONS(CELoginSequenceV1);
 
+enum
+{
+    AsnTag_BitString = 0x03,
+    AsnTag_OctetString = 0x04,
+    AsnTag_Null = 0x05,
+    AsnTag_ObjectIdentifier = 0x06,
+    AsnTag_PrintableString = 0x13,
+    AsnTag_Sequence = 0x30,
+
+    AsnBitString_MaxUnusedBits = 7,
+
+    AsnLength_LongForm = 0x80,
+    AsnLength_MaxLengthOctets = 4,
+};
+
+// Reads the tag and the definite length of the element at posParm. On
+// success posParm is moved to the contents, which may not all be there yet.
+// AsnDecode_Incomplete is returned if the header runs past endParm.
+static AsnDecodeResult readHeader(const uint8_t*& posParm,
+                                  const uint8_t* endParm, const uint8_t tagParm,
+                                  uint64_t& lengthParm)
+{
+    AsnDecodeResult sResult = AsnDecode_Complete;
+    const uint8_t* sPos = posParm;
+    uint64_t sLength = 0;
+
+    if (sPos == endParm)
+    {
+        sResult = AsnDecode_Incomplete;
+    }
+    else if (tagParm != *sPos++)
+    {
+        sResult = AsnDecode_Invalid;
+    }
+    else if (sPos == endParm)
+    {
+        sResult = AsnDecode_Incomplete;
+    }
+    else if (*sPos < AsnLength_LongForm)
+    {
+        sLength = *sPos++;
+    }
+    else
+    {
+        // The indefinite length form (0x80) is not allowed in DER
+        const uint8_t sOctets = *sPos++ & ~AsnLength_LongForm;
+        if (0 == sOctets || AsnLength_MaxLengthOctets < sOctets)
+        {
+            sResult = AsnDecode_Invalid;
+        }
+        else if (sOctets > endParm - sPos)
+        {
+            sResult = AsnDecode_Incomplete;
+        }
+        for (uint8_t sIdx = 0; AsnDecode_Complete == sResult && sIdx < sOctets;
+             sIdx++)
+        {
+            sLength = (sLength << 8) | *sPos++;
+        }
+    }
+
+    if (AsnDecode_Complete == sResult)
+    {
+        posParm = sPos;
+        lengthParm = sLength;
+    }
+
+    return sResult;
+}
+
+// Reads the tag and the definite length of the element at posParm and checks
+// that its contents fit before endParm. On success posParm is moved past the
+// element.
+static bool readElement(const uint8_t*& posParm, const uint8_t* endParm,
+                        const uint8_t tagParm, CELoginAsnViewV1& contentsParm)
+{
+    const uint8_t* sPos = posParm;
+    uint64_t sLength = 0;
+    bool sValid = AsnDecode_Complete ==
+                      readHeader(sPos, endParm, tagParm, sLength) &&
+                  sLength <= (uint64_t)(endParm - sPos);
+
+    if (sValid)
+    {
+        contentsParm.data = sPos;
+        contentsParm.length = sLength;
+        posParm = sPos + sLength;
+    }
+
+    return sValid;
+}
+
+// Same rules as OpenSSL applies when decoding an object identifier: every
+// sub-identifier is minimally encoded and the last one is complete.
+static bool isValidObjectIdentifier(const CELoginAsnViewV1& oidParm)
+{
+    bool sValid = 0 < oidParm.length &&
+                  0 == (oidParm.data[oidParm.length - 1] & 0x80);
+    bool sStart = true;
+
+    for (uint64_t sIdx = 0; sValid && sIdx < oidParm.length; sIdx++)
+    {
+        sValid = !(sStart && 0x80 == oidParm.data[sIdx]);
+        sStart = 0 == (oidParm.data[sIdx] & 0x80);
+    }
+
+    return sValid;
+}
+
+// Reads an element of the sequence that has to be there in full before the
+// next one can be read. sequenceEndParm may be past endParm while the rest of
+// the sequence has not been received.
+static AsnDecodeResult readPrefixElement(const uint8_t*& posParm,
+                                         const uint8_t* endParm,
+                                         const uint64_t sequenceLeftParm,
+                                         const uint8_t tagParm,
+                                         CELoginAsnViewV1& contentsParm)
+{
+    const uint8_t* sPos = posParm;
+    const bool sTruncated = sequenceLeftParm > (uint64_t)(endParm - sPos);
+    const uint8_t* sEnd = sTruncated ? endParm : sPos + sequenceLeftParm;
+    uint64_t sLength = 0;
+
+    AsnDecodeResult sResult = readHeader(sPos, sEnd, tagParm, sLength);
+    if (AsnDecode_Incomplete == sResult && !sTruncated)
+    {
+        sResult = AsnDecode_Invalid;
+    }
+    if (AsnDecode_Complete == sResult)
+    {
+        if (sLength > sequenceLeftParm - (uint64_t)(sPos - posParm))
+        {
+            sResult = AsnDecode_Invalid;
+        }
+        else if (sLength > (uint64_t)(endParm - sPos) &&
+                 AsnTag_OctetString != tagParm)
+        {
+            sResult = AsnDecode_Incomplete;
+        }
+    }
+
+    if (AsnDecode_Complete == sResult)
+    {
+        contentsParm.data = sPos;
+        contentsParm.length = sLength;
+        posParm = sPos;
+        if (AsnTag_OctetString != tagParm)
+        {
+            posParm += sLength;
+        }
+    }
+
+    return sResult;
+}
+
+AsnDecodeResult decodeCELoginSequenceV1Prefix(const uint8_t* derParm,
+                                              const uint64_t derLengthParm,
+                                              CELoginSequenceV1View& viewParm,
+                                              uint64_t& sequenceEndParm)
+{
+    const uint8_t* sPos = derParm;
+    const uint8_t* sEnd = derParm + derLengthParm;
+    uint64_t sSequenceLength = 0;
+
+    memset(&viewParm, 0x00, sizeof(viewParm));
+    sequenceEndParm = 0;
+
+    AsnDecodeResult sResult =
+        derParm ? readHeader(sPos, sEnd, AsnTag_Sequence, sSequenceLength)
+                : AsnDecode_Invalid;
+    const uint64_t sSequenceEnd = (uint64_t)(sPos - derParm) + sSequenceLength;
+
+    if (AsnDecode_Complete == sResult)
+    {
+        sResult = readPrefixElement(sPos, sEnd,
+                                    sSequenceEnd - (uint64_t)(sPos - derParm),
+                                    AsnTag_PrintableString,
+                                    viewParm.processingType);
+    }
+    if (AsnDecode_Complete == sResult)
+    {
+        sResult = readPrefixElement(sPos, sEnd,
+                                    sSequenceEnd - (uint64_t)(sPos - derParm),
+                                    AsnTag_PrintableString,
+                                    viewParm.sourceFileName);
+    }
+    if (AsnDecode_Complete == sResult)
+    {
+        sResult = readPrefixElement(sPos, sEnd,
+                                    sSequenceEnd - (uint64_t)(sPos - derParm),
+                                    AsnTag_OctetString,
+                                    viewParm.sourceFileData);
+    }
+
+    if (AsnDecode_Complete == sResult)
+    {
+        sequenceEndParm = sSequenceEnd;
+    }
+    else
+    {
+        memset(&viewParm, 0x00, sizeof(viewParm));
+    }
+
+    return sResult;
+}
+
+bool decodeCELoginSequenceV1Trailer(const uint8_t* derParm,
+                                    const uint64_t derLengthParm,
+                                    CELoginSequenceV1View& viewParm)
+{
+    CELoginAsnViewV1 sAlgorithm = {NULL, 0};
+    CELoginAsnViewV1 sNull = {NULL, 0};
+    CELoginAsnViewV1 sBitString = {NULL, 0};
+
+    // The fields after sourceFileData, which must be used up exactly
+    const uint8_t* sPos = derParm;
+    const uint8_t* sEnd = derParm + derLengthParm;
+    bool sValid = NULL != derParm &&
+                  readElement(sPos, sEnd, AsnTag_Sequence, sAlgorithm) &&
+                  readElement(sPos, sEnd, AsnTag_BitString, sBitString) &&
+                  sPos == sEnd;
+
+    // The algorithm identifier, an object identifier and a NULL
+    if (sValid)
+    {
+        sPos = sAlgorithm.data;
+        sEnd = sAlgorithm.data + sAlgorithm.length;
+        sValid = readElement(sPos, sEnd, AsnTag_ObjectIdentifier,
+                             viewParm.algorithmId) &&
+                 isValidObjectIdentifier(viewParm.algorithmId) &&
+                 readElement(sPos, sEnd, AsnTag_Null, sNull) &&
+                 0 == sNull.length && sPos == sEnd;
+    }
+
+    // OpenSSL counts the trailing zero bits of the signature as unused bits
+    // when encoding it. The signature is still made of whole octets, only the
+    // unused bits have to be zero.
+    if (sValid)
+    {
+        sValid = 0 < sBitString.length &&
+                 sBitString.data[0] <= AsnBitString_MaxUnusedBits;
+    }
+    if (sValid)
+    {
+        const uint8_t sUnusedMask = (1 << sBitString.data[0]) - 1;
+        sValid = 1 < sBitString.length
+                     ? 0 == (sBitString.data[sBitString.length - 1] &
+                             sUnusedMask)
+                     : 0 == sBitString.data[0];
+    }
+
+    if (sValid)
+    {
+        viewParm.signature.data = sBitString.data + 1;
+        viewParm.signature.length = sBitString.length - 1;
+    }
+    else
+    {
+        viewParm.algorithmId.data = NULL;
+        viewParm.algorithmId.length = 0;
+    }
+
+    return sValid;
+}
+
+bool decodeCELoginSequenceV1View(const uint8_t* derParm,
+                                 const uint64_t derLengthParm,
+                                 CELoginSequenceV1View& viewParm)
+{
+    CELoginAsnViewV1 sSequence = {NULL, 0};
+
+    memset(&viewParm, 0x00, sizeof(viewParm));
+
+    const uint8_t* sPos = derParm;
+    bool sValid = NULL != derParm &&
+                  readElement(sPos, derParm + derLengthParm, AsnTag_Sequence,
+                              sSequence);
+
+    // The fields up to sourceFileData, the rest is left to the trailer
+    const uint8_t* sEnd = sSequence.data + sSequence.length;
+    sPos = sSequence.data;
+    sValid = sValid &&
+             readElement(sPos, sEnd, AsnTag_PrintableString,
+                         viewParm.processingType) &&
+             readElement(sPos, sEnd, AsnTag_PrintableString,
+                         viewParm.sourceFileName) &&
+             readElement(sPos, sEnd, AsnTag_OctetString,
+                         viewParm.sourceFileData) &&
+             decodeCELoginSequenceV1Trailer(sPos, sEnd - sPos, viewParm);
+
+    if (!sValid)
+    {
+        memset(&viewParm, 0x00, sizeof(viewParm));
+    }
+
+    return sValid;
+}
+
 }; // namespace CeLogin
@@ -1,5 +1,6 @@
 
 #include <openssl/asn1t.h>
+#include <stdint.h>
 
 #ifndef _CELOGINASNV1_H
 #define _CELOGINASNV1_H
@@ -25,5 +26,68 @@ struct CELoginSequenceV1
 
 DECLARE_ASN1_FUNCTIONS(CELoginSequenceV1)
 
+/// A field of a DER encoded ACF, pointing into the buffer it was decoded from
+struct CELoginAsnViewV1
+{
+    const uint8_t* data;
+    uint64_t length;
+};
+
+/// The fields of a CELoginSequenceV1, decoded in place. The views are only
+/// valid for as long as the buffer they were decoded from.
+struct CELoginSequenceV1View
+{
+    CELoginAsnViewV1 processingType;
+    CELoginAsnViewV1 sourceFileName;
+    CELoginAsnViewV1 sourceFileData;
+    CELoginAsnViewV1 algorithmId; // contents of the object identifier
+    CELoginAsnViewV1 signature;   // without the unused bits count
+};
+
+/// @brief Decode a DER encoded CELoginSequenceV1 without allocating or copying
+/// anything. Every length is checked against the provided buffer. Any data
+/// following the sequence is ignored, as done by d2i_CELoginSequenceV1.
+/// Anything this accepts is decoded to the same contents by
+/// d2i_CELoginSequenceV1, which only differs by also accepting BER forms.
+/// @param[in] derParm DER encoded sequence
+/// @param[in] derLengthParm length of the DER encoded sequence buffer
+/// @param[out] viewParm decoded fields
+/// @return true if the sequence was decoded
+bool decodeCELoginSequenceV1View(const uint8_t* derParm,
+                                 const uint64_t derLengthParm,
+                                 CELoginSequenceV1View& viewParm);
+
+enum AsnDecodeResult
+{
+    AsnDecode_Complete,
+    AsnDecode_Incomplete, // more of the DER encoding is needed to tell
+    AsnDecode_Invalid,
+};
+
+/// @brief Decode the start of a DER encoded CELoginSequenceV1 that is received
+/// in pieces, up to the start of the contents of sourceFileData. Applies the
+/// same checks as decodeCELoginSequenceV1View to everything it decodes.
+/// @param[in] derParm start of the DER encoded sequence received so far
+/// @param[in] derLengthParm number of bytes received so far
+/// @param[out] viewParm processingType and sourceFileName, and the length of
+/// sourceFileData with its data pointing to where the contents start
+/// @param[out] sequenceEndParm offset of the end of the sequence in derParm
+/// @return AsnDecode_Incomplete if more bytes are needed to get that far
+AsnDecodeResult decodeCELoginSequenceV1Prefix(const uint8_t* derParm,
+                                              const uint64_t derLengthParm,
+                                              CELoginSequenceV1View& viewParm,
+                                              uint64_t& sequenceEndParm);
+
+/// @brief Decode the fields of a DER encoded CELoginSequenceV1 that follow
+/// sourceFileData, up to the end of the sequence
+/// @param[in] derParm the DER encoding following sourceFileData
+/// @param[in] derLengthParm the bytes left in the sequence, which must be used
+/// up exactly
+/// @param[out] viewParm algorithmId and signature are set
+/// @return true if the fields were decoded
+bool decodeCELoginSequenceV1Trailer(const uint8_t* derParm,
+                                    const uint64_t derLengthParm,
+                                    CELoginSequenceV1View& viewParm);
+
 }; // namespace CeLogin
 #endif
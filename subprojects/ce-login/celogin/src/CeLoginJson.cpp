@@ -5,6 +5,7 @@
 #include "JsmnUtils.h"
 
 #include <CeLogin.h>
+#include <openssl/crypto.h>
 #include <string.h>
 
 using namespace CeLogin;
@@ -17,6 +18,7 @@ enum JsonUtilsRc
 
     DecodeJson_JsmnParseFailed = 0x10,
     DecodeJson_JsonRootNotObject = 0x11,
+    DecodeJson_TooManyTokens = 0x12,
 
     ParseDate_InvalidParm = 0x20,
     ParseDate_NotString = 0x21,
@@ -39,10 +41,124 @@ enum JsonUtilsRc
 
 enum
 {
-    JsmnMaxNumTokens = 128,
+    // Tokens parsed on the stack, the tokens of larger ACFs are allocated
+    JsmnStackNumTokens = 128,
+};
+
+// The names in the root object of an ACF, numbered by their slot in a
+// perfect hash of the names. Unused slots are left out.
+enum JsonField
+{
+    JsonField_Version = 0,
+    JsonField_Type = 1,
+    JsonField_Iterations = 2,
+    JsonField_BmcShellScript = 4,
+    JsonField_Expiration = 5,
+    JsonField_ResourceDumps = 6,
+    JsonField_Salt = 7,
+    JsonField_HashedAuthCode = 8,
+    JsonField_IssueBmcDump = 9,
+    JsonField_Machines = 10,
+    JsonField_ReplayId = 12,
+    JsonField_AdminAuthCode = 13,
+    JsonField_BmcTimeoutVal = 14,
+
+    JsonField_NumSlots = 16,
+    JsonField_MaxNameLength = 21, // executionTimeoutInSec
+};
+
+// The keys of the root object, indexed in a single walk over it. Looking up a
+// field gives the same result as JsmnUtils::ObjectGetValueByKey would.
+struct JsonRootFields
+{
+    JsmnUtils::JsmnUtilRc mWalkRc; // Error that ended the walk early
+    uint16_t mFoundMask;
+    uint16_t mDuplicateMask;
+    uint64_t mKeyIdx[JsonField_NumSlots];
 };
 }; // namespace JsonUtils
 
+// Polynomial string hash, only used on keys of at most JsonField_MaxNameLength
+// characters
+static constexpr uint32_t getJsonFieldHash(const char* keyParm,
+                                           const uint64_t keyLengthParm,
+                                           const uint32_t hashParm)
+{
+    return 0 == keyLengthParm
+               ? hashParm
+               : getJsonFieldHash(keyParm + 1, keyLengthParm - 1,
+                                  hashParm * 121 + (uint8_t)*keyParm);
+}
+
+static constexpr uint64_t getJsonFieldSlot(const char* keyParm,
+                                           const uint64_t keyLengthParm)
+{
+    return (getJsonFieldHash(keyParm, keyLengthParm, 0) >> 4) &
+           (JsonUtils::JsonField_NumSlots - 1);
+}
+
+template <uint64_t N>
+static constexpr uint64_t getJsonFieldSlot(const char (&keyParm)[N])
+{
+    return getJsonFieldSlot(keyParm, N - 1);
+}
+
+// The names have to match CeLoginJsonExterns.cpp
+static_assert(JsonUtils::JsonField_Version == getJsonFieldSlot("version"),
+              "version slot mismatch");
+static_assert(JsonUtils::JsonField_Type == getJsonFieldSlot("type"),
+              "type slot mismatch");
+static_assert(JsonUtils::JsonField_Iterations ==
+                  getJsonFieldSlot("iterations"),
+              "iterations slot mismatch");
+static_assert(JsonUtils::JsonField_BmcShellScript ==
+                  getJsonFieldSlot("shellscript"),
+              "shellscript slot mismatch");
+static_assert(JsonUtils::JsonField_Expiration ==
+                  getJsonFieldSlot("expiration"),
+              "expiration slot mismatch");
+static_assert(JsonUtils::JsonField_ResourceDumps ==
+                  getJsonFieldSlot("resourcedumps"),
+              "resourcedumps slot mismatch");
+static_assert(JsonUtils::JsonField_Salt == getJsonFieldSlot("salt"),
+              "salt slot mismatch");
+static_assert(JsonUtils::JsonField_HashedAuthCode ==
+                  getJsonFieldSlot("hashedAuthCode"),
+              "hashedAuthCode slot mismatch");
+static_assert(JsonUtils::JsonField_IssueBmcDump ==
+                  getJsonFieldSlot("issueDumpOnCompletion"),
+              "issueDumpOnCompletion slot mismatch");
+static_assert(JsonUtils::JsonField_Machines == getJsonFieldSlot("machines"),
+              "machines slot mismatch");
+static_assert(JsonUtils::JsonField_ReplayId == getJsonFieldSlot("replayid"),
+              "replayid slot mismatch");
+static_assert(JsonUtils::JsonField_AdminAuthCode ==
+                  getJsonFieldSlot("adminAuthCode"),
+              "adminAuthCode slot mismatch");
+static_assert(JsonUtils::JsonField_BmcTimeoutVal ==
+                  getJsonFieldSlot("executionTimeoutInSec"),
+              "executionTimeoutInSec slot mismatch");
+
+// The name expected in each slot
+static const char* const* const JsonFieldNames[JsonUtils::JsonField_NumSlots] =
+    {&JsonName_Version,        &JsonName_Type,
+     &JsonName_Iterations,     NULL,
+     &JsonName_BmcShellScript, &JsonName_Expiration,
+     &JsonName_ResourceDumps,  &JsonName_Salt,
+     &JsonName_HashedAuthCode, &JsonName_IssueBmcDump,
+     &JsonName_Machines,       NULL,
+     &JsonName_ReplayId,       &JsonName_AdminAuthCode,
+     &JsonName_BmcTimeoutVal,  NULL};
+
+static void IndexRootObjectFields(const JsmnUtils::JsmnState& jsmnStateParm,
+                                  JsonUtils::JsonRootFields& fieldsParm);
+
+static JsmnUtils::JsmnUtilRc
+    GetRootFieldValue(const JsmnUtils::JsmnState& jsmnStateParm,
+                      const JsonUtils::JsonRootFields& fieldsParm,
+                      const JsonUtils::JsonField fieldParm,
+                      uint64_t& valueIdxParm);
+
 static CeLoginRc ParseDateFromToken(const JsmnUtils::JsmnState& jsmnStateParm,
                                     const uint64_t expirationTokenIdxParm,
                                     CeLogin_Date& dateParm);
@@ -54,47 +170,52 @@ static CeLoginRc ParseAuthorityFromMachineArrayToken(
 
 static CeLoginRc ParseHashedAuthCodeFromToken(
     const JsmnUtils::JsmnState& jsmnStateParm,
-    const uint64_t hashedAuthCodeTokenIdxParm, uint8_t* hashedAuthCodeParm,
-    const uint64_t hashedAuthCodeSizeParm, uint64_t& bytesWrittenParm);
+    const uint64_t hashedAuthCodeTokenIdxParm,
+    JsonFieldLocation& hashedAuthCodeParm);
 
 static CeLoginRc ParseSaltFromToken(const JsmnUtils::JsmnState& jsmnStateParm,
                                     const uint64_t saltTokenIdxParm,
-                                    uint8_t* saltParm,
-                                    const uint64_t saltSizeParm,
-                                    uint64_t& bytesWrittenParm);
+                                    JsonFieldLocation& saltParm);
 
 static CeLoginRc
     ParseIterationsFromToken(const JsmnUtils::JsmnState& jsmnStateParm,
                              const uint64_t saltTokenIdxParm,
                              uint64_t& iterationsParm);
 
+static CeLoginRc ParseScriptFromToken(const JsmnUtils::JsmnState& jsmnStateParm,
+                                      const uint64_t scriptTokenIdxParm,
+                                      JsonFieldLocation& scriptParm);
+
 // machines and expiration
-static CeLoginRc ParseCommonAcfFields(const JsmnUtils::JsmnState& jsmnStateParm,
-                                      CeLogin_Date& dateParm,
-                                      const char* serialNumberParm,
-                                      const uint64_t serialNumberLengthParm,
-                                      ServiceAuthority& authorityParm);
+static CeLoginRc ParseCommonAcfFields(
+    const JsmnUtils::JsmnState& jsmnStateParm,
+    const JsonUtils::JsonRootFields& rootFieldsParm, CeLogin_Date& dateParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    ServiceAuthority& authorityParm);
 
 static CeLoginRc ParseServiceLoginFields(
-    const JsmnUtils::JsmnState& jsmnStateParm, const AcfVersion versionParm,
-    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
-    CeLoginJsonData& decodedJsonParm);
+    const JsmnUtils::JsmnState& jsmnStateParm,
+    const JsonUtils::JsonRootFields& rootFieldsParm,
+    const AcfVersion versionParm, const char* serialNumberParm,
+    const uint64_t serialNumberLengthParm, CeLoginJsonData& decodedJsonParm);
 
 static CeLoginRc ParseAdminResetFields(
-    const JsmnUtils::JsmnState& jsmnStateParm, const AcfVersion versionParm,
-    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
-    CeLoginJsonData& decodedJsonParm);
+    const JsmnUtils::JsmnState& jsmnStateParm,
+    const JsonUtils::JsonRootFields& rootFieldsParm,
+    const AcfVersion versionParm, const char* serialNumberParm,
+    const uint64_t serialNumberLengthParm, CeLoginJsonData& decodedJsonParm);
 
 static CeLoginRc ParseResourceDumpFields(
-    const JsmnUtils::JsmnState& jsmnStateParm, const AcfVersion versionParm,
-    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
-    CeLoginJsonData& decodedJsonParm);
+    const JsmnUtils::JsmnState& jsmnStateParm,
+    const JsonUtils::JsonRootFields& rootFieldsParm,
+    const AcfVersion versionParm, const char* serialNumberParm,
+    const uint64_t serialNumberLengthParm, CeLoginJsonData& decodedJsonParm);
 
-static CeLoginRc ParseBmcShellFields(const JsmnUtils::JsmnState& jsmnStateParm,
-                                     const AcfVersion versionParm,
-                                     const char* serialNumberParm,
-                                     const uint64_t serialNumberLengthParm,
-                                     CeLoginJsonData& decodedJsonParm);
+static CeLoginRc ParseBmcShellFields(
+    const JsmnUtils::JsmnState& jsmnStateParm,
+    const JsonUtils::JsonRootFields& rootFieldsParm,
+    const AcfVersion versionParm, const char* serialNumberParm,
+    const uint64_t serialNumberLengthParm, CeLoginJsonData& decodedJsonParm);
 
 CeLoginRc CeLogin::decodeJson(const char* jsonStringParm,
                               const uint64_t jsonStringLengthParm,
@@ -106,17 +227,58 @@ CeLoginRc CeLogin::decodeJson(const char* jsonStringParm,
     AcfVersion sVersion = CeLoginInvalidVersion;
     AcfType sAcfType = AcfType_Invalid;
 
-    // Used to parse fields in the highest level json object
-    const uint64_t sRootObjectTokenIdx = 0;
+    // Keys of the highest level json object
+    JsonUtils::JsonRootFields sRootFields;
 
     jsmn_parser sJsmnParser;
-    jsmntok_t sJsmnTokens[JsonUtils::JsmnMaxNumTokens];
+    jsmntok_t sStackTokens[JsonUtils::JsmnStackNumTokens];
+    uint32_t sStackSubtreeEnds[JsonUtils::JsmnStackNumTokens];
+    jsmntok_t* sHeapTokens = NULL;
+    jsmntok_t* sJsmnTokens = sStackTokens;
+    uint32_t* sSubtreeEnds = sStackSubtreeEnds;
+
+    decodedJsonParm.mJson = jsonStringParm;
 
     jsmn_init(&sJsmnParser);
-    int sNumTokens = jsmn_parse(&sJsmnParser, jsonStringParm,
-                                jsonStringLengthParm, sJsmnTokens, 128);
+    int sNumTokens =
+        jsmn_parse(&sJsmnParser, jsonStringParm, jsonStringLengthParm,
+                   sStackTokens, JsonUtils::JsmnStackNumTokens);
 
-    if (sNumTokens <= 0)
+    // An ACF listing many machines does not fit on the stack. Count its
+    // tokens, then parse it again into an allocation of the right size.
+    if (JSMN_ERROR_NOMEM == sNumTokens)
+    {
+        jsmn_init(&sJsmnParser);
+        sNumTokens = jsmn_parse(&sJsmnParser, jsonStringParm,
+                                jsonStringLengthParm, NULL, 0);
+
+        if (sNumTokens > CeLogin_MaxNumberOfJsonTokens)
+        {
+            sRc = CeLoginRc(CeLoginRc::JsonUtils,
+                            JsonUtils::DecodeJson_TooManyTokens);
+        }
+        else if (sNumTokens > 0)
+        {
+            // The subtree index follows the tokens in the same allocation
+            sHeapTokens = (jsmntok_t*)allocateScratch(
+                sNumTokens * (sizeof(jsmntok_t) + sizeof(uint32_t)));
+            if (sHeapTokens)
+            {
+                sSubtreeEnds = (uint32_t*)(sHeapTokens + sNumTokens);
+                jsmn_init(&sJsmnParser);
+                sNumTokens = jsmn_parse(&sJsmnParser, jsonStringParm,
+                                        jsonStringLengthParm, sHeapTokens,
+                                        sNumTokens);
+                sJsmnTokens = sHeapTokens;
+            }
+            else
+            {
+                sRc = CeLoginRc::JsonDataAllocationFailure;
+            }
+        }
+    }
+
+    if (CeLoginRc::Success == sRc && sNumTokens <= 0)
     {
         sRc = CeLoginRc(CeLoginRc::JsonUtils,
                         JsonUtils::DecodeJson_JsmnParseFailed);
@@ -147,6 +309,13 @@ CeLoginRc CeLogin::decodeJson(const char* jsonStringParm,
     sJsmnState.mTokenArray = sJsmnTokens;
     sJsmnState.mTokenArrayLength = sNumTokens;
 
+    // Skipping over an entry is then a single lookup, rather than a walk over
+    // all of its descendants
+    if (CeLoginRc::Success == sRc)
+    {
+        JsmnUtils::IndexSubtreeEnds(sJsmnState, sSubtreeEnds);
+    }
+
     // Step 1: Examine the top level entity. JSON only allows for a single
     // top-level entity. In the case of CeLogin, it must be an Object.
     if (CeLoginRc::Success == sRc)
@@ -173,7 +342,11 @@ CeLoginRc CeLogin::decodeJson(const char* jsonStringParm,
     // For the admin reset ACF, we also have the following fields:
     //      - "adminAuthCode"
     // Any others are ignored. If a duplicate is detected, then an error will be
-    // returned.
+    // returned. The keys are all located in a single walk over the object.
+    if (CeLoginRc::Success == sRc)
+    {
+        IndexRootObjectFields(sJsmnState, sRootFields);
+    }
 
     uint64_t sVersionIdx = 0;
     uint64_t sTypeIdx = 0;
@@ -187,9 +360,8 @@ CeLoginRc CeLogin::decodeJson(const char* jsonStringParm,
 
         // Get the token for the version integer
         JsmnUtils::JsmnUtilRc sJsmnRc = JsmnUtils::Success;
-        sJsmnRc = JsmnUtils::ObjectGetValueByKey(
-            sJsmnState, sRootObjectTokenIdx, JsonName_Version,
-            strlen(JsonName_Version), sVersionIdx);
+        sJsmnRc = GetRootFieldValue(sJsmnState, sRootFields,
+                                    JsonUtils::JsonField_Version, sVersionIdx);
         sRc = CeLoginRc(CeLoginRc::JsmnUtils, sJsmnRc);
 
         // Parse the string from the token into an unsigned integer
@@ -227,9 +399,8 @@ CeLoginRc CeLogin::decodeJson(const char* jsonStringParm,
         }
         else
         {
-            JsmnUtils::JsmnUtilRc sJsmnRc = JsmnUtils::ObjectGetValueByKey(
-                sJsmnState, sRootObjectTokenIdx, JsonName_Type,
-                strlen(JsonName_Type), sTypeIdx);
+            JsmnUtils::JsmnUtilRc sJsmnRc = GetRootFieldValue(
+                sJsmnState, sRootFields, JsonUtils::JsonField_Type, sTypeIdx);
 
             if (JsmnUtils::Success == sJsmnRc)
             {
@@ -276,9 +447,9 @@ CeLoginRc CeLogin::decodeJson(const char* jsonStringParm,
     // Parse replay ID if exists
     if (CeLoginRc::Success == sRc && sVersion == CeLoginVersion2)
     {
-        JsmnUtils::JsmnUtilRc sTmpRc = JsmnUtils::ObjectGetValueByKey(
-            sJsmnState, sRootObjectTokenIdx, JsonName_ReplayId,
-            strlen(JsonName_ReplayId), sReplayIdIdx);
+        JsmnUtils::JsmnUtilRc sTmpRc =
+            GetRootFieldValue(sJsmnState, sRootFields,
+                              JsonUtils::JsonField_ReplayId, sReplayIdIdx);
 
         if (JsmnUtils::Success == sTmpRc)
         {
@@ -298,28 +469,28 @@ CeLoginRc CeLogin::decodeJson(const char* jsonStringParm,
             case AcfType_AdminReset:
             {
                 sRc = ParseAdminResetFields(
-                    sJsmnState, sVersion, serialNumberParm,
+                    sJsmnState, sRootFields, sVersion, serialNumberParm,
                     serialNumberLengthParm, decodedJsonParm);
                 break;
             }
             case AcfType_Service:
             {
                 sRc = ParseServiceLoginFields(
-                    sJsmnState, sVersion, serialNumberParm,
+                    sJsmnState, sRootFields, sVersion, serialNumberParm,
                     serialNumberLengthParm, decodedJsonParm);
                 break;
             }
             case AcfType_ResourceDump:
             {
                 sRc = ParseResourceDumpFields(
-                    sJsmnState, sVersion, serialNumberParm,
+                    sJsmnState, sRootFields, sVersion, serialNumberParm,
                     serialNumberLengthParm, decodedJsonParm);
                 break;
             }
             case AcfType_BmcShell:
             {
                 sRc = ParseBmcShellFields(
-                    sJsmnState, sVersion, serialNumberParm,
+                    sJsmnState, sRootFields, sVersion, serialNumberParm,
                     serialNumberLengthParm, decodedJsonParm);
                 break;
             }
@@ -328,6 +499,134 @@ CeLoginRc CeLogin::decodeJson(const char* jsonStringParm,
         }
     }
 
+
+    releaseScratch(sHeapTokens);
+    return sRc;
+}
+
+uint64_t CeLogin::getJsonScratchSize(const uint64_t jsonStringLengthParm)
+{
+    // Every token but the last takes at least two characters, counting the
+    // separator that follows it
+    uint64_t sMaxTokens = jsonStringLengthParm / 2 + 1;
+    if (sMaxTokens > CeLogin_MaxNumberOfJsonTokens)
+    {
+        sMaxTokens = CeLogin_MaxNumberOfJsonTokens;
+    }
+
+    uint64_t sSize = 0;
+    if (sMaxTokens > JsonUtils::JsmnStackNumTokens)
+    {
+        sSize = sMaxTokens * (sizeof(jsmntok_t) + sizeof(uint32_t));
+    }
+    return sSize;
+}
+
+void IndexRootObjectFields(const JsmnUtils::JsmnState& jsmnStateParm,
+                           JsonUtils::JsonRootFields& fieldsParm)
+{
+    const uint64_t sRootObjectTokenIdx = 0;
+
+    fieldsParm.mWalkRc = JsmnUtils::Success;
+    fieldsParm.mFoundMask = 0;
+    fieldsParm.mDuplicateMask = 0;
+
+    if (!jsmnStateParm.isValid() ||
+        !jsmnStateParm.isTokenIdxValid(sRootObjectTokenIdx) ||
+        JSMN_OBJECT != jsmnStateParm.getToken(sRootObjectTokenIdx).type)
+    {
+        fieldsParm.mWalkRc = JsmnUtils::ObjectGetValueByKey_InvalidParm;
+    }
+    else if (0 == jsmnStateParm.getToken(sRootObjectTokenIdx).size)
+    {
+        fieldsParm.mWalkRc = JsmnUtils::ObjectGetValueByKey_KeyNotFound;
+    }
+    else
+    {
+        // Walk the same entries, in the same order, as ObjectGetValueByKey
+        uint64_t sTokenIdx = sRootObjectTokenIdx + 1;
+        uint64_t sObjectEndIdx = 0;
+        fieldsParm.mWalkRc = JsmnUtils::GetNextJsonEntry(
+            jsmnStateParm, sRootObjectTokenIdx, sObjectEndIdx);
+
+        while (JsmnUtils::Success == fieldsParm.mWalkRc &&
+               jsmnStateParm.isTokenIdxValid(sTokenIdx) &&
+               sTokenIdx < sObjectEndIdx)
+        {
+            JsmnUtils::JsmnString sKey = jsmnStateParm.getString(sTokenIdx);
+
+            if (sKey.mCharLength <= JsonUtils::JsonField_MaxNameLength)
+            {
+                const uint64_t sSlot =
+                    getJsonFieldSlot(sKey.mCharArray, sKey.mCharLength);
+                const char* sName =
+                    JsonFieldNames[sSlot] ? *JsonFieldNames[sSlot] : NULL;
+
+                if (sName && JsmnUtils::SafeJsmnStringCompare(sKey, sName,
+                                                              strlen(sName)))
+                {
+                    const uint16_t sBit = (uint16_t)(1 << sSlot);
+                    if (fieldsParm.mFoundMask & sBit)
+                    {
+                        fieldsParm.mDuplicateMask |= sBit;
+                    }
+                    else
+                    {
+                        fieldsParm.mFoundMask |= sBit;
+                        fieldsParm.mKeyIdx[sSlot] = sTokenIdx;
+                    }
+                }
+            }
+
+            uint64_t sNextTokenIdx = 0;
+            fieldsParm.mWalkRc = JsmnUtils::GetNextJsonEntry(
+                jsmnStateParm, sTokenIdx, sNextTokenIdx);
+            if (JsmnUtils::Success != fieldsParm.mWalkRc)
+            {
+                break;
+            }
+            sTokenIdx = sNextTokenIdx;
+        }
+    }
+}
+
+JsmnUtils::JsmnUtilRc
+    GetRootFieldValue(const JsmnUtils::JsmnState& jsmnStateParm,
+                      const JsonUtils::JsonRootFields& fieldsParm,
+                      const JsonUtils::JsonField fieldParm,
+                      uint64_t& valueIdxParm)
+{
+    JsmnUtils::JsmnUtilRc sRc = JsmnUtils::Success;
+    const uint16_t sBit = (uint16_t)(1 << fieldParm);
+
+    // A duplicate is reported even if the walk failed further on, just like
+    // ObjectGetValueByKey stops at the first duplicate
+    if (fieldsParm.mDuplicateMask & sBit)
+    {
+        sRc = JsmnUtils::ObjectGetValueByKey_DuplicateKeyFound;
+    }
+    else if (JsmnUtils::Success != fieldsParm.mWalkRc)
+    {
+        sRc = fieldsParm.mWalkRc;
+    }
+    else if (fieldsParm.mFoundMask & sBit)
+    {
+        // By definition, the found object should have size = 1 (the value)
+        const uint64_t sKeyIdx = fieldsParm.mKeyIdx[fieldParm];
+        if (1 == jsmnStateParm.getToken(sKeyIdx).size &&
+            jsmnStateParm.isTokenIdxValid(sKeyIdx + 1))
+        {
+            valueIdxParm = sKeyIdx + 1;
+        }
+        else
+        {
+            sRc = JsmnUtils::ObjectGetValueByKey_ObjectMissingValue;
+        }
+    }
+    else
+    {
+        sRc = JsmnUtils::ObjectGetValueByKey_KeyNotFound;
+    }
     return sRc;
 }
 
@@ -363,6 +662,88 @@ CeLoginRc ParseDateFromToken(const JsmnUtils::JsmnState& jsmnStateParm,
     return sRc;
 }
 
+#ifdef JSMN_PARENT_LINKS
+// Scan the raw bytes of the machines array for the serial number and only
+// look at the tokens where it occurs. The entry is the first one the walk over
+// the machines array would have matched, provided the entries before it are
+// well formed. Returns false if there is no such entry.
+static bool FindMachineEntryBySerialNumber(
+    const JsmnUtils::JsmnState& jsmnStateParm,
+    const uint64_t machineArrayTokenIdxParm, const char* serialNumberParm,
+    const uint64_t serialNumberLengthParm, uint64_t& entryIdxParm)
+{
+    const jsmntok_t& sArray = jsmnStateParm.getToken(machineArrayTokenIdxParm);
+    uint64_t sArrayEndIdx = 0;
+    if (JsmnUtils::Success !=
+            JsmnUtils::GetNextJsonEntry(jsmnStateParm, machineArrayTokenIdxParm,
+                                        sArrayEndIdx) ||
+        sArray.start < 0 || sArray.end < sArray.start ||
+        (uint64_t)sArray.end > jsmnStateParm.mJsonStringLength)
+    {
+        return false;
+    }
+
+    const char* sArrayData = jsmnStateParm.mJsonString + sArray.start;
+    const uint64_t sArrayLength = sArray.end - sArray.start;
+    for (uint64_t sOffset = 0; sOffset < sArrayLength; sOffset++)
+    {
+        sOffset += JsmnUtils::FindString(sArrayData + sOffset,
+                                         sArrayLength - sOffset,
+                                         serialNumberParm,
+                                         serialNumberLengthParm);
+        if (sOffset >= sArrayLength)
+        {
+            break;
+        }
+
+        // Tokens are ordered by their start, find the first one starting here
+        const int sStart = sArray.start + (int)sOffset;
+        uint64_t sLow = machineArrayTokenIdxParm + 1;
+        uint64_t sHigh = sArrayEndIdx;
+        while (sLow < sHigh)
+        {
+            const uint64_t sMid = sLow + (sHigh - sLow) / 2;
+            if (jsmnStateParm.getToken(sMid).start < sStart)
+            {
+                sLow = sMid + 1;
+            }
+            else
+            {
+                sHigh = sMid;
+            }
+        }
+
+        // It has to be the whole value of a serial number key, in an object
+        // that is directly in the machines array
+        if (sLow < sArrayEndIdx)
+        {
+            const jsmntok_t& sValue = jsmnStateParm.getToken(sLow);
+            const int sKeyIdx = sValue.parent;
+            if (sStart == sValue.start &&
+                serialNumberLengthParm ==
+                    (uint64_t)(sValue.end - sValue.start) &&
+                sKeyIdx > (int)machineArrayTokenIdxParm &&
+                JsmnUtils::SafeJsmnStringCompare(
+                    jsmnStateParm.getString(sKeyIdx), JsonName_SerialNumber,
+                    strlen(JsonName_SerialNumber)))
+            {
+                const int sEntryIdx = jsmnStateParm.getToken(sKeyIdx).parent;
+                if (sEntryIdx > (int)machineArrayTokenIdxParm &&
+                    JSMN_OBJECT == jsmnStateParm.getToken(sEntryIdx).type &&
+                    (int)machineArrayTokenIdxParm ==
+                        jsmnStateParm.getToken(sEntryIdx).parent)
+                {
+                    entryIdxParm = sEntryIdx;
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+#endif
+
 CeLoginRc ParseAuthorityFromMachineArrayToken(
     const JsmnUtils::JsmnState& jsmnStateParm,
     const uint64_t machineArrayTokenIdxParm, const char* serialNumberParm,
@@ -395,6 +776,14 @@ CeLoginRc ParseAuthorityFromMachineArrayToken(
             const uint64_t sNumOfEntries = sTokenValue.size; // Array length
             uint64_t sCurIdx =
                 machineArrayTokenIdxParm + 1; // Next token is the first element
+#ifdef JSMN_PARENT_LINKS
+            // Start at the entry with the serial number, if there is one. The
+            // full walk is kept for when there is not, to reject the same ACFs.
+            FindMachineEntryBySerialNumber(jsmnStateParm,
+                                           machineArrayTokenIdxParm,
+                                           serialNumberParm,
+                                           serialNumberLengthParm, sCurIdx);
+#endif
             for (uint64_t sIdx = 0; sIdx < sNumOfEntries;
                  sIdx++) // Iterate over the array
             {
@@ -478,13 +867,13 @@ CeLoginRc ParseAuthorityFromMachineArrayToken(
     return sRc;
 }
 
+// The value is decoded to check it, and decoded again whenever it is used
 CeLoginRc ParseHashedAuthCodeFromToken(
     const JsmnUtils::JsmnState& jsmnStateParm,
-    const uint64_t hashedAuthCodeTokenIdxParm, uint8_t* hashedAuthCodeParm,
-    const uint64_t hashedAuthCodeSizeParm, uint64_t& bytesWrittenParm)
+    const uint64_t hashedAuthCodeTokenIdxParm,
+    JsonFieldLocation& hashedAuthCodeParm)
 {
     CeLoginRc sRc = CeLoginRc::Success;
-    bytesWrittenParm = 0;
 
     if (!jsmnStateParm.isValid() ||
         !jsmnStateParm.isTokenIdxValid(hashedAuthCodeTokenIdxParm))
@@ -507,29 +896,35 @@ CeLoginRc ParseHashedAuthCodeFromToken(
             JsmnUtils::JsmnString sJsmnString =
                 jsmnStateParm.getString(hashedAuthCodeTokenIdxParm);
 
+            uint8_t sHashedAuthCode[CeLogin_MaxHashedAuthCodeLength];
+            uint64_t sBytesWritten = 0;
             sRc = getBinaryFromHex(sJsmnString.mCharArray,
-                                   sJsmnString.mCharLength, hashedAuthCodeParm,
-                                   hashedAuthCodeSizeParm, bytesWrittenParm);
+                                   sJsmnString.mCharLength, sHashedAuthCode,
+                                   sizeof(sHashedAuthCode), sBytesWritten);
 
             if (CeLoginRc::Success == sRc &&
-                CeLogin_MaxHashedAuthCodeLength < bytesWrittenParm)
+                CeLogin_MaxHashedAuthCodeLength < sBytesWritten)
             {
                 sRc =
                     CeLoginRc(CeLoginRc::JsonUtils,
                               JsonUtils::ParseHashedAuth_UnexpectedHashLength);
             }
+
+            if (CeLoginRc::Success == sRc)
+            {
+                hashedAuthCodeParm.mOffset = sTokenValue.start;
+                hashedAuthCodeParm.mLength = sJsmnString.mCharLength;
+            }
         }
     }
     return sRc;
 }
 
 CeLoginRc ParseSaltFromToken(const JsmnUtils::JsmnState& jsmnStateParm,
-                             const uint64_t saltTokenIdxParm, uint8_t* saltParm,
-                             const uint64_t saltSizeParm,
-                             uint64_t& bytesWrittenParm)
+                             const uint64_t saltTokenIdxParm,
+                             JsonFieldLocation& saltParm)
 {
     CeLoginRc sRc = CeLoginRc::Success;
-    bytesWrittenParm = 0;
 
     if (!jsmnStateParm.isValid() ||
         !jsmnStateParm.isTokenIdxValid(saltTokenIdxParm))
@@ -550,16 +945,24 @@ CeLoginRc ParseSaltFromToken(const JsmnUtils::JsmnState& jsmnStateParm,
             JsmnUtils::JsmnString sJsmnString =
                 jsmnStateParm.getString(saltTokenIdxParm);
 
+            uint8_t sSalt[CeLogin_MaxHashedAuthCodeSaltLength];
+            uint64_t sBytesWritten = 0;
             sRc = getBinaryFromHex(sJsmnString.mCharArray,
-                                   sJsmnString.mCharLength, saltParm,
-                                   saltSizeParm, bytesWrittenParm);
+                                   sJsmnString.mCharLength, sSalt,
+                                   sizeof(sSalt), sBytesWritten);
 
             if (CeLoginRc::Success == sRc &&
-                CeLogin_MaxHashedAuthCodeSaltLength < bytesWrittenParm)
+                CeLogin_MaxHashedAuthCodeSaltLength < sBytesWritten)
             {
                 sRc = CeLoginRc(CeLoginRc::JsonUtils,
                                 JsonUtils::ParseSalt_SaltTooLong);
             }
+
+            if (CeLoginRc::Success == sRc)
+            {
+                saltParm.mOffset = sTokenValue.start;
+                saltParm.mLength = sJsmnString.mCharLength;
+            }
         }
     }
     return sRc;
@@ -572,7 +975,7 @@ CeLoginRc ParseIterationsFromToken(const JsmnUtils::JsmnState& jsmnStateParm,
     CeLoginRc sRc = CeLoginRc::Success;
 
     if (!jsmnStateParm.isValid() ||
-        !jsmnStateParm.isTokenIdxValid(iterationsParm))
+        !jsmnStateParm.isTokenIdxValid(iterationsTokenIdxParm))
     {
         sRc = CeLoginRc(CeLoginRc::JsonUtils,
                         JsonUtils::ParseIterations_InvalidParm);
@@ -600,40 +1003,37 @@ CeLoginRc ParseIterationsFromToken(const JsmnUtils::JsmnState& jsmnStateParm,
     return sRc;
 }
 
-CeLoginRc ParseServiceLoginFields(const JsmnUtils::JsmnState& jsmnStateParm,
-                                  const AcfVersion versionParm,
-                                  const char* serialNumberParm,
-                                  const uint64_t serialNumberLengthParm,
-                                  CeLoginJsonData& decodedJsonParm)
+CeLoginRc ParseServiceLoginFields(
+    const JsmnUtils::JsmnState& jsmnStateParm,
+    const JsonUtils::JsonRootFields& rootFieldsParm,
+    const AcfVersion versionParm, const char* serialNumberParm,
+    const uint64_t serialNumberLengthParm, CeLoginJsonData& decodedJsonParm)
 {
     CeLoginRc sRc = CeLoginRc::Success;
     JsmnUtils::JsmnUtilRc sJsmnRc = JsmnUtils::Success;
 
-    const uint64_t sRootObjectTokenIdx = 0;
-
     uint64_t sHashedAuthCodeIdx = 0;
     uint64_t sSaltIdx = 0;
     uint64_t sIterationsIdx = 0;
 
     if (JsmnUtils::Success == sJsmnRc)
     {
-        sJsmnRc = JsmnUtils::ObjectGetValueByKey(
-            jsmnStateParm, sRootObjectTokenIdx, JsonName_HashedAuthCode,
-            strlen(JsonName_HashedAuthCode), sHashedAuthCodeIdx);
+        sJsmnRc = GetRootFieldValue(jsmnStateParm, rootFieldsParm,
+                                    JsonUtils::JsonField_HashedAuthCode,
+                                    sHashedAuthCodeIdx);
     }
 
     if (JsmnUtils::Success == sJsmnRc)
     {
-        sJsmnRc = JsmnUtils::ObjectGetValueByKey(
-            jsmnStateParm, sRootObjectTokenIdx, JsonName_Salt,
-            strlen(JsonName_Salt), sSaltIdx);
+        sJsmnRc = GetRootFieldValue(jsmnStateParm, rootFieldsParm,
+                                    JsonUtils::JsonField_Salt, sSaltIdx);
     }
 
     if (JsmnUtils::Success == sJsmnRc)
     {
-        sJsmnRc = JsmnUtils::ObjectGetValueByKey(
-            jsmnStateParm, sRootObjectTokenIdx, JsonName_Iterations,
-            strlen(JsonName_Iterations), sIterationsIdx);
+        sJsmnRc = GetRootFieldValue(jsmnStateParm, rootFieldsParm,
+                                    JsonUtils::JsonField_Iterations,
+                                    sIterationsIdx);
     }
 
     // Convert JsmnRc to CeLoginRc for consolidated RC handling
@@ -641,27 +1041,24 @@ CeLoginRc ParseServiceLoginFields(const JsmnUtils::JsmnState& jsmnStateParm,
 
     if (CeLoginRc::Success == sRc)
     {
-        sRc = ParseCommonAcfFields(
-            jsmnStateParm, decodedJsonParm.mExpirationDate, serialNumberParm,
-            serialNumberLengthParm, decodedJsonParm.mRequestedAuthority);
+        sRc = ParseCommonAcfFields(jsmnStateParm, rootFieldsParm,
+                                   decodedJsonParm.mExpirationDate,
+                                   serialNumberParm, serialNumberLengthParm,
+                                   decodedJsonParm.mRequestedAuthority);
     }
 
     // parse hashed auth code
     if (CeLoginRc::Success == sRc)
     {
-        sRc = ParseHashedAuthCodeFromToken(
-            jsmnStateParm, sHashedAuthCodeIdx, decodedJsonParm.mHashedAuthCode,
-            sizeof(decodedJsonParm.mHashedAuthCode),
-            decodedJsonParm.mHashedAuthCodeLength);
+        sRc = ParseHashedAuthCodeFromToken(jsmnStateParm, sHashedAuthCodeIdx,
+                                           decodedJsonParm.mHashedAuthCode);
     }
 
     // parse salt
     if (CeLoginRc::Success == sRc)
     {
         sRc = ParseSaltFromToken(jsmnStateParm, sSaltIdx,
-                                 decodedJsonParm.mAuthCodeSalt,
-                                 sizeof(decodedJsonParm.mAuthCodeSalt),
-                                 decodedJsonParm.mAuthCodeSaltLength);
+                                 decodedJsonParm.mAuthCodeSalt);
     }
 
     // parse number of iterations
@@ -675,6 +1072,7 @@ CeLoginRc ParseServiceLoginFields(const JsmnUtils::JsmnState& jsmnStateParm,
 }
 
 CeLoginRc ParseAdminResetFields(const JsmnUtils::JsmnState& jsmnStateParm,
+                                const JsonUtils::JsonRootFields& rootFieldsParm,
                                 const AcfVersion versionParm,
                                 const char* serialNumberParm,
                                 const uint64_t serialNumberLengthParm,
@@ -683,15 +1081,13 @@ CeLoginRc ParseAdminResetFields(const JsmnUtils::JsmnState& jsmnStateParm,
     CeLoginRc sRc = CeLoginRc::Success;
     JsmnUtils::JsmnUtilRc sJsmnRc = JsmnUtils::Success;
 
-    const uint64_t sRootObjectTokenIdx = 0;
-
     uint64_t sAdminAuthCodeIdx = 0;
 
     if (JsmnUtils::Success == sJsmnRc)
     {
-        sJsmnRc = JsmnUtils::ObjectGetValueByKey(
-            jsmnStateParm, sRootObjectTokenIdx, JsonName_AdminAuthCode,
-            strlen(JsonName_AdminAuthCode), sAdminAuthCodeIdx);
+        sJsmnRc = GetRootFieldValue(jsmnStateParm, rootFieldsParm,
+                                    JsonUtils::JsonField_AdminAuthCode,
+                                    sAdminAuthCodeIdx);
     }
 
     // Convert to CeLoginRc for consolidated RC handling
@@ -701,20 +1097,21 @@ CeLoginRc ParseAdminResetFields(const JsmnUtils::JsmnState& jsmnStateParm,
     {
         ServiceAuthority sIgnoredAuth;
         sRc = ParseCommonAcfFields(
-            jsmnStateParm, decodedJsonParm.mExpirationDate, serialNumberParm,
-            serialNumberLengthParm, sIgnoredAuth);
+            jsmnStateParm, rootFieldsParm, decodedJsonParm.mExpirationDate,
+            serialNumberParm, serialNumberLengthParm, sIgnoredAuth);
     }
 
-    // Copy out adminAuthCode
+    // Locate adminAuthCode
     if (CeLoginRc::Success == sRc)
     {
-        JsmnUtils::JsmnString sAdminAuthStr =
-            jsmnStateParm.getString(sAdminAuthCodeIdx);
-        if (sAdminAuthStr.mCharLength <= CeLogin_MaxHashedAuthCodeLength)
+        const jsmntok_t& sAdminAuthToken =
+            jsmnStateParm.getToken(sAdminAuthCodeIdx);
+        const uint64_t sAdminAuthLength =
+            sAdminAuthToken.end - sAdminAuthToken.start;
+        if (sAdminAuthLength <= CeLogin_MaxHashedAuthCodeLength)
         {
-            memcpy(decodedJsonParm.mAdminAuthCode, sAdminAuthStr.mCharArray,
-                   sAdminAuthStr.mCharLength);
-            decodedJsonParm.mAdminAuthCodeLength = sAdminAuthStr.mCharLength;
+            decodedJsonParm.mAdminAuthCode.mOffset = sAdminAuthToken.start;
+            decodedJsonParm.mAdminAuthCode.mLength = sAdminAuthLength;
         }
         else
         {
@@ -725,24 +1122,22 @@ CeLoginRc ParseAdminResetFields(const JsmnUtils::JsmnState& jsmnStateParm,
     return sRc;
 }
 
-CeLoginRc ParseResourceDumpFields(const JsmnUtils::JsmnState& jsmnStateParm,
-                                  const AcfVersion versionParm,
-                                  const char* serialNumberParm,
-                                  const uint64_t serialNumberLengthParm,
-                                  CeLoginJsonData& decodedJsonParm)
+CeLoginRc ParseResourceDumpFields(
+    const JsmnUtils::JsmnState& jsmnStateParm,
+    const JsonUtils::JsonRootFields& rootFieldsParm,
+    const AcfVersion versionParm, const char* serialNumberParm,
+    const uint64_t serialNumberLengthParm, CeLoginJsonData& decodedJsonParm)
 {
     CeLoginRc sRc = CeLoginRc::Success;
     JsmnUtils::JsmnUtilRc sJsmnRc = JsmnUtils::Success;
 
-    const uint64_t sRootObjectTokenIdx = 0;
-
     uint64_t sResourceDumpIdx = 0;
 
     if (JsmnUtils::Success == sJsmnRc)
     {
-        sJsmnRc = JsmnUtils::ObjectGetValueByKey(
-            jsmnStateParm, sRootObjectTokenIdx, JsonName_ResourceDumps,
-            strlen(JsonName_ResourceDumps), sResourceDumpIdx);
+        sJsmnRc = GetRootFieldValue(jsmnStateParm, rootFieldsParm,
+                                    JsonUtils::JsonField_ResourceDumps,
+                                    sResourceDumpIdx);
     }
 
     // Convert to CeLoginRc for consolidated RC handling
@@ -750,27 +1145,24 @@ CeLoginRc ParseResourceDumpFields(const JsmnUtils::JsmnState& jsmnStateParm,
 
     if (CeLoginRc::Success == sRc)
     {
-        sRc = ParseCommonAcfFields(
-            jsmnStateParm, decodedJsonParm.mExpirationDate, serialNumberParm,
-            serialNumberLengthParm, decodedJsonParm.mRequestedAuthority);
+        sRc = ParseCommonAcfFields(jsmnStateParm, rootFieldsParm,
+                                   decodedJsonParm.mExpirationDate,
+                                   serialNumberParm, serialNumberLengthParm,
+                                   decodedJsonParm.mRequestedAuthority);
     }
 
-    // Copy out resourcedump field
+    // Check resourcedump field
     if (CeLoginRc::Success == sRc)
     {
-        JsmnUtils::JsmnString sResourceDumpStr =
-            jsmnStateParm.getString(sResourceDumpIdx);
-        sRc = CeLogin::base64Decode(sResourceDumpStr.mCharArray,
-                                    sResourceDumpStr.mCharLength,
-                                    decodedJsonParm.mAsciiScriptFile,
-                                    sizeof(decodedJsonParm.mAsciiScriptFile),
-                                    decodedJsonParm.mAsciiScriptFileLength);
+        sRc = ParseScriptFromToken(jsmnStateParm, sResourceDumpIdx,
+                                   decodedJsonParm.mAsciiScriptFile);
     }
 
     return sRc;
 }
 
 CeLoginRc ParseBmcShellFields(const JsmnUtils::JsmnState& jsmnStateParm,
+                              const JsonUtils::JsonRootFields& rootFieldsParm,
                               const AcfVersion versionParm,
                               const char* serialNumberParm,
                               const uint64_t serialNumberLengthParm,
@@ -779,31 +1171,29 @@ CeLoginRc ParseBmcShellFields(const JsmnUtils::JsmnState& jsmnStateParm,
     CeLoginRc sRc = CeLoginRc::Success;
     JsmnUtils::JsmnUtilRc sJsmnRc = JsmnUtils::Success;
 
-    const uint64_t sRootObjectTokenIdx = 0;
-
     uint64_t sBmcShellIdx = 0;
     uint64_t sBmcTimeoutIdx = 0;
     uint64_t sIssueBmcDumpIdx = 0;
 
     if (JsmnUtils::Success == sJsmnRc)
     {
-        sJsmnRc = JsmnUtils::ObjectGetValueByKey(
-            jsmnStateParm, sRootObjectTokenIdx, JsonName_BmcShellScript,
-            strlen(JsonName_BmcShellScript), sBmcShellIdx);
+        sJsmnRc = GetRootFieldValue(jsmnStateParm, rootFieldsParm,
+                                    JsonUtils::JsonField_BmcShellScript,
+                                    sBmcShellIdx);
     }
 
     if (JsmnUtils::Success == sJsmnRc)
     {
-        sJsmnRc = JsmnUtils::ObjectGetValueByKey(
-            jsmnStateParm, sRootObjectTokenIdx, JsonName_BmcTimeoutVal,
-            strlen(JsonName_BmcTimeoutVal), sBmcTimeoutIdx);
+        sJsmnRc = GetRootFieldValue(jsmnStateParm, rootFieldsParm,
+                                    JsonUtils::JsonField_BmcTimeoutVal,
+                                    sBmcTimeoutIdx);
     }
 
     if (JsmnUtils::Success == sJsmnRc)
     {
-        sJsmnRc = JsmnUtils::ObjectGetValueByKey(
-            jsmnStateParm, sRootObjectTokenIdx, JsonName_IssueBmcDump,
-            strlen(JsonName_IssueBmcDump), sIssueBmcDumpIdx);
+        sJsmnRc = GetRootFieldValue(jsmnStateParm, rootFieldsParm,
+                                    JsonUtils::JsonField_IssueBmcDump,
+                                    sIssueBmcDumpIdx);
     }
 
     // Convert to CeLoginRc for consolidated RC handling
@@ -813,21 +1203,15 @@ CeLoginRc ParseBmcShellFields(const JsmnUtils::JsmnState& jsmnStateParm,
     {
         ServiceAuthority sIgnoredAuth;
         sRc = ParseCommonAcfFields(
-            jsmnStateParm, decodedJsonParm.mExpirationDate, serialNumberParm,
-            serialNumberLengthParm, sIgnoredAuth);
+            jsmnStateParm, rootFieldsParm, decodedJsonParm.mExpirationDate,
+            serialNumberParm, serialNumberLengthParm, sIgnoredAuth);
     }
 
-    // Copy out bmcshell field
+    // Check bmcshell field
     if (CeLoginRc::Success == sRc)
     {
-        JsmnUtils::JsmnString sBmcShellStr =
-            jsmnStateParm.getString(sBmcShellIdx);
-
-        sRc = CeLogin::base64Decode(sBmcShellStr.mCharArray,
-                                    sBmcShellStr.mCharLength,
-                                    decodedJsonParm.mAsciiScriptFile,
-                                    sizeof(decodedJsonParm.mAsciiScriptFile),
-                                    decodedJsonParm.mAsciiScriptFileLength);
+        sRc = ParseScriptFromToken(jsmnStateParm, sBmcShellIdx,
+                                   decodedJsonParm.mAsciiScriptFile);
     }
 
     if (CeLoginRc::Success == sRc)
@@ -855,7 +1239,80 @@ CeLoginRc ParseBmcShellFields(const JsmnUtils::JsmnState& jsmnStateParm,
     return sRc;
 }
 
+// The script is decoded in pieces to check it, and decoded again whenever it
+// is used. A script of any length can be checked this way.
+CeLoginRc ParseScriptFromToken(const JsmnUtils::JsmnState& jsmnStateParm,
+                               const uint64_t scriptTokenIdxParm,
+                               JsonFieldLocation& scriptParm)
+{
+    CeLoginRc sRc = CeLoginRc::Success;
+
+    const jsmntok_t& sScriptToken = jsmnStateParm.getToken(scriptTokenIdxParm);
+    JsmnUtils::JsmnString sScriptStr =
+        jsmnStateParm.getString(scriptTokenIdxParm);
+
+    // Padding may only end the script, not any of the pieces before it
+    const char* sPad = (const char*)memchr(sScriptStr.mCharArray, '=',
+                                           sScriptStr.mCharLength);
+    if (sPad && sPad + 2 < sScriptStr.mCharArray + sScriptStr.mCharLength)
+    {
+        sRc = CeLoginRc::Failure;
+    }
+
+    uint8_t sPiece[192];
+    const uint64_t sPieceLength = sizeof(sPiece) / 3 * 4;
+    for (uint64_t sOffset = 0;
+         CeLoginRc::Success == sRc && sOffset < sScriptStr.mCharLength;
+         sOffset += sPieceLength)
+    {
+        uint64_t sLength = sScriptStr.mCharLength - sOffset;
+        if (sLength > sPieceLength)
+        {
+            sLength = sPieceLength;
+        }
+
+        size_t sDecodedLength = 0;
+        sRc = CeLogin::base64Decode(sScriptStr.mCharArray + sOffset, sLength,
+                                    sPiece, sizeof(sPiece), sDecodedLength);
+    }
+
+    if (CeLoginRc::Success == sRc)
+    {
+        scriptParm.mOffset = sScriptToken.start;
+        scriptParm.mLength = sScriptStr.mCharLength;
+    }
+
+    return sRc;
+}
+
+CeLoginRc CeLogin::getJsonFieldFromHex(const CeLoginJsonData& jsonDataParm,
+                                       const JsonFieldLocation& fieldParm,
+                                       uint8_t* binaryParm,
+                                       const uint64_t binarySizeParm,
+                                       uint64_t& binaryLengthParm)
+{
+    return getBinaryFromHex(getJsonFieldData(jsonDataParm, fieldParm),
+                            fieldParm.mLength, binaryParm, binarySizeParm,
+                            binaryLengthParm);
+}
+
+CeLoginRc CeLogin::getJsonFieldFromBase64(const CeLoginJsonData& jsonDataParm,
+                                          const JsonFieldLocation& fieldParm,
+                                          uint8_t* binaryParm,
+                                          const uint64_t binarySizeParm,
+                                          uint64_t& binaryLengthParm)
+{
+    size_t sBinaryLength = 0;
+    CeLoginRc sRc =
+        base64Decode(getJsonFieldData(jsonDataParm, fieldParm),
+                     fieldParm.mLength, binaryParm, binarySizeParm,
+                     sBinaryLength);
+    binaryLengthParm = (CeLoginRc::Success == sRc) ? sBinaryLength : 0;
+    return sRc;
+}
+
 CeLoginRc ParseCommonAcfFields(const JsmnUtils::JsmnState& jsmnStateParm,
+                               const JsonUtils::JsonRootFields& rootFieldsParm,
                                CeLogin_Date& dateParm,
                                const char* serialNumberParm,
                                const uint64_t serialNumberLengthParm,
@@ -864,23 +1321,21 @@ CeLoginRc ParseCommonAcfFields(const JsmnUtils::JsmnState& jsmnStateParm,
     CeLoginRc sRc = CeLoginRc::Success;
     JsmnUtils::JsmnUtilRc sJsmnRc = JsmnUtils::Success;
 
-    const uint64_t sRootObjectTokenIdx = 0;
-
     uint64_t sMachinesIdx = 0;
     uint64_t sExpirationIdx = 0;
 
     if (JsmnUtils::Success == sJsmnRc)
     {
-        sJsmnRc = JsmnUtils::ObjectGetValueByKey(
-            jsmnStateParm, sRootObjectTokenIdx, JsonName_Machines,
-            strlen(JsonName_Machines), sMachinesIdx);
+        sJsmnRc = GetRootFieldValue(jsmnStateParm, rootFieldsParm,
+                                    JsonUtils::JsonField_Machines,
+                                    sMachinesIdx);
     }
 
     if (JsmnUtils::Success == sJsmnRc)
     {
-        sJsmnRc = JsmnUtils::ObjectGetValueByKey(
-            jsmnStateParm, sRootObjectTokenIdx, JsonName_Expiration,
-            strlen(JsonName_Expiration), sExpirationIdx);
+        sJsmnRc = GetRootFieldValue(jsmnStateParm, rootFieldsParm,
+                                    JsonUtils::JsonField_Expiration,
+                                    sExpirationIdx);
     }
 
     // Parsing complete, start using CeLogin return codes
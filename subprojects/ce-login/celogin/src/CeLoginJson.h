@@ -40,33 +40,37 @@ struct AntiReplayInfo
     uint64_t mReplayId;
 };
 
+/// Where a string value lies in the JSON it was decoded from, without the
+/// quotes. A length of 0 if the value was not present.
+struct JsonFieldLocation
+{
+    JsonFieldLocation() : mOffset(0), mLength(0)
+    {}
+
+    uint32_t mOffset;
+    uint32_t mLength;
+};
+
+/// The contents of an ACF. Binary fields are left encoded in the JSON and
+/// decoded when needed, so the JSON has to outlive the data.
 struct CeLoginJsonData
 {
     CeLoginJsonData() :
-        mVersion(CeLoginInvalidVersion), mType(AcfType_Invalid),
-        mRequestedAuthority(ServiceAuth_None), mHashedAuthCodeLength(0),
-        mAuthCodeSaltLength(0), mExpirationDate(), mIterations(0),
-        mAdminAuthCodeLength(0), mAsciiScriptFileLength(0), mReplayInfo()
-    {
-        memset(&mHashedAuthCode, 0x00, sizeof(mHashedAuthCode));
-        memset(&mAuthCodeSalt, 0x00, sizeof(mAuthCodeSalt));
-        memset(&mAdminAuthCode, 0x00, sizeof(mAdminAuthCode));
-        memset(&mAsciiScriptFile, 0x00, sizeof(mAsciiScriptFile));
-    };
+        mJson(NULL), mVersion(CeLoginInvalidVersion), mType(AcfType_Invalid),
+        mRequestedAuthority(ServiceAuth_None), mExpirationDate(),
+        mIterations(0), mBmcTimeout(0), mIssueBmcDump(false), mReplayInfo()
+    {}
 
+    const char* mJson;
     AcfVersion mVersion;
     AcfType mType;
     ServiceAuthority mRequestedAuthority;
-    uint8_t mHashedAuthCode[CeLogin_MaxHashedAuthCodeLength];
-    uint64_t mHashedAuthCodeLength;
-    uint8_t mAuthCodeSalt[CeLogin_MaxHashedAuthCodeSaltLength];
-    uint64_t mAuthCodeSaltLength;
     CeLogin_Date mExpirationDate;
     uint64_t mIterations;
-    uint8_t mAdminAuthCode[CeLogin_MaxHashedAuthCodeLength];
-    uint64_t mAdminAuthCodeLength;
-    uint8_t mAsciiScriptFile[MaxAsciiScriptFileLength];
-    size_t mAsciiScriptFileLength;
+    JsonFieldLocation mHashedAuthCode;  // Hex
+    JsonFieldLocation mAuthCodeSalt;    // Hex
+    JsonFieldLocation mAdminAuthCode;   // Hex
+    JsonFieldLocation mAsciiScriptFile; // Base64
     uint64_t mBmcTimeout;
     bool mIssueBmcDump;
     AntiReplayInfo mReplayInfo;
@@ -78,6 +82,31 @@ CeLoginRc decodeJson(const char* jsonStringParm,
                      const uint64_t serialNumberLengthParm,
                      CeLoginJsonData& decodedJsonParm);
 
+/// @brief The characters of a field, inside the JSON the data was decoded from
+inline const char* getJsonFieldData(const CeLoginJsonData& jsonDataParm,
+                                    const JsonFieldLocation& fieldParm)
+{
+    return jsonDataParm.mJson + fieldParm.mOffset;
+}
+
+/// @brief Decode a hex encoded field
+CeLoginRc getJsonFieldFromHex(const CeLoginJsonData& jsonDataParm,
+                              const JsonFieldLocation& fieldParm,
+                              uint8_t* binaryParm,
+                              const uint64_t binarySizeParm,
+                              uint64_t& binaryLengthParm);
+
+/// @brief Decode a base64 encoded field
+CeLoginRc getJsonFieldFromBase64(const CeLoginJsonData& jsonDataParm,
+                                 const JsonFieldLocation& fieldParm,
+                                 uint8_t* binaryParm,
+                                 const uint64_t binarySizeParm,
+                                 uint64_t& binaryLengthParm);
+
+/// @brief The scratch memory decodeJson allocates for JSON of up to the given
+/// length, 0 if it does not need any
+uint64_t getJsonScratchSize(const uint64_t jsonStringLengthParm);
+
 CeLoginRc isTimeExpired(const CeLoginJsonData* sJsonData,
                         uint64_t& sExpirationTime,
                         const uint64_t timeSinceUnixEpocInSecondsParm);
@@ -0,0 +1,852 @@
+
+#include "CeLoginUtil.h"
+
+#include <CeLogin.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+#include <string.h> // memcpy, memset
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#else
+#include <openssl/hmac.h>
+#endif
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+using namespace CeLogin;
+
+namespace
+{
+
+const uint64_t Sha512BlockLength = 128;
+const uint64_t Sha512DigestWords = 8;
+const uint64_t Sha512BlockWords = 16;
+
+// Longest output derived in the lanes, the longest hashed auth code. Longer
+// outputs are rare enough to be left to OpenSSL.
+const uint64_t MaxLaneOutputBlocks =
+    AcfAuthRecordMaxHashedAuthCodeLength / SHA512_DIGEST_LENGTH;
+
+const uint64_t Sha512K[80] = {
+    0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL,
+    0xe9b5dba58189dbbcULL, 0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
+    0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL, 0xd807aa98a3030242ULL,
+    0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+    0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL,
+    0xc19bf174cf692694ULL, 0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL,
+    0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL, 0x2de92c6f592b0275ULL,
+    0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+    0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL,
+    0xbf597fc7beef0ee4ULL, 0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+    0x06ca6351e003826fULL, 0x142929670a0e6e70ULL, 0x27b70a8546d22ffcULL,
+    0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+    0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL,
+    0x92722c851482353bULL, 0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL,
+    0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL, 0xd192e819d6ef5218ULL,
+    0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+    0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL,
+    0x34b0bcb5e19b48a8ULL, 0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL,
+    0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL, 0x748f82ee5defb2fcULL,
+    0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+    0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL,
+    0xc67178f2e372532bULL, 0xca273eceea26619cULL, 0xd186b8c721c0c207ULL,
+    0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL, 0x06f067aa72176fbaULL,
+    0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+    0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL,
+    0x431d67c49c100d4cULL, 0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL,
+    0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL};
+
+const uint64_t Sha512Iv[Sha512DigestWords] = {
+    0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL,
+    0xa54ff53a5f1d36f1ULL, 0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+    0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL};
+
+// The 64 bit word operations of SHA-512, on one word
+struct ScalarLanes
+{
+    enum
+    {
+        Count = 1
+    };
+    typedef uint64_t Word;
+
+    static inline Word set1(const uint64_t valueParm)
+    {
+        return valueParm;
+    }
+    static inline Word load(const uint64_t* srcParm)
+    {
+        return *srcParm;
+    }
+    static inline void store(uint64_t* dstParm, const Word wordParm)
+    {
+        *dstParm = wordParm;
+    }
+    static inline Word add(const Word aParm, const Word bParm)
+    {
+        return aParm + bParm;
+    }
+    static inline Word bitXor(const Word aParm, const Word bParm)
+    {
+        return aParm ^ bParm;
+    }
+    static inline Word bitAnd(const Word aParm, const Word bParm)
+    {
+        return aParm & bParm;
+    }
+    static inline Word bitOr(const Word aParm, const Word bParm)
+    {
+        return aParm | bParm;
+    }
+    // ~aParm & bParm
+    static inline Word andNot(const Word aParm, const Word bParm)
+    {
+        return ~aParm & bParm;
+    }
+    template <int N>
+    static inline Word rotr(const Word aParm)
+    {
+        return (aParm >> N) | (aParm << (64 - N));
+    }
+    template <int N>
+    static inline Word shr(const Word aParm)
+    {
+        return aParm >> N;
+    }
+};
+
+#if defined(__AVX512F__)
+// The same operations on eight words, one per derivation
+struct Avx512Lanes
+{
+    enum
+    {
+        Count = 8
+    };
+    typedef __m512i Word;
+
+    static inline Word set1(const uint64_t valueParm)
+    {
+        return _mm512_set1_epi64(valueParm);
+    }
+    static inline Word load(const uint64_t* srcParm)
+    {
+        return _mm512_loadu_si512(srcParm);
+    }
+    static inline void store(uint64_t* dstParm, const Word wordParm)
+    {
+        _mm512_storeu_si512(dstParm, wordParm);
+    }
+    static inline Word add(const Word aParm, const Word bParm)
+    {
+        return _mm512_add_epi64(aParm, bParm);
+    }
+    static inline Word bitXor(const Word aParm, const Word bParm)
+    {
+        return _mm512_xor_si512(aParm, bParm);
+    }
+    static inline Word bitAnd(const Word aParm, const Word bParm)
+    {
+        return _mm512_and_si512(aParm, bParm);
+    }
+    static inline Word bitOr(const Word aParm, const Word bParm)
+    {
+        return _mm512_or_si512(aParm, bParm);
+    }
+    static inline Word andNot(const Word aParm, const Word bParm)
+    {
+        return _mm512_andnot_si512(aParm, bParm);
+    }
+    template <int N>
+    static inline Word rotr(const Word aParm)
+    {
+        return _mm512_ror_epi64(aParm, N);
+    }
+    template <int N>
+    static inline Word shr(const Word aParm)
+    {
+        return _mm512_srli_epi64(aParm, N);
+    }
+};
+#elif defined(__AVX2__)
+// The same operations on four words, one per derivation
+struct Avx2Lanes
+{
+    enum
+    {
+        Count = 4
+    };
+    typedef __m256i Word;
+
+    static inline Word set1(const uint64_t valueParm)
+    {
+        return _mm256_set1_epi64x(valueParm);
+    }
+    static inline Word load(const uint64_t* srcParm)
+    {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(srcParm));
+    }
+    static inline void store(uint64_t* dstParm, const Word wordParm)
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dstParm), wordParm);
+    }
+    static inline Word add(const Word aParm, const Word bParm)
+    {
+        return _mm256_add_epi64(aParm, bParm);
+    }
+    static inline Word bitXor(const Word aParm, const Word bParm)
+    {
+        return _mm256_xor_si256(aParm, bParm);
+    }
+    static inline Word bitAnd(const Word aParm, const Word bParm)
+    {
+        return _mm256_and_si256(aParm, bParm);
+    }
+    static inline Word bitOr(const Word aParm, const Word bParm)
+    {
+        return _mm256_or_si256(aParm, bParm);
+    }
+    static inline Word andNot(const Word aParm, const Word bParm)
+    {
+        return _mm256_andnot_si256(aParm, bParm);
+    }
+    template <int N>
+    static inline Word rotr(const Word aParm)
+    {
+        return _mm256_or_si256(_mm256_srli_epi64(aParm, N),
+                               _mm256_slli_epi64(aParm, 64 - N));
+    }
+    template <int N>
+    static inline Word shr(const Word aParm)
+    {
+        return _mm256_srli_epi64(aParm, N);
+    }
+};
+#endif
+
+// The widest lanes of the build
+#if defined(__AVX512F__)
+typedef Avx512Lanes BatchLanes;
+#elif defined(__AVX2__)
+typedef Avx2Lanes BatchLanes;
+#else
+typedef ScalarLanes BatchLanes;
+#endif
+
+// One SHA-512 compression of a block into a state, in every lane
+template <typename Lanes>
+inline void compressBlock(typename Lanes::Word stateParm[Sha512DigestWords],
+                          const typename Lanes::Word blockParm[16])
+{
+    typedef typename Lanes::Word Word;
+
+    Word sW[Sha512BlockWords];
+    for (uint64_t sIdx = 0; sIdx < Sha512BlockWords; sIdx++)
+    {
+        sW[sIdx] = blockParm[sIdx];
+    }
+
+    Word sA = stateParm[0];
+    Word sB = stateParm[1];
+    Word sC = stateParm[2];
+    Word sD = stateParm[3];
+    Word sE = stateParm[4];
+    Word sF = stateParm[5];
+    Word sG = stateParm[6];
+    Word sH = stateParm[7];
+
+    for (uint64_t sRound = 0; sRound < 80; sRound++)
+    {
+        const uint64_t sIdx = sRound & 15;
+        if (sRound >= 16)
+        {
+            const Word sW2 = sW[(sRound - 2) & 15];
+            const Word sW15 = sW[(sRound - 15) & 15];
+            const Word sSigma1 = Lanes::bitXor(
+                Lanes::bitXor(Lanes::template rotr<19>(sW2),
+                              Lanes::template rotr<61>(sW2)),
+                Lanes::template shr<6>(sW2));
+            const Word sSigma0 = Lanes::bitXor(
+                Lanes::bitXor(Lanes::template rotr<1>(sW15),
+                              Lanes::template rotr<8>(sW15)),
+                Lanes::template shr<7>(sW15));
+            sW[sIdx] = Lanes::add(
+                Lanes::add(sW[sIdx], sSigma1),
+                Lanes::add(sW[(sRound - 7) & 15], sSigma0));
+        }
+
+        const Word sSum1 =
+            Lanes::bitXor(Lanes::bitXor(Lanes::template rotr<14>(sE),
+                                        Lanes::template rotr<18>(sE)),
+                          Lanes::template rotr<41>(sE));
+        const Word sChoose = Lanes::bitXor(Lanes::bitAnd(sE, sF),
+                                           Lanes::andNot(sE, sG));
+        const Word sT1 = Lanes::add(
+            Lanes::add(Lanes::add(sH, sSum1), Lanes::add(sChoose, sW[sIdx])),
+            Lanes::set1(Sha512K[sRound]));
+
+        const Word sSum0 =
+            Lanes::bitXor(Lanes::bitXor(Lanes::template rotr<28>(sA),
+                                        Lanes::template rotr<34>(sA)),
+                          Lanes::template rotr<39>(sA));
+        const Word sMajority = Lanes::bitOr(
+            Lanes::bitAnd(sA, sB), Lanes::bitAnd(sC, Lanes::bitOr(sA, sB)));
+        const Word sT2 = Lanes::add(sSum0, sMajority);
+
+        sH = sG;
+        sG = sF;
+        sF = sE;
+        sE = Lanes::add(sD, sT1);
+        sD = sC;
+        sC = sB;
+        sB = sA;
+        sA = Lanes::add(sT1, sT2);
+    }
+
+    stateParm[0] = Lanes::add(stateParm[0], sA);
+    stateParm[1] = Lanes::add(stateParm[1], sB);
+    stateParm[2] = Lanes::add(stateParm[2], sC);
+    stateParm[3] = Lanes::add(stateParm[3], sD);
+    stateParm[4] = Lanes::add(stateParm[4], sE);
+    stateParm[5] = Lanes::add(stateParm[5], sF);
+    stateParm[6] = Lanes::add(stateParm[6], sG);
+    stateParm[7] = Lanes::add(stateParm[7], sH);
+}
+
+inline uint64_t loadBigEndian(const uint8_t* srcParm)
+{
+    uint64_t sWord = 0;
+    for (uint64_t sIdx = 0; sIdx < 8; sIdx++)
+    {
+        sWord = (sWord << 8) | srcParm[sIdx];
+    }
+    return sWord;
+}
+
+inline void storeBigEndian(uint8_t* dstParm, const uint64_t wordParm)
+{
+    for (uint64_t sIdx = 0; sIdx < 8; sIdx++)
+    {
+        dstParm[sIdx] = static_cast<uint8_t>(wordParm >> (56 - 8 * sIdx));
+    }
+}
+
+// The HMAC state after the key block XORed with the pad byte
+void createHmacPadState(const uint8_t keyParm[Sha512BlockLength],
+                        const uint8_t padParm,
+                        uint64_t stateParm[Sha512DigestWords])
+{
+    uint64_t sBlock[Sha512BlockWords];
+    uint8_t sPadded[8];
+    for (uint64_t sWord = 0; sWord < Sha512BlockWords; sWord++)
+    {
+        for (uint64_t sIdx = 0; sIdx < 8; sIdx++)
+        {
+            sPadded[sIdx] = keyParm[sWord * 8 + sIdx] ^ padParm;
+        }
+        sBlock[sWord] = loadBigEndian(sPadded);
+    }
+    memcpy(stateParm, Sha512Iv, sizeof(Sha512Iv));
+    compressBlock<ScalarLanes>(stateParm, sBlock);
+    OPENSSL_cleanse(sBlock, sizeof(sBlock));
+    OPENSSL_cleanse(sPadded, sizeof(sPadded));
+}
+
+// Derivation state of each lane, word sWord of lane sLane is at
+// [sWord * Count + sLane] so a SIMD word loads straight from it
+template <typename Lanes>
+struct LaneStates
+{
+    uint64_t mInner[Sha512DigestWords * Lanes::Count];
+    uint64_t mOuter[Sha512DigestWords * Lanes::Count];
+    uint64_t mU[Sha512DigestWords * Lanes::Count];
+    uint64_t mT[Sha512DigestWords * Lanes::Count];
+    uint64_t mLeft[Lanes::Count]; // iterations to go, 0 for an idle lane
+    PasswordHashRequest* mRequest[Lanes::Count];
+    uint64_t mBlock[Lanes::Count]; // output block of the request, from 1
+};
+
+// Next output block still to be derived in the lanes
+struct JobCursor
+{
+    PasswordHashRequest* mRequests;
+    uint64_t mCount;
+    uint64_t mRequest;
+    uint64_t mBlock;
+};
+
+bool isLaneRequest(const PasswordHashRequest& requestParm)
+{
+    return CeLoginRc::Success == requestParm.mRc &&
+           requestParm.mRequestedOutputLength <=
+               MaxLaneOutputBlocks * SHA512_DIGEST_LENGTH;
+}
+
+// Start the next job in a lane: the HMAC key states and the first iteration
+// are computed here, one at a time, and the lane runs the rest
+template <typename Lanes>
+void startLane(LaneStates<Lanes>& statesParm, const uint64_t laneParm,
+               JobCursor& cursorParm)
+{
+    statesParm.mLeft[laneParm] = 0;
+    while (cursorParm.mRequest < cursorParm.mCount)
+    {
+        PasswordHashRequest& sRequest =
+            cursorParm.mRequests[cursorParm.mRequest];
+        const uint64_t sBlocks =
+            (sRequest.mRequestedOutputLength + SHA512_DIGEST_LENGTH - 1) /
+            SHA512_DIGEST_LENGTH;
+        if (!isLaneRequest(sRequest) || cursorParm.mBlock > sBlocks)
+        {
+            cursorParm.mRequest++;
+            cursorParm.mBlock = 1;
+            continue;
+        }
+        const uint64_t sBlock = cursorParm.mBlock++;
+
+        // U1 of every block up to this one, an iteration count of one makes
+        // PBKDF2 return them as they are
+        uint8_t sFirst[MaxLaneOutputBlocks * SHA512_DIGEST_LENGTH];
+        if (1 != PKCS5_PBKDF2_HMAC(sRequest.mPassword, sRequest.mPasswordLength,
+                                   sRequest.mSalt, sRequest.mSaltLength, 1,
+                                   EVP_sha512(), sBlock * SHA512_DIGEST_LENGTH,
+                                   sFirst))
+        {
+            sRequest.mRc = CeLoginRc::CreatePasswordHash_OsslCallFailed;
+            OPENSSL_cleanse(sFirst, sizeof(sFirst));
+            continue;
+        }
+
+        uint8_t sKey[Sha512BlockLength];
+        memset(sKey, 0, sizeof(sKey));
+        if (sRequest.mPasswordLength > Sha512BlockLength)
+        {
+            SHA512(reinterpret_cast<const uint8_t*>(sRequest.mPassword),
+                   sRequest.mPasswordLength, sKey);
+        }
+        else
+        {
+            memcpy(sKey, sRequest.mPassword, sRequest.mPasswordLength);
+        }
+
+        uint64_t sInner[Sha512DigestWords];
+        uint64_t sOuter[Sha512DigestWords];
+        createHmacPadState(sKey, 0x36, sInner);
+        createHmacPadState(sKey, 0x5c, sOuter);
+
+        const uint8_t* sU = sFirst + (sBlock - 1) * SHA512_DIGEST_LENGTH;
+        for (uint64_t sWord = 0; sWord < Sha512DigestWords; sWord++)
+        {
+            const uint64_t sIdx = sWord * Lanes::Count + laneParm;
+            statesParm.mInner[sIdx] = sInner[sWord];
+            statesParm.mOuter[sIdx] = sOuter[sWord];
+            statesParm.mU[sIdx] = loadBigEndian(sU + sWord * 8);
+            statesParm.mT[sIdx] = statesParm.mU[sIdx];
+        }
+        statesParm.mLeft[laneParm] = sRequest.mIterations - 1;
+        statesParm.mRequest[laneParm] = &sRequest;
+        statesParm.mBlock[laneParm] = sBlock;
+
+        OPENSSL_cleanse(sFirst, sizeof(sFirst));
+        OPENSSL_cleanse(sKey, sizeof(sKey));
+        OPENSSL_cleanse(sInner, sizeof(sInner));
+        OPENSSL_cleanse(sOuter, sizeof(sOuter));
+        return;
+    }
+}
+
+// Write the derived block of a lane to the output of its request
+template <typename Lanes>
+void finishLane(LaneStates<Lanes>& statesParm, const uint64_t laneParm)
+{
+    PasswordHashRequest& sRequest = *statesParm.mRequest[laneParm];
+    if (CeLoginRc::Success != sRequest.mRc)
+    {
+        return;
+    }
+    uint8_t sDerived[SHA512_DIGEST_LENGTH];
+    for (uint64_t sWord = 0; sWord < Sha512DigestWords; sWord++)
+    {
+        storeBigEndian(sDerived + sWord * 8,
+                       statesParm.mT[sWord * Lanes::Count + laneParm]);
+    }
+    const uint64_t sOffset =
+        (statesParm.mBlock[laneParm] - 1) * SHA512_DIGEST_LENGTH;
+    uint64_t sLength = sRequest.mRequestedOutputLength - sOffset;
+    if (sLength > SHA512_DIGEST_LENGTH)
+    {
+        sLength = SHA512_DIGEST_LENGTH;
+    }
+    memcpy(sRequest.mOutputHash + sOffset, sDerived, sLength);
+    OPENSSL_cleanse(sDerived, sizeof(sDerived));
+}
+
+// Run the given number of iterations in every lane, an iteration being
+// U = HMAC(P, U) from the key states and T ^= U
+template <typename Lanes>
+void iterateLanes(LaneStates<Lanes>& statesParm, const uint64_t iterationsParm)
+{
+    typedef typename Lanes::Word Word;
+
+    Word sInner[Sha512DigestWords];
+    Word sOuter[Sha512DigestWords];
+    Word sT[Sha512DigestWords];
+    Word sBlock[Sha512BlockWords];
+    for (uint64_t sWord = 0; sWord < Sha512DigestWords; sWord++)
+    {
+        sInner[sWord] = Lanes::load(statesParm.mInner + sWord * Lanes::Count);
+        sOuter[sWord] = Lanes::load(statesParm.mOuter + sWord * Lanes::Count);
+        sT[sWord] = Lanes::load(statesParm.mT + sWord * Lanes::Count);
+        sBlock[sWord] = Lanes::load(statesParm.mU + sWord * Lanes::Count);
+    }
+
+    // Both hashed messages are one digest after a key block, so the padding
+    // is the same every time: the end bit and a length of 1536 bits
+    sBlock[Sha512DigestWords] = Lanes::set1(0x8000000000000000ULL);
+    for (uint64_t sWord = Sha512DigestWords + 1; sWord < 15; sWord++)
+    {
+        sBlock[sWord] = Lanes::set1(0);
+    }
+    sBlock[15] = Lanes::set1((Sha512BlockLength + SHA512_DIGEST_LENGTH) * 8);
+
+    Word sState[Sha512DigestWords];
+    for (uint64_t sIteration = 0; sIteration < iterationsParm; sIteration++)
+    {
+        memcpy(sState, sInner, sizeof(sState));
+        compressBlock<Lanes>(sState, sBlock);
+        memcpy(sBlock, sState, sizeof(sState));
+        memcpy(sState, sOuter, sizeof(sState));
+        compressBlock<Lanes>(sState, sBlock);
+        for (uint64_t sWord = 0; sWord < Sha512DigestWords; sWord++)
+        {
+            sBlock[sWord] = sState[sWord];
+            sT[sWord] = Lanes::bitXor(sT[sWord], sState[sWord]);
+        }
+    }
+
+    for (uint64_t sWord = 0; sWord < Sha512DigestWords; sWord++)
+    {
+        Lanes::store(statesParm.mT + sWord * Lanes::Count, sT[sWord]);
+        Lanes::store(statesParm.mU + sWord * Lanes::Count, sBlock[sWord]);
+    }
+    OPENSSL_cleanse(sInner, sizeof(sInner));
+    OPENSSL_cleanse(sOuter, sizeof(sOuter));
+    OPENSSL_cleanse(sT, sizeof(sT));
+    OPENSSL_cleanse(sBlock, sizeof(sBlock));
+    OPENSSL_cleanse(sState, sizeof(sState));
+}
+
+// Fail every request that still has a block to derive once told to stop
+template <typename Lanes>
+void stopLanes(LaneStates<Lanes>& statesParm, const JobCursor& cursorParm)
+{
+    for (uint64_t sLane = 0; sLane < Lanes::Count; sLane++)
+    {
+        if (statesParm.mRequest[sLane])
+        {
+            statesParm.mRequest[sLane]->mRc = CeLoginRc::PasswordHashStopped;
+        }
+    }
+    for (uint64_t sIdx = cursorParm.mRequest; sIdx < cursorParm.mCount; sIdx++)
+    {
+        PasswordHashRequest& sRequest = cursorParm.mRequests[sIdx];
+        const uint64_t sBlocks =
+            (sRequest.mRequestedOutputLength + SHA512_DIGEST_LENGTH - 1) /
+            SHA512_DIGEST_LENGTH;
+        if (isLaneRequest(sRequest) &&
+            (sIdx != cursorParm.mRequest || cursorParm.mBlock <= sBlocks))
+        {
+            sRequest.mRc = CeLoginRc::PasswordHashStopped;
+        }
+    }
+}
+
+// Derive every output block of the lane requests, each lane taking the next
+// block as soon as its previous one is done
+template <typename Lanes>
+void deriveInLanes(PasswordHashRequest* requestsParm, const uint64_t countParm,
+                   const PasswordHashControl* controlParm)
+{
+    LaneStates<Lanes> sStates;
+    memset(&sStates, 0, sizeof(sStates));
+
+    JobCursor sCursor;
+    sCursor.mRequests = requestsParm;
+    sCursor.mCount = countParm;
+    sCursor.mRequest = 0;
+    sCursor.mBlock = 1;
+
+    bool sActive = false;
+    for (uint64_t sLane = 0; sLane < Lanes::Count; sLane++)
+    {
+        startLane(sStates, sLane, sCursor);
+        sActive = sActive || NULL != sStates.mRequest[sLane];
+    }
+
+    while (sActive)
+    {
+        // Lanes done with their block, a single iteration needs no more
+        // work, take the next one before the lanes run again
+        uint64_t sRun = 0;
+        sActive = false;
+        for (uint64_t sLane = 0; sLane < Lanes::Count; sLane++)
+        {
+            while (sStates.mRequest[sLane] && 0 == sStates.mLeft[sLane])
+            {
+                finishLane(sStates, sLane);
+                sStates.mRequest[sLane] = NULL;
+                startLane(sStates, sLane, sCursor);
+            }
+            if (sStates.mRequest[sLane])
+            {
+                sActive = true;
+                if (0 == sRun || sStates.mLeft[sLane] < sRun)
+                {
+                    sRun = sStates.mLeft[sLane];
+                }
+            }
+        }
+
+        if (sActive && controlParm)
+        {
+            if (controlParm->mShouldStop(controlParm->mContext))
+            {
+                stopLanes(sStates, sCursor);
+                break;
+            }
+            if (sRun > PasswordHashControl::PasswordHashCheckIterations)
+            {
+                sRun = PasswordHashControl::PasswordHashCheckIterations;
+            }
+        }
+
+        if (sActive)
+        {
+            // Run until the first lane is done, idle lanes run along
+            iterateLanes(sStates, sRun);
+            for (uint64_t sLane = 0; sLane < Lanes::Count; sLane++)
+            {
+                if (sStates.mRequest[sLane])
+                {
+                    sStates.mLeft[sLane] -= sRun;
+                }
+            }
+        }
+    }
+    OPENSSL_cleanse(&sStates, sizeof(sStates));
+}
+
+// HMAC-SHA512 keyed with a password. The key is set up once and every
+// compute() starts again from the keyed state.
+class PasswordHmac
+{
+  public:
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    PasswordHmac() : mMac(NULL), mCtx(NULL)
+    {
+    }
+#else
+    PasswordHmac() : mCtx(NULL)
+    {
+    }
+#endif
+
+    ~PasswordHmac()
+    {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        EVP_MAC_CTX_free(mCtx);
+        EVP_MAC_free(mMac);
+#else
+        HMAC_CTX_free(mCtx);
+#endif
+    }
+
+    bool setKey(const char* passwordParm, const uint64_t passwordLengthParm)
+    {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        OSSL_PARAM sParams[] = {
+            OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+                                             (char*)"SHA512", 0),
+            OSSL_PARAM_construct_end()};
+        mMac = EVP_MAC_fetch(NULL, "HMAC", NULL);
+        mCtx = mMac ? EVP_MAC_CTX_new(mMac) : NULL;
+        return mCtx && 1 == EVP_MAC_init(mCtx, (const uint8_t*)passwordParm,
+                                         passwordLengthParm, sParams);
+#else
+        mCtx = HMAC_CTX_new();
+        return mCtx && 1 == HMAC_Init_ex(mCtx, passwordParm,
+                                         (int)passwordLengthParm,
+                                         EVP_sha512(), NULL);
+#endif
+    }
+
+    // The HMAC of the first buffer followed by the second, which may be empty
+    bool compute(const uint8_t* firstParm, const uint64_t firstLengthParm,
+                 const uint8_t* secondParm, const uint64_t secondLengthParm,
+                 uint8_t outputParm[SHA512_DIGEST_LENGTH])
+    {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        size_t sLength = 0;
+        return 1 == EVP_MAC_init(mCtx, NULL, 0, NULL) &&
+               1 == EVP_MAC_update(mCtx, firstParm, firstLengthParm) &&
+               1 == EVP_MAC_update(mCtx, secondParm, secondLengthParm) &&
+               1 == EVP_MAC_final(mCtx, outputParm, &sLength,
+                                  SHA512_DIGEST_LENGTH) &&
+               SHA512_DIGEST_LENGTH == sLength;
+#else
+        unsigned int sLength = 0;
+        return 1 == HMAC_Init_ex(mCtx, NULL, 0, NULL, NULL) &&
+               1 == HMAC_Update(mCtx, firstParm, firstLengthParm) &&
+               1 == HMAC_Update(mCtx, secondParm, secondLengthParm) &&
+               1 == HMAC_Final(mCtx, outputParm, &sLength) &&
+               SHA512_DIGEST_LENGTH == sLength;
+#endif
+    }
+
+  private:
+    PasswordHmac(const PasswordHmac&);
+    PasswordHmac& operator=(const PasswordHmac&);
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    EVP_MAC* mMac;
+    EVP_MAC_CTX* mCtx;
+#else
+    HMAC_CTX* mCtx;
+#endif
+};
+
+// PBKDF2-HMAC-SHA512 of a single request that asks the control whether to
+// go on before every PasswordHashCheckIterations iterations. Used in place of
+// a single lane, which is slower than the OpenSSL HMAC.
+CeLoginRc deriveStoppable(PasswordHashRequest& requestParm,
+                          const PasswordHashControl& controlParm)
+{
+    const uint64_t sCheckIterations =
+        PasswordHashControl::PasswordHashCheckIterations;
+    CeLoginRc sRc = CeLoginRc::Success;
+    PasswordHmac sHmac;
+    uint8_t sU[SHA512_DIGEST_LENGTH];
+    uint8_t sT[SHA512_DIGEST_LENGTH];
+
+    if (!sHmac.setKey(requestParm.mPassword, requestParm.mPasswordLength))
+    {
+        sRc = CeLoginRc::CreatePasswordHash_OsslCallFailed;
+    }
+
+    for (uint64_t sOffset = 0; CeLoginRc::Success == sRc &&
+                               sOffset < requestParm.mRequestedOutputLength;
+         sOffset += SHA512_DIGEST_LENGTH)
+    {
+        const uint64_t sBlock = sOffset / SHA512_DIGEST_LENGTH + 1;
+        const uint8_t sBlockIndex[4] = {
+            (uint8_t)(sBlock >> 24), (uint8_t)(sBlock >> 16),
+            (uint8_t)(sBlock >> 8), (uint8_t)sBlock};
+
+        for (uint64_t sIteration = 0;
+             CeLoginRc::Success == sRc && sIteration < requestParm.mIterations;
+             sIteration++)
+        {
+            if (0 == sIteration % sCheckIterations &&
+                controlParm.mShouldStop(controlParm.mContext))
+            {
+                sRc = CeLoginRc::PasswordHashStopped;
+            }
+            else if (0 == sIteration
+                         ? !sHmac.compute(requestParm.mSalt,
+                                          requestParm.mSaltLength, sBlockIndex,
+                                          sizeof(sBlockIndex), sU)
+                         : !sHmac.compute(sU, sizeof(sU), NULL, 0, sU))
+            {
+                sRc = CeLoginRc::CreatePasswordHash_OsslCallFailed;
+            }
+            else
+            {
+                for (uint64_t sIdx = 0; sIdx < sizeof(sT); sIdx++)
+                {
+                    sT[sIdx] = 0 == sIteration ? sU[sIdx] : sT[sIdx] ^ sU[sIdx];
+                }
+            }
+        }
+
+        if (CeLoginRc::Success == sRc)
+        {
+            const uint64_t sLeft =
+                requestParm.mRequestedOutputLength - sOffset;
+            memcpy(requestParm.mOutputHash + sOffset, sT,
+                   sLeft < sizeof(sT) ? sLeft : sizeof(sT));
+        }
+    }
+
+    if (CeLoginRc::Success != sRc)
+    {
+        OPENSSL_cleanse(requestParm.mOutputHash,
+                        requestParm.mRequestedOutputLength);
+    }
+    OPENSSL_cleanse(sU, sizeof(sU));
+    OPENSSL_cleanse(sT, sizeof(sT));
+    return sRc;
+}
+
+} // namespace
+
+void CeLogin::createPasswordHashes(PasswordHashRequest* requestsParm,
+                                   const uint64_t countParm)
+{
+    createPasswordHashes(requestsParm, countParm, NULL);
+}
+
+void CeLogin::createPasswordHashes(PasswordHashRequest* requestsParm,
+                                   const uint64_t countParm,
+                                   const PasswordHashControl* controlParm)
+{
+    for (uint64_t sIdx = 0; sIdx < countParm; sIdx++)
+    {
+        PasswordHashRequest& sRequest = requestsParm[sIdx];
+        sRequest.mRc = checkPasswordHashParms(
+            sRequest.mPassword, sRequest.mPasswordLength, sRequest.mSalt,
+            sRequest.mSaltLength, sRequest.mIterations, sRequest.mOutputHash,
+            sRequest.mOutputHashSize, sRequest.mRequestedOutputLength);
+    }
+
+    // A single lane is no faster than OpenSSL, so without SIMD a derivation
+    // that may have to stop part way runs on the OpenSSL HMAC instead
+    const bool sUseLanes = BatchLanes::Count > 1;
+    if (sUseLanes)
+    {
+        deriveInLanes<BatchLanes>(requestsParm, countParm, controlParm);
+    }
+
+    // Once stopped the control is not asked again, every request still to be
+    // derived fails
+    bool sStopped = false;
+    for (uint64_t sIdx = 0; sIdx < countParm; sIdx++)
+    {
+        PasswordHashRequest& sRequest = requestsParm[sIdx];
+        if (CeLoginRc::Success != sRequest.mRc ||
+            (sUseLanes && isLaneRequest(sRequest)))
+        {
+            continue;
+        }
+        if (controlParm)
+        {
+            sRequest.mRc = sStopped ? CeLoginRc::PasswordHashStopped
+                                    : deriveStoppable(sRequest, *controlParm);
+            sStopped = CeLoginRc::PasswordHashStopped == sRequest.mRc;
+            continue;
+        }
+        sRequest.mRc = createPasswordHash(
+            sRequest.mPassword, sRequest.mPasswordLength, sRequest.mSalt,
+            sRequest.mSaltLength, sRequest.mIterations, sRequest.mOutputHash,
+            sRequest.mOutputHashSize, sRequest.mRequestedOutputLength);
+    }
+}
+
+uint64_t CeLogin::getPasswordHashLanes()
+{
+    return BatchLanes::Count;
+}
@@ -0,0 +1,330 @@
+#include "CeLoginAsnV1.h"
+#include "CeLoginUtil.h"
+
+#include <CeLogin.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <string.h>
+
+#include <ce_logger.hpp>
+
+#if !defined(CELOGIN_NO_HEAP) && !defined(CELOGIN_POWERVM_TARGET)
+
+using CeLogin::AcfUploadStream;
+using CeLogin::CeLoginRc;
+using CeLogin::CELoginSequenceV1View;
+
+// The ACF is received as the fields up to the contents of sourceFileData, then
+// the contents, then the fields after it up to the end of the sequence
+enum StreamState
+{
+    StreamState_Idle = 0,
+    StreamState_Header = 1,
+    StreamState_Payload = 2,
+    StreamState_Trailer = 3,
+    StreamState_Done = 4,
+};
+
+AcfUploadStream::AcfUploadStream() :
+    mJson(NULL), mJsonSize(0), mHeaderLength(0), mPayloadLength(0),
+    mPayloadReceived(0), mTrailerLength(0), mTrailerReceived(0),
+    mReceivedLength(0), mDigestCtx(NULL), mDigestFailed(false),
+    mState(StreamState_Idle), mRc(CeLoginRc::Success)
+{}
+
+AcfUploadStream::~AcfUploadStream()
+{
+    if (mDigestCtx)
+    {
+        EVP_MD_CTX_free(mDigestCtx);
+    }
+}
+
+CeLoginRc AcfUploadStream::begin(uint8_t* jsonBufferParm,
+                                 const uint64_t jsonBufferSizeParm)
+{
+    mJson = NULL;
+    mJsonSize = 0;
+    mHeaderLength = 0;
+    mPayloadLength = 0;
+    mPayloadReceived = 0;
+    mTrailerLength = 0;
+    mTrailerReceived = 0;
+    mReceivedLength = 0;
+    mDigestFailed = false;
+    mState = StreamState_Idle;
+    mRc = CeLoginRc::Success;
+
+    if (!jsonBufferParm || 0 == jsonBufferSizeParm)
+    {
+        mRc = CeLoginRc::VerifyAcf_InvalidParm;
+    }
+
+    if (CeLoginRc::Success == mRc && !mDigestCtx)
+    {
+        mDigestCtx = EVP_MD_CTX_new();
+    }
+    if (CeLoginRc::Success == mRc &&
+        (!mDigestCtx ||
+         1 != EVP_DigestInit_ex(mDigestCtx, EVP_sha512(), NULL)))
+    {
+        CE_LOG_DEBUG("Failed to set up the digest");
+        mRc = CeLoginRc::VerifyAcf_CreateJsonDigestFailure;
+    }
+
+    if (CeLoginRc::Success == mRc)
+    {
+        mJson = jsonBufferParm;
+        mJsonSize = jsonBufferSizeParm;
+        mState = StreamState_Header;
+    }
+
+    return mRc;
+}
+
+// Collects the fields before the payload until they can be decoded. Only the
+// bytes that belong to them are used.
+uint64_t AcfUploadStream::receiveHeader(const uint8_t* dataParm,
+                                        const uint64_t dataLengthParm)
+{
+    uint64_t sUsed = MaxHeaderLength - mHeaderLength;
+    if (sUsed > dataLengthParm)
+    {
+        sUsed = dataLengthParm;
+    }
+    memcpy(mHeader + mHeaderLength, dataParm, sUsed);
+
+    CELoginSequenceV1View sDecodedAsn;
+    uint64_t sSequenceEnd = 0;
+    const CeLogin::AsnDecodeResult sResult =
+        CeLogin::decodeCELoginSequenceV1Prefix(mHeader, mHeaderLength + sUsed,
+                                               sDecodedAsn, sSequenceEnd);
+
+    if (CeLogin::AsnDecode_Complete == sResult)
+    {
+        const uint64_t sHeaderLength =
+            sDecodedAsn.sourceFileData.data - mHeader;
+        sUsed = sHeaderLength - mHeaderLength;
+        mHeaderLength = sHeaderLength;
+        mPayloadLength = sDecodedAsn.sourceFileData.length;
+        mTrailerLength = sSequenceEnd - sHeaderLength - mPayloadLength;
+        mState = StreamState_Payload;
+
+        if (mPayloadLength > mJsonSize)
+        {
+            CE_LOG_DEBUG("ACF payload is larger than the buffer");
+            mRc = CeLoginRc::GetSevAuth_InvalidAcfLength;
+        }
+        else if (mTrailerLength > MaxTrailerLength)
+        {
+            mRc = CeLoginRc::VerifyAcf_AsnDecodeFailure;
+        }
+    }
+    else if (CeLogin::AsnDecode_Incomplete == sResult &&
+             MaxHeaderLength != mHeaderLength + sUsed)
+    {
+        mHeaderLength += sUsed;
+    }
+    else
+    {
+        CE_LOG_DEBUG("Failed to decode ASN.1 structure");
+        mRc = CeLoginRc::VerifyAcf_AsnDecodeFailure;
+    }
+
+    return sUsed;
+}
+
+uint64_t AcfUploadStream::receivePayload(const uint8_t* dataParm,
+                                         const uint64_t dataLengthParm)
+{
+    uint64_t sUsed = mPayloadLength - mPayloadReceived;
+    if (sUsed > dataLengthParm)
+    {
+        sUsed = dataLengthParm;
+    }
+
+    memcpy(mJson + mPayloadReceived, dataParm, sUsed);
+    if (!mDigestFailed && 1 != EVP_DigestUpdate(mDigestCtx, dataParm, sUsed))
+    {
+        mDigestFailed = true;
+    }
+    mPayloadReceived += sUsed;
+
+    if (mPayloadLength == mPayloadReceived)
+    {
+        mState = StreamState_Trailer;
+    }
+
+    return sUsed;
+}
+
+// The fields after the payload are checked as soon as they are all there
+uint64_t AcfUploadStream::receiveTrailer(const uint8_t* dataParm,
+                                         const uint64_t dataLengthParm)
+{
+    uint64_t sUsed = mTrailerLength - mTrailerReceived;
+    if (sUsed > dataLengthParm)
+    {
+        sUsed = dataLengthParm;
+    }
+
+    memcpy(mTrailer + mTrailerReceived, dataParm, sUsed);
+    mTrailerReceived += sUsed;
+
+    if (mTrailerLength == mTrailerReceived)
+    {
+        CELoginSequenceV1View sDecodedAsn;
+        if (!CeLogin::decodeCELoginSequenceV1Trailer(mTrailer, mTrailerLength,
+                                                     sDecodedAsn))
+        {
+            CE_LOG_DEBUG("Failed to decode ASN.1 structure");
+            mRc = CeLoginRc::VerifyAcf_AsnDecodeFailure;
+        }
+        mState = StreamState_Done;
+    }
+
+    return sUsed;
+}
+
+CeLoginRc AcfUploadStream::update(const uint8_t* dataParm,
+                                  const uint64_t dataLengthParm)
+{
+    if (StreamState_Idle == mState)
+    {
+        CE_LOG_DEBUG("ACF stream was not started");
+        return CeLoginRc::GetSevAuth_InvalidAcfPtr;
+    }
+    if (!dataParm && CeLoginRc::Success == mRc)
+    {
+        CE_LOG_DEBUG("ACF pointer is NULL");
+        mRc = CeLoginRc::GetSevAuth_InvalidAcfPtr;
+    }
+
+    const uint8_t* sData = dataParm;
+    uint64_t sLength = dataLengthParm;
+
+    // Nothing more is kept once an error is found
+    while (CeLoginRc::Success == mRc && 0 != sLength)
+    {
+        uint64_t sUsed = sLength;
+        if (StreamState_Header == mState)
+        {
+            sUsed = receiveHeader(sData, sLength);
+        }
+        else if (StreamState_Payload == mState)
+        {
+            sUsed = receivePayload(sData, sLength);
+        }
+        else if (StreamState_Trailer == mState)
+        {
+            sUsed = receiveTrailer(sData, sLength);
+        }
+        // Anything after the end of the sequence is ignored
+        mReceivedLength += sUsed;
+        sData += sUsed;
+        sLength -= sUsed;
+    }
+
+    return mRc;
+}
+
+CeLoginRc AcfUploadStream::finish(
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    CeLoginVerifier* verifierParm, const char* serialNumberParm,
+    const uint64_t serialNumberLengthParm, const uint64_t currentReplayIdParm,
+    uint64_t& updatedReplayIdParm, AcfType& acfTypeParm,
+    uint64_t& expirationTimeParm)
+{
+    CeLoginRc sRc = CeLoginRc::Success;
+    ReceivedAcf sReceivedAcf;
+    uint8_t sDigest[CeLogin_DigestLength];
+
+    updatedReplayIdParm = 0;
+    acfTypeParm = AcfType_Invalid;
+    expirationTimeParm = 0;
+
+    if (StreamState_Idle == mState)
+    {
+        CE_LOG_DEBUG("ACF stream was not started");
+        sRc = CeLoginRc::GetSevAuth_InvalidAcfPtr;
+    }
+    else if (0 == mReceivedLength)
+    {
+        CE_LOG_DEBUG("ACF length is 0");
+        sRc = CeLoginRc::GetSevAuth_InvalidAcfLength;
+    }
+
+    // Decode the fields that were kept again, they point into the stream
+    if (CeLoginRc::Success == sRc)
+    {
+        uint64_t sSequenceEnd = 0;
+        sReceivedAcf.mRc = mRc;
+        if (CeLoginRc::Success == sReceivedAcf.mRc &&
+            StreamState_Done != mState)
+        {
+            CE_LOG_DEBUG("ACF is incomplete");
+            sReceivedAcf.mRc = CeLoginRc::VerifyAcf_AsnDecodeFailure;
+        }
+        if (CeLoginRc::Success == sReceivedAcf.mRc &&
+            (CeLogin::AsnDecode_Complete !=
+                 CeLogin::decodeCELoginSequenceV1Prefix(
+                     mHeader, mHeaderLength, sReceivedAcf.mDecodedAsn,
+                     sSequenceEnd) ||
+             !CeLogin::decodeCELoginSequenceV1Trailer(
+                 mTrailer, mTrailerLength, sReceivedAcf.mDecodedAsn)))
+        {
+            sReceivedAcf.mRc = CeLoginRc::VerifyAcf_AsnDecodeFailure;
+        }
+        sReceivedAcf.mDecodedAsn.sourceFileData.data = mJson;
+
+        unsigned int sDigestLength = 0;
+        if (CeLoginRc::Success == sReceivedAcf.mRc && !mDigestFailed &&
+            1 == EVP_DigestFinal_ex(mDigestCtx, sDigest, &sDigestLength) &&
+            sizeof(sDigest) == sDigestLength)
+        {
+            sReceivedAcf.mDigest = sDigest;
+        }
+
+        sRc = verifyReceivedACFForBMCUploadV2(
+            sReceivedAcf, timeSinceUnixEpochInSecondsParm, publicKeyParm,
+            publicKeyLengthParm, verifierParm, serialNumberParm,
+            serialNumberLengthParm, currentReplayIdParm, updatedReplayIdParm,
+            acfTypeParm, expirationTimeParm);
+    }
+
+    OPENSSL_cleanse(sDigest, sizeof(sDigest));
+    mState = StreamState_Idle;
+
+    return sRc;
+}
+
+CeLoginRc AcfUploadStream::finish(
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    const uint64_t currentReplayIdParm, uint64_t& updatedReplayIdParm,
+    AcfType& acfTypeParm, uint64_t& expirationTimeParm)
+{
+    return finish(timeSinceUnixEpochInSecondsParm, publicKeyParm,
+                  publicKeyLengthParm, NULL, serialNumberParm,
+                  serialNumberLengthParm, currentReplayIdParm,
+                  updatedReplayIdParm, acfTypeParm, expirationTimeParm);
+}
+
+CeLoginRc AcfUploadStream::finish(
+    const uint64_t timeSinceUnixEpochInSecondsParm, EVP_PKEY* publicKeyParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    const uint64_t currentReplayIdParm, uint64_t& updatedReplayIdParm,
+    AcfType& acfTypeParm, uint64_t& expirationTimeParm)
+{
+    CeLoginVerifier sVerifier;
+    sVerifier.setPublicKeys(&publicKeyParm, 1);
+
+    return finish(timeSinceUnixEpochInSecondsParm, NULL, 0, &sVerifier,
+                  serialNumberParm, serialNumberLengthParm,
+                  currentReplayIdParm, updatedReplayIdParm, acfTypeParm,
+                  expirationTimeParm);
+}
+
+#endif /* !CELOGIN_NO_HEAP && !CELOGIN_POWERVM_TARGET */
@@ -8,14 +8,54 @@
 #include <openssl/crypto.h>
 #include <openssl/rsa.h>
 #include <openssl/x509.h>
-#include <stdio.h>   // sprintf
+#include <stdio.h>   // snprintf
 #include <stdlib.h>  // strtoul
 #include <string.h>  // strstr, memcpy, strlen
 #include <strings.h> // bzero
 
 #include <ce_logger.hpp>
-/// TODO: rtc 268075 Determine if openssl can provide this function. If it can,
-/// use that instead.
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Value of a hex digit, or 0xFF for any other character
+static inline uint8_t getHexDigitValue(const char charParm)
+{
+    if (charParm >= '0' && charParm <= '9')
+    {
+        return charParm - '0';
+    }
+    const char sLower = charParm | 0x20;
+    if (sLower >= 'a' && sLower <= 'f')
+    {
+        return sLower - 'a' + 10;
+    }
+    return 0xFF;
+}
+
+// A pair that is not two hex digits is converted the way strtoul always has,
+// which also takes leading whitespace, a sign or a single digit
+static bool getByteFromHexPair(const char* hexPairParm, uint8_t& byteParm)
+{
+    const uint8_t sHigh = getHexDigitValue(hexPairParm[0]);
+    const uint8_t sLow = getHexDigitValue(hexPairParm[1]);
+    if (sHigh <= 0xF && sLow <= 0xF)
+    {
+        byteParm = (sHigh << 4) | sLow;
+        return true;
+    }
+
+    char sByteHexString[3];
+    memcpy(sByteHexString, hexPairParm, 2);
+    sByteHexString[2] = '\0';
+    unsigned long int sVal = strtoul(sByteHexString, NULL, 16);
+    byteParm = sVal;
+    return sVal <= 0xFF;
+}
+
 CeLogin::CeLoginRc CeLogin::getBinaryFromHex(const char* hexStringParm,
                                              const uint64_t hexStringLengthParm,
                                              uint8_t* binaryParm,
@@ -28,15 +68,48 @@ CeLogin::CeLoginRc CeLogin::getBinaryFromHex(const char* hexStringParm,
         hexStringLengthParm <= (2 * binarySizeParm) &&
         0 == hexStringLengthParm % 2)
     {
-        for (uint64_t sIdx = 0; sIdx < hexStringLengthParm; sIdx += 2)
+        uint64_t sIdx = 0;
+#if defined(__SSE2__)
+        // 16 digits at a time, until a block holds anything but hex digits
+        const __m128i sMinusOne = _mm_set1_epi8(-1);
+        for (; sIdx + 16 <= hexStringLengthParm; sIdx += 16)
         {
-            char sByteHexString[3];
-            memcpy(sByteHexString, &hexStringParm[sIdx], 2);
-            sByteHexString[2] = '\0';
-            unsigned long int sVal = strtoul(sByteHexString, NULL, 16);
-            if (sVal <= 0xFF)
+            const __m128i sChars =
+                _mm_loadu_si128((const __m128i*)(hexStringParm + sIdx));
+            const __m128i sDigits = _mm_sub_epi8(sChars, _mm_set1_epi8('0'));
+            const __m128i sIsDigit =
+                _mm_and_si128(_mm_cmpgt_epi8(sDigits, sMinusOne),
+                              _mm_cmplt_epi8(sDigits, _mm_set1_epi8(10)));
+            const __m128i sLetters = _mm_sub_epi8(
+                _mm_or_si128(sChars, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+            const __m128i sIsLetter =
+                _mm_and_si128(_mm_cmpgt_epi8(sLetters, sMinusOne),
+                              _mm_cmplt_epi8(sLetters, _mm_set1_epi8(6)));
+            if (0xFFFF !=
+                _mm_movemask_epi8(_mm_or_si128(sIsDigit, sIsLetter)))
+            {
+                break;
+            }
+
+            const __m128i sValues = _mm_or_si128(
+                _mm_and_si128(sIsDigit, sDigits),
+                _mm_andnot_si128(sIsDigit,
+                                 _mm_add_epi8(sLetters, _mm_set1_epi8(10))));
+            // Each 16 bit lane holds the high digit first, then the low digit
+            const __m128i sBytes = _mm_or_si128(
+                _mm_slli_epi16(
+                    _mm_and_si128(sValues, _mm_set1_epi16(0x00FF)), 4),
+                _mm_srli_epi16(sValues, 8));
+            _mm_storel_epi64((__m128i*)(binaryParm + sIdx / 2),
+                             _mm_packus_epi16(sBytes, sBytes));
+        }
+        binaryLengthParm = sIdx / 2;
+#endif
+
+        for (; sIdx < hexStringLengthParm; sIdx += 2)
+        {
+            if (getByteFromHexPair(&hexStringParm[sIdx], binaryParm[sIdx / 2]))
             {
-                binaryParm[sIdx / 2] = sVal;
                 binaryLengthParm++;
             }
             else
@@ -53,6 +126,59 @@ CeLogin::CeLoginRc CeLogin::getBinaryFromHex(const char* hexStringParm,
     return sRc;
 }
 
+CeLogin::CeLoginRc CeLogin::getHexFromBinary(const uint8_t* binaryParm,
+                                             const uint64_t binaryLengthParm,
+                                             char* hexStringParm,
+                                             const uint64_t hexStringSizeParm,
+                                             uint64_t& hexStringLengthParm)
+{
+    CeLoginRc sRc = CeLoginRc::Success;
+    hexStringLengthParm = 0;
+    if ((binaryParm && hexStringParm &&
+         binaryLengthParm <= hexStringSizeParm / 2) ||
+        0 == binaryLengthParm)
+    {
+        uint64_t sIdx = 0;
+#if defined(__SSE2__)
+        // 16 bytes at a time, as lower case digits like the scalar loop
+        const __m128i sNibbleMask = _mm_set1_epi8(0x0F);
+        const __m128i sNine = _mm_set1_epi8(9);
+        const __m128i sLetterOffset = _mm_set1_epi8('a' - '0' - 10);
+        for (; sIdx + 16 <= binaryLengthParm; sIdx += 16)
+        {
+            const __m128i sBytes =
+                _mm_loadu_si128((const __m128i*)(binaryParm + sIdx));
+            __m128i sHigh =
+                _mm_and_si128(_mm_srli_epi16(sBytes, 4), sNibbleMask);
+            __m128i sLow = _mm_and_si128(sBytes, sNibbleMask);
+            sHigh = _mm_add_epi8(
+                _mm_add_epi8(sHigh, _mm_set1_epi8('0')),
+                _mm_and_si128(_mm_cmpgt_epi8(sHigh, sNine), sLetterOffset));
+            sLow = _mm_add_epi8(
+                _mm_add_epi8(sLow, _mm_set1_epi8('0')),
+                _mm_and_si128(_mm_cmpgt_epi8(sLow, sNine), sLetterOffset));
+            _mm_storeu_si128((__m128i*)(hexStringParm + 2 * sIdx),
+                             _mm_unpacklo_epi8(sHigh, sLow));
+            _mm_storeu_si128((__m128i*)(hexStringParm + 2 * sIdx + 16),
+                             _mm_unpackhi_epi8(sHigh, sLow));
+        }
+#endif
+
+        static const char sHexDigits[] = "0123456789abcdef";
+        for (; sIdx < binaryLengthParm; sIdx++)
+        {
+            hexStringParm[2 * sIdx] = sHexDigits[binaryParm[sIdx] >> 4];
+            hexStringParm[2 * sIdx + 1] = sHexDigits[binaryParm[sIdx] & 0xF];
+        }
+        hexStringLengthParm = 2 * binaryLengthParm;
+    }
+    else
+    {
+        sRc = CeLoginRc::Failure;
+    }
+    return sRc;
+}
+
 CeLogin::CeLoginRc
     CeLogin::getDateFromString(const char* dateStringParm,
                                const uint64_t dateStringLengthParm,
@@ -117,9 +243,11 @@ CeLogin::CeLoginRc
         const uint8_t sMin = 59;
         const uint8_t sSec = 59;
 
-        int sLength =
-            sprintf(sTimeStr, "%04u%02u%02u%02u%02u%02uZ", dateParm.mYear,
-                    dateParm.mMonth, dateParm.mDay, sHour, sMin, sSec);
+        // A date that does not fit is truncated, and caught by the length
+        int sLength = snprintf(sTimeStr, sizeof(sTimeStr),
+                               "%04u%02u%02u%02u%02u%02uZ", dateParm.mYear,
+                               dateParm.mMonth, dateParm.mDay, sHour, sMin,
+                               sSec);
         if (15 == sLength)
         {
             // returns 1 if the time value is successfully set and 0 otherwise
@@ -140,18 +268,198 @@ CeLogin::CeLoginRc
     return sRc;
 }
 
+CeLogin::CeLoginRc
+    CeLogin::getExpirationTimeFromDate(const CeLogin::CeLogin_Date& dateParm,
+                                       uint64_t& expirationTimeParm)
+{
+    CeLoginRc sRc = CeLoginRc::Success;
+
+    // The ASN.1 time string only has room for 4 digit years and 2 digit
+    // months and days
+    if (dateParm.mYear > 9999 || dateParm.mMonth > 99 || dateParm.mDay > 99)
+    {
+        sRc = CeLoginRc::GetAsn1Time_FormatStringFailure;
+    }
+    else if (dateParm.mMonth < 1 || dateParm.mMonth > 12 || dateParm.mDay < 1 ||
+             dateParm.mDay > getDaysInMonth(dateParm.mYear, dateParm.mMonth))
+    {
+        sRc = CeLoginRc::GetAsn1Time_SetStringFailure;
+    }
+    else
+    {
+        const int64_t sDays =
+            getDaysFromCivil(dateParm.mYear, dateParm.mMonth, dateParm.mDay);
+        if (sDays >= 0)
+        {
+            expirationTimeParm = (uint64_t)sDays * 24 * 60 * 60 +
+                                 (23 * 60 * 60) + (59 * 60) + 59;
+        }
+        else
+        {
+            sRc = CeLoginRc::DetermineAuth_Asn1ExpirationToUnixOsslFailure;
+        }
+    }
+
+    return sRc;
+}
+
+// Validates everything in a decoded ACF that does not depend on the public
+// key or on the contents of sourceFileData. The expected object identifier is
+// looked up if one is not provided.
+static CeLogin::CeLoginRc
+    checkDecodedAcf(const CeLogin::CELoginSequenceV1View& decodedAsnParm,
+                    const ASN1_OBJECT* expectedObjectParm)
+{
+    CeLogin::CeLoginRc sRc = CeLogin::CeLoginRc::Success;
+
+    // Validate the NID stored within the ASN.1 structure. This indicates
+    // both the Digest algorithm and the Signature algorithm. It is
+    // different from the NID provided to OpenSSL when performing the
+    // sign/verify routine.
+
+    // Returns pointer to a static definition of the object identifier.
+    // Returns NULL on failure.
+    const ASN1_OBJECT* sExpectedObject = expectedObjectParm;
+    if (!sExpectedObject)
+    {
+        sExpectedObject = OBJ_nid2obj(CeLogin::CeLogin_Acf_NID);
+    }
+    if (!sExpectedObject)
+    {
+        CE_LOG_DEBUG("Failed to get NID");
+        sRc = CeLogin::CeLoginRc::VerifyAcf_Nid2OidFailed;
+    }
+
+    // Verify supported OID/signature algorithm
+    if (CeLogin::CeLoginRc::Success == sRc)
+    {
+        // Compare the encoded contents of the two object identifiers
+        const size_t sExpectedLength = OBJ_length(sExpectedObject);
+        if (sExpectedLength != decodedAsnParm.algorithmId.length ||
+            memcmp(OBJ_get0_data(sExpectedObject),
+                   decodedAsnParm.algorithmId.data, sExpectedLength))
+        {
+            sRc = CeLogin::CeLoginRc::VerifyAcf_OidMismatchFailure;
+        }
+    }
+
+    // Verify expected ProcessingType
+    if (CeLogin::CeLoginRc::Success == sRc)
+    {
+        const size_t sProcessingTypeLength =
+            strlen(CeLogin::AcfProcessingType);
+        if (sProcessingTypeLength != decodedAsnParm.processingType.length ||
+            memcmp(CeLogin::AcfProcessingType,
+                   decodedAsnParm.processingType.data,
+                   sProcessingTypeLength))
+        {
+            sRc = CeLogin::CeLoginRc::VerifyAcf_ProcessingTypeMismatch;
+        }
+    }
+
+    return sRc;
+}
+
+// Decodes the ACF and validates everything that does not depend on the
+// public key. Returns the digest the signature has to be verified against.
+static CeLogin::CeLoginRc
+    decodeAcfForVerify(const uint8_t* accessControlFileParm,
+                       const uint64_t accessControlFileLengthParm,
+                       const ASN1_OBJECT* expectedObjectParm,
+                       CeLogin::CELoginSequenceV1View& decodedAsnParm,
+                       uint8_t* digestParm, const uint64_t digestSizeParm)
+{
+    CeLogin::CeLoginRc sRc = CeLogin::CeLoginRc::Success;
+
+    // The views point into the ACF, nothing is allocated or copied
+    if (!CeLogin::decodeCELoginSequenceV1View(accessControlFileParm,
+                                              accessControlFileLengthParm,
+                                              decodedAsnParm))
+    {
+        CE_LOG_DEBUG("Failed to decode ASN.1 structure");
+        sRc = CeLogin::CeLoginRc::VerifyAcf_AsnDecodeFailure;
+    }
+
+    if (CeLogin::CeLoginRc::Success == sRc)
+    {
+        sRc = checkDecodedAcf(decodedAsnParm, expectedObjectParm);
+    }
+
+    if (CeLogin::CeLoginRc::Success == sRc)
+    {
+        // returns a pointer to the hash value on success, NULL on failure
+        // hash of the data, not the hash authcode
+        sRc = CeLogin::createDigest(decodedAsnParm.sourceFileData.data,
+                                    decodedAsnParm.sourceFileData.length,
+                                    digestParm, digestSizeParm);
+    }
+
+    return sRc;
+}
+
+// The checks createDigest makes on its input, for a digest that was computed
+// as the ACF was received. digestParm is NULL if computing it failed.
+static CeLogin::CeLoginRc
+    checkReceivedDigest(const CeLogin::CELoginSequenceV1View& decodedAsnParm,
+                        const uint8_t* digestParm)
+{
+    CeLogin::CeLoginRc sRc = CeLogin::CeLoginRc::Success;
+    if (!decodedAsnParm.sourceFileData.data)
+    {
+        sRc = CeLogin::CeLoginRc::CreateDigest_InvalidInputBuffer;
+    }
+    else if (0 == decodedAsnParm.sourceFileData.length)
+    {
+        sRc = CeLogin::CeLoginRc::CreateDigest_InvalidInputBufferLength;
+    }
+    else if (!digestParm)
+    {
+        sRc = CeLogin::CeLoginRc::CreateDigest_OsslCallFailed;
+    }
+    return sRc;
+}
+
+// Verify signature over SourceFileData
+static CeLogin::CeLoginRc
+    verifyAcfSignature(const CeLogin::CELoginSequenceV1View& decodedAsnParm,
+                       const uint8_t* digestParm, const uint8_t* publicKeyParm,
+                       uint64_t publicKeyLengthParm)
+{
+    CeLogin::CeLoginRc sRc = CeLogin::CeLoginRc::Success;
+
+    // return a valid EVP structure or NULL if an error occurs.
+    EVP_PKEY* sPublicKey =
+        d2i_PUBKEY(NULL, &publicKeyParm, publicKeyLengthParm);
+    if (!sPublicKey)
+    {
+        sRc = CeLogin::CeLoginRc::VerifyAcf_PublicKeyImportFailure;
+    }
+
+    if (CeLogin::CeLoginRc::Success == sRc)
+    {
+        sRc = CeLogin::verifySignature(
+            sPublicKey, EVP_sha512(), decodedAsnParm.signature.data,
+            decodedAsnParm.signature.length, digestParm,
+            CeLogin::CeLogin_DigestLength);
+    }
+    if (sPublicKey)
+    {
+        EVP_PKEY_free(sPublicKey);
+    }
+
+    return sRc;
+}
+
 CeLogin::CeLoginRc CeLogin::decodeAndVerifyAcf(
     const uint8_t* accessControlFileParm,
     const uint64_t accessControlFileLengthParm, const uint8_t* publicKeyParm,
-    uint64_t publicKeyLengthParm, CeLogin::CELoginSequenceV1*& decodedAsnParm)
+    uint64_t publicKeyLengthParm,
+    CeLogin::CELoginSequenceV1View& decodedAsnParm)
 {
     CeLoginRc sRc = CeLoginRc::Success;
 
-    EVP_PKEY* sPublicKey = NULL;
     uint8_t sHashReceivedJson[CeLogin_DigestLength];
 
-    ASN1_OBJECT* sExpectedObject = NULL;
-
     if (!accessControlFileParm || !publicKeyParm)
     {
         sRc = CeLoginRc::VerifyAcf_InvalidParm;
@@ -159,101 +467,130 @@ CeLogin::CeLoginRc CeLogin::decodeAndVerifyAcf(
 
     if (CeLoginRc::Success == sRc)
     {
-        // Validate the NID stored within the ASN.1 structure. This indicates
-        // both the Digest algorithm and the Signature algorithm. It is
-        // different from the NID provided to OpenSSL when performing the
-        // sign/verify routine.
+        sRc = decodeAcfForVerify(
+            accessControlFileParm, accessControlFileLengthParm, NULL,
+            decodedAsnParm, sHashReceivedJson, sizeof(sHashReceivedJson));
+    }
 
-        // Returns pointer to a static definition of the object identifier.
-        // Returns NULL on failure.
-        sExpectedObject = OBJ_nid2obj(CeLogin_Acf_NID);
-        if (!sExpectedObject)
-        {
-            CE_LOG_DEBUG("Failed to get NID");
-            sRc = CeLoginRc::VerifyAcf_Nid2OidFailed;
-        }
+    if (CeLoginRc::Success == sRc)
+    {
+        sRc = verifyAcfSignature(decodedAsnParm, sHashReceivedJson,
+                                 publicKeyParm, publicKeyLengthParm);
+    }
+
+    return sRc;
+}
+
+#ifndef CELOGIN_NO_HEAP
+CeLogin::CeLoginRc CeLogin::decodeAndVerifyAcf(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm, CeLoginVerifier& verifierParm,
+    CeLogin::CELoginSequenceV1View& decodedAsnParm, uint64_t& keyIndexParm)
+{
+    CeLoginRc sRc = CeLoginRc::Success;
+
+    uint8_t sHashReceivedJson[CeLogin_DigestLength];
+
+    keyIndexParm = verifierParm.getPublicKeyCount();
+
+    if (!accessControlFileParm || 0 == verifierParm.getPublicKeyCount())
+    {
+        sRc = CeLoginRc::VerifyAcf_InvalidParm;
     }
 
     if (CeLoginRc::Success == sRc)
     {
-        // return a valid TYPE structure or NULL if an error occurs
-        // NOTE: there is a "reuse" capability where an existing structure can
-        // be provided,
-        //       however in the event of a failure, the structure is
-        //       automatically free'd. Either way there is undesirable behavior.
-        //       So in this case returning a heap allocation seems slightly more
-        //       straightforward.
-        decodedAsnParm = d2i_CELoginSequenceV1(NULL, &accessControlFileParm,
-                                               accessControlFileLengthParm);
-        if (!decodedAsnParm)
-        {
+        sRc = decodeAcfForVerify(accessControlFileParm,
+                                 accessControlFileLengthParm,
+                                 verifierParm.getAcfObject(), decodedAsnParm,
+                                 sHashReceivedJson, sizeof(sHashReceivedJson));
+    }
 
-            CE_LOG_DEBUG("Failed to decode ASN.1 structure");
-            sRc = CeLoginRc::VerifyAcf_AsnDecodeFailure;
-        }
+    // Verify signature over SourceFileData, only the signature check depends
+    // on the key
+    if (CeLoginRc::Success == sRc)
+    {
+        sRc = verifierParm.verifySignature(
+            decodedAsnParm.signature.data, decodedAsnParm.signature.length,
+            sHashReceivedJson, sizeof(sHashReceivedJson), keyIndexParm);
+    }
+
+    return sRc;
+}
+#endif /* CELOGIN_NO_HEAP */
+
+CeLogin::CeLoginRc CeLogin::verifyReceivedAcf(
+    const CeLogin::CELoginSequenceV1View& decodedAsnParm,
+    const uint8_t* digestParm, const uint8_t* publicKeyParm,
+    uint64_t publicKeyLengthParm)
+{
+    CeLoginRc sRc = CeLoginRc::Success;
+
+    if (!publicKeyParm)
+    {
+        sRc = CeLoginRc::VerifyAcf_InvalidParm;
     }
 
-    // Verify supported OID/signature algorithm
     if (CeLoginRc::Success == sRc)
     {
-        // If the two are identical 0 is returned
-        if (0 != OBJ_cmp(sExpectedObject, decodedAsnParm->algorithm->id))
-        {
-            sRc = CeLoginRc::VerifyAcf_OidMismatchFailure;
-        }
+        sRc = checkDecodedAcf(decodedAsnParm, NULL);
     }
 
-    // Verify expected ProcessingType
     if (CeLoginRc::Success == sRc)
     {
-        const size_t sProcessingTypeLength = strlen(AcfProcessingType);
-        if (sProcessingTypeLength !=
-                (size_t)decodedAsnParm->processingType->length ||
-            memcmp(AcfProcessingType, decodedAsnParm->processingType->data,
-                   sProcessingTypeLength))
-        {
-            sRc = CeLoginRc::VerifyAcf_ProcessingTypeMismatch;
-        }
+        sRc = checkReceivedDigest(decodedAsnParm, digestParm);
     }
 
     if (CeLoginRc::Success == sRc)
     {
-        // returns a pointer to the hash value on success, NULL on failure
-        // hash of the data, not the hash authcode
-        sRc = createDigest(decodedAsnParm->sourceFileData->data,
-                           decodedAsnParm->sourceFileData->length,
-                           sHashReceivedJson, sizeof(sHashReceivedJson));
+        sRc = verifyAcfSignature(decodedAsnParm, digestParm, publicKeyParm,
+                                 publicKeyLengthParm);
+    }
+
+    return sRc;
+}
+
+#ifndef CELOGIN_NO_HEAP
+CeLogin::CeLoginRc CeLogin::verifyReceivedAcf(
+    const CeLogin::CELoginSequenceV1View& decodedAsnParm,
+    const uint8_t* digestParm, CeLoginVerifier& verifierParm,
+    uint64_t& keyIndexParm)
+{
+    CeLoginRc sRc = CeLoginRc::Success;
+
+    keyIndexParm = verifierParm.getPublicKeyCount();
+
+    if (0 == verifierParm.getPublicKeyCount())
+    {
+        sRc = CeLoginRc::VerifyAcf_InvalidParm;
     }
 
     if (CeLoginRc::Success == sRc)
     {
-        // return a valid EVP structure or NULL if an error occurs.
-        sPublicKey = d2i_PUBKEY(NULL, &publicKeyParm, publicKeyLengthParm);
-        if (!sPublicKey)
-        {
-            sRc = CeLoginRc::VerifyAcf_PublicKeyImportFailure;
-        }
+        sRc = checkDecodedAcf(decodedAsnParm, verifierParm.getAcfObject());
     }
 
-    // Verify signature over SourceFileData
     if (CeLoginRc::Success == sRc)
     {
-        sRc = verifySignature(sPublicKey, EVP_sha512(),
-                              decodedAsnParm->signature->data,
-                              decodedAsnParm->signature->length,
-                              sHashReceivedJson, sizeof(sHashReceivedJson));
+        sRc = checkReceivedDigest(decodedAsnParm, digestParm);
     }
-    if (sPublicKey)
+
+    if (CeLoginRc::Success == sRc)
     {
-        EVP_PKEY_free(sPublicKey);
+        sRc = verifierParm.verifySignature(
+            decodedAsnParm.signature.data, decodedAsnParm.signature.length,
+            digestParm, CeLogin_DigestLength, keyIndexParm);
     }
 
     return sRc;
 }
+#endif /* CELOGIN_NO_HEAP */
+
 CeLogin::CeLoginRc CeLogin::decodeAndVerifySignature(
     const uint8_t* accessControlFileParm,
     const uint64_t accessControlFileLengthParm, const uint8_t* publicKeyParm,
-    uint64_t publicKeyLengthParm, CeLogin::CELoginSequenceV1*& decodedAsnParm)
+    uint64_t publicKeyLengthParm,
+    CeLogin::CELoginSequenceV1View& decodedAsnParm)
 {
     CeLoginRc sRc = CeLoginRc::Success;
 
@@ -267,16 +604,9 @@ CeLogin::CeLoginRc CeLogin::decodeAndVerifySignature(
 
     if (CeLoginRc::Success == sRc)
     {
-        // return a valid TYPE structure or NULL if an error occurs
-        // NOTE: there is a "reuse" capability where an existing structure can
-        // be provided,
-        //       however in the event of a failure, the structure is
-        //       automatically free'd. Either way there is undesirable behavior.
-        //       So in this case returning a heap allocation seems slightly more
-        //       straightforward.
-        decodedAsnParm = d2i_CELoginSequenceV1(NULL, &accessControlFileParm,
-                                               accessControlFileLengthParm);
-        if (!decodedAsnParm)
+        if (!decodeCELoginSequenceV1View(accessControlFileParm,
+                                         accessControlFileLengthParm,
+                                         decodedAsnParm))
         {
             sRc = CeLoginRc::VerifyAcf_AsnDecodeFailure;
         }
@@ -286,8 +616,8 @@ CeLogin::CeLoginRc CeLogin::decodeAndVerifySignature(
     {
         // returns a pointer to the hash value on success, NULL on failure
         // hash of the data, not the hash authcode
-        sRc = createDigest(decodedAsnParm->sourceFileData->data,
-                           decodedAsnParm->sourceFileData->length,
+        sRc = createDigest(decodedAsnParm.sourceFileData.data,
+                           decodedAsnParm.sourceFileData.length,
                            sHashReceivedJson, sizeof(sHashReceivedJson));
     }
 
@@ -306,8 +636,8 @@ CeLogin::CeLoginRc CeLogin::decodeAndVerifySignature(
     if (CeLoginRc::Success == sRc)
     {
         sRc = verifySignature(sPublicKey, EVP_sha512(),
-                              decodedAsnParm->signature->data,
-                              decodedAsnParm->signature->length,
+                              decodedAsnParm.signature.data,
+                              decodedAsnParm.signature.length,
                               sHashReceivedJson, sizeof(sHashReceivedJson));
     }
 
@@ -353,7 +683,7 @@ CeLogin::CeLoginRc CeLogin::createDigest(const uint8_t* inputDataParm,
     return sRc;
 }
 
-CeLogin::CeLoginRc CeLogin::createPasswordHash(
+CeLogin::CeLoginRc CeLogin::checkPasswordHashParms(
     const char* inputDataParm, const uint64_t inputDataLengthParm,
     const uint8_t* inputSaltParm, const uint64_t inputSaltLengthParm,
     const uint64_t iterationsParm, uint8_t* outputHashParm,
@@ -402,7 +732,20 @@ CeLogin::CeLoginRc CeLogin::createPasswordHash(
         // would get truncated.
         sRc = CeLoginRc::CreatePasswordHash_IterationTooLarge;
     }
-    else
+    return sRc;
+}
+
+CeLogin::CeLoginRc CeLogin::createPasswordHash(
+    const char* inputDataParm, const uint64_t inputDataLengthParm,
+    const uint8_t* inputSaltParm, const uint64_t inputSaltLengthParm,
+    const uint64_t iterationsParm, uint8_t* outputHashParm,
+    const uint64_t outputHashSizeParm, const uint64_t requestedOutputLengthParm)
+{
+    CeLoginRc sRc = checkPasswordHashParms(
+        inputDataParm, inputDataLengthParm, inputSaltParm, inputSaltLengthParm,
+        iterationsParm, outputHashParm, outputHashSizeParm,
+        requestedOutputLengthParm);
+    if (CeLoginRc::Success == sRc)
     {
         // return 1 on success or 0 on error.
         int sOsslRc =
@@ -607,6 +950,165 @@ CeLogin::CeLoginRc CeLogin::verifySignature(EVP_PKEY* publicKeyParm,
     return sRc;
 }
 
+// Value of each base64 character, or 0xFF for any other character below 0x80
+static const uint8_t Base64Values[128] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0x3E, 0xFF, 0xFF, 0xFF, 0x3F,
+    0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B,
+    0x3C, 0x3D, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+    0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E,
+    0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
+    0x17, 0x18, 0x19, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20,
+    0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, 0x30,
+    0x31, 0x32, 0x33, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+static const char Base64Chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static inline uint8_t getBase64Value(const char charParm)
+{
+    return (charParm & 0x80) ? 0xFF : Base64Values[(uint8_t)charParm];
+}
+
+#if defined(__SSSE3__)
+// Decode 16 base64 characters into 12 bytes, the nibble lookups both check
+// and translate the characters. Returns false for any other character.
+static inline bool base64DecodeBlock(const char* inputParm,
+                                     uint8_t* decodedOutputParm)
+{
+    const __m128i sLutLow =
+        _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                      0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i sLutHigh =
+        _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10,
+                      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i sLutRoll =
+        _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i sMask2F = _mm_set1_epi8(0x2F);
+
+    __m128i sChars = _mm_loadu_si128((const __m128i*)inputParm);
+    const __m128i sHighNibbles =
+        _mm_and_si128(_mm_srli_epi32(sChars, 4), sMask2F);
+    const __m128i sLow =
+        _mm_shuffle_epi8(sLutLow, _mm_and_si128(sChars, sMask2F));
+    const __m128i sHigh = _mm_shuffle_epi8(sLutHigh, sHighNibbles);
+    if (0xFFFF != _mm_movemask_epi8(_mm_cmpeq_epi8(
+                      _mm_and_si128(sLow, sHigh), _mm_setzero_si128())))
+    {
+        return false;
+    }
+
+    const __m128i sRoll = _mm_shuffle_epi8(
+        sLutRoll,
+        _mm_add_epi8(_mm_cmpeq_epi8(sChars, sMask2F), sHighNibbles));
+    sChars = _mm_add_epi8(sChars, sRoll);
+
+    // Merge the 6 bit values into 24 bit groups, then drop the gaps
+    const __m128i sPairs =
+        _mm_maddubs_epi16(sChars, _mm_set1_epi32(0x01400140));
+    const __m128i sGroups = _mm_madd_epi16(sPairs, _mm_set1_epi32(0x00011000));
+    const __m128i sBytes = _mm_shuffle_epi8(
+        sGroups, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1,
+                               -1, -1));
+
+    uint8_t sOutput[16];
+    _mm_storeu_si128((__m128i*)sOutput, sBytes);
+    memcpy(decodedOutputParm, sOutput, 12);
+    return true;
+}
+
+// Encode 12 bytes, out of 16 readable ones, into 16 base64 characters
+static inline void base64EncodeBlock(const uint8_t* inputParm,
+                                     char* encodedOutputParm)
+{
+    __m128i sBytes = _mm_loadu_si128((const __m128i*)inputParm);
+    sBytes = _mm_shuffle_epi8(sBytes, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7,
+                                                   4, 5, 3, 4, 1, 2, 0, 1));
+
+    // Split each 24 bit group into four 6 bit values
+    const __m128i sValues = _mm_or_si128(
+        _mm_mulhi_epu16(_mm_and_si128(sBytes, _mm_set1_epi32(0x0FC0FC00)),
+                        _mm_set1_epi32(0x04000040)),
+        _mm_mullo_epi16(_mm_and_si128(sBytes, _mm_set1_epi32(0x003F03F0)),
+                        _mm_set1_epi32(0x01000010)));
+
+    // Offset from each value to its character, by range of values
+    const __m128i sLut = _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4,
+                                       -4, -4, -19, -16, 0, 0);
+    __m128i sIndices = _mm_subs_epu8(sValues, _mm_set1_epi8(51));
+    sIndices = _mm_sub_epi8(
+        sIndices, _mm_cmpgt_epi8(sValues, _mm_set1_epi8(25)));
+    _mm_storeu_si128(
+        (__m128i*)encodedOutputParm,
+        _mm_add_epi8(sValues, _mm_shuffle_epi8(sLut, sIndices)));
+}
+#endif
+
+// Decodes input made of base64 characters only, ending in at most two "="
+// characters. The output matches EVP_DecodeBlock, including the bytes for the
+// padding. Returns false for anything else.
+static bool base64DecodeCanonical(const char* inputParm,
+                                  const size_t inputLenParm,
+                                  uint8_t* decodedOutputParm,
+                                  size_t& numDecodedBytesParm)
+{
+    size_t sPadding = 0;
+    if (inputLenParm >= 4 && '=' == inputParm[inputLenParm - 1])
+    {
+        sPadding = ('=' == inputParm[inputLenParm - 2]) ? 2 : 1;
+    }
+
+    size_t sIn = 0;
+    size_t sOut = 0;
+#if defined(__SSSE3__)
+    // The last group of four is left for the padding, and each block reads 16
+    // characters
+    for (; sIn + 16 + 4 <= inputLenParm; sIn += 16, sOut += 12)
+    {
+        if (!base64DecodeBlock(inputParm + sIn, decodedOutputParm + sOut))
+        {
+            break;
+        }
+    }
+#endif
+
+    for (; sIn < inputLenParm; sIn += 4, sOut += 3)
+    {
+        const bool sIsLast = sIn + 4 == inputLenParm;
+        uint8_t sValues[4];
+        for (size_t sIdx = 0; sIdx < 4; sIdx++)
+        {
+            if (sIsLast && sIdx >= 4 - sPadding)
+            {
+                sValues[sIdx] = 0;
+            }
+            else
+            {
+                sValues[sIdx] = getBase64Value(inputParm[sIn + sIdx]);
+                if (0xFF == sValues[sIdx])
+                {
+                    return false;
+                }
+            }
+        }
+
+        decodedOutputParm[sOut] = (sValues[0] << 2) | (sValues[1] >> 4);
+        decodedOutputParm[sOut + 1] = (sValues[1] << 4) | (sValues[2] >> 2);
+        decodedOutputParm[sOut + 2] = (sValues[2] << 6) | sValues[3];
+    }
+
+    numDecodedBytesParm = sOut - sPadding;
+    return true;
+}
+
 CeLogin::CeLoginRc CeLogin::base64Decode(const char* inputParm,
                                          const size_t inputLenParm,
                                          uint8_t* decodedOutputParm,
@@ -627,6 +1129,11 @@ CeLogin::CeLoginRc CeLogin::base64Decode(const char* inputParm,
         // decode Input length should be divisible by 4
         sRc = CeLoginRc::Failure;
     }
+    else if (base64DecodeCanonical(inputParm, inputLenParm, decodedOutputParm,
+                                   numDecodedBytesParm))
+    {
+        // Anything else, like whitespace, is left to OpenSSL below
+    }
     else
     {
         const size_t sNumBytesDecoded = EVP_DecodeBlock(
@@ -658,4 +1165,63 @@ CeLogin::CeLoginRc CeLogin::base64Decode(const char* inputParm,
     }
 
     return sRc;
-}
\ No newline at end of file
+}
+
+CeLogin::CeLoginRc CeLogin::base64Encode(const uint8_t* inputParm,
+                                         const size_t inputLenParm,
+                                         char* encodedOutputParm,
+                                         const size_t encodedOutputLenParm,
+                                         size_t& numEncodedBytesParm)
+{
+    CeLoginRc sRc = CeLoginRc::Success;
+    numEncodedBytesParm = 0;
+
+    // Every group of up to three bytes takes four characters
+    const size_t sExpectedOutputLen = 4 * ((inputLenParm + 2) / 3);
+    if ((NULL == inputParm && 0 != inputLenParm) ||
+        (NULL == encodedOutputParm && 0 != sExpectedOutputLen) ||
+        sExpectedOutputLen > encodedOutputLenParm)
+    {
+        sRc = CeLoginRc::Failure;
+    }
+    else
+    {
+        size_t sIn = 0;
+        size_t sOut = 0;
+#if defined(__SSSE3__)
+        for (; sIn + 16 <= inputLenParm; sIn += 12, sOut += 16)
+        {
+            base64EncodeBlock(inputParm + sIn, encodedOutputParm + sOut);
+        }
+#endif
+
+        for (; sIn + 3 <= inputLenParm; sIn += 3, sOut += 4)
+        {
+            const uint32_t sGroup = (inputParm[sIn] << 16) |
+                                    (inputParm[sIn + 1] << 8) |
+                                    inputParm[sIn + 2];
+            encodedOutputParm[sOut] = Base64Chars[sGroup >> 18];
+            encodedOutputParm[sOut + 1] = Base64Chars[(sGroup >> 12) & 0x3F];
+            encodedOutputParm[sOut + 2] = Base64Chars[(sGroup >> 6) & 0x3F];
+            encodedOutputParm[sOut + 3] = Base64Chars[sGroup & 0x3F];
+        }
+
+        // The last one or two bytes are padded with "="
+        if (sIn < inputLenParm)
+        {
+            const bool sHasSecond = sIn + 1 < inputLenParm;
+            const uint32_t sGroup = (inputParm[sIn] << 16) |
+                                    (sHasSecond ? inputParm[sIn + 1] << 8 : 0);
+            encodedOutputParm[sOut] = Base64Chars[sGroup >> 18];
+            encodedOutputParm[sOut + 1] = Base64Chars[(sGroup >> 12) & 0x3F];
+            encodedOutputParm[sOut + 2] =
+                sHasSecond ? Base64Chars[(sGroup >> 6) & 0x3F] : '=';
+            encodedOutputParm[sOut + 3] = '=';
+            sOut += 4;
+        }
+
+        numEncodedBytesParm = sOut;
+    }
+
+    return sRc;
+}
@@ -9,6 +9,10 @@
 #ifndef _CELOGINUTIL_H
 #define _CELOGINUTIL_H
 
+#ifndef CELOGIN_MAX_JSON_TOKENS
+#define CELOGIN_MAX_JSON_TOKENS 65536
+#endif
+
 namespace CeLogin
 {
 extern const char* FrameworkEc_P10_Dev;
@@ -26,16 +30,90 @@ enum
     CeLogin_MaxHashedAuthCodeLength = 256,
     CeLogin_MaxHashedAuthCodeSaltLength = 128,
 
-    CeLogin_MaxNumberOfJsonTokens = 128, // somewhat arbitrary right now
+    // Upper bound on the tokens of the ACF JSON, each machine entry takes 5
+    CeLogin_MaxNumberOfJsonTokens = CELOGIN_MAX_JSON_TOKENS,
 };
 
 CeLoginRc getCeLoginRcFromJsmnRc(const JsmnUtils::JsmnUtilRc jsmnRc);
 
+#ifdef CELOGIN_NO_HEAP
+// A build without a heap has no verifiers, the internal interfaces that take
+// one are only ever passed NULL
+class CeLoginVerifier;
+#endif
+
+/// Makes an arena the source of scratch memory for the calling thread until
+/// the scope ends. The arena is reset on entry.
+class ArenaScope
+{
+  public:
+    explicit ArenaScope(CeLoginArena& arenaParm);
+    ~ArenaScope();
+
+  private:
+    ArenaScope(const ArenaScope&);
+    ArenaScope& operator=(const ArenaScope&);
+
+    CeLoginArena* mPrevious;
+    bool mPreviousOverflows;
+};
+
+#ifndef CELOGIN_NO_HEAP
+/// The arena of a call that was not given one. The temporaries of the call
+/// are carved from a single allocation, from the OpenSSL secure heap if it
+/// was set up, which is wiped and freed in one step when the scope ends. The
+/// allocation is only made once the call needs scratch memory, so a call that
+/// needs none allocates nothing. Whatever does not fit goes to the heap. Does
+/// nothing within another arena.
+class CallArena
+{
+  public:
+    /// @param[in] acfLengthParm the length of the ACF of the call, or of its
+    /// JSON, to size the arena for
+    explicit CallArena(const uint64_t acfLengthParm);
+    ~CallArena();
+
+  private:
+    CallArena(const CallArena&);
+    CallArena& operator=(const CallArena&);
+
+    // Allocates the buffer and makes it the arena of the call
+    friend void* allocateScratch(const uint64_t sizeParm);
+    void enter();
+
+    uint64_t mSize;
+    bool mEntered;
+    uint8_t* mBuffer;
+    CeLoginArena mArena;
+};
+#endif /* CELOGIN_NO_HEAP */
+
+/// @brief Scratch memory for a single call, from the arena of the call or
+/// else the heap. NULL if it could not be allocated, which is always the case
+/// without an arena in a build without a heap (CELOGIN_NO_HEAP).
+void* allocateScratch(const uint64_t sizeParm);
+
+/// @brief Give back memory from allocateScratch. NULL is ignored.
+void releaseScratch(void* ptrParm);
+
 CeLoginRc getBinaryFromHex(const char* hexStringParm,
                            const uint64_t hexStringLengthParm,
                            uint8_t* binaryParm, const uint64_t binarySizeParm,
                            uint64_t& binaryLengthParm);
 
+/// @brief Lower case hex digits for each byte, without a null terminator
+/// @param[in] binaryParm input bytes
+/// @param[in] binaryLengthParm number of input bytes
+/// @param[out] hexStringParm output buffer, twice the number of input bytes
+/// @param[in] hexStringSizeParm size of the output buffer
+/// @param[out] hexStringLengthParm number of hex digits written
+/// @return CeLoginRc
+CeLoginRc getHexFromBinary(const uint8_t* binaryParm,
+                           const uint64_t binaryLengthParm,
+                           char* hexStringParm,
+                           const uint64_t hexStringSizeParm,
+                           uint64_t& hexStringLengthParm);
+
 CeLoginRc getDateFromString(const char* dateStringParm,
                             const uint64_t dateStringLengthParm,
                             CeLogin_Date& dateParm);
@@ -43,23 +121,142 @@ CeLoginRc getDateFromString(const char* dateStringParm,
 CeLoginRc getAsn1TimeForExpiration(const CeLogin_Date& dateParm,
                                    ASN1_TIME* timeParm);
 
+// Days from 1970-01-01 to a date in the proleptic Gregorian calendar. Years
+// are counted from March, so that the leap day is the last day of the year,
+// and grouped into eras of 400 years (146097 days) that repeat exactly.
+inline constexpr int64_t getDaysFromMarchYear(const int64_t yearParm,
+                                              const int64_t eraParm,
+                                              const int64_t dayOfYearParm)
+{
+    return eraParm * 146097 + (yearParm - eraParm * 400) * 365 +
+           (yearParm - eraParm * 400) / 4 - (yearParm - eraParm * 400) / 100 +
+           dayOfYearParm - 719468;
+}
+
+inline constexpr int64_t getDaysFromCivil(const int64_t yearParm,
+                                          const uint64_t monthParm,
+                                          const uint64_t dayParm)
+{
+    return getDaysFromMarchYear(
+        yearParm - (monthParm <= 2 ? 1 : 0),
+        (yearParm - (monthParm <= 2 ? 1 : 0) -
+         (yearParm - (monthParm <= 2 ? 1 : 0) >= 0 ? 0 : 399)) /
+            400,
+        (153 * (monthParm > 2 ? monthParm - 3 : monthParm + 9) + 2) / 5 +
+            dayParm - 1);
+}
+
+inline constexpr bool isLeapYear(const uint64_t yearParm)
+{
+    return 0 == yearParm % 4 && (0 != yearParm % 100 || 0 == yearParm % 400);
+}
+
+inline constexpr uint64_t getDaysInMonth(const uint64_t yearParm,
+                                         const uint64_t monthParm)
+{
+    return 2 == monthParm ? (isLeapYear(yearParm) ? 29 : 28)
+           : (4 == monthParm || 6 == monthParm || 9 == monthParm ||
+              11 == monthParm)
+               ? 30
+               : 31;
+}
+
+static_assert(0 == getDaysFromCivil(1970, 1, 1), "unix epoch");
+static_assert(-1 == getDaysFromCivil(1969, 12, 31), "before unix epoch");
+static_assert(11016 == getDaysFromCivil(2000, 2, 29), "leap day");
+static_assert(2932896 == getDaysFromCivil(9999, 12, 31), "last ACF date");
+
+// Seconds since the unix epoch at the end of the day (23:59:59 UTC) the ACF
+// expires on. Dates are rejected with the same return codes as
+// getAsn1TimeForExpiration, and dates before 1970 the same as isTimeExpired.
+CeLoginRc getExpirationTimeFromDate(const CeLogin_Date& dateParm,
+                                    uint64_t& expirationTimeParm);
+
 CeLoginRc decodeAndVerifySignature(const uint8_t* accessControlFileParm,
                                    const uint64_t accessControlFileLengthParm,
                                    const uint8_t* publicKeyParm,
                                    uint64_t publicKeyLengthParm,
-                                   CELoginSequenceV1*& decodedAsnParm);
+                                   CELoginSequenceV1View& decodedAsnParm);
 
 CeLoginRc decodeAndVerifyAcf(const uint8_t* accessControlFileParm,
                              const uint64_t accessControlFileLengthParm,
                              const uint8_t* publicKeyParm,
                              uint64_t publicKeyLengthParm,
-                             CELoginSequenceV1*& decodedAsnParm);
+                             CELoginSequenceV1View& decodedAsnParm);
+
+#ifndef CELOGIN_NO_HEAP
+/// @brief Same as decodeAndVerifyAcf, using the public keys of a verifier. The
+/// ACF is decoded and digested once, then the keys are tried in order.
+/// keyIndexParm is set to the index of the key that verified the signature,
+/// or to the number of keys if none did.
+CeLoginRc decodeAndVerifyAcf(const uint8_t* accessControlFileParm,
+                             const uint64_t accessControlFileLengthParm,
+                             CeLoginVerifier& verifierParm,
+                             CELoginSequenceV1View& decodedAsnParm,
+                             uint64_t& keyIndexParm);
+#endif /* CELOGIN_NO_HEAP */
+
+/// @brief Same as decodeAndVerifyAcf, for an ACF that was decoded as it was
+/// received. The digest of sourceFileData was computed by the caller, and is
+/// NULL if that failed.
+CeLoginRc verifyReceivedAcf(const CELoginSequenceV1View& decodedAsnParm,
+                            const uint8_t* digestParm,
+                            const uint8_t* publicKeyParm,
+                            uint64_t publicKeyLengthParm);
+
+#ifndef CELOGIN_NO_HEAP
+/// @brief Same as verifyReceivedAcf, using the public keys of a verifier
+CeLoginRc verifyReceivedAcf(const CELoginSequenceV1View& decodedAsnParm,
+                            const uint8_t* digestParm,
+                            CeLoginVerifier& verifierParm,
+                            uint64_t& keyIndexParm);
+#endif /* CELOGIN_NO_HEAP */
+
+/// An ACF that was decoded and digested as it was received, used in place of
+/// the buffer holding an ACF. mRc is the result of receiving it, returned
+/// where decoding the ACF from a buffer would fail. mDigest is the digest of
+/// sourceFileData, NULL if computing it failed.
+struct ReceivedAcf
+{
+    ReceivedAcf() : mRc(CeLoginRc::Success), mDigest(NULL)
+    {
+        memset(&mDecodedAsn, 0x00, sizeof(mDecodedAsn));
+    }
+
+    CeLoginRc mRc;
+    CELoginSequenceV1View mDecodedAsn;
+    const uint8_t* mDigest;
+};
+
+#if !defined(CELOGIN_NO_HEAP) && !defined(CELOGIN_POWERVM_TARGET)
+/// @brief verifyACFForBMCUploadV2 for an ACF that was received by an
+/// AcfUploadStream. The public key is taken from the verifier if there is one.
+CeLoginRc verifyReceivedACFForBMCUploadV2(
+    const ReceivedAcf& receivedAcfParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    CeLoginVerifier* verifierParm, const char* serialNumberParm,
+    const uint64_t serialNumberLengthParm, const uint64_t currentReplayIdParm,
+    uint64_t& updatedReplayIdParm, AcfType& acfTypeParm,
+    uint64_t& expirationTimeParm);
+#endif
 
 CeLoginRc createDigest(const uint8_t* inputDataParm,
                        const uint64_t inputDataLengthParm,
                        uint8_t* outputHashParm,
                        const uint64_t outputHashSizeParm);
 
+/// @brief Check the parameters of a password hash the way createPasswordHash
+///        does, without deriving anything
+CeLoginRc checkPasswordHashParms(const char* inputDataParm,
+                                 const uint64_t inputDataLengthParm,
+                                 const uint8_t* inputSaltParm,
+                                 const uint64_t inputSaltLengthParm,
+                                 const uint64_t iterationsParm,
+                                 uint8_t* outputHashParm,
+                                 const uint64_t outputHashSizeParm,
+                                 const uint64_t requestedOutputLengthParm);
+
 CeLoginRc createPasswordHash(const char* inputDataParm,
                              const uint64_t inputDataLengthParm,
                              const uint8_t* inputSaltParm,
@@ -69,6 +266,48 @@ CeLoginRc createPasswordHash(const char* inputDataParm,
                              const uint64_t outputHashSizeParm,
                              const uint64_t requestedOutputLengthParm);
 
+/// @brief One PBKDF2-HMAC-SHA512 derivation of a batch, with the parameters of
+///        createPasswordHash
+struct PasswordHashRequest
+{
+    PasswordHashRequest() :
+        mPassword(NULL), mPasswordLength(0), mSalt(NULL), mSaltLength(0),
+        mIterations(0), mOutputHash(NULL), mOutputHashSize(0),
+        mRequestedOutputLength(0), mRc(CeLoginRc::Failure)
+    {}
+
+    const char* mPassword;
+    uint64_t mPasswordLength;
+    const uint8_t* mSalt;
+    uint64_t mSaltLength;
+    uint64_t mIterations;
+    uint8_t* mOutputHash;
+    uint64_t mOutputHashSize;
+    uint64_t mRequestedOutputLength;
+    CeLoginRc mRc; // result of the derivation, set by createPasswordHashes
+};
+
+/// @brief Derive every password hash of a batch, giving each request the
+///        result createPasswordHash would give for the same parameters.
+///        With AVX-512 or AVX2 the iterations of several derivations run
+///        together, one SIMD lane each; otherwise they run one at a time.
+/// @param[in,out] requestsParm the requests, each gets its mRc
+/// @param[in] countParm number of requests
+void createPasswordHashes(PasswordHashRequest* requestsParm,
+                          const uint64_t countParm);
+
+/// @brief Same as createPasswordHashes, asking the control whether to go on
+///        between blocks of iterations. Requests that are not complete when
+///        told to stop fail with PasswordHashStopped. Outputs longer than
+///        AcfAuthRecordMaxHashedAuthCodeLength are derived without asking.
+/// @param[in] controlParm decides whether the derivations go on, may be NULL
+void createPasswordHashes(PasswordHashRequest* requestsParm,
+                          const uint64_t countParm,
+                          const PasswordHashControl* controlParm);
+
+/// @brief Number of derivations createPasswordHashes runs side by side
+uint64_t getPasswordHashLanes();
+
 CeLoginRc getUnsignedIntegerFromString(const char* stringParm,
                                        const uint64_t stringLengthParm,
                                        uint64_t& integerParm);
@@ -110,6 +349,19 @@ CeLoginRc base64Decode(const char* inputParm, const size_t inputLenParm,
                        const size_t decodedOutputLenParm,
                        size_t& numDecodedBytesParm);
 
+/// @brief Base64 encoding with padding, without a null terminator
+/// @param[in] inputParm input bytes
+/// @param[in] inputLenParm number of input bytes
+/// @param[out] encodedOutputParm output buffer, 4 characters for every 3 bytes
+/// or part thereof
+/// @param[in] encodedOutputLenParm size of the output buffer
+/// @param[out] numEncodedBytesParm number of characters written
+/// @return CeLoginRc
+CeLoginRc base64Encode(const uint8_t* inputParm, const size_t inputLenParm,
+                       char* encodedOutputParm,
+                       const size_t encodedOutputLenParm,
+                       size_t& numEncodedBytesParm);
+
 }; // namespace CeLogin
 
 #endif
@@ -9,44 +9,60 @@
 #include <string.h>
 
 #include <ce_logger.hpp>
-
-#include <new>
+using CeLogin::ArenaScope;
 using CeLogin::CeLoginJsonData;
 using CeLogin::CeLoginRc;
-using CeLogin::CELoginSequenceV1;
+using CeLogin::CeLoginVerifier;
+using CeLogin::CELoginSequenceV1View;
+
+// True if the call was given a verifier with public keys. A build without a
+// heap has no verifiers.
+static bool hasVerifierKeys(const CeLoginVerifier* verifierParm)
+{
+#ifndef CELOGIN_NO_HEAP
+    return verifierParm && 0 != verifierParm->getPublicKeyCount();
+#else
+    return false;
+#endif
+}
 
 // This common helper function performs three operations:
 //   1. Verifies signature on ACF
 //   2. Verifies ACF is not expired and is valid for this system
 //   3. Fills out JSON data object with fiels in the ACF
 //   4. Verifies replay ID if present and returns updated id
+// An ACF that was decoded as it was received is used in place of the buffer
+// when receivedAcfParm is not NULL.
 static CeLoginRc validateAndParseAcfV2(
     const uint8_t* accessControlFileParm,
     const uint64_t accessControlFileLengthParm,
+    const CeLogin::ReceivedAcf* receivedAcfParm,
     const uint64_t timeSinceUnixEpochInSecondsParm,
     const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    CeLogin::CeLoginVerifier* verifierParm, uint64_t& keyIndexParm,
     const char* serialNumberParm, const uint64_t serialNumberLengthParm,
     CeLoginJsonData& outputJsonParm, uint64_t& expirationTimeParm)
 {
     CeLoginRc sRc = CeLoginRc::Success;
-    CELoginSequenceV1* sDecodedAsn = NULL;
+    CELoginSequenceV1View sDecodedAsn;
 
-    if (!accessControlFileParm)
+    // A received ACF was checked to be there while it was received
+    if (!receivedAcfParm && !accessControlFileParm)
     {
         CE_LOG_DEBUG("ACF pointer is NULL");
         sRc = CeLoginRc::GetSevAuth_InvalidAcfPtr;
     }
-    else if (0 == accessControlFileLengthParm)
+    else if (!receivedAcfParm && 0 == accessControlFileLengthParm)
     {
         CE_LOG_DEBUG("ACF length is 0");
         sRc = CeLoginRc::GetSevAuth_InvalidAcfLength;
     }
-    else if (!publicKeyParm)
+    else if (!publicKeyParm && !hasVerifierKeys(verifierParm))
     {
         CE_LOG_DEBUG("Public key pointer is NULL");
         sRc = CeLoginRc::GetSevAuth_InvalidPublicKeyPtr;
     }
-    else if (0 == publicKeyLengthParm)
+    else if (0 == publicKeyLengthParm && !verifierParm)
     {
         CE_LOG_DEBUG("Public key length is 0");
         sRc = CeLoginRc::GetSevAuth_InvalidPublicKeyLength;
@@ -62,23 +78,55 @@ static CeLoginRc validateAndParseAcfV2(
         sRc = CeLoginRc::GetSevAuth_InvalidSerialNumberLength;
     }
 
-    if (CeLoginRc::Success == sRc)
+    // Same checks for a received ACF, which fails the way decoding it would
+    // if receiving it failed
+    if (CeLoginRc::Success == sRc && receivedAcfParm)
+    {
+        sDecodedAsn = receivedAcfParm->mDecodedAsn;
+        sRc = receivedAcfParm->mRc;
+#ifndef CELOGIN_NO_HEAP
+        if (CeLoginRc::Success == sRc && verifierParm)
+        {
+            sRc = verifyReceivedAcf(sDecodedAsn, receivedAcfParm->mDigest,
+                                    *verifierParm, keyIndexParm);
+        }
+        else
+#endif
+        if (CeLoginRc::Success == sRc)
+        {
+            sRc = verifyReceivedAcf(sDecodedAsn, receivedAcfParm->mDigest,
+                                    publicKeyParm, publicKeyLengthParm);
+        }
+    }
+    else if (CeLoginRc::Success == sRc)
     {
-        // Returns a heap allocation of the decoded ANS1 structure.
+        // Decodes the ANS1 structure in place.
         //  - Verify supported OID/signature algorithm
         //  - Verify expected ProcessingType
         //  - Verify signature over SourceFileData
-        sRc = decodeAndVerifyAcf(accessControlFileParm,
-                                 accessControlFileLengthParm, publicKeyParm,
-                                 publicKeyLengthParm, sDecodedAsn);
+#ifndef CELOGIN_NO_HEAP
+        if (verifierParm)
+        {
+            sRc = decodeAndVerifyAcf(accessControlFileParm,
+                                     accessControlFileLengthParm, *verifierParm,
+                                     sDecodedAsn, keyIndexParm);
+        }
+        else
+#endif
+        {
+            sRc = decodeAndVerifyAcf(accessControlFileParm,
+                                     accessControlFileLengthParm,
+                                     publicKeyParm, publicKeyLengthParm,
+                                     sDecodedAsn);
+        }
     }
 
     // Verify system serial number is in machine list (and get the
     // authorization)
     if (CeLoginRc::Success == sRc)
     {
-        sRc = decodeJson((const char*)sDecodedAsn->sourceFileData->data,
-                         sDecodedAsn->sourceFileData->length, serialNumberParm,
+        sRc = decodeJson((const char*)sDecodedAsn.sourceFileData.data,
+                         sDecodedAsn.sourceFileData.length, serialNumberParm,
                          serialNumberLengthParm, outputJsonParm);
     }
 
@@ -89,11 +137,6 @@ static CeLoginRc validateAndParseAcfV2(
                             timeSinceUnixEpochInSecondsParm);
     }
 
-    if (sDecodedAsn)
-    {
-        CELoginSequenceV1_free(sDecodedAsn);
-    }
-
     return sRc;
 }
 
@@ -138,22 +181,26 @@ static CeLogin::CeLoginRc doFullReplayValidation(
     return sRc;
 }
 
-CeLoginRc CeLogin::extractACFMetadataV2(
+static CeLoginRc extractACFMetadataV2Internal(
     const uint8_t* accessControlFileParm,
     const uint64_t accessControlFileLengthParm,
     const uint64_t timeSinceUnixEpochInSecondsParm,
     const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    CeLogin::CeLoginVerifier* verifierParm, uint64_t& keyIndexParm,
     const char* serialNumberParm, const uint64_t serialNumberLengthParm,
-    AcfType& acfTypeParm, uint64_t& expirationTimeParm,
-    CeLogin_Date& expirationDateParm, AcfVersion& versionParm,
+    CeLogin::AcfType& acfTypeParm, uint64_t& expirationTimeParm,
+    CeLogin::CeLogin_Date& expirationDateParm, CeLogin::AcfVersion& versionParm,
     bool& hasReplayIdParm)
 {
     CeLoginRc sRc = CeLoginRc::Success;
-    CeLoginJsonData* sJsonData = NULL;
+#ifndef CELOGIN_NO_HEAP
+    CeLogin::CallArena sCallArena(accessControlFileLengthParm);
+#endif
+    CeLoginJsonData sJsonData;
 
     acfTypeParm = CeLogin::AcfType_Invalid;
     expirationTimeParm = 0;
-    versionParm = CeLoginInvalidVersion;
+    versionParm = CeLogin::CeLoginInvalidVersion;
     hasReplayIdParm = false;
 
     if (!accessControlFileParm)
@@ -164,11 +211,11 @@ CeLoginRc CeLogin::extractACFMetadataV2(
     {
         sRc = CeLoginRc::GetSevAuth_InvalidAcfLength;
     }
-    else if (!publicKeyParm)
+    else if (!publicKeyParm && !hasVerifierKeys(verifierParm))
     {
         sRc = CeLoginRc::GetSevAuth_InvalidPublicKeyPtr;
     }
-    else if (0 == publicKeyLengthParm)
+    else if (0 == publicKeyLengthParm && !verifierParm)
     {
         sRc = CeLoginRc::GetSevAuth_InvalidPublicKeyLength;
     }
@@ -182,20 +229,6 @@ CeLoginRc CeLogin::extractACFMetadataV2(
     }
     // No check for PW parms; may or may not be required.
 
-    // Allocate on heap to avoid blowing the stack
-    if (CeLoginRc::Success == sRc)
-    {
-        sJsonData = (CeLoginJsonData*)OPENSSL_malloc(sizeof(CeLoginJsonData));
-        if (sJsonData)
-        {
-            new (sJsonData) CeLoginJsonData();
-        }
-        else
-        {
-            sRc = CeLoginRc::JsonDataAllocationFailure;
-        }
-    }
-
     // Stack copy to store the parsed expiration time into. Only pass back
     // the value if the authority has validated as CE or Dev.
     uint64_t sExpirationTime = 0;
@@ -203,17 +236,17 @@ CeLoginRc CeLogin::extractACFMetadataV2(
     if (CeLoginRc::Success == sRc)
     {
         sRc = validateAndParseAcfV2(
-            accessControlFileParm, accessControlFileLengthParm,
+            accessControlFileParm, accessControlFileLengthParm, NULL,
             timeSinceUnixEpochInSecondsParm, publicKeyParm, publicKeyLengthParm,
-            serialNumberParm, serialNumberLengthParm, *sJsonData,
-            sExpirationTime);
+            verifierParm, keyIndexParm, serialNumberParm,
+            serialNumberLengthParm, sJsonData, sExpirationTime);
     }
 
     // This interface only supports V1 and V2
     if (CeLoginRc::Success == sRc)
     {
-        if (CeLogin::CeLoginVersion1 != sJsonData->mVersion &&
-            CeLogin::CeLoginVersion2 != sJsonData->mVersion)
+        if (CeLogin::CeLoginVersion1 != sJsonData.mVersion &&
+            CeLogin::CeLoginVersion2 != sJsonData.mVersion)
         {
             sRc = CeLoginRc::UnsupportedVersion;
         }
@@ -221,55 +254,151 @@ CeLoginRc CeLogin::extractACFMetadataV2(
 
     if (CeLoginRc::Success == sRc)
     {
-        acfTypeParm = sJsonData->mType;
+        acfTypeParm = sJsonData.mType;
         expirationTimeParm = sExpirationTime;
-        expirationDateParm = sJsonData->mExpirationDate;
-        versionParm = sJsonData->mVersion;
-        hasReplayIdParm = sJsonData->mReplayInfo.mReplayIdPresent;
+        expirationDateParm = sJsonData.mExpirationDate;
+        versionParm = sJsonData.mVersion;
+        hasReplayIdParm = sJsonData.mReplayInfo.mReplayIdPresent;
+    }
+
+    return sRc;
+}
+
+#ifndef CELOGIN_NO_HEAP
+CeLoginRc CeLogin::extractACFMetadataV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    AcfType& acfTypeParm, uint64_t& expirationTimeParm,
+    CeLogin_Date& expirationDateParm, AcfVersion& versionParm,
+    bool& hasReplayIdParm)
+{
+    uint64_t sKeyIndex = 0;
+
+    return extractACFMetadataV2Internal(
+        accessControlFileParm, accessControlFileLengthParm,
+        timeSinceUnixEpochInSecondsParm, publicKeyParm, publicKeyLengthParm,
+        NULL, sKeyIndex, serialNumberParm, serialNumberLengthParm, acfTypeParm,
+        expirationTimeParm, expirationDateParm, versionParm, hasReplayIdParm);
+}
+
+#ifndef CELOGIN_POWERVM_TARGET
+CeLoginRc CeLogin::extractACFMetadataV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm, EVP_PKEY* publicKeyParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    AcfType& acfTypeParm, uint64_t& expirationTimeParm,
+    CeLogin_Date& expirationDateParm, AcfVersion& versionParm,
+    bool& hasReplayIdParm)
+{
+    uint64_t sKeyIndex = 0;
+    CeLoginVerifier sVerifier;
+    CeLoginRc sRc = sVerifier.setPublicKeys(&publicKeyParm, 1);
+
+    if (CeLoginRc::Success == sRc)
+    {
+        sRc = extractACFMetadataV2Internal(
+            accessControlFileParm, accessControlFileLengthParm,
+            timeSinceUnixEpochInSecondsParm, NULL, 0, &sVerifier, sKeyIndex,
+            serialNumberParm, serialNumberLengthParm, acfTypeParm,
+            expirationTimeParm, expirationDateParm, versionParm,
+            hasReplayIdParm);
     }
 
-    if (sJsonData)
+    return sRc;
+}
+
+CeLoginRc CeLogin::extractACFMetadataV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    EVP_PKEY* const* publicKeysParm, const uint64_t publicKeyCountParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    AcfType& acfTypeParm, uint64_t& expirationTimeParm,
+    CeLogin_Date& expirationDateParm, AcfVersion& versionParm,
+    bool& hasReplayIdParm, uint64_t& keyIndexParm)
+{
+    CeLoginVerifier sVerifier;
+    CeLoginRc sRc = sVerifier.setPublicKeys(publicKeysParm, publicKeyCountParm);
+    keyIndexParm = publicKeyCountParm;
+
+    if (CeLoginRc::Success == sRc)
     {
-        sJsonData->~CeLoginJsonData();
-        OPENSSL_free(sJsonData);
+        sRc = extractACFMetadataV2Internal(
+            accessControlFileParm, accessControlFileLengthParm,
+            timeSinceUnixEpochInSecondsParm, NULL, 0, &sVerifier, keyIndexParm,
+            serialNumberParm, serialNumberLengthParm, acfTypeParm,
+            expirationTimeParm, expirationDateParm, versionParm,
+            hasReplayIdParm);
     }
 
     return sRc;
 }
 
+CeLoginRc CeLogin::extractACFMetadataV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    CeLoginVerifier& verifierParm, const char* serialNumberParm,
+    const uint64_t serialNumberLengthParm, AcfType& acfTypeParm,
+    uint64_t& expirationTimeParm, CeLogin_Date& expirationDateParm,
+    AcfVersion& versionParm, bool& hasReplayIdParm, uint64_t& keyIndexParm)
+{
+    keyIndexParm = verifierParm.getPublicKeyCount();
+
+    return extractACFMetadataV2Internal(
+        accessControlFileParm, accessControlFileLengthParm,
+        timeSinceUnixEpochInSecondsParm, NULL, 0, &verifierParm, keyIndexParm,
+        serialNumberParm, serialNumberLengthParm, acfTypeParm,
+        expirationTimeParm, expirationDateParm, versionParm, hasReplayIdParm);
+}
+#endif /* CELOGIN_POWERVM_TARGET */
+#endif /* CELOGIN_NO_HEAP */
+
 #ifndef CELOGIN_POWERVM_TARGET
-CeLoginRc CeLogin::verifyACFForBMCUploadV2(
+static CeLoginRc verifyACFForBMCUploadV2Internal(
     const uint8_t* accessControlFileParm,
     const uint64_t accessControlFileLengthParm,
+    const CeLogin::ReceivedAcf* receivedAcfParm,
     const uint64_t timeSinceUnixEpochInSecondsParm,
     const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    CeLogin::CeLoginVerifier* verifierParm, uint64_t& keyIndexParm,
     const char* serialNumberParm, const uint64_t serialNumberLengthParm,
     const uint64_t currentReplayIdParm, uint64_t& updatedReplayIdParm,
     CeLogin::AcfType& acfTypeParm, uint64_t& expirationTimeParm)
 {
     CeLoginRc sRc = CeLoginRc::Success;
-    CeLoginJsonData* sJsonData = NULL;
+#ifndef CELOGIN_NO_HEAP
+    CeLogin::CallArena sCallArena(
+        receivedAcfParm ? receivedAcfParm->mDecodedAsn.sourceFileData.length
+                        : accessControlFileLengthParm);
+#endif
+    CeLoginJsonData sJsonData;
 
     updatedReplayIdParm = 0;
     acfTypeParm = CeLogin::AcfType_Invalid;
     expirationTimeParm = 0;
 
-    if (!accessControlFileParm)
+    // A received ACF was checked to be there while it was received
+    if (!receivedAcfParm && !accessControlFileParm)
     {
         CE_LOG_DEBUG("ACF pointer is NULL");
         sRc = CeLoginRc::GetSevAuth_InvalidAcfPtr;
     }
-    else if (0 == accessControlFileLengthParm)
+    else if (!receivedAcfParm && 0 == accessControlFileLengthParm)
     {
         CE_LOG_DEBUG("ACF length is 0");
         sRc = CeLoginRc::GetSevAuth_InvalidAcfLength;
     }
-    else if (!publicKeyParm)
+    else if (!publicKeyParm && !hasVerifierKeys(verifierParm))
     {
         CE_LOG_DEBUG("Public key pointer is NULL");
         sRc = CeLoginRc::GetSevAuth_InvalidPublicKeyPtr;
     }
-    else if (0 == publicKeyLengthParm)
+    else if (0 == publicKeyLengthParm && !verifierParm)
     {
         CE_LOG_DEBUG("Public key length is 0");
         sRc = CeLoginRc::GetSevAuth_InvalidPublicKeyLength;
@@ -286,20 +415,6 @@ CeLoginRc CeLogin::verifyACFForBMCUploadV2(
     }
     // No check for PW parms; may or may not be required.
 
-    // Allocate on heap to avoid blowing the stack
-    if (CeLoginRc::Success == sRc)
-    {
-        sJsonData = (CeLoginJsonData*)OPENSSL_malloc(sizeof(CeLoginJsonData));
-        if (sJsonData)
-        {
-            new (sJsonData) CeLoginJsonData();
-        }
-        else
-        {
-            sRc = CeLoginRc::JsonDataAllocationFailure;
-        }
-    }
-
     // Stack copy to store the parsed expiration time into. Only pass back
     // the value if the authority has validated as CE or Dev.
     uint64_t sExpirationTime = 0;
@@ -308,16 +423,16 @@ CeLoginRc CeLogin::verifyACFForBMCUploadV2(
     {
         sRc = validateAndParseAcfV2(
             accessControlFileParm, accessControlFileLengthParm,
-            timeSinceUnixEpochInSecondsParm, publicKeyParm, publicKeyLengthParm,
-            serialNumberParm, serialNumberLengthParm, *sJsonData,
-            sExpirationTime);
+            receivedAcfParm, timeSinceUnixEpochInSecondsParm, publicKeyParm,
+            publicKeyLengthParm, verifierParm, keyIndexParm, serialNumberParm,
+            serialNumberLengthParm, sJsonData, sExpirationTime);
     }
 
     // This interface only supports V1 and V2
     if (CeLoginRc::Success == sRc)
     {
-        if (CeLogin::CeLoginVersion1 != sJsonData->mVersion &&
-            CeLogin::CeLoginVersion2 != sJsonData->mVersion)
+        if (CeLogin::CeLoginVersion1 != sJsonData.mVersion &&
+            CeLogin::CeLoginVersion2 != sJsonData.mVersion)
         {
             CE_LOG_DEBUG("Unsupported version");
             sRc = CeLoginRc::UnsupportedVersion;
@@ -329,44 +444,337 @@ CeLoginRc CeLogin::verifyACFForBMCUploadV2(
     {
 
         sRc = doFullReplayValidation(
-            sJsonData->mType, sJsonData->mReplayInfo.mReplayIdPresent,
-            currentReplayIdParm, sJsonData->mReplayInfo.mReplayId,
+            sJsonData.mType, sJsonData.mReplayInfo.mReplayIdPresent,
+            currentReplayIdParm, sJsonData.mReplayInfo.mReplayId,
             updatedReplayIdParm);
     }
 
     if (CeLoginRc::Success == sRc)
     {
-        acfTypeParm = sJsonData->mType;
+        acfTypeParm = sJsonData.mType;
         expirationTimeParm = sExpirationTime;
     }
 
-    if (sJsonData)
+    return sRc;
+}
+
+#ifndef CELOGIN_NO_HEAP
+CeLoginRc CeLogin::verifyACFForBMCUploadV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    const uint64_t currentReplayIdParm, uint64_t& updatedReplayIdParm,
+    CeLogin::AcfType& acfTypeParm, uint64_t& expirationTimeParm)
+{
+    uint64_t sKeyIndex = 0;
+
+    return verifyACFForBMCUploadV2Internal(
+        accessControlFileParm, accessControlFileLengthParm, NULL,
+        timeSinceUnixEpochInSecondsParm, publicKeyParm, publicKeyLengthParm,
+        NULL, sKeyIndex, serialNumberParm, serialNumberLengthParm,
+        currentReplayIdParm, updatedReplayIdParm, acfTypeParm,
+        expirationTimeParm);
+}
+
+CeLoginRc CeLogin::verifyACFForBMCUploadV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm, EVP_PKEY* publicKeyParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    const uint64_t currentReplayIdParm, uint64_t& updatedReplayIdParm,
+    CeLogin::AcfType& acfTypeParm, uint64_t& expirationTimeParm)
+{
+    uint64_t sKeyIndex = 0;
+    CeLoginVerifier sVerifier;
+    CeLoginRc sRc = sVerifier.setPublicKeys(&publicKeyParm, 1);
+
+    if (CeLoginRc::Success == sRc)
     {
-        sJsonData->~CeLoginJsonData();
-        OPENSSL_free(sJsonData);
+        sRc = verifyACFForBMCUploadV2Internal(
+            accessControlFileParm, accessControlFileLengthParm, NULL,
+            timeSinceUnixEpochInSecondsParm, NULL, 0, &sVerifier, sKeyIndex,
+            serialNumberParm, serialNumberLengthParm, currentReplayIdParm,
+            updatedReplayIdParm, acfTypeParm, expirationTimeParm);
     }
 
     return sRc;
 }
+
+CeLoginRc CeLogin::verifyReceivedACFForBMCUploadV2(
+    const ReceivedAcf& receivedAcfParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    CeLoginVerifier* verifierParm, const char* serialNumberParm,
+    const uint64_t serialNumberLengthParm, const uint64_t currentReplayIdParm,
+    uint64_t& updatedReplayIdParm, AcfType& acfTypeParm,
+    uint64_t& expirationTimeParm)
+{
+    uint64_t sKeyIndex = 0;
+
+    return verifyACFForBMCUploadV2Internal(
+        NULL, 0, &receivedAcfParm, timeSinceUnixEpochInSecondsParm,
+        publicKeyParm, publicKeyLengthParm, verifierParm, sKeyIndex,
+        serialNumberParm, serialNumberLengthParm, currentReplayIdParm,
+        updatedReplayIdParm, acfTypeParm, expirationTimeParm);
+}
+#endif /* CELOGIN_NO_HEAP */
 #endif /* CELOGIN_POWERVM_TARGET */
 
+// Fills out the user fields of an ACF that has already been validated and
+// parsed by validateAndParseAcfV2
+static CeLoginRc
+    getAcfUserFieldsFromJson(const CeLoginJsonData& jsonDataParm,
+                             const uint64_t expirationTimeParm,
+                             CeLogin::AcfUserFields& userFieldsParm)
+{
+    CeLoginRc sRc = CeLoginRc::Success;
+
+    userFieldsParm.mVersion = jsonDataParm.mVersion;
+    userFieldsParm.mType = jsonDataParm.mType;
+    userFieldsParm.mExpirationTime = expirationTimeParm;
+
+    if (CeLogin::AcfType_AdminReset == jsonDataParm.mType)
+    {
+        if (jsonDataParm.mAdminAuthCode.mLength == 0 ||
+            jsonDataParm.mAdminAuthCode.mLength >= CeLogin::AdminAuthCodeMaxLen)
+        {
+            sRc = CeLoginRc::Failure;
+        }
+        else
+        {
+            // Reconstruct the ASCII version from hex
+            sRc = CeLogin::getJsonFieldFromHex(
+                jsonDataParm, jsonDataParm.mAdminAuthCode,
+                (uint8_t*)userFieldsParm.mTypeSpecificFields
+                    .mAdminResetFields.mAdminAuthCode,
+                CeLogin::AdminAuthCodeMaxLen,
+                userFieldsParm.mTypeSpecificFields.mAdminResetFields
+                    .mAdminAuthCodeLength);
+        }
+    }
+    else if (CeLogin::AcfType_ResourceDump == jsonDataParm.mType)
+    {
+        uint64_t& sLength = userFieldsParm.mTypeSpecificFields
+                                .mResourceDumpFields.mResourceDumpLength;
+        sRc = CeLogin::getJsonFieldFromBase64(
+            jsonDataParm, jsonDataParm.mAsciiScriptFile,
+            (uint8_t*)userFieldsParm.mTypeSpecificFields.mResourceDumpFields
+                .mResourceDump,
+            CeLogin::MaxAsciiScriptFileLength, sLength);
+        if (CeLoginRc::Success == sRc && 0 == sLength)
+        {
+            sRc = CeLoginRc::Failure;
+        }
+        else if (CeLoginRc::Success == sRc)
+        {
+            userFieldsParm.mTypeSpecificFields.mResourceDumpFields.mAuth =
+                jsonDataParm.mRequestedAuthority;
+        }
+    }
+    else if (CeLogin::AcfType_BmcShell == jsonDataParm.mType)
+    {
+        uint64_t& sLength =
+            userFieldsParm.mTypeSpecificFields.mBmcShellFields.mBmcShellLength;
+        sRc = CeLogin::getJsonFieldFromBase64(
+            jsonDataParm, jsonDataParm.mAsciiScriptFile,
+            (uint8_t*)userFieldsParm.mTypeSpecificFields.mBmcShellFields
+                .mBmcShell,
+            CeLogin::MaxAsciiScriptFileLength, sLength);
+        if (CeLoginRc::Success == sRc && 0 == sLength)
+        {
+            sRc = CeLoginRc::Failure;
+        }
+        else if (CeLoginRc::Success == sRc)
+        {
+            userFieldsParm.mTypeSpecificFields.mBmcShellFields.mBmcTimeout =
+                jsonDataParm.mBmcTimeout;
+            userFieldsParm.mTypeSpecificFields.mBmcShellFields.mIssueBmcDump =
+                jsonDataParm.mIssueBmcDump;
+        }
+    }
+    else if (CeLogin::AcfType_Service == jsonDataParm.mType)
+    {
+        userFieldsParm.mTypeSpecificFields.mServiceFields.mAuth =
+            jsonDataParm.mRequestedAuthority;
+    }
+
+    return sRc;
+}
+
+// Same as getAcfUserFieldsFromJson, but leaves the encoded admin auth code or
+// script in the JSON for the caller to decode
+static CeLoginRc
+    getAcfUserFieldsViewFromJson(const CeLoginJsonData& jsonDataParm,
+                                 const uint64_t expirationTimeParm,
+                                 CeLogin::AcfUserFieldsView& userFieldsParm)
+{
+    CeLoginRc sRc = CeLoginRc::Success;
+
+    userFieldsParm.mVersion = jsonDataParm.mVersion;
+    userFieldsParm.mType = jsonDataParm.mType;
+    userFieldsParm.mExpirationTime = expirationTimeParm;
+
+    if (CeLogin::AcfType_Service == jsonDataParm.mType ||
+        CeLogin::AcfType_ResourceDump == jsonDataParm.mType)
+    {
+        userFieldsParm.mAuth = jsonDataParm.mRequestedAuthority;
+    }
+
+    const CeLogin::JsonFieldLocation* sField = NULL;
+    if (CeLogin::AcfType_AdminReset == jsonDataParm.mType)
+    {
+        sField = &jsonDataParm.mAdminAuthCode;
+    }
+    else if (CeLogin::AcfType_ResourceDump == jsonDataParm.mType ||
+             CeLogin::AcfType_BmcShell == jsonDataParm.mType)
+    {
+        sField = &jsonDataParm.mAsciiScriptFile;
+    }
+
+    if (sField && 0 == sField->mLength)
+    {
+        sRc = CeLoginRc::Failure;
+    }
+    else if (sField)
+    {
+        userFieldsParm.mEncodedField.mData =
+            CeLogin::getJsonFieldData(jsonDataParm, *sField);
+        userFieldsParm.mEncodedField.mLength = sField->mLength;
+    }
+
+    if (CeLogin::AcfType_BmcShell == jsonDataParm.mType)
+    {
+        userFieldsParm.mBmcTimeout = jsonDataParm.mBmcTimeout;
+        userFieldsParm.mIssueBmcDump = jsonDataParm.mIssueBmcDump;
+    }
+
+    return sRc;
+}
+
+uint64_t CeLogin::getAcfUserFieldDecodedSize(
+    const AcfUserFieldsView& userFieldsParm)
+{
+    uint64_t sSize = 0;
+    if (CeLogin::AcfType_AdminReset == userFieldsParm.mType)
+    {
+        sSize = userFieldsParm.mEncodedField.mLength / 2;
+    }
+    else if (CeLogin::AcfType_ResourceDump == userFieldsParm.mType ||
+             CeLogin::AcfType_BmcShell == userFieldsParm.mType)
+    {
+        sSize = userFieldsParm.mEncodedField.mLength / 4 * 3;
+    }
+    return sSize;
+}
+
+CeLoginRc CeLogin::decodeAcfUserField(const AcfUserFieldsView& userFieldsParm,
+                                      char* outputParm,
+                                      const uint64_t outputSizeParm,
+                                      uint64_t& outputLengthParm)
+{
+    CeLoginRc sRc = CeLoginRc::Success;
+    outputLengthParm = 0;
+
+    if (CeLogin::AcfType_AdminReset != userFieldsParm.mType &&
+        CeLogin::AcfType_ResourceDump != userFieldsParm.mType &&
+        CeLogin::AcfType_BmcShell != userFieldsParm.mType)
+    {
+        sRc = CeLoginRc::UnsupportedAcfType;
+    }
+    else if (!outputParm || !userFieldsParm.mEncodedField.mData)
+    {
+        sRc = CeLoginRc::Failure;
+    }
+    else if (CeLogin::AcfType_AdminReset == userFieldsParm.mType)
+    {
+        sRc = CeLogin::getBinaryFromHex(userFieldsParm.mEncodedField.mData,
+                                        userFieldsParm.mEncodedField.mLength,
+                                        (uint8_t*)outputParm, outputSizeParm,
+                                        outputLengthParm);
+    }
+    else
+    {
+        size_t sDecodedLength = 0;
+        sRc = CeLogin::base64Decode(userFieldsParm.mEncodedField.mData,
+                                    userFieldsParm.mEncodedField.mLength,
+                                    (uint8_t*)outputParm, outputSizeParm,
+                                    sDecodedLength);
+        if (CeLoginRc::Success == sRc)
+        {
+            outputLengthParm = sDecodedLength;
+        }
+    }
+
+    return sRc;
+}
+
+// Exactly one of userFieldsParm and userFieldsViewParm is populated, the
+// other is NULL
+// Hash a password for a password check, asking the control whether to go on
+// if there is one
+static CeLoginRc hashPassword(const char* passwordParm,
+                              const uint64_t passwordLengthParm,
+                              const uint8_t* saltParm,
+                              const uint64_t saltLengthParm,
+                              const uint64_t iterationsParm,
+                              uint8_t* outputHashParm,
+                              const uint64_t outputHashSizeParm,
+                              const uint64_t requestedOutputLengthParm,
+                              const CeLogin::PasswordHashControl* controlParm)
+{
+    if (!controlParm)
+    {
+        return CeLogin::createPasswordHash(
+            passwordParm, passwordLengthParm, saltParm, saltLengthParm,
+            iterationsParm, outputHashParm, outputHashSizeParm,
+            requestedOutputLengthParm);
+    }
+
+    CeLogin::PasswordHashRequest sRequest;
+    sRequest.mPassword = passwordParm;
+    sRequest.mPasswordLength = passwordLengthParm;
+    sRequest.mSalt = saltParm;
+    sRequest.mSaltLength = saltLengthParm;
+    sRequest.mIterations = iterationsParm;
+    sRequest.mOutputHash = outputHashParm;
+    sRequest.mOutputHashSize = outputHashSizeParm;
+    sRequest.mRequestedOutputLength = requestedOutputLengthParm;
+    CeLogin::createPasswordHashes(&sRequest, 1, controlParm);
+    return sRequest.mRc;
+}
+
 static CeLoginRc checkAuthorizationAndGetAcfUserFieldsV2Internal(
     const uint8_t* accessControlFileParm,
     const uint64_t accessControlFileLengthParm, const char* passwordParm,
     const uint64_t passwordLengthParm,
     const uint64_t timeSinceUnixEpochInSecondsParm,
     const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    CeLogin::CeLoginVerifier* verifierParm, uint64_t& keyIndexParm,
     const char* serialNumberParm, const uint64_t serialNumberLengthParm,
     bool& replayIdPresentParm, uint64_t& acfReplayIdParm,
-    CeLogin::AcfUserFields& userFieldsParm)
+    CeLogin::AcfUserFields* userFieldsParm,
+    CeLogin::AcfUserFieldsView* userFieldsViewParm,
+    const CeLogin::PasswordHashControl* controlParm)
 {
     CeLoginRc sRc = CeLoginRc::Success;
+#ifndef CELOGIN_NO_HEAP
+    CeLogin::CallArena sCallArena(accessControlFileLengthParm);
+#endif
 
-    userFieldsParm.clear();
+    if (userFieldsParm)
+    {
+        userFieldsParm->clear();
+    }
+    if (userFieldsViewParm)
+    {
+        userFieldsViewParm->clear();
+    }
     replayIdPresentParm = false;
     acfReplayIdParm = 0;
 
-    CeLoginJsonData* sJsonData = NULL;
+    CeLoginJsonData sJsonData;
 
     if (!accessControlFileParm)
     {
@@ -376,11 +784,11 @@ static CeLoginRc checkAuthorizationAndGetAcfUserFieldsV2Internal(
     {
         sRc = CeLoginRc::GetSevAuth_InvalidAcfLength;
     }
-    else if (!publicKeyParm)
+    else if (!publicKeyParm && !hasVerifierKeys(verifierParm))
     {
         sRc = CeLoginRc::GetSevAuth_InvalidPublicKeyPtr;
     }
-    else if (0 == publicKeyLengthParm)
+    else if (0 == publicKeyLengthParm && !verifierParm)
     {
         sRc = CeLoginRc::GetSevAuth_InvalidPublicKeyLength;
     }
@@ -394,20 +802,6 @@ static CeLoginRc checkAuthorizationAndGetAcfUserFieldsV2Internal(
     }
     // No check for PW parms; may or may not be required.
 
-    // Allocate on heap to avoid blowing the stack
-    if (CeLoginRc::Success == sRc)
-    {
-        sJsonData = (CeLoginJsonData*)OPENSSL_malloc(sizeof(CeLoginJsonData));
-        if (sJsonData)
-        {
-            new (sJsonData) CeLoginJsonData();
-        }
-        else
-        {
-            sRc = CeLoginRc::JsonDataAllocationFailure;
-        }
-    }
-
     // Stack copy to store the parsed expiration time into. Only pass back
     // the value if the authority has validated as CE or Dev.
     uint64_t sExpirationTime = 0;
@@ -415,17 +809,17 @@ static CeLoginRc checkAuthorizationAndGetAcfUserFieldsV2Internal(
     if (CeLoginRc::Success == sRc)
     {
         sRc = validateAndParseAcfV2(
-            accessControlFileParm, accessControlFileLengthParm,
+            accessControlFileParm, accessControlFileLengthParm, NULL,
             timeSinceUnixEpochInSecondsParm, publicKeyParm, publicKeyLengthParm,
-            serialNumberParm, serialNumberLengthParm, *sJsonData,
-            sExpirationTime);
+            verifierParm, keyIndexParm, serialNumberParm,
+            serialNumberLengthParm, sJsonData, sExpirationTime);
     }
 
     // This interface only supports V1 and V2
     if (CeLoginRc::Success == sRc)
     {
-        if (CeLogin::CeLoginVersion1 != sJsonData->mVersion &&
-            CeLogin::CeLoginVersion2 != sJsonData->mVersion)
+        if (CeLogin::CeLoginVersion1 != sJsonData.mVersion &&
+            CeLogin::CeLoginVersion2 != sJsonData.mVersion)
         {
             CE_LOG_DEBUG("Unsupported version");
             sRc = CeLoginRc::UnsupportedVersion;
@@ -434,7 +828,7 @@ static CeLoginRc checkAuthorizationAndGetAcfUserFieldsV2Internal(
 
     // Need to verify the password for service ACF
     if (CeLoginRc::Success == sRc &&
-        CeLogin::AcfType_Service == sJsonData->mType)
+        CeLogin::AcfType_Service == sJsonData.mType)
     {
         if (!passwordParm)
         {
@@ -446,23 +840,38 @@ static CeLoginRc checkAuthorizationAndGetAcfUserFieldsV2Internal(
         }
 
         uint8_t sGeneratedAuthCode[CeLogin::CeLogin_MaxHashedAuthCodeLength];
+        uint8_t sHashedAuthCode[CeLogin::CeLogin_MaxHashedAuthCodeLength];
+        uint64_t sHashedAuthCodeLength = 0;
+        uint8_t sAuthCodeSalt[CeLogin::CeLogin_MaxHashedAuthCodeSaltLength];
+        uint64_t sAuthCodeSaltLength = 0;
+
+        if (CeLoginRc::Success == sRc)
+        {
+            sRc = CeLogin::getJsonFieldFromHex(
+                sJsonData, sJsonData.mHashedAuthCode, sHashedAuthCode,
+                sizeof(sHashedAuthCode), sHashedAuthCodeLength);
+        }
+        if (CeLoginRc::Success == sRc)
+        {
+            sRc = CeLogin::getJsonFieldFromHex(
+                sJsonData, sJsonData.mAuthCodeSalt, sAuthCodeSalt,
+                sizeof(sAuthCodeSalt), sAuthCodeSaltLength);
+        }
 
         // Hash the provided ACF password
         if (CeLoginRc::Success == sRc)
         {
-            sRc = CeLogin::createPasswordHash(
-                passwordParm, passwordLengthParm, sJsonData->mAuthCodeSalt,
-                sJsonData->mAuthCodeSaltLength, sJsonData->mIterations,
-                sGeneratedAuthCode, sizeof(sGeneratedAuthCode),
-                sJsonData->mHashedAuthCodeLength);
+            sRc = hashPassword(passwordParm, passwordLengthParm, sAuthCodeSalt,
+                               sAuthCodeSaltLength, sJsonData.mIterations,
+                               sGeneratedAuthCode, sizeof(sGeneratedAuthCode),
+                               sHashedAuthCodeLength, controlParm);
         }
 
         // Verify password hash matches the ACF hashed auth code
         if (CeLoginRc::Success == sRc)
         {
-            if (0 != CRYPTO_memcmp(sGeneratedAuthCode,
-                                   sJsonData->mHashedAuthCode,
-                                   sJsonData->mHashedAuthCodeLength))
+            if (0 != CRYPTO_memcmp(sGeneratedAuthCode, sHashedAuthCode,
+                                   sHashedAuthCodeLength))
             {
                 sRc = CeLoginRc::PasswordNotValid;
             }
@@ -471,103 +880,39 @@ static CeLoginRc checkAuthorizationAndGetAcfUserFieldsV2Internal(
 
     if (CeLoginRc::Success == sRc)
     {
-        userFieldsParm.mVersion = sJsonData->mVersion;
-        userFieldsParm.mType = sJsonData->mType;
-        userFieldsParm.mExpirationTime = sExpirationTime;
-
-        if (sJsonData->mReplayInfo.mReplayIdPresent)
+        if (sJsonData.mReplayInfo.mReplayIdPresent)
         {
             replayIdPresentParm = true;
-            acfReplayIdParm = sJsonData->mReplayInfo.mReplayId;
+            acfReplayIdParm = sJsonData.mReplayInfo.mReplayId;
         }
 
-        if (CeLogin::AcfType_AdminReset == sJsonData->mType)
+        if (userFieldsParm)
         {
-            if (sJsonData->mAdminAuthCodeLength == 0 ||
-                sJsonData->mAdminAuthCodeLength >= CeLogin::AdminAuthCodeMaxLen)
-            {
-                sRc = CeLoginRc::Failure;
-            }
-            else
-            {
-                // Reconstruct the ASCII version from hex
-                sRc = CeLogin::getBinaryFromHex(
-                    (const char*)sJsonData->mAdminAuthCode,
-                    sJsonData->mAdminAuthCodeLength,
-                    (uint8_t*)userFieldsParm.mTypeSpecificFields
-                        .mAdminResetFields.mAdminAuthCode,
-                    CeLogin::AdminAuthCodeMaxLen,
-                    userFieldsParm.mTypeSpecificFields.mAdminResetFields
-                        .mAdminAuthCodeLength);
-            }
+            sRc = getAcfUserFieldsFromJson(sJsonData, sExpirationTime,
+                                           *userFieldsParm);
         }
-        else if (CeLogin::AcfType_ResourceDump == sJsonData->mType)
+        else
         {
-            if (sJsonData->mAsciiScriptFileLength == 0 ||
-                sJsonData->mAsciiScriptFileLength >
-                    CeLogin::MaxAsciiScriptFileLength)
-            {
-                sRc = CeLoginRc::Failure;
-            }
-            else
-            {
-                memcpy(userFieldsParm.mTypeSpecificFields.mResourceDumpFields
-                           .mResourceDump,
-                       sJsonData->mAsciiScriptFile,
-                       sJsonData->mAsciiScriptFileLength);
-                userFieldsParm.mTypeSpecificFields.mResourceDumpFields
-                    .mResourceDumpLength = sJsonData->mAsciiScriptFileLength;
-                userFieldsParm.mTypeSpecificFields.mResourceDumpFields.mAuth =
-                    sJsonData->mRequestedAuthority;
-            }
-        }
-        else if (CeLogin::AcfType_BmcShell == sJsonData->mType)
-        {
-            if (sJsonData->mAsciiScriptFileLength == 0 ||
-                sJsonData->mAsciiScriptFileLength >
-                    CeLogin::MaxAsciiScriptFileLength)
-            {
-                sRc = CeLoginRc::Failure;
-            }
-            else
-            {
-                memcpy(userFieldsParm.mTypeSpecificFields.mBmcShellFields
-                           .mBmcShell,
-                       sJsonData->mAsciiScriptFile,
-                       sJsonData->mAsciiScriptFileLength);
-                userFieldsParm.mTypeSpecificFields.mBmcShellFields
-                    .mBmcShellLength = sJsonData->mAsciiScriptFileLength;
-                userFieldsParm.mTypeSpecificFields.mBmcShellFields.mBmcTimeout =
-                    sJsonData->mBmcTimeout;
-                userFieldsParm.mTypeSpecificFields.mBmcShellFields
-                    .mIssueBmcDump = sJsonData->mIssueBmcDump;
-            }
-        }
-        else if (CeLogin::AcfType_Service == sJsonData->mType)
-        {
-            userFieldsParm.mTypeSpecificFields.mServiceFields.mAuth =
-                sJsonData->mRequestedAuthority;
+            sRc = getAcfUserFieldsViewFromJson(sJsonData, sExpirationTime,
+                                               *userFieldsViewParm);
         }
     }
 
-    if (sJsonData)
-    {
-        sJsonData->~CeLoginJsonData();
-        OPENSSL_free(sJsonData);
-    }
-
     return sRc;
 }
 
 #ifndef CELOGIN_POWERVM_TARGET
-CeLoginRc CeLogin::checkAuthorizationAndGetAcfUserFieldsV2(
+static CeLoginRc checkAuthorizationAndGetAcfUserFieldsV2ForBmc(
     const uint8_t* accessControlFileParm,
     const uint64_t accessControlFileLengthParm, const char* passwordParm,
     const uint64_t passwordLengthParm,
     const uint64_t timeSinceUnixEpochInSecondsParm,
     const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    CeLogin::CeLoginVerifier* verifierParm, uint64_t& keyIndexParm,
     const char* serialNumberParm, const uint64_t serialNumberLengthParm,
-    const uint64_t currentReplayIdParm, AcfUserFields& userFieldsParm)
+    const uint64_t currentReplayIdParm, CeLogin::AcfUserFields* userFieldsParm,
+    CeLogin::AcfUserFieldsView* userFieldsViewParm,
+    const CeLogin::PasswordHashControl* controlParm)
 {
     bool sHasReplayId = false;
     uint64_t sAcfReplayId = 0;
@@ -575,8 +920,9 @@ CeLoginRc CeLogin::checkAuthorizationAndGetAcfUserFieldsV2(
     CeLoginRc sRc = checkAuthorizationAndGetAcfUserFieldsV2Internal(
         accessControlFileParm, accessControlFileLengthParm, passwordParm,
         passwordLengthParm, timeSinceUnixEpochInSecondsParm, publicKeyParm,
-        publicKeyLengthParm, serialNumberParm, serialNumberLengthParm,
-        sHasReplayId, sAcfReplayId, userFieldsParm);
+        publicKeyLengthParm, verifierParm, keyIndexParm, serialNumberParm,
+        serialNumberLengthParm, sHasReplayId, sAcfReplayId, userFieldsParm,
+        userFieldsViewParm, controlParm);
 
     if (CeLoginRc::Success == sRc && sHasReplayId)
     {
@@ -593,8 +939,121 @@ CeLoginRc CeLogin::checkAuthorizationAndGetAcfUserFieldsV2(
 
     return sRc;
 }
+
+#ifndef CELOGIN_NO_HEAP
+CeLoginRc CeLogin::checkAuthorizationAndGetAcfUserFieldsV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm, const char* passwordParm,
+    const uint64_t passwordLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    const uint64_t currentReplayIdParm, AcfUserFields& userFieldsParm)
+{
+    uint64_t sKeyIndex = 0;
+
+    return checkAuthorizationAndGetAcfUserFieldsV2ForBmc(
+        accessControlFileParm, accessControlFileLengthParm, passwordParm,
+        passwordLengthParm, timeSinceUnixEpochInSecondsParm, publicKeyParm,
+        publicKeyLengthParm, NULL, sKeyIndex, serialNumberParm,
+        serialNumberLengthParm, currentReplayIdParm, &userFieldsParm, NULL,
+        NULL);
+}
+
+CeLoginRc CeLogin::checkAuthorizationAndGetAcfUserFieldsV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm, const char* passwordParm,
+    const uint64_t passwordLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm, EVP_PKEY* publicKeyParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    const uint64_t currentReplayIdParm, AcfUserFields& userFieldsParm)
+{
+    uint64_t sKeyIndex = 0;
+    CeLoginVerifier sVerifier;
+    CeLoginRc sRc = sVerifier.setPublicKeys(&publicKeyParm, 1);
+
+    if (CeLoginRc::Success == sRc)
+    {
+        sRc = checkAuthorizationAndGetAcfUserFieldsV2ForBmc(
+            accessControlFileParm, accessControlFileLengthParm, passwordParm,
+            passwordLengthParm, timeSinceUnixEpochInSecondsParm, NULL, 0,
+            &sVerifier, sKeyIndex, serialNumberParm, serialNumberLengthParm,
+            currentReplayIdParm, &userFieldsParm, NULL, NULL);
+    }
+
+    return sRc;
+}
+
+CeLoginRc CeLogin::checkAuthorizationAndGetAcfUserFieldsV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm, const char* passwordParm,
+    const uint64_t passwordLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm, EVP_PKEY* publicKeyParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    const uint64_t currentReplayIdParm, AcfUserFields& userFieldsParm,
+    const PasswordHashControl& controlParm)
+{
+    uint64_t sKeyIndex = 0;
+    CeLoginVerifier sVerifier;
+    CeLoginRc sRc = sVerifier.setPublicKeys(&publicKeyParm, 1);
+
+    if (CeLoginRc::Success == sRc)
+    {
+        sRc = checkAuthorizationAndGetAcfUserFieldsV2ForBmc(
+            accessControlFileParm, accessControlFileLengthParm, passwordParm,
+            passwordLengthParm, timeSinceUnixEpochInSecondsParm, NULL, 0,
+            &sVerifier, sKeyIndex, serialNumberParm, serialNumberLengthParm,
+            currentReplayIdParm, &userFieldsParm, NULL, &controlParm);
+    }
+
+    return sRc;
+}
+
+CeLoginRc CeLogin::checkAuthorizationAndGetAcfUserFieldsViewV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm, const char* passwordParm,
+    const uint64_t passwordLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    const uint64_t currentReplayIdParm, AcfUserFieldsView& userFieldsParm)
+{
+    uint64_t sKeyIndex = 0;
+
+    return checkAuthorizationAndGetAcfUserFieldsV2ForBmc(
+        accessControlFileParm, accessControlFileLengthParm, passwordParm,
+        passwordLengthParm, timeSinceUnixEpochInSecondsParm, publicKeyParm,
+        publicKeyLengthParm, NULL, sKeyIndex, serialNumberParm,
+        serialNumberLengthParm, currentReplayIdParm, NULL, &userFieldsParm,
+        NULL);
+}
+
+CeLoginRc CeLogin::checkAuthorizationAndGetAcfUserFieldsViewV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm, const char* passwordParm,
+    const uint64_t passwordLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm, EVP_PKEY* publicKeyParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    const uint64_t currentReplayIdParm, AcfUserFieldsView& userFieldsParm)
+{
+    uint64_t sKeyIndex = 0;
+    CeLoginVerifier sVerifier;
+    CeLoginRc sRc = sVerifier.setPublicKeys(&publicKeyParm, 1);
+
+    if (CeLoginRc::Success == sRc)
+    {
+        sRc = checkAuthorizationAndGetAcfUserFieldsV2ForBmc(
+            accessControlFileParm, accessControlFileLengthParm, passwordParm,
+            passwordLengthParm, timeSinceUnixEpochInSecondsParm, NULL, 0,
+            &sVerifier, sKeyIndex, serialNumberParm, serialNumberLengthParm,
+            currentReplayIdParm, NULL, &userFieldsParm, NULL);
+    }
+
+    return sRc;
+}
+#endif /* CELOGIN_NO_HEAP */
 #else
-CeLoginRc CeLogin::checkAuthorizationAndGetAcfUserFieldsV2ForPowerVM(
+static CeLoginRc checkAuthorizationAndGetAcfUserFieldsV2ForPowerVMInternal(
     const uint8_t* accessControlFileParm,
     const uint64_t accessControlFileLengthParm, const char* passwordParm,
     const uint64_t passwordLengthParm,
@@ -603,16 +1062,18 @@ CeLoginRc CeLogin::checkAuthorizationAndGetAcfUserFieldsV2ForPowerVM(
     const char* serialNumberParm, const uint64_t serialNumberLengthParm,
     const uint64_t currentReplayIdParm, uint64_t& updatedReplayIdParm,
     const bool failValidationIfReplayIdPresentParm,
-    AcfUserFields& userFieldsParm)
+    CeLogin::AcfUserFields& userFieldsParm)
 {
+    uint64_t sKeyIndex = 0;
     bool sHasReplayId = false;
     uint64_t sAcfReplayId = 0;
 
     CeLoginRc sRc = checkAuthorizationAndGetAcfUserFieldsV2Internal(
         accessControlFileParm, accessControlFileLengthParm, passwordParm,
         passwordLengthParm, timeSinceUnixEpochInSecondsParm, publicKeyParm,
-        publicKeyLengthParm, serialNumberParm, serialNumberLengthParm,
-        sHasReplayId, sAcfReplayId, userFieldsParm);
+        publicKeyLengthParm, NULL, sKeyIndex, serialNumberParm,
+        serialNumberLengthParm, sHasReplayId, sAcfReplayId, &userFieldsParm,
+        NULL, NULL);
 
     // Verify Replay ID
     if (CeLoginRc::Success == sRc)
@@ -631,4 +1092,653 @@ CeLoginRc CeLogin::checkAuthorizationAndGetAcfUserFieldsV2ForPowerVM(
 
     return sRc;
 }
+
+#ifndef CELOGIN_NO_HEAP
+CeLoginRc CeLogin::checkAuthorizationAndGetAcfUserFieldsV2ForPowerVM(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm, const char* passwordParm,
+    const uint64_t passwordLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    const uint64_t currentReplayIdParm, uint64_t& updatedReplayIdParm,
+    const bool failValidationIfReplayIdPresentParm,
+    AcfUserFields& userFieldsParm)
+{
+    return checkAuthorizationAndGetAcfUserFieldsV2ForPowerVMInternal(
+        accessControlFileParm, accessControlFileLengthParm, passwordParm,
+        passwordLengthParm, timeSinceUnixEpochInSecondsParm, publicKeyParm,
+        publicKeyLengthParm, serialNumberParm, serialNumberLengthParm,
+        currentReplayIdParm, updatedReplayIdParm,
+        failValidationIfReplayIdPresentParm, userFieldsParm);
+}
+#endif /* CELOGIN_NO_HEAP */
+#endif /* CELOGIN_POWERVM_TARGET */
+
+#ifndef CELOGIN_POWERVM_TARGET
+static_assert((int)CeLogin::AcfAuthRecordMaxHashedAuthCodeLength ==
+                  (int)CeLogin::CeLogin_MaxHashedAuthCodeLength,
+              "AcfAuthRecord hashed auth code size mismatch");
+static_assert((int)CeLogin::AcfAuthRecordMaxSaltLength ==
+                  (int)CeLogin::CeLogin_MaxHashedAuthCodeSaltLength,
+              "AcfAuthRecord salt size mismatch");
+
+static CeLoginRc getAcfAuthRecordV2Internal(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    CeLogin::CeLoginVerifier* verifierParm, uint64_t& keyIndexParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    CeLogin::AcfAuthRecord& recordParm)
+{
+    CeLoginRc sRc = CeLoginRc::Success;
+#ifndef CELOGIN_NO_HEAP
+    CeLogin::CallArena sCallArena(accessControlFileLengthParm);
+#endif
+    CeLoginJsonData sJsonData;
+
+    recordParm.clear();
+
+    uint64_t sExpirationTime = 0;
+
+    // Parameter checks are handled by the common helper
+    if (CeLoginRc::Success == sRc)
+    {
+        sRc = validateAndParseAcfV2(
+            accessControlFileParm, accessControlFileLengthParm, NULL,
+            timeSinceUnixEpochInSecondsParm, publicKeyParm, publicKeyLengthParm,
+            verifierParm, keyIndexParm, serialNumberParm,
+            serialNumberLengthParm, sJsonData, sExpirationTime);
+    }
+
+    // This interface only supports V1 and V2
+    if (CeLoginRc::Success == sRc)
+    {
+        if (CeLogin::CeLoginVersion1 != sJsonData.mVersion &&
+            CeLogin::CeLoginVersion2 != sJsonData.mVersion)
+        {
+            CE_LOG_DEBUG("Unsupported version");
+            sRc = CeLoginRc::UnsupportedVersion;
+        }
+    }
+
+    // Only a service ACF is authenticated with a password
+    if (CeLoginRc::Success == sRc)
+    {
+        if (CeLogin::AcfType_Service != sJsonData.mType)
+        {
+            CE_LOG_DEBUG("Auth record requires a service ACF");
+            sRc = CeLoginRc::UnsupportedAcfType;
+        }
+    }
+
+    if (CeLoginRc::Success == sRc)
+    {
+        recordParm.mVersion = sJsonData.mVersion;
+        recordParm.mType = sJsonData.mType;
+        recordParm.mAuth = sJsonData.mRequestedAuthority;
+        recordParm.mExpirationTime = sExpirationTime;
+        recordParm.mReplayIdPresent = sJsonData.mReplayInfo.mReplayIdPresent;
+        recordParm.mReplayId = sJsonData.mReplayInfo.mReplayId;
+        recordParm.mIterations = sJsonData.mIterations;
+
+        sRc = CeLogin::getJsonFieldFromHex(
+            sJsonData, sJsonData.mHashedAuthCode, recordParm.mHashedAuthCode,
+            sizeof(recordParm.mHashedAuthCode),
+            recordParm.mHashedAuthCodeLength);
+    }
+
+    if (CeLoginRc::Success == sRc)
+    {
+        sRc = CeLogin::getJsonFieldFromHex(
+            sJsonData, sJsonData.mAuthCodeSalt, recordParm.mAuthCodeSalt,
+            sizeof(recordParm.mAuthCodeSalt), recordParm.mAuthCodeSaltLength);
+    }
+
+    if (CeLoginRc::Success != sRc)
+    {
+        recordParm.clear();
+    }
+
+    return sRc;
+}
+
+#ifndef CELOGIN_NO_HEAP
+CeLoginRc CeLogin::getAcfAuthRecordV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    AcfAuthRecord& recordParm)
+{
+    uint64_t sKeyIndex = 0;
+
+    return getAcfAuthRecordV2Internal(
+        accessControlFileParm, accessControlFileLengthParm,
+        timeSinceUnixEpochInSecondsParm, publicKeyParm, publicKeyLengthParm,
+        NULL, sKeyIndex, serialNumberParm, serialNumberLengthParm, recordParm);
+}
+
+CeLoginRc CeLogin::getAcfAuthRecordV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm, EVP_PKEY* publicKeyParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    AcfAuthRecord& recordParm)
+{
+    uint64_t sKeyIndex = 0;
+    CeLoginVerifier sVerifier;
+    CeLoginRc sRc = sVerifier.setPublicKeys(&publicKeyParm, 1);
+
+    if (CeLoginRc::Success == sRc)
+    {
+        sRc = getAcfAuthRecordV2Internal(
+            accessControlFileParm, accessControlFileLengthParm,
+            timeSinceUnixEpochInSecondsParm, NULL, 0, &sVerifier, sKeyIndex,
+            serialNumberParm, serialNumberLengthParm, recordParm);
+    }
+
+    return sRc;
+}
+
+CeLoginRc CeLogin::getAcfAuthRecordV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    EVP_PKEY* const* publicKeysParm, const uint64_t publicKeyCountParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    AcfAuthRecord& recordParm, uint64_t& keyIndexParm)
+{
+    CeLoginVerifier sVerifier;
+    CeLoginRc sRc = sVerifier.setPublicKeys(publicKeysParm, publicKeyCountParm);
+    keyIndexParm = publicKeyCountParm;
+
+    if (CeLoginRc::Success == sRc)
+    {
+        sRc = getAcfAuthRecordV2Internal(
+            accessControlFileParm, accessControlFileLengthParm,
+            timeSinceUnixEpochInSecondsParm, NULL, 0, &sVerifier, keyIndexParm,
+            serialNumberParm, serialNumberLengthParm, recordParm);
+    }
+
+    return sRc;
+}
+
+CeLoginRc CeLogin::getAcfAuthRecordV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    CeLoginVerifier& verifierParm, const char* serialNumberParm,
+    const uint64_t serialNumberLengthParm, AcfAuthRecord& recordParm,
+    uint64_t& keyIndexParm)
+{
+    keyIndexParm = verifierParm.getPublicKeyCount();
+
+    return getAcfAuthRecordV2Internal(
+        accessControlFileParm, accessControlFileLengthParm,
+        timeSinceUnixEpochInSecondsParm, NULL, 0, &verifierParm, keyIndexParm,
+        serialNumberParm, serialNumberLengthParm, recordParm);
+}
+#endif /* CELOGIN_NO_HEAP */
+
+static CeLoginRc getAcfVerifiedRecordV2Internal(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    CeLogin::CeLoginVerifier* verifierParm, uint64_t& keyIndexParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    const uint64_t currentReplayIdParm, CeLogin::AcfVerifiedRecord& recordParm)
+{
+    CeLoginRc sRc = CeLoginRc::Success;
+#ifndef CELOGIN_NO_HEAP
+    CeLogin::CallArena sCallArena(accessControlFileLengthParm);
+#endif
+    CeLoginJsonData sJsonData;
+
+    recordParm.clear();
+
+    uint64_t sExpirationTime = 0;
+
+    // Parameter checks are handled by the common helper
+    if (CeLoginRc::Success == sRc)
+    {
+        sRc = validateAndParseAcfV2(
+            accessControlFileParm, accessControlFileLengthParm, NULL,
+            timeSinceUnixEpochInSecondsParm, publicKeyParm, publicKeyLengthParm,
+            verifierParm, keyIndexParm, serialNumberParm,
+            serialNumberLengthParm, sJsonData, sExpirationTime);
+    }
+
+    // This interface only supports V1 and V2
+    if (CeLoginRc::Success == sRc)
+    {
+        if (CeLogin::CeLoginVersion1 != sJsonData.mVersion &&
+            CeLogin::CeLoginVersion2 != sJsonData.mVersion)
+        {
+            CE_LOG_DEBUG("Unsupported version");
+            sRc = CeLoginRc::UnsupportedVersion;
+        }
+    }
+
+    // Same replay ID rules as verifyACFForBMCUploadV2
+    uint64_t sUpdatedReplayId = 0;
+    if (CeLoginRc::Success == sRc)
+    {
+        sRc = doFullReplayValidation(
+            sJsonData.mType, sJsonData.mReplayInfo.mReplayIdPresent,
+            currentReplayIdParm, sJsonData.mReplayInfo.mReplayId,
+            sUpdatedReplayId);
+    }
+
+    if (CeLoginRc::Success == sRc)
+    {
+        sRc = getAcfUserFieldsFromJson(sJsonData, sExpirationTime,
+                                       recordParm.mUserFields);
+    }
+
+    if (CeLoginRc::Success == sRc)
+    {
+        recordParm.mVersion = sJsonData.mVersion;
+        recordParm.mType = sJsonData.mType;
+        recordParm.mExpirationTime = sExpirationTime;
+        recordParm.mExpirationDate = sJsonData.mExpirationDate;
+        recordParm.mReplayIdPresent = sJsonData.mReplayInfo.mReplayIdPresent;
+        recordParm.mReplayId = sJsonData.mReplayInfo.mReplayId;
+        recordParm.mUpdatedReplayId = sUpdatedReplayId;
+    }
+    else
+    {
+        recordParm.clear();
+    }
+
+    return sRc;
+}
+
+#ifndef CELOGIN_NO_HEAP
+CeLoginRc CeLogin::getAcfVerifiedRecordV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    const uint64_t currentReplayIdParm, AcfVerifiedRecord& recordParm)
+{
+    uint64_t sKeyIndex = 0;
+
+    return getAcfVerifiedRecordV2Internal(
+        accessControlFileParm, accessControlFileLengthParm,
+        timeSinceUnixEpochInSecondsParm, publicKeyParm, publicKeyLengthParm,
+        NULL, sKeyIndex, serialNumberParm, serialNumberLengthParm,
+        currentReplayIdParm, recordParm);
+}
+
+CeLoginRc CeLogin::getAcfVerifiedRecordV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm, EVP_PKEY* publicKeyParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    const uint64_t currentReplayIdParm, AcfVerifiedRecord& recordParm)
+{
+    uint64_t sKeyIndex = 0;
+    CeLoginVerifier sVerifier;
+    CeLoginRc sRc = sVerifier.setPublicKeys(&publicKeyParm, 1);
+
+    if (CeLoginRc::Success == sRc)
+    {
+        sRc = getAcfVerifiedRecordV2Internal(
+            accessControlFileParm, accessControlFileLengthParm,
+            timeSinceUnixEpochInSecondsParm, NULL, 0, &sVerifier, sKeyIndex,
+            serialNumberParm, serialNumberLengthParm, currentReplayIdParm,
+            recordParm);
+    }
+
+    return sRc;
+}
+
+CeLoginRc CeLogin::getAcfVerifiedRecordV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    EVP_PKEY* const* publicKeysParm, const uint64_t publicKeyCountParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    const uint64_t currentReplayIdParm, AcfVerifiedRecord& recordParm,
+    uint64_t& keyIndexParm)
+{
+    CeLoginVerifier sVerifier;
+    CeLoginRc sRc = sVerifier.setPublicKeys(publicKeysParm, publicKeyCountParm);
+    keyIndexParm = publicKeyCountParm;
+
+    if (CeLoginRc::Success == sRc)
+    {
+        sRc = getAcfVerifiedRecordV2Internal(
+            accessControlFileParm, accessControlFileLengthParm,
+            timeSinceUnixEpochInSecondsParm, NULL, 0, &sVerifier, keyIndexParm,
+            serialNumberParm, serialNumberLengthParm, currentReplayIdParm,
+            recordParm);
+    }
+
+    return sRc;
+}
+
+CeLoginRc CeLogin::getAcfVerifiedRecordV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    CeLoginVerifier& verifierParm, const char* serialNumberParm,
+    const uint64_t serialNumberLengthParm, const uint64_t currentReplayIdParm,
+    AcfVerifiedRecord& recordParm, uint64_t& keyIndexParm)
+{
+    keyIndexParm = verifierParm.getPublicKeyCount();
+
+    return getAcfVerifiedRecordV2Internal(
+        accessControlFileParm, accessControlFileLengthParm,
+        timeSinceUnixEpochInSecondsParm, NULL, 0, &verifierParm, keyIndexParm,
+        serialNumberParm, serialNumberLengthParm, currentReplayIdParm,
+        recordParm);
+}
+#endif /* CELOGIN_NO_HEAP */
+
+static CeLoginRc checkAuthorizationWithAcfAuthRecordV2Internal(
+    const CeLogin::AcfAuthRecord& recordParm, const char* passwordParm,
+    const uint64_t passwordLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint64_t currentReplayIdParm, CeLogin::AcfUserFields& userFieldsParm,
+    const CeLogin::PasswordHashControl* controlParm)
+{
+    CeLoginRc sRc = CeLoginRc::Success;
+
+    userFieldsParm.clear();
+
+    if (CeLogin::CeLoginVersion1 != recordParm.mVersion &&
+        CeLogin::CeLoginVersion2 != recordParm.mVersion)
+    {
+        sRc = CeLoginRc::UnsupportedVersion;
+    }
+    else if (CeLogin::AcfType_Service != recordParm.mType)
+    {
+        sRc = CeLoginRc::UnsupportedAcfType;
+    }
+    else if (0 == recordParm.mHashedAuthCodeLength ||
+             recordParm.mHashedAuthCodeLength >
+                 sizeof(recordParm.mHashedAuthCode) ||
+             recordParm.mAuthCodeSaltLength > sizeof(recordParm.mAuthCodeSalt))
+    {
+        sRc = CeLoginRc::Failure;
+    }
+    else if (!passwordParm)
+    {
+        sRc = CeLoginRc::GetSevAuth_InvalidPasswordPtr;
+    }
+    else if (0 == passwordLengthParm)
+    {
+        sRc = CeLoginRc::GetSevAuth_InvalidPasswordLength;
+    }
+
+    // The signature was verified when the record was created, but time has
+    // moved on since then
+    if (CeLoginRc::Success == sRc)
+    {
+        if (timeSinceUnixEpochInSecondsParm > recordParm.mExpirationTime)
+        {
+            sRc = CeLoginRc::AcfExpired;
+        }
+    }
+
+    uint8_t sGeneratedAuthCode[CeLogin::CeLogin_MaxHashedAuthCodeLength];
+
+    // Hash the provided ACF password
+    if (CeLoginRc::Success == sRc)
+    {
+        sRc = hashPassword(passwordParm, passwordLengthParm,
+                           recordParm.mAuthCodeSalt,
+                           recordParm.mAuthCodeSaltLength,
+                           recordParm.mIterations, sGeneratedAuthCode,
+                           sizeof(sGeneratedAuthCode),
+                           recordParm.mHashedAuthCodeLength, controlParm);
+    }
+
+    // Verify password hash matches the ACF hashed auth code
+    if (CeLoginRc::Success == sRc)
+    {
+        if (0 != CRYPTO_memcmp(sGeneratedAuthCode, recordParm.mHashedAuthCode,
+                               recordParm.mHashedAuthCodeLength))
+        {
+            sRc = CeLoginRc::PasswordNotValid;
+        }
+    }
+
+    // Same exact match requirement as checkAuthorizationAndGetAcfUserFieldsV2
+    if (CeLoginRc::Success == sRc && recordParm.mReplayIdPresent)
+    {
+        if (recordParm.mReplayId != currentReplayIdParm)
+        {
+            CE_LOG_DEBUG("Replay ID mismatch");
+            sRc = CeLoginRc::ReplayIdPersistenceFailure;
+        }
+    }
+
+    if (CeLoginRc::Success == sRc)
+    {
+        userFieldsParm.mVersion = recordParm.mVersion;
+        userFieldsParm.mType = recordParm.mType;
+        userFieldsParm.mExpirationTime = recordParm.mExpirationTime;
+        userFieldsParm.mTypeSpecificFields.mServiceFields.mAuth =
+            recordParm.mAuth;
+    }
+
+    return sRc;
+}
+
+#ifndef CELOGIN_NO_HEAP
+CeLoginRc CeLogin::checkAuthorizationWithAcfAuthRecordV2(
+    const AcfAuthRecord& recordParm, const char* passwordParm,
+    const uint64_t passwordLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint64_t currentReplayIdParm, AcfUserFields& userFieldsParm)
+{
+    return checkAuthorizationWithAcfAuthRecordV2Internal(
+        recordParm, passwordParm, passwordLengthParm,
+        timeSinceUnixEpochInSecondsParm, currentReplayIdParm, userFieldsParm,
+        NULL);
+}
+
+CeLoginRc CeLogin::checkAuthorizationWithAcfAuthRecordV2(
+    const AcfAuthRecord& recordParm, const char* passwordParm,
+    const uint64_t passwordLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint64_t currentReplayIdParm, AcfUserFields& userFieldsParm,
+    const PasswordHashControl& controlParm)
+{
+    return checkAuthorizationWithAcfAuthRecordV2Internal(
+        recordParm, passwordParm, passwordLengthParm,
+        timeSinceUnixEpochInSecondsParm, currentReplayIdParm, userFieldsParm,
+        &controlParm);
+}
+#endif /* CELOGIN_NO_HEAP */
+#endif /* CELOGIN_POWERVM_TARGET */
+
+// An allocation that fails for want of space in the arena can surface as
+// almost any error, so the arena variants report it as such
+static CeLoginRc getArenaRc(const CeLogin::CeLoginArena& arenaParm,
+                            const CeLoginRc rcParm)
+{
+    return arenaParm.isExhausted() ? CeLoginRc(CeLoginRc::ArenaExhausted)
+                                   : rcParm;
+}
+
+CeLoginRc CeLogin::extractACFMetadataV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    AcfType& acfTypeParm, uint64_t& expirationTimeParm,
+    CeLogin_Date& expirationDateParm, AcfVersion& versionParm,
+    bool& hasReplayIdParm, CeLoginArena& arenaParm)
+{
+    uint64_t sKeyIndex = 0;
+    ArenaScope sScope(arenaParm);
+
+    return getArenaRc(
+        arenaParm,
+        extractACFMetadataV2Internal(
+            accessControlFileParm, accessControlFileLengthParm,
+            timeSinceUnixEpochInSecondsParm, publicKeyParm, publicKeyLengthParm,
+            NULL, sKeyIndex, serialNumberParm, serialNumberLengthParm,
+            acfTypeParm, expirationTimeParm, expirationDateParm, versionParm,
+            hasReplayIdParm));
+}
+
+#ifndef CELOGIN_POWERVM_TARGET
+CeLoginRc CeLogin::verifyACFForBMCUploadV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    const uint64_t currentReplayIdParm, uint64_t& updatedReplayIdParm,
+    AcfType& acfTypeParm, uint64_t& expirationTimeParm,
+    CeLoginArena& arenaParm)
+{
+    uint64_t sKeyIndex = 0;
+    ArenaScope sScope(arenaParm);
+
+    return getArenaRc(
+        arenaParm,
+        verifyACFForBMCUploadV2Internal(
+            accessControlFileParm, accessControlFileLengthParm, NULL,
+            timeSinceUnixEpochInSecondsParm, publicKeyParm, publicKeyLengthParm,
+            NULL, sKeyIndex, serialNumberParm, serialNumberLengthParm,
+            currentReplayIdParm, updatedReplayIdParm, acfTypeParm,
+            expirationTimeParm));
+}
+
+CeLoginRc CeLogin::checkAuthorizationAndGetAcfUserFieldsV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm, const char* passwordParm,
+    const uint64_t passwordLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    const uint64_t currentReplayIdParm, AcfUserFields& userFieldsParm,
+    CeLoginArena& arenaParm)
+{
+    uint64_t sKeyIndex = 0;
+    ArenaScope sScope(arenaParm);
+
+    return getArenaRc(arenaParm,
+                      checkAuthorizationAndGetAcfUserFieldsV2ForBmc(
+                          accessControlFileParm, accessControlFileLengthParm,
+                          passwordParm, passwordLengthParm,
+                          timeSinceUnixEpochInSecondsParm, publicKeyParm,
+                          publicKeyLengthParm, NULL, sKeyIndex,
+                          serialNumberParm, serialNumberLengthParm,
+                          currentReplayIdParm, &userFieldsParm, NULL, NULL));
+}
+
+CeLoginRc CeLogin::checkAuthorizationAndGetAcfUserFieldsViewV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm, const char* passwordParm,
+    const uint64_t passwordLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    const uint64_t currentReplayIdParm, AcfUserFieldsView& userFieldsParm,
+    CeLoginArena& arenaParm)
+{
+    uint64_t sKeyIndex = 0;
+    ArenaScope sScope(arenaParm);
+
+    return getArenaRc(arenaParm,
+                      checkAuthorizationAndGetAcfUserFieldsV2ForBmc(
+                          accessControlFileParm, accessControlFileLengthParm,
+                          passwordParm, passwordLengthParm,
+                          timeSinceUnixEpochInSecondsParm, publicKeyParm,
+                          publicKeyLengthParm, NULL, sKeyIndex,
+                          serialNumberParm, serialNumberLengthParm,
+                          currentReplayIdParm, NULL, &userFieldsParm, NULL));
+}
+
+CeLoginRc CeLogin::getAcfAuthRecordV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    AcfAuthRecord& recordParm, CeLoginArena& arenaParm)
+{
+    uint64_t sKeyIndex = 0;
+    ArenaScope sScope(arenaParm);
+
+    return getArenaRc(
+        arenaParm,
+        getAcfAuthRecordV2Internal(
+            accessControlFileParm, accessControlFileLengthParm,
+            timeSinceUnixEpochInSecondsParm, publicKeyParm, publicKeyLengthParm,
+            NULL, sKeyIndex, serialNumberParm, serialNumberLengthParm,
+            recordParm));
+}
+
+CeLoginRc CeLogin::checkAuthorizationWithAcfAuthRecordV2(
+    const AcfAuthRecord& recordParm, const char* passwordParm,
+    const uint64_t passwordLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint64_t currentReplayIdParm, AcfUserFields& userFieldsParm,
+    CeLoginArena& arenaParm)
+{
+    ArenaScope sScope(arenaParm);
+
+    return getArenaRc(arenaParm,
+                      checkAuthorizationWithAcfAuthRecordV2Internal(
+                          recordParm, passwordParm, passwordLengthParm,
+                          timeSinceUnixEpochInSecondsParm, currentReplayIdParm,
+                          userFieldsParm, NULL));
+}
+
+CeLoginRc CeLogin::getAcfVerifiedRecordV2(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    const uint64_t currentReplayIdParm, AcfVerifiedRecord& recordParm,
+    CeLoginArena& arenaParm)
+{
+    uint64_t sKeyIndex = 0;
+    ArenaScope sScope(arenaParm);
+
+    return getArenaRc(
+        arenaParm,
+        getAcfVerifiedRecordV2Internal(
+            accessControlFileParm, accessControlFileLengthParm,
+            timeSinceUnixEpochInSecondsParm, publicKeyParm, publicKeyLengthParm,
+            NULL, sKeyIndex, serialNumberParm, serialNumberLengthParm,
+            currentReplayIdParm, recordParm));
+}
+#else
+CeLoginRc CeLogin::checkAuthorizationAndGetAcfUserFieldsV2ForPowerVM(
+    const uint8_t* accessControlFileParm,
+    const uint64_t accessControlFileLengthParm, const char* passwordParm,
+    const uint64_t passwordLengthParm,
+    const uint64_t timeSinceUnixEpochInSecondsParm,
+    const uint8_t* publicKeyParm, const uint64_t publicKeyLengthParm,
+    const char* serialNumberParm, const uint64_t serialNumberLengthParm,
+    const uint64_t currentReplayIdParm, uint64_t& updatedReplayIdParm,
+    const bool failValidationIfReplayIdPresentParm,
+    AcfUserFields& userFieldsParm, CeLoginArena& arenaParm)
+{
+    ArenaScope sScope(arenaParm);
+
+    return getArenaRc(
+        arenaParm,
+        checkAuthorizationAndGetAcfUserFieldsV2ForPowerVMInternal(
+            accessControlFileParm, accessControlFileLengthParm, passwordParm,
+            passwordLengthParm, timeSinceUnixEpochInSecondsParm, publicKeyParm,
+            publicKeyLengthParm, serialNumberParm, serialNumberLengthParm,
+            currentReplayIdParm, updatedReplayIdParm,
+            failValidationIfReplayIdPresentParm, userFieldsParm));
+}
 #endif /* CELOGIN_POWERVM_TARGET */
@@ -0,0 +1,154 @@
+#include "CeLoginJson.h"
+#include "CeLoginUtil.h"
+
+#include <CeLogin.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/objects.h>
+#include <openssl/rsa.h>
+
+#include <ce_logger.hpp>
+
+using CeLogin::CeLoginRc;
+using CeLogin::CeLoginVerifier;
+
+#ifndef CELOGIN_NO_HEAP
+CeLoginVerifier::CeLoginVerifier() :
+    mPublicKeys(NULL), mVerifyCtxs(NULL), mPublicKeyCount(0),
+    mDigest(EVP_sha512()), mAcfObject(OBJ_nid2obj(CeLogin_Acf_NID))
+{}
+
+CeLoginVerifier::~CeLoginVerifier()
+{
+    clearPublicKeys();
+}
+
+void CeLoginVerifier::clearPublicKeys()
+{
+    for (uint64_t sIdx = 0; mVerifyCtxs && sIdx < mPublicKeyCount; sIdx++)
+    {
+        if (mVerifyCtxs[sIdx])
+        {
+            EVP_PKEY_CTX_free(mVerifyCtxs[sIdx]);
+        }
+    }
+    OPENSSL_free(mVerifyCtxs);
+    OPENSSL_free(mPublicKeys);
+    mVerifyCtxs = NULL;
+    mPublicKeys = NULL;
+    mPublicKeyCount = 0;
+}
+
+CeLoginRc CeLoginVerifier::setPublicKeys(EVP_PKEY* const* publicKeysParm,
+                                         const uint64_t publicKeyCountParm)
+{
+    CeLoginRc sRc = CeLoginRc::Success;
+
+    clearPublicKeys();
+
+    if (!publicKeysParm || 0 == publicKeyCountParm)
+    {
+        sRc = CeLoginRc::GetSevAuth_InvalidPublicKeyPtr;
+    }
+
+    for (uint64_t sIdx = 0;
+         CeLoginRc::Success == sRc && sIdx < publicKeyCountParm; sIdx++)
+    {
+        if (!publicKeysParm[sIdx])
+        {
+            sRc = CeLoginRc::GetSevAuth_InvalidPublicKeyPtr;
+        }
+    }
+
+    if (CeLoginRc::Success == sRc)
+    {
+        mPublicKeys = (EVP_PKEY**)OPENSSL_malloc(publicKeyCountParm *
+                                                 sizeof(EVP_PKEY*));
+        mVerifyCtxs = (EVP_PKEY_CTX**)OPENSSL_zalloc(publicKeyCountParm *
+                                                     sizeof(EVP_PKEY_CTX*));
+        if (!mPublicKeys || !mVerifyCtxs)
+        {
+            CE_LOG_DEBUG("Failed to allocate public key storage");
+            sRc = CeLoginRc::VerifyAcf_PublicKeyAllocFailure;
+        }
+    }
+
+    if (CeLoginRc::Success == sRc)
+    {
+        memcpy(mPublicKeys, publicKeysParm,
+               publicKeyCountParm * sizeof(EVP_PKEY*));
+        mPublicKeyCount = publicKeyCountParm;
+    }
+    else
+    {
+        clearPublicKeys();
+    }
+
+    return sRc;
+}
+
+// The context is set up for RSA PKCS#1 v1.5 with SHA-512 on first use and can
+// then verify any number of signatures with the same key.
+EVP_PKEY_CTX* CeLoginVerifier::getVerifyCtx(const uint64_t keyIndexParm)
+{
+    if (!mVerifyCtxs[keyIndexParm])
+    {
+        int sResult = 1;
+        EVP_PKEY_CTX* sCtx =
+            EVP_PKEY_CTX_new(mPublicKeys[keyIndexParm], NULL /* no engine */);
+        if (!sCtx)
+        {
+            sResult = 0;
+        }
+        if (1 == sResult)
+        {
+            sResult = EVP_PKEY_verify_init(sCtx);
+        }
+        if (1 == sResult)
+        {
+            sResult = EVP_PKEY_CTX_set_rsa_padding(sCtx, RSA_PKCS1_PADDING);
+        }
+        if (1 == sResult)
+        {
+            sResult = EVP_PKEY_CTX_set_signature_md(sCtx, mDigest);
+        }
+
+        if (1 == sResult)
+        {
+            mVerifyCtxs[keyIndexParm] = sCtx;
+        }
+        else if (sCtx)
+        {
+            EVP_PKEY_CTX_free(sCtx);
+        }
+    }
+
+    return mVerifyCtxs[keyIndexParm];
+}
+
+CeLoginRc CeLoginVerifier::verifySignature(const uint8_t* signatureParm,
+                                           const uint64_t signatureLengthParm,
+                                           const uint8_t* digestParm,
+                                           const uint64_t digestLengthParm,
+                                           uint64_t& keyIndexParm)
+{
+    CeLoginRc sRc = CeLoginRc::SignatureNotValid;
+
+    keyIndexParm = mPublicKeyCount;
+
+    for (uint64_t sIdx = 0;
+         CeLoginRc::Success != sRc && sIdx < mPublicKeyCount; sIdx++)
+    {
+        EVP_PKEY_CTX* sCtx = getVerifyCtx(sIdx);
+        if (sCtx && 1 == EVP_PKEY_verify(sCtx, signatureParm,
+                                         signatureLengthParm, digestParm,
+                                         digestLengthParm))
+        {
+            sRc = CeLoginRc::Success;
+            keyIndexParm = sIdx;
+        }
+    }
+
+    return sRc;
+}
+#endif /* CELOGIN_NO_HEAP */
@@ -5,6 +5,39 @@
 #include <stdio.h>
 #include <string.h>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void JsmnUtils::IndexSubtreeEnds(JsmnState& jsmnStateParm,
+                                 uint32_t* subtreeEndsParm)
+{
+    const uint64_t sLength = jsmnStateParm.mTokenArrayLength;
+
+    // Tokens are stored parent first. Going backwards, the subtree of every
+    // child is known by the time its parent is reached.
+    for (uint64_t sIdx = sLength; sIdx-- > 0;)
+    {
+        uint64_t sEnd = sIdx + 1;
+        int sChildren = jsmnStateParm.getToken(sIdx).size;
+        for (; sChildren > 0 && sEnd < sLength; sChildren--)
+        {
+            sEnd = subtreeEndsParm[sEnd];
+        }
+
+        // A subtree running past the last token is marked as such
+        if (sChildren > 0)
+        {
+            sEnd = sLength + 1;
+        }
+        subtreeEndsParm[sIdx] = (uint32_t)sEnd;
+    }
+
+    jsmnStateParm.mSubtreeEnds = subtreeEndsParm;
+}
+
 JsmnUtils::JsmnUtilRc JsmnUtils::GetNextJsonEntry(const JsmnState& jsmnState,
                                                   const uint64_t currentIdxParm,
                                                   uint64_t& nextIdxParm)
@@ -14,6 +47,14 @@ JsmnUtils::JsmnUtilRc JsmnUtils::GetNextJsonEntry(const JsmnState& jsmnState,
     {
         sRc = GetNextJsonEntry_InvalidParm;
     }
+    else if (jsmnState.mSubtreeEnds)
+    {
+        nextIdxParm = jsmnState.mSubtreeEnds[currentIdxParm];
+        if (nextIdxParm > jsmnState.mTokenArrayLength)
+        {
+            sRc = GetNextJsonEntry_BadWalk;
+        }
+    }
     else
     {
         uint64_t sTokensRemaining = jsmnState.getToken(currentIdxParm).size;
@@ -110,11 +151,17 @@ JsmnUtils::JsmnUtilRc JsmnUtils::ObjectGetValueByKey(
         uint64_t sTokenIdx =
             objectRootIdxParm + 1; // Next token after the top level object
 
+        // Only the entries of the object are searched
+        uint64_t sObjectEndIdx = 0;
+        sRc = JsmnUtils::GetNextJsonEntry(jsmnStateParm, objectRootIdxParm,
+                                          sObjectEndIdx);
+
         // Limit the number of iterations to prevent an infinite loop
         for (uint64_t sIter = objectRootIdxParm;
-             sIter < jsmnStateParm.mTokenArrayLength; sIter++)
+             Success == sRc && sIter < jsmnStateParm.mTokenArrayLength; sIter++)
         {
-            if (!jsmnStateParm.isTokenIdxValid(sTokenIdx))
+            if (!jsmnStateParm.isTokenIdxValid(sTokenIdx) ||
+                sTokenIdx >= sObjectEndIdx)
             {
                 break;
             }
@@ -171,6 +218,89 @@ JsmnUtils::JsmnUtilRc JsmnUtils::ObjectGetValueByKey(
     return sRc;
 }
 
+uint64_t JsmnUtils::FindString(const char* dataParm,
+                               const uint64_t dataLengthParm,
+                               const char* stringParm,
+                               const uint64_t stringLengthParm)
+{
+    if (!dataParm || !stringParm || 0 == stringLengthParm ||
+        stringLengthParm > dataLengthParm)
+    {
+        return dataLengthParm;
+    }
+
+    // The string can start at any offset up to and including this one
+    const uint64_t sLastOffset = dataLengthParm - stringLengthParm;
+    const uint64_t sLastCharOffset = stringLengthParm - 1;
+    uint64_t sIdx = 0;
+
+    // Compare the first and the last character of the string at a block of
+    // offsets at once, and only compare the whole string where both match
+#if defined(__AVX2__)
+    const __m256i sFirst256 = _mm256_set1_epi8(stringParm[0]);
+    const __m256i sLast256 = _mm256_set1_epi8(stringParm[sLastCharOffset]);
+    for (; sIdx + 32 <= sLastOffset + 1; sIdx += 32)
+    {
+        const __m256i sFirstBlock =
+            _mm256_loadu_si256((const __m256i*)(dataParm + sIdx));
+        const __m256i sLastBlock = _mm256_loadu_si256(
+            (const __m256i*)(dataParm + sIdx + sLastCharOffset));
+        uint32_t sMask = (uint32_t)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(sFirstBlock, sFirst256),
+                             _mm256_cmpeq_epi8(sLastBlock, sLast256)));
+        for (; 0 != sMask; sMask &= sMask - 1)
+        {
+            const uint64_t sOffset = sIdx + __builtin_ctz(sMask);
+            if (0 == memcmp(dataParm + sOffset, stringParm, stringLengthParm))
+            {
+                return sOffset;
+            }
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i sFirst128 = _mm_set1_epi8(stringParm[0]);
+    const __m128i sLast128 = _mm_set1_epi8(stringParm[sLastCharOffset]);
+    for (; sIdx + 16 <= sLastOffset + 1; sIdx += 16)
+    {
+        const __m128i sFirstBlock =
+            _mm_loadu_si128((const __m128i*)(dataParm + sIdx));
+        const __m128i sLastBlock = _mm_loadu_si128(
+            (const __m128i*)(dataParm + sIdx + sLastCharOffset));
+        uint32_t sMask = (uint32_t)_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(sFirstBlock, sFirst128),
+                          _mm_cmpeq_epi8(sLastBlock, sLast128)));
+        for (; 0 != sMask; sMask &= sMask - 1)
+        {
+            const uint64_t sOffset = sIdx + __builtin_ctz(sMask);
+            if (0 == memcmp(dataParm + sOffset, stringParm, stringLengthParm))
+            {
+                return sOffset;
+            }
+        }
+    }
+#endif
+
+    // The remaining offsets, or all of them without SIMD support
+    while (sIdx <= sLastOffset)
+    {
+        const char* sFound = (const char*)memchr(
+            dataParm + sIdx, stringParm[0], sLastOffset + 1 - sIdx);
+        if (!sFound)
+        {
+            break;
+        }
+        sIdx = sFound - dataParm;
+        if (0 == memcmp(dataParm + sIdx, stringParm, stringLengthParm))
+        {
+            return sIdx;
+        }
+        sIdx++;
+    }
+
+    return dataLengthParm;
+}
+
 bool JsmnUtils::SafeJsmnStringCompare(const JsmnString& jsmnStringParm,
                                       const char* stringParm,
                                       const uint64_t stringLengthParm)
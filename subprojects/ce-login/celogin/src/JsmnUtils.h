@@ -32,10 +32,16 @@ struct JsmnString
 
 struct JsmnState
 {
+    JsmnState() :
+        mJsonString(NULL), mJsonStringLength(0), mTokenArray(NULL),
+        mTokenArrayLength(0), mSubtreeEnds(NULL)
+    {}
+
     const char* mJsonString;
     uint64_t mJsonStringLength;
     const jsmntok_t* mTokenArray;
     uint64_t mTokenArrayLength;
+    const uint32_t* mSubtreeEnds; // Optional, see IndexSubtreeEnds
 
     inline bool isValid() const
     {
@@ -67,6 +73,13 @@ struct JsmnState
     }
 };
 
+/// @brief Record, for each token, the index just past the token and all of
+/// its descendants. GetNextJsonEntry then skips over a token in constant time.
+/// @param[in,out] jsmnStateParm tokens to index, refers to the index afterwards
+/// @param[out] subtreeEndsParm one entry for each token, must be kept for as
+/// long as jsmnStateParm is used
+void IndexSubtreeEnds(JsmnState& jsmnStateParm, uint32_t* subtreeEndsParm);
+
 JsmnUtilRc GetNextJsonEntry(const JsmnState& jsmnState,
                             const uint64_t currentIdxParm,
                             uint64_t& nextIdxParm);
@@ -78,6 +91,12 @@ JsmnUtilRc ObjectGetValueByKey(const JsmnState& jsmnStateParm,
                                const char* keyParm, const uint64_t keyLenParm,
                                uint64_t& valueIdxParm);
 
+/// @brief Find the first occurrence of a string in raw JSON text, comparing
+/// 32 or 16 positions at a time where AVX2 or SSE2 is available.
+/// @return offset of the occurrence, or dataLengthParm if there is none
+uint64_t FindString(const char* dataParm, const uint64_t dataLengthParm,
+                    const char* stringParm, const uint64_t stringLengthParm);
+
 bool SafeJsmnStringCompare(const JsmnString& jsmnStringParm,
                            const char* stringParm,
                            const uint64_t stringLengthParm);
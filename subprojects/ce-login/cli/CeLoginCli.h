@@ -9,6 +9,7 @@ namespace cli
 CeLogin::CeLoginRc createHsf(int argc, char** argv);
 CeLogin::CeLoginRc decodeHsf(int argc, char** argv);
 CeLogin::CeLoginRc verifyHsf(int argc, char** argv);
+CeLogin::CeLoginRc verifyBatch(int argc, char** argv);
 CeLogin::CeLoginRc createProductionHsf(int argc, char** argv);
 CeLogin::CeLoginRc createProductionHsfV2(int argc, char** argv);
 }; // namespace cli
@@ -0,0 +1,231 @@
+#include "CliBenchmark.h"
+
+#include "../celogin/src/CeLoginJson.h"
+#include "../celogin/src/CeLoginUtil.h"
+
+#include <CeLogin.h>
+#include <stdio.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using CeLogin::CeLoginJsonData;
+using CeLogin::CeLoginRc;
+
+// Service ACF JSON listing the given number of machines. Only the last
+// machine matches the serial number searched for.
+static std::string createMachinesJson(const uint64_t numMachinesParm)
+{
+    std::string sJson = "{\"version\":2,\"type\":\"service\",\"machines\":[";
+    for (uint64_t sIdx = 0; sIdx < numMachinesParm; sIdx++)
+    {
+        char sSerial[32];
+        snprintf(sSerial, sizeof(sSerial), "SN%010llu",
+                 (unsigned long long)(numMachinesParm - 1 - sIdx));
+        sJson += (0 == sIdx) ? "{" : ",{";
+        sJson += "\"serialNumber\":\"";
+        sJson += sSerial;
+        sJson += "\",\"frameworkEc\":\"PWR10S\"}";
+    }
+    sJson += "],\"hashedAuthCode\":\"00ff\",\"salt\":\"0011\","
+             "\"iterations\":1000,\"expiration\":\"2099-12-31\","
+             "\"requestId\":\"FACE0FF0\",\"replayid\":5}";
+    return sJson;
+}
+
+// Average time of decodeJson in microseconds, repeated for at least a
+// fraction of a second
+static double timeDecodeJson(const std::string& jsonParm,
+                             const std::string& serialParm, CeLoginRc& rcParm)
+{
+    const std::chrono::steady_clock::duration sMinDuration =
+        std::chrono::milliseconds(200);
+
+    CeLoginJsonData* sJsonData = new CeLoginJsonData();
+    uint64_t sIterations = 0;
+    const std::chrono::steady_clock::time_point sStart =
+        std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration sElapsed;
+    do
+    {
+        rcParm = CeLogin::decodeJson(jsonParm.c_str(), jsonParm.length(),
+                                     serialParm.c_str(), serialParm.length(),
+                                     *sJsonData);
+        sIterations++;
+        sElapsed = std::chrono::steady_clock::now() - sStart;
+    } while (sElapsed < sMinDuration);
+    delete sJsonData;
+
+    return std::chrono::duration<double, std::micro>(sElapsed).count() /
+           sIterations;
+}
+
+// Throughput in MB/s of the hex and base64 codecs on the given number of
+// bytes, repeated for at least a fraction of a second each
+static void timeCodecs(const uint64_t numBytesParm)
+{
+    const std::chrono::steady_clock::duration sMinDuration =
+        std::chrono::milliseconds(200);
+    // Room for the padding bytes base64 decoding writes
+    std::vector<uint8_t> sBinary(numBytesParm + 2);
+    for (uint64_t sIdx = 0; sIdx < numBytesParm; sIdx++)
+    {
+        sBinary[sIdx] = (uint8_t)(sIdx * 131 + 7);
+    }
+    std::vector<char> sText(2 * numBytesParm + 4);
+    double sRates[4];
+
+    for (int sCodec = 0; sCodec < 4; sCodec++)
+    {
+        uint64_t sIterations = 0;
+        uint64_t sTextLength = 0;
+        size_t sLength = 0;
+        const std::chrono::steady_clock::time_point sStart =
+            std::chrono::steady_clock::now();
+        std::chrono::steady_clock::duration sElapsed;
+        do
+        {
+            switch (sCodec)
+            {
+                case 0:
+                    CeLogin::getHexFromBinary(sBinary.data(), numBytesParm,
+                                              sText.data(), sText.size(),
+                                              sTextLength);
+                    break;
+                case 1:
+                    CeLogin::getBinaryFromHex(sText.data(), 2 * numBytesParm,
+                                              sBinary.data(), sBinary.size(),
+                                              sTextLength);
+                    break;
+                case 2:
+                    CeLogin::base64Encode(sBinary.data(), numBytesParm,
+                                          sText.data(), sText.size(), sLength);
+                    break;
+                default:
+                    CeLogin::base64Decode(
+                        sText.data(), 4 * ((numBytesParm + 2) / 3),
+                        sBinary.data(), sBinary.size(), sLength);
+                    break;
+            }
+            sIterations++;
+            sElapsed = std::chrono::steady_clock::now() - sStart;
+        } while (sElapsed < sMinDuration);
+
+        sRates[sCodec] = (double)numBytesParm * sIterations /
+                         std::chrono::duration<double, std::micro>(sElapsed)
+                             .count();
+    }
+
+    printf("%10llu %16.1f %16.1f %16.1f %16.1f\n",
+           (unsigned long long)numBytesParm, sRates[0], sRates[1], sRates[2],
+           sRates[3]);
+}
+
+// Time in milliseconds to derive the given number of password hashes, one
+// createPasswordHash call each and all of them with createPasswordHashes
+static void timePasswordHashes(const uint64_t numPairsParm)
+{
+    const uint64_t sHashLength = 64; // the length ACFs are created with
+    std::vector<std::string> sPasswords(numPairsParm);
+    std::vector<std::vector<uint8_t>> sSalts(numPairsParm);
+    std::vector<std::vector<uint8_t>> sExpected(numPairsParm);
+    std::vector<std::vector<uint8_t>> sBatched(numPairsParm);
+    std::vector<CeLogin::PasswordHashRequest> sRequests(numPairsParm);
+    for (uint64_t sIdx = 0; sIdx < numPairsParm; sIdx++)
+    {
+        sPasswords[sIdx] = "password" + std::to_string(sIdx);
+        sSalts[sIdx].assign(sHashLength, (uint8_t)(sIdx * 131 + 7));
+        sExpected[sIdx].assign(sHashLength, 0);
+        sBatched[sIdx].assign(sHashLength, 0);
+
+        CeLogin::PasswordHashRequest& sRequest = sRequests[sIdx];
+        sRequest.mPassword = sPasswords[sIdx].c_str();
+        sRequest.mPasswordLength = sPasswords[sIdx].length();
+        sRequest.mSalt = sSalts[sIdx].data();
+        sRequest.mSaltLength = sSalts[sIdx].size();
+        sRequest.mIterations = CeLogin::CeLogin_PBKDF2_Iterations;
+        sRequest.mOutputHash = sBatched[sIdx].data();
+        sRequest.mOutputHashSize = sHashLength;
+        sRequest.mRequestedOutputLength = sHashLength;
+    }
+
+    bool sMatch = true;
+    const std::chrono::steady_clock::time_point sStart =
+        std::chrono::steady_clock::now();
+    for (uint64_t sIdx = 0; sIdx < numPairsParm; sIdx++)
+    {
+        const CeLogin::PasswordHashRequest& sRequest = sRequests[sIdx];
+        CeLoginRc sRc = CeLogin::createPasswordHash(
+            sRequest.mPassword, sRequest.mPasswordLength, sRequest.mSalt,
+            sRequest.mSaltLength, sRequest.mIterations,
+            sExpected[sIdx].data(), sHashLength, sHashLength);
+        sMatch = sMatch && sRc.isSuccess();
+    }
+    const std::chrono::steady_clock::time_point sMiddle =
+        std::chrono::steady_clock::now();
+    CeLogin::createPasswordHashes(sRequests.data(), sRequests.size());
+    const std::chrono::steady_clock::time_point sEnd =
+        std::chrono::steady_clock::now();
+
+    for (uint64_t sIdx = 0; sIdx < numPairsParm; sIdx++)
+    {
+        sMatch = sMatch && sRequests[sIdx].mRc.isSuccess() &&
+                 sExpected[sIdx] == sBatched[sIdx];
+    }
+
+    const double sSingle =
+        std::chrono::duration<double, std::milli>(sMiddle - sStart).count();
+    const double sBatch =
+        std::chrono::duration<double, std::milli>(sEnd - sMiddle).count();
+    printf("%10llu %16.1f %16.1f %10.2f%s\n", (unsigned long long)numPairsParm,
+           sSingle, sBatch, sSingle / sBatch, sMatch ? "" : "  mismatch");
+}
+
+void cli::benchmark_main(int, char**)
+{
+    const uint64_t sNumMachines[] = {1, 10, 100, 1000, 10000};
+    const std::string sFirstSerial = "SN0000000000";
+    const std::string sMissingSerial = "SN9999999999";
+
+    printf("%10s %10s %16s %16s\n", "machines", "bytes", "match (us)",
+           "no match (us)");
+    for (uint64_t sIdx = 0; sIdx < sizeof(sNumMachines) / sizeof(uint64_t);
+         sIdx++)
+    {
+        const std::string sJson = createMachinesJson(sNumMachines[sIdx]);
+
+        CeLoginRc sMatchRc = CeLoginRc::Success;
+        CeLoginRc sMissRc = CeLoginRc::Success;
+        const double sMatch = timeDecodeJson(sJson, sFirstSerial, sMatchRc);
+        const double sMiss = timeDecodeJson(sJson, sMissingSerial, sMissRc);
+
+        printf("%10llu %10llu %16.1f %16.1f",
+               (unsigned long long)sNumMachines[sIdx],
+               (unsigned long long)sJson.length(), sMatch, sMiss);
+        if (CeLoginRc::Success != sMatchRc ||
+            CeLoginRc::SerialNumberMismatch != sMissRc)
+        {
+            printf("  unexpected rc 0x%x 0x%x", (uint16_t)sMatchRc,
+                   (uint16_t)sMissRc);
+        }
+        printf("\n");
+    }
+
+    printf("\n%10s %16s %16s %16s %16s\n", "bytes", "hex enc (MB/s)",
+           "hex dec (MB/s)", "b64 enc (MB/s)", "b64 dec (MB/s)");
+    timeCodecs(64);
+    timeCodecs(65536);
+
+    printf("\n%llu PBKDF2 lanes, %llu iterations\n",
+           (unsigned long long)CeLogin::getPasswordHashLanes(),
+           (unsigned long long)CeLogin::CeLogin_PBKDF2_Iterations);
+    printf("%10s %16s %16s %10s\n", "pairs", "single (ms)", "batch (ms)",
+           "speedup");
+    const uint64_t sNumPairs[] = {1, 4, 8, 64};
+    for (uint64_t sIdx = 0; sIdx < sizeof(sNumPairs) / sizeof(uint64_t); sIdx++)
+    {
+        timePasswordHashes(sNumPairs[sIdx]);
+    }
+}
@@ -0,0 +1,4 @@
+namespace cli
+{
+void benchmark_main(int argc, char** argv);
+};
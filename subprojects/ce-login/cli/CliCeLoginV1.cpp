@@ -329,6 +329,10 @@ CeLogin::CeLoginRc
         ASN1_BIT_STRING_set(sHsfStruct->signature,
                             (uint8_t*)signatureParm.data(),
                             signatureParm.size());
+        // Without an explicit count of unused bits the DER encoder drops
+        // trailing zero bytes, which truncates the signature.
+        sHsfStruct->signature->flags &= ~0x07;
+        sHsfStruct->signature->flags |= ASN1_STRING_FLAG_BITS_LEFT;
 
         std::vector<uint8_t> sHsfDerEncoded(4096);
         uint8_t* sDataPtr = sHsfDerEncoded.data();
@@ -390,7 +394,7 @@ CeLogin::CeLoginRc CeLogin::decodeAndVerifyCeLoginHsfV1(
 {
     CeLoginRc sRc = CeLoginRc::Success;
 
-    CELoginSequenceV1* sDecodedAsn = NULL;
+    CELoginSequenceV1View sDecodedAsn;
 
     if (CeLoginRc::Success == sRc)
     {
@@ -409,17 +413,8 @@ CeLogin::CeLoginRc CeLogin::decodeAndVerifyCeLoginHsfV1(
 
             if (CeLoginRc::Success == sRc)
             {
-                // return a valid TYPE structure or NULL if an error occurs
-                // NOTE: there is a "reuse" capability where an existing
-                // structure can be provided,
-                //       however in the event of a failure, the structure is
-                //       automatically free'd. Either way there is undesirable
-                //       behavior. So in this case returning a heap allocation
-                //       seems slightly more straightforward.
-                const uint8_t* sHsfPtr = hsfParm.data();
-                sDecodedAsn =
-                    d2i_CELoginSequenceV1(NULL, &sHsfPtr, hsfParm.size());
-                if (!sDecodedAsn)
+                if (!decodeCELoginSequenceV1View(hsfParm.data(),
+                                                 hsfParm.size(), sDecodedAsn))
                 {
                     sRc = CeLoginRc::VerifyAcf_AsnDecodeFailure;
                 }
@@ -430,28 +425,24 @@ CeLogin::CeLoginRc CeLogin::decodeAndVerifyCeLoginHsfV1(
     if (CeLoginRc::Success == sRc)
     {
         decodedHsfParm.mProcessingType =
-            std::string((const char*)sDecodedAsn->processingType->data,
-                        sDecodedAsn->processingType->length);
+            std::string((const char*)sDecodedAsn.processingType.data,
+                        sDecodedAsn.processingType.length);
         decodedHsfParm.mSourceFileName =
-            std::string((const char*)sDecodedAsn->sourceFileName->data,
-                        sDecodedAsn->sourceFileName->length);
+            std::string((const char*)sDecodedAsn.sourceFileName.data,
+                        sDecodedAsn.sourceFileName.length);
     }
 
     if (CeLoginRc::Success == sRc)
     {
-        for (int i = 0; i < sDecodedAsn->sourceFileData->length; i++)
-        {
-            decodedHsfParm.mSignedPayload.push_back(
-                sDecodedAsn->sourceFileData->data[i]);
-        }
+        // The payload is not NUL terminated within the ACF
+        const std::string sPayload((const char*)sDecodedAsn.sourceFileData.data,
+                                   sDecodedAsn.sourceFileData.length);
+        decodedHsfParm.mSignedPayload.assign(sPayload.begin(), sPayload.end());
+        decodedHsfParm.mSignature.assign(sDecodedAsn.signature.data,
+                                         sDecodedAsn.signature.data +
+                                             sDecodedAsn.signature.length);
 
-        for (int i = 0; i < sDecodedAsn->signature->length; i++)
-        {
-            decodedHsfParm.mSignature.push_back(
-                sDecodedAsn->signature->data[i]);
-        }
-        json_object* sJson =
-            json_tokener_parse((const char*)sDecodedAsn->sourceFileData->data);
+        json_object* sJson = json_tokener_parse(sPayload.c_str());
 
         if (!sJson)
         {
@@ -557,10 +548,6 @@ CeLogin::CeLoginRc CeLogin::decodeAndVerifyCeLoginHsfV1(
         }
     }
 
-    if (sDecodedAsn)
-    {
-        CELoginSequenceV1_free(sDecodedAsn);
-    }
     return sRc;
 }
 
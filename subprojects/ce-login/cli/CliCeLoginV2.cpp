@@ -32,25 +32,33 @@ using CeLogin::CeLoginCreateHsfArgsV1;
 using CeLogin::CeLoginCreateHsfArgsV2;
 using CeLogin::CeLoginRc;
 
-CeLoginRc CeLogin::createCeLoginAcfV2Payload(
-    const CeLoginCreateHsfArgsV2& argsParm, std::string& generatedJsonParm,
-    std::vector<uint8_t>& generatedPayloadHashParm)
+namespace CeLogin
+{
+// The password hash of an ACF, made before the rest of its payload so that
+// the PBKDF2 derivations of several ACFs can run together
+struct AcfV2PasswordHash
+{
+    std::vector<uint8_t> mHashedAuthCode;
+    std::vector<uint8_t> mSalt;
+    uint64_t mIterations;
+    bool mNeedsPbkdf2; // mHashedAuthCode is still to be derived
+};
+
+static CeLoginRc
+    prepareAcfV2PasswordHash(const CeLoginCreateHsfArgsV2& argsParm,
+                             AcfV2PasswordHash& hashParm)
 {
     CeLoginRc sRc = CeLoginRc::Success;
 
     const CeLoginCreateHsfArgsV2& sArgsV2 = argsParm;
     const CeLoginCreateHsfArgsV1& sArgsV1 = argsParm.mV1Args;
 
-    std::string sPasswordHashHexString;
-    std::string sSaltHexString;
-    std::string sReplayId = cli::generateReplayId();
-
     const AcfType sAcfType = CeLogin::getAcfTypeFromString(sArgsV2.mType);
 
-    std::vector<uint8_t> sHashedAuthCode(sArgsV1.mHashedAuthCodeLength);
-    std::vector<uint8_t> sSalt(sArgsV1.mSaltLength, 0);
-
-    uint64_t sIterations = sArgsV1.mIterations;
+    hashParm.mHashedAuthCode.assign(sArgsV1.mHashedAuthCodeLength, 0);
+    hashParm.mSalt.assign(sArgsV1.mSaltLength, 0);
+    hashParm.mIterations = sArgsV1.mIterations;
+    hashParm.mNeedsPbkdf2 = false;
 
     if (sArgsV1.mMachines.empty() || !sArgsV1.mPasswordPtr ||
         0 == sArgsV1.mPasswordLength || sArgsV1.mExpirationDate.empty() ||
@@ -65,29 +73,27 @@ CeLoginRc CeLogin::createCeLoginAcfV2Payload(
         PasswordHash_Production == sArgsV1.mPasswordHashAlgorithm)
     {
         // Create a random salt
-        int sOsslRc = RAND_bytes(sSalt.data(), sSalt.size());
+        int sOsslRc =
+            RAND_bytes(hashParm.mSalt.data(), hashParm.mSalt.size());
         if (1 != sOsslRc)
         {
             sRc = CeLoginRc::Failure;
         }
     }
 
-    // Hash password
+    // Hash password, a production hash is left to the caller
     if (CeLoginRc::Success == sRc)
     {
         if (PasswordHash_Production == sArgsV1.mPasswordHashAlgorithm)
         {
-            sRc = CeLogin::createPasswordHash(
-                sArgsV1.mPasswordPtr, sArgsV1.mPasswordLength, sSalt.data(),
-                sSalt.size(), sIterations, sHashedAuthCode.data(),
-                sHashedAuthCode.size(), sHashedAuthCode.size());
+            hashParm.mNeedsPbkdf2 = true;
         }
         else if (PasswordHash_SHA512 == sArgsV1.mPasswordHashAlgorithm)
         {
-            sIterations = 0;
+            hashParm.mIterations = 0;
             bool sSuccess = cli::createSha512PasswordHash(
                 (const uint8_t*)sArgsV1.mPasswordPtr, sArgsV1.mPasswordLength,
-                sHashedAuthCode);
+                hashParm.mHashedAuthCode);
             if (!sSuccess)
             {
                 sRc = CeLoginRc::Failure;
@@ -101,11 +107,48 @@ CeLoginRc CeLogin::createCeLoginAcfV2Payload(
         }
     }
 
+    return sRc;
+}
+
+static CeLogin::PasswordHashRequest
+    getAcfV2PasswordHashRequest(const CeLoginCreateHsfArgsV2& argsParm,
+                                AcfV2PasswordHash& hashParm)
+{
+    CeLogin::PasswordHashRequest sRequest;
+    sRequest.mPassword = argsParm.mV1Args.mPasswordPtr;
+    sRequest.mPasswordLength = argsParm.mV1Args.mPasswordLength;
+    sRequest.mSalt = hashParm.mSalt.data();
+    sRequest.mSaltLength = hashParm.mSalt.size();
+    sRequest.mIterations = hashParm.mIterations;
+    sRequest.mOutputHash = hashParm.mHashedAuthCode.data();
+    sRequest.mOutputHashSize = hashParm.mHashedAuthCode.size();
+    sRequest.mRequestedOutputLength = hashParm.mHashedAuthCode.size();
+    return sRequest;
+}
+
+static CeLoginRc
+    createAcfV2PayloadFromHash(const CeLoginCreateHsfArgsV2& argsParm,
+                               const AcfV2PasswordHash& hashParm,
+                               std::string& generatedJsonParm,
+                               std::vector<uint8_t>& generatedPayloadHashParm)
+{
+    CeLoginRc sRc = CeLoginRc::Success;
+
+    const CeLoginCreateHsfArgsV2& sArgsV2 = argsParm;
+    const CeLoginCreateHsfArgsV1& sArgsV1 = argsParm.mV1Args;
+
+    std::string sPasswordHashHexString;
+    std::string sSaltHexString;
+    std::string sReplayId = cli::generateReplayId();
+
+    const AcfType sAcfType = CeLogin::getAcfTypeFromString(sArgsV2.mType);
+
     // Convert binary hash to Hex String
     if (CeLoginRc::Success == sRc)
     {
-        sPasswordHashHexString = cli::getHexStringFromBinary(sHashedAuthCode);
-        sSaltHexString = cli::getHexStringFromBinary(sSalt);
+        sPasswordHashHexString =
+            cli::getHexStringFromBinary(hashParm.mHashedAuthCode);
+        sSaltHexString = cli::getHexStringFromBinary(hashParm.mSalt);
     }
 
     // Create json structure
@@ -277,7 +320,7 @@ CeLoginRc CeLogin::createCeLoginAcfV2Payload(
                 sHashedPassword =
                     json_object_new_string(sPasswordHashHexString.c_str());
                 sSaltObj = json_object_new_string(sSaltHexString.c_str());
-                sIterationsObj = json_object_new_int(sIterations);
+                sIterationsObj = json_object_new_int(hashParm.mIterations);
 
                 if (sHashedPassword && sSaltObj && sIterationsObj)
                 {
@@ -357,6 +400,89 @@ CeLoginRc CeLogin::createCeLoginAcfV2Payload(
     return sRc;
 }
 
+} // namespace CeLogin
+
+CeLoginRc CeLogin::createCeLoginAcfV2Payload(
+    const CeLoginCreateHsfArgsV2& argsParm, std::string& generatedJsonParm,
+    std::vector<uint8_t>& generatedPayloadHashParm)
+{
+    AcfV2PasswordHash sHash;
+    CeLoginRc sRc = prepareAcfV2PasswordHash(argsParm, sHash);
+
+    if (CeLoginRc::Success == sRc && sHash.mNeedsPbkdf2)
+    {
+        PasswordHashRequest sRequest =
+            getAcfV2PasswordHashRequest(argsParm, sHash);
+        sRc = CeLogin::createPasswordHash(
+            sRequest.mPassword, sRequest.mPasswordLength, sRequest.mSalt,
+            sRequest.mSaltLength, sRequest.mIterations, sRequest.mOutputHash,
+            sRequest.mOutputHashSize, sRequest.mRequestedOutputLength);
+    }
+
+    if (CeLoginRc::Success == sRc)
+    {
+        sRc = createAcfV2PayloadFromHash(argsParm, sHash, generatedJsonParm,
+                                         generatedPayloadHashParm);
+    }
+    else
+    {
+        generatedPayloadHashParm.clear();
+        generatedJsonParm.clear();
+    }
+    return sRc;
+}
+
+CeLoginRc CeLogin::createCeLoginAcfV2Payloads(
+    const std::vector<CeLoginCreateHsfArgsV2>& argsParm,
+    std::vector<std::string>& generatedJsonParm,
+    std::vector<std::vector<uint8_t>>& generatedPayloadHashParm)
+{
+    CeLoginRc sRc = CeLoginRc::Success;
+
+    std::vector<AcfV2PasswordHash> sHashes(argsParm.size());
+    std::vector<PasswordHashRequest> sRequests;
+    std::vector<uint64_t> sRequestAcfs;
+    for (uint64_t sIdx = 0; sIdx < argsParm.size() && sRc.isSuccess(); sIdx++)
+    {
+        sRc = prepareAcfV2PasswordHash(argsParm[sIdx], sHashes[sIdx]);
+        if (CeLoginRc::Success == sRc && sHashes[sIdx].mNeedsPbkdf2)
+        {
+            sRequests.push_back(
+                getAcfV2PasswordHashRequest(argsParm[sIdx], sHashes[sIdx]));
+            sRequestAcfs.push_back(sIdx);
+        }
+    }
+
+    if (CeLoginRc::Success == sRc && !sRequests.empty())
+    {
+        CeLogin::createPasswordHashes(sRequests.data(), sRequests.size());
+        for (uint64_t sIdx = 0; sIdx < sRequests.size(); sIdx++)
+        {
+            if (CeLoginRc::Success != sRequests[sIdx].mRc)
+            {
+                sRc = sRequests[sIdx].mRc;
+                break;
+            }
+        }
+    }
+
+    generatedJsonParm.assign(argsParm.size(), std::string());
+    generatedPayloadHashParm.assign(argsParm.size(), std::vector<uint8_t>());
+    for (uint64_t sIdx = 0; sIdx < argsParm.size() && sRc.isSuccess(); sIdx++)
+    {
+        sRc = createAcfV2PayloadFromHash(argsParm[sIdx], sHashes[sIdx],
+                                         generatedJsonParm[sIdx],
+                                         generatedPayloadHashParm[sIdx]);
+    }
+
+    if (CeLoginRc::Success != sRc)
+    {
+        generatedJsonParm.clear();
+        generatedPayloadHashParm.clear();
+    }
+    return sRc;
+}
+
 CeLogin::CeLoginRc CeLogin::createCeLoginAcfV2Signature(
     const CeLoginCreateHsfArgsV2& argsParm,
     const std::vector<uint8_t>& jsonDigestParm,
@@ -473,6 +599,10 @@ CeLogin::CeLoginRc
         ASN1_BIT_STRING_set(sHsfStruct->signature,
                             (uint8_t*)signatureParm.data(),
                             signatureParm.size());
+        // Without an explicit count of unused bits the DER encoder drops
+        // trailing zero bytes, which truncates the signature.
+        sHsfStruct->signature->flags &= ~0x07;
+        sHsfStruct->signature->flags |= ASN1_STRING_FLAG_BITS_LEFT;
 
         std::vector<uint8_t> sHsfDerEncoded(4096);
         uint8_t* sDataPtr = sHsfDerEncoded.data();
@@ -534,7 +664,7 @@ CeLogin::CeLoginRc CeLogin::decodeAndVerifyCeLoginHsfV2(
 {
     CeLoginRc sRc = CeLoginRc::Success;
 
-    CELoginSequenceV1* sDecodedAsn = NULL;
+    CELoginSequenceV1View sDecodedAsn;
 
     if (CeLoginRc::Success == sRc)
     {
@@ -553,17 +683,8 @@ CeLogin::CeLoginRc CeLogin::decodeAndVerifyCeLoginHsfV2(
 
             if (CeLoginRc::Success == sRc)
             {
-                // return a valid TYPE structure or NULL if an error occurs
-                // NOTE: there is a "reuse" capability where an existing
-                // structure can be provided,
-                //       however in the event of a failure, the structure is
-                //       automatically free'd. Either way there is undesirable
-                //       behavior. So in this case returning a heap allocation
-                //       seems slightly more straightforward.
-                const uint8_t* sHsfPtr = hsfParm.data();
-                sDecodedAsn =
-                    d2i_CELoginSequenceV1(NULL, &sHsfPtr, hsfParm.size());
-                if (!sDecodedAsn)
+                if (!decodeCELoginSequenceV1View(hsfParm.data(),
+                                                 hsfParm.size(), sDecodedAsn))
                 {
                     sRc = CeLoginRc::VerifyAcf_AsnDecodeFailure;
                 }
@@ -574,28 +695,24 @@ CeLogin::CeLoginRc CeLogin::decodeAndVerifyCeLoginHsfV2(
     if (CeLoginRc::Success == sRc)
     {
         decodedHsfParm.mProcessingType =
-            std::string((const char*)sDecodedAsn->processingType->data,
-                        sDecodedAsn->processingType->length);
+            std::string((const char*)sDecodedAsn.processingType.data,
+                        sDecodedAsn.processingType.length);
         decodedHsfParm.mSourceFileName =
-            std::string((const char*)sDecodedAsn->sourceFileName->data,
-                        sDecodedAsn->sourceFileName->length);
+            std::string((const char*)sDecodedAsn.sourceFileName.data,
+                        sDecodedAsn.sourceFileName.length);
     }
 
     if (CeLoginRc::Success == sRc)
     {
-        for (int i = 0; i < sDecodedAsn->sourceFileData->length; i++)
-        {
-            decodedHsfParm.mSignedPayload.push_back(
-                sDecodedAsn->sourceFileData->data[i]);
-        }
+        // The payload is not NUL terminated within the ACF
+        const std::string sPayload((const char*)sDecodedAsn.sourceFileData.data,
+                                   sDecodedAsn.sourceFileData.length);
+        decodedHsfParm.mSignedPayload.assign(sPayload.begin(), sPayload.end());
+        decodedHsfParm.mSignature.assign(sDecodedAsn.signature.data,
+                                         sDecodedAsn.signature.data +
+                                             sDecodedAsn.signature.length);
 
-        for (int i = 0; i < sDecodedAsn->signature->length; i++)
-        {
-            decodedHsfParm.mSignature.push_back(
-                sDecodedAsn->signature->data[i]);
-        }
-        json_object* sJson =
-            json_tokener_parse((const char*)sDecodedAsn->sourceFileData->data);
+        json_object* sJson = json_tokener_parse(sPayload.c_str());
 
         if (!sJson)
         {
@@ -702,10 +819,6 @@ CeLogin::CeLoginRc CeLogin::decodeAndVerifyCeLoginHsfV2(
         }
     }
 
-    if (sDecodedAsn)
-    {
-        CELoginSequenceV1_free(sDecodedAsn);
-    }
     return sRc;
 }
 
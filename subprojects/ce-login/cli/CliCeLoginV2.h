@@ -57,6 +57,13 @@ CeLoginRc
                               std::string& generatedAcfParm,
                               std::vector<uint8_t>& generatedPayloadHashParm);
 
+/// Payloads of several ACFs, the password hashes of all of them derived
+/// together with createPasswordHashes
+CeLoginRc createCeLoginAcfV2Payloads(
+    const std::vector<CeLoginCreateHsfArgsV2>& argsParm,
+    std::vector<std::string>& generatedJsonParm,
+    std::vector<std::vector<uint8_t>>& generatedPayloadHashParm);
+
 CeLoginRc
     createCeLoginAcfV2Signature(const CeLoginCreateHsfArgsV2& argsParm,
                                 const std::vector<uint8_t>& jsonDigestParm,
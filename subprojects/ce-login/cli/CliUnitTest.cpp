@@ -1,5 +1,6 @@
 #include "CliUnitTest.h"
 
+#include "../celogin/src/CeLoginJson.h"
 #include "../celogin/src/CeLoginUtil.h"
 #include "CliCeLoginV1.h"
 #include "CliCeLoginV2.h"
@@ -11,9 +12,16 @@ using cli::P10;
 using cli::P11;
 
 #include <CeLogin.h>
+#include <limits.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+#include <openssl/x509.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <array>
+#include <atomic>
 #include <iostream>
 #include <vector>
 
@@ -578,6 +586,32 @@ CeLoginRc cplusplus_getServiceAuthorityV1(
         expirationParm);
 }
 
+// Counts the allocations made through OpenSSL, which ce-login uses for its
+// own allocations as well. OpenSSL only allows replacing the allocation
+// functions before its first allocation, so they are installed first thing
+// when the unit tests start, and the other commands keep the defaults. The
+// count is atomic in case a test uses threads.
+static std::atomic<uint64_t> sOpensslAllocations(0);
+
+static void* countingMalloc(size_t sizeParm, const char*, int)
+{
+    sOpensslAllocations++;
+    return malloc(sizeParm);
+}
+
+static void* countingRealloc(void* ptrParm, size_t sizeParm, const char*, int)
+{
+    sOpensslAllocations++;
+    return realloc(ptrParm, sizeParm);
+}
+
+static void countingFree(void* ptrParm, const char*, int)
+{
+    free(ptrParm);
+}
+
+static bool sAllocationCounterInstalled = false;
+
 static CeLogin::CeLoginCreateHsfArgsV1 GetDefaultHsfArgs();
 static CeLogin::CeLoginCreateHsfArgsV1 GetDefaultHsfArgsP11();
 
@@ -598,11 +632,36 @@ static UnitTestResult ut_acf_metadata_v2();
 static UnitTestResult ut_powervm();
 static UnitTestResult ut_acf_resource_dump_v2();
 static UnitTestResult ut_acf_bmc_shell_v2();
+static UnitTestResult ut_acf_auth_record_v2();
+static UnitTestResult ut_acf_parsed_public_key_v2();
+static UnitTestResult ut_acf_verified_record_v2();
+static UnitTestResult ut_acf_multi_key_v2();
+static UnitTestResult ut_acf_verifier_v2();
+static UnitTestResult ut_asn_view_v1();
+static UnitTestResult ut_json_root_fields();
+static UnitTestResult ut_json_many_machines();
+static UnitTestResult ut_jsmn_subtree_ends();
+static UnitTestResult ut_jsmn_find_string();
+static UnitTestResult ut_json_machine_prescan();
+static UnitTestResult ut_expiration_days_from_civil();
+static UnitTestResult ut_hex_codec();
+static UnitTestResult ut_base64_codec();
+static UnitTestResult ut_arena();
+static UnitTestResult ut_arena_v2();
+static UnitTestResult ut_call_arena_v2();
+static UnitTestResult ut_user_fields_view_v2();
+static UnitTestResult ut_upload_stream_v2();
+static UnitTestResult ut_password_hashes();
+static UnitTestResult ut_password_hash_control();
 
 void cli::unit_test_main(int argc, char** argv)
 {
     UnitTestResult sResults;
 
+    sAllocationCounterInstalled =
+        1 == CRYPTO_set_mem_functions(countingMalloc, countingRealloc,
+                                      countingFree);
+
     sResults += ut_validate_defaults();
     sResults += ut_invalid_parms();
     sResults += ut_validate_unset_serial();
@@ -620,6 +679,27 @@ void cli::unit_test_main(int argc, char** argv)
     sResults += ut_powervm();
     sResults += ut_acf_resource_dump_v2();
     sResults += ut_acf_bmc_shell_v2();
+    sResults += ut_acf_auth_record_v2();
+    sResults += ut_acf_parsed_public_key_v2();
+    sResults += ut_acf_verified_record_v2();
+    sResults += ut_acf_multi_key_v2();
+    sResults += ut_acf_verifier_v2();
+    sResults += ut_asn_view_v1();
+    sResults += ut_json_root_fields();
+    sResults += ut_json_many_machines();
+    sResults += ut_jsmn_subtree_ends();
+    sResults += ut_jsmn_find_string();
+    sResults += ut_json_machine_prescan();
+    sResults += ut_expiration_days_from_civil();
+    sResults += ut_hex_codec();
+    sResults += ut_base64_codec();
+    sResults += ut_arena();
+    sResults += ut_arena_v2();
+    sResults += ut_call_arena_v2();
+    sResults += ut_user_fields_view_v2();
+    sResults += ut_upload_stream_v2();
+    sResults += ut_password_hashes();
+    sResults += ut_password_hash_control();
 
     std::cout << std::dec << sResults.mFailedTests << " failures out of "
               << std::dec << sResults.mTotalTests << " total tests run"
@@ -1643,7 +1723,8 @@ UnitTestResult ut_invalid_parms()
             sHsfArgs.mMachines.front().mSerialNumber.data(),
             sHsfArgs.mMachines.front().mSerialNumber.length(), sAuth,
             sExpirationTime);
-        DO_TEST(sResult, CeLoginRc::GetSevAuth_InvalidPasswordPtr == sRc, sRc);
+        DO_TEST(sResult, !sRc.isSuccess(), sRc);
+        DO_TEST(sResult, CeLoginRc::PasswordHashStopped != sRc, sRc);
         DO_TEST(sResult, sAuth == ServiceAuth_None, sAuth);
         DO_TEST(sResult, 0 == sExpirationTime, sExpirationTime);
     }
@@ -2578,6 +2659,8 @@ UnitTestResult ut_acf_bmc_shell_v2()
     sHsfArgsV2.mV1Args = sHsfArgs;
     sHsfArgsV2.mNoReplayId = false;
     sHsfArgsV2.mType = "bmcshell";
+    sHsfArgsV2.mBmcTimeout = 60;
+    sHsfArgsV2.mIssueBmcDump = false;
     sExistingReplayId = 0;
     sReplayId = 0;
 
@@ -2673,3 +2756,2476 @@ UnitTestResult ut_acf_bmc_shell_v2()
 #endif
     return sResult;
 }
+
+UnitTestResult ut_acf_auth_record_v2()
+{
+    UnitTestResult sResult;
+#ifndef CELOGIN_POWERVM_TARGET
+    CeLoginRc sRc = CeLoginRc::Success;
+
+    CeLoginCreateHsfArgsV1 sHsfArgs = GetDefaultHsfArgs();
+    CeLoginCreateHsfArgsV2 sHsfArgsV2;
+    std::vector<uint8_t> sAcf;
+
+    const std::string& sSerial = sHsfArgs.mMachines.front().mSerialNumber;
+
+    //
+    // Service ACF v2 with replay ID
+    //
+    sHsfArgsV2.mV1Args = sHsfArgs;
+    sHsfArgsV2.mNoReplayId = false;
+    sHsfArgsV2.mType = "service";
+
+    sRc = createCeLoginAcfV2(sHsfArgsV2, sAcf);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+    uint64_t sReplayId = 0;
+    uint64_t sExp = 0;
+    AcfType sType;
+    sRc = CeLogin::verifyACFForBMCUploadV2(
+        sAcf.data(), sAcf.size(), 0, key1_pub_der, key1_pub_der_len,
+        sSerial.c_str(), sSerial.length(), 0, sReplayId, sType, sExp);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+    AcfAuthRecord sRecord;
+    sRc = getAcfAuthRecordV2(sAcf.data(), sAcf.size(), 0, key1_pub_der,
+                             key1_pub_der_len, sSerial.c_str(),
+                             sSerial.length(), sRecord);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+    DO_TEST(sResult, sRecord.mType == AcfType_Service, sRecord.mType);
+    DO_TEST(sResult, sRecord.mReplayIdPresent, sRecord.mReplayIdPresent);
+    DO_TEST(sResult, sRecord.mReplayId == sReplayId, sRecord.mReplayId);
+    DO_TEST(sResult, sRecord.mExpirationTime == sExp, sRecord.mExpirationTime);
+
+    // The record must produce the same result as the full interface
+    AcfUserFields sExpectedFields;
+    sRc = checkAuthorizationAndGetAcfUserFieldsV2(
+        sAcf.data(), sAcf.size(), sHsfArgs.mPasswordPtr,
+        sHsfArgs.mPasswordLength, 0, key1_pub_der, key1_pub_der_len,
+        sSerial.c_str(), sSerial.length(), sReplayId, sExpectedFields);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+    AcfUserFields sFields;
+    sRc = checkAuthorizationWithAcfAuthRecordV2(
+        sRecord, sHsfArgs.mPasswordPtr, sHsfArgs.mPasswordLength, 0,
+        sReplayId, sFields);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+    DO_TEST(sResult, sFields.mVersion == sExpectedFields.mVersion,
+            sFields.mVersion);
+    DO_TEST(sResult, sFields.mType == sExpectedFields.mType, sFields.mType);
+    DO_TEST(sResult,
+            sFields.mExpirationTime == sExpectedFields.mExpirationTime,
+            sFields.mExpirationTime);
+    DO_TEST(sResult,
+            sFields.mTypeSpecificFields.mServiceFields.mAuth ==
+                sExpectedFields.mTypeSpecificFields.mServiceFields.mAuth,
+            sFields.mTypeSpecificFields.mServiceFields.mAuth);
+
+    // Wrong password
+    sRc = checkAuthorizationWithAcfAuthRecordV2(sRecord, "wrong", 5, 0,
+                                                sReplayId, sFields);
+    DO_TEST(sResult, CeLoginRc::PasswordNotValid == sRc, sRc);
+
+    // Missing password
+    sRc = checkAuthorizationWithAcfAuthRecordV2(sRecord, NULL, 0, 0, sReplayId,
+                                                sFields);
+    DO_TEST(sResult, CeLoginRc::GetSevAuth_InvalidPasswordPtr == sRc, sRc);
+
+    // Expired since the record was created
+    sRc = checkAuthorizationWithAcfAuthRecordV2(
+        sRecord, sHsfArgs.mPasswordPtr, sHsfArgs.mPasswordLength,
+        sRecord.mExpirationTime + 1, sReplayId, sFields);
+    DO_TEST(sResult, CeLoginRc::AcfExpired == sRc, sRc);
+
+    // Replay ID must match exactly
+    sRc = checkAuthorizationWithAcfAuthRecordV2(
+        sRecord, sHsfArgs.mPasswordPtr, sHsfArgs.mPasswordLength, 0,
+        sReplayId + 1, sFields);
+    DO_TEST(sResult, CeLoginRc::ReplayIdPersistenceFailure == sRc, sRc);
+
+    // A corrupted record must not be used
+    AcfAuthRecord sBadRecord = sRecord;
+    sBadRecord.mHashedAuthCodeLength = sizeof(sBadRecord.mHashedAuthCode) + 1;
+    sRc = checkAuthorizationWithAcfAuthRecordV2(
+        sBadRecord, sHsfArgs.mPasswordPtr, sHsfArgs.mPasswordLength, 0,
+        sReplayId, sFields);
+    DO_TEST(sResult, CeLoginRc::Success != sRc, sRc);
+
+    // Wrong key
+    sRc = getAcfAuthRecordV2(sAcf.data(), sAcf.size(), 0, key2_pub_der,
+                             key2_pub_der_len, sSerial.c_str(),
+                             sSerial.length(), sRecord);
+    DO_TEST(sResult, CeLoginRc::Success != sRc, sRc);
+    DO_TEST(sResult, sRecord.mType == AcfType_Invalid, sRecord.mType);
+
+    //
+    // Only service ACFs produce a record
+    //
+    sHsfArgsV2.mType = "adminreset";
+    sRc = createCeLoginAcfV2(sHsfArgsV2, sAcf);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+    sRc = getAcfAuthRecordV2(sAcf.data(), sAcf.size(), 0, key1_pub_der,
+                             key1_pub_der_len, sSerial.c_str(),
+                             sSerial.length(), sRecord);
+    DO_TEST(sResult, CeLoginRc::UnsupportedAcfType == sRc, sRc);
+#endif
+    return sResult;
+}
+
+UnitTestResult ut_acf_parsed_public_key_v2()
+{
+    UnitTestResult sResult;
+#ifndef CELOGIN_POWERVM_TARGET
+    CeLoginRc sRc = CeLoginRc::Success;
+
+    CeLoginCreateHsfArgsV1 sHsfArgs = GetDefaultHsfArgs();
+    CeLoginCreateHsfArgsV2 sHsfArgsV2;
+    std::vector<uint8_t> sAcf;
+
+    const std::string& sSerial = sHsfArgs.mMachines.front().mSerialNumber;
+
+    const uint8_t* sKey1Der = key1_pub_der;
+    const uint8_t* sKey2Der = key2_pub_der;
+    EVP_PKEY* sKey1 = d2i_PUBKEY(NULL, &sKey1Der, key1_pub_der_len);
+    EVP_PKEY* sKey2 = d2i_PUBKEY(NULL, &sKey2Der, key2_pub_der_len);
+    DO_TEST(sResult, NULL != sKey1, 0);
+    DO_TEST(sResult, NULL != sKey2, 0);
+
+    sHsfArgsV2.mV1Args = sHsfArgs;
+    sHsfArgsV2.mNoReplayId = false;
+    sHsfArgsV2.mType = "service";
+
+    sRc = createCeLoginAcfV2(sHsfArgsV2, sAcf);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+    // Each parsed key interface matches its DER encoded counterpart, and
+    // the key can be reused across calls
+    for (int sPass = 0; sPass < 2 && sKey1 && sKey2; sPass++)
+    {
+        uint64_t sReplayId = 0;
+        uint64_t sExp = 0;
+        AcfType sType = AcfType_Invalid;
+        sRc = verifyACFForBMCUploadV2(sAcf.data(), sAcf.size(), 0, sKey1,
+                                      sSerial.c_str(), sSerial.length(), 0,
+                                      sReplayId, sType, sExp);
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+        DO_TEST(sResult, AcfType_Service == sType, sType);
+
+        uint64_t sDerReplayId = 0;
+        uint64_t sDerExp = 0;
+        sRc = verifyACFForBMCUploadV2(
+            sAcf.data(), sAcf.size(), 0, key1_pub_der, key1_pub_der_len,
+            sSerial.c_str(), sSerial.length(), 0, sDerReplayId, sType,
+            sDerExp);
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+        DO_TEST(sResult, sDerReplayId == sReplayId, sReplayId);
+        DO_TEST(sResult, sDerExp == sExp, sExp);
+
+        CeLogin_Date sDate;
+        AcfVersion sVersion = CeLoginInvalidVersion;
+        bool sHasReplayId = false;
+        sRc = extractACFMetadataV2(sAcf.data(), sAcf.size(), 0, sKey1,
+                                   sSerial.c_str(), sSerial.length(), sType,
+                                   sExp, sDate, sVersion, sHasReplayId);
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+        DO_TEST(sResult, CeLoginVersion2 == sVersion, sVersion);
+        DO_TEST(sResult, sHasReplayId, sHasReplayId);
+        DO_TEST(sResult, sDerExp == sExp, sExp);
+
+        AcfUserFields sFields;
+        sRc = checkAuthorizationAndGetAcfUserFieldsV2(
+            sAcf.data(), sAcf.size(), sHsfArgs.mPasswordPtr,
+            sHsfArgs.mPasswordLength, 0, sKey1, sSerial.c_str(),
+            sSerial.length(), sReplayId, sFields);
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+        DO_TEST(sResult, AcfType_Service == sFields.mType, sFields.mType);
+
+        sRc = checkAuthorizationAndGetAcfUserFieldsV2(
+            sAcf.data(), sAcf.size(), "wrong", 5, 0, sKey1, sSerial.c_str(),
+            sSerial.length(), sReplayId, sFields);
+        DO_TEST(sResult, CeLoginRc::PasswordNotValid == sRc, sRc);
+
+        AcfAuthRecord sRecord;
+        sRc = getAcfAuthRecordV2(sAcf.data(), sAcf.size(), 0, sKey1,
+                                 sSerial.c_str(), sSerial.length(), sRecord);
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+        DO_TEST(sResult, sRecord.mReplayId == sReplayId, sRecord.mReplayId);
+
+        // Wrong key
+        sRc = verifyACFForBMCUploadV2(sAcf.data(), sAcf.size(), 0, sKey2,
+                                      sSerial.c_str(), sSerial.length(), 0,
+                                      sReplayId, sType, sExp);
+        DO_TEST(sResult, CeLoginRc::SignatureNotValid == sRc, sRc);
+
+        sRc = getAcfAuthRecordV2(sAcf.data(), sAcf.size(), 0, sKey2,
+                                 sSerial.c_str(), sSerial.length(), sRecord);
+        DO_TEST(sResult, CeLoginRc::SignatureNotValid == sRc, sRc);
+    }
+
+    // Missing key
+    uint64_t sReplayId = 0;
+    uint64_t sExp = 0;
+    AcfType sType = AcfType_Invalid;
+    sRc = verifyACFForBMCUploadV2(sAcf.data(), sAcf.size(), 0, (EVP_PKEY*)NULL,
+                                  sSerial.c_str(), sSerial.length(), 0,
+                                  sReplayId, sType, sExp);
+    DO_TEST(sResult, CeLoginRc::GetSevAuth_InvalidPublicKeyPtr == sRc, sRc);
+
+    EVP_PKEY_free(sKey1);
+    EVP_PKEY_free(sKey2);
+#endif
+    return sResult;
+}
+
+UnitTestResult ut_acf_verified_record_v2()
+{
+    UnitTestResult sResult;
+#ifndef CELOGIN_POWERVM_TARGET
+    CeLoginRc sRc = CeLoginRc::Success;
+
+    CeLoginCreateHsfArgsV1 sHsfArgs = GetDefaultHsfArgs();
+    CeLoginCreateHsfArgsV2 sHsfArgsV2;
+    std::vector<uint8_t> sAcf;
+
+    const std::string& sSerial = sHsfArgs.mMachines.front().mSerialNumber;
+
+    const char* sTypes[] = {"service", "adminreset", "resourcedump",
+                            "bmcshell"};
+
+    // The single pass interface must agree with the three interfaces it
+    // replaces for every ACF type, with and without a replay ID
+    for (size_t sTypeIdx = 0; sTypeIdx < sizeof(sTypes) / sizeof(sTypes[0]);
+         sTypeIdx++)
+    {
+        for (int sNoReplayId = 0; sNoReplayId < 2; sNoReplayId++)
+        {
+            sHsfArgsV2.mV1Args = sHsfArgs;
+            sHsfArgsV2.mNoReplayId = sNoReplayId;
+            sHsfArgsV2.mType = sTypes[sTypeIdx];
+            sHsfArgsV2.mScript = "script command;";
+            sHsfArgsV2.mBmcTimeout = 60;
+            sHsfArgsV2.mIssueBmcDump = false;
+
+            sRc = createCeLoginAcfV2(sHsfArgsV2, sAcf);
+            DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+            uint64_t sExistingReplayId = 0;
+            uint64_t sUpdatedReplayId = 0;
+            AcfType sType = AcfType_Invalid;
+            uint64_t sExp = 0;
+            sRc = verifyACFForBMCUploadV2(
+                sAcf.data(), sAcf.size(), 0, key1_pub_der, key1_pub_der_len,
+                sSerial.c_str(), sSerial.length(), sExistingReplayId,
+                sUpdatedReplayId, sType, sExp);
+            DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+            bool sIsService = AcfType_Service == sType;
+            AcfUserFields sFields;
+            sRc = checkAuthorizationAndGetAcfUserFieldsV2(
+                sAcf.data(), sAcf.size(),
+                sIsService ? sHsfArgs.mPasswordPtr : NULL,
+                sIsService ? sHsfArgs.mPasswordLength : 0, 0, key1_pub_der,
+                key1_pub_der_len, sSerial.c_str(), sSerial.length(),
+                sUpdatedReplayId, sFields);
+            DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+            AcfType sMetaType = AcfType_Invalid;
+            uint64_t sMetaExp = 0;
+            CeLogin_Date sDate;
+            AcfVersion sVersion = CeLoginInvalidVersion;
+            bool sHasReplayId = false;
+            sRc = extractACFMetadataV2(
+                sAcf.data(), sAcf.size(), 0, key1_pub_der, key1_pub_der_len,
+                sSerial.c_str(), sSerial.length(), sMetaType, sMetaExp, sDate,
+                sVersion, sHasReplayId);
+            DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+            AcfVerifiedRecord sRecord;
+            sRc = getAcfVerifiedRecordV2(
+                sAcf.data(), sAcf.size(), 0, key1_pub_der, key1_pub_der_len,
+                sSerial.c_str(), sSerial.length(), sExistingReplayId,
+                sRecord);
+            DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+            DO_TEST(sResult, sRecord.mType == sType, sRecord.mType);
+            DO_TEST(sResult, sRecord.mVersion == sVersion, sRecord.mVersion);
+            DO_TEST(sResult, sRecord.mExpirationTime == sExp,
+                    sRecord.mExpirationTime);
+            DO_TEST(sResult, sRecord.mExpirationDate.mYear == sDate.mYear,
+                    sRecord.mExpirationDate.mYear);
+            DO_TEST(sResult, sRecord.mExpirationDate.mMonth == sDate.mMonth,
+                    sRecord.mExpirationDate.mMonth);
+            DO_TEST(sResult, sRecord.mExpirationDate.mDay == sDate.mDay,
+                    sRecord.mExpirationDate.mDay);
+            DO_TEST(sResult, sRecord.mReplayIdPresent == sHasReplayId,
+                    sRecord.mReplayIdPresent);
+            DO_TEST(sResult, sRecord.mReplayIdPresent == !sNoReplayId,
+                    sRecord.mReplayIdPresent);
+            DO_TEST(sResult, sRecord.mUpdatedReplayId == sUpdatedReplayId,
+                    sRecord.mUpdatedReplayId);
+            DO_TEST(sResult, sRecord.mUserFields.mType == sFields.mType,
+                    sRecord.mUserFields.mType);
+            DO_TEST(sResult,
+                    sRecord.mUserFields.mExpirationTime ==
+                        sFields.mExpirationTime,
+                    sRecord.mUserFields.mExpirationTime);
+            DO_TEST(sResult,
+                    0 == memcmp(&sRecord.mUserFields.mTypeSpecificFields,
+                                &sFields.mTypeSpecificFields,
+                                sizeof(sFields.mTypeSpecificFields)),
+                    sType);
+
+            // A replay ID that was already used is rejected like at upload
+            if (sRecord.mReplayIdPresent)
+            {
+                sRc = getAcfVerifiedRecordV2(
+                    sAcf.data(), sAcf.size(), 0, key1_pub_der,
+                    key1_pub_der_len, sSerial.c_str(), sSerial.length(),
+                    sRecord.mReplayId + 1, sRecord);
+                DO_TEST(sResult, CeLoginRc::InvalidReplayId == sRc, sRc);
+                DO_TEST(sResult, AcfType_Invalid == sRecord.mType,
+                        sRecord.mType);
+            }
+        }
+    }
+
+    // Wrong key, using the parsed public key interface
+    const uint8_t* sKey2Der = key2_pub_der;
+    EVP_PKEY* sKey2 = d2i_PUBKEY(NULL, &sKey2Der, key2_pub_der_len);
+    DO_TEST(sResult, NULL != sKey2, 0);
+
+    AcfVerifiedRecord sRecord;
+    sRc = getAcfVerifiedRecordV2(sAcf.data(), sAcf.size(), 0, sKey2,
+                                 sSerial.c_str(), sSerial.length(), 0,
+                                 sRecord);
+    DO_TEST(sResult, CeLoginRc::SignatureNotValid == sRc, sRc);
+    DO_TEST(sResult, AcfType_Invalid == sRecord.mType, sRecord.mType);
+
+    EVP_PKEY_free(sKey2);
+#endif
+    return sResult;
+}
+
+UnitTestResult ut_acf_multi_key_v2()
+{
+    UnitTestResult sResult;
+#ifndef CELOGIN_POWERVM_TARGET
+    CeLoginRc sRc = CeLoginRc::Success;
+
+    CeLoginCreateHsfArgsV1 sHsfArgs = GetDefaultHsfArgs();
+    CeLoginCreateHsfArgsV2 sHsfArgsV2;
+    std::vector<uint8_t> sAcf;
+
+    const std::string& sSerial = sHsfArgs.mMachines.front().mSerialNumber;
+
+    const uint8_t* sKey1Der = key1_pub_der;
+    const uint8_t* sKey2Der = key2_pub_der;
+    EVP_PKEY* sKey1 = d2i_PUBKEY(NULL, &sKey1Der, key1_pub_der_len);
+    EVP_PKEY* sKey2 = d2i_PUBKEY(NULL, &sKey2Der, key2_pub_der_len);
+    DO_TEST(sResult, NULL != sKey1, 0);
+    DO_TEST(sResult, NULL != sKey2, 0);
+
+    sHsfArgsV2.mV1Args = sHsfArgs;
+    sHsfArgsV2.mNoReplayId = false;
+    sHsfArgsV2.mType = "service";
+
+    sRc = createCeLoginAcfV2(sHsfArgsV2, sAcf);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+    EVP_PKEY* sSecondMatches[] = {sKey2, sKey1};
+    EVP_PKEY* sFirstMatches[] = {sKey1, sKey2};
+    EVP_PKEY* sNoneMatch[] = {sKey2, sKey2};
+    EVP_PKEY* sWithNull[] = {sKey2, NULL};
+
+    // The matching key is reported wherever it is in the list
+    uint64_t sKeyIndex = 0;
+    AcfAuthRecord sRecord;
+    sRc = getAcfAuthRecordV2(sAcf.data(), sAcf.size(), 0, sSecondMatches, 2,
+                             sSerial.c_str(), sSerial.length(), sRecord,
+                             sKeyIndex);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+    DO_TEST(sResult, 1 == sKeyIndex, sKeyIndex);
+    DO_TEST(sResult, AcfType_Service == sRecord.mType, sRecord.mType);
+
+    sRc = getAcfAuthRecordV2(sAcf.data(), sAcf.size(), 0, sFirstMatches, 2,
+                             sSerial.c_str(), sSerial.length(), sRecord,
+                             sKeyIndex);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+    DO_TEST(sResult, 0 == sKeyIndex, sKeyIndex);
+
+    sRc = getAcfAuthRecordV2(sAcf.data(), sAcf.size(), 0, sNoneMatch, 2,
+                             sSerial.c_str(), sSerial.length(), sRecord,
+                             sKeyIndex);
+    DO_TEST(sResult, CeLoginRc::SignatureNotValid == sRc, sRc);
+    DO_TEST(sResult, 2 == sKeyIndex, sKeyIndex);
+
+    // A failure after the signature check still reports the key
+    sRc = getAcfAuthRecordV2(sAcf.data(), sAcf.size(), UINT64_MAX,
+                             sSecondMatches, 2, sSerial.c_str(),
+                             sSerial.length(), sRecord, sKeyIndex);
+    DO_TEST(sResult, CeLoginRc::AcfExpired == sRc, sRc);
+    DO_TEST(sResult, 1 == sKeyIndex, sKeyIndex);
+
+    // Invalid key lists
+    sRc = getAcfAuthRecordV2(sAcf.data(), sAcf.size(), 0, sWithNull, 2,
+                             sSerial.c_str(), sSerial.length(), sRecord,
+                             sKeyIndex);
+    DO_TEST(sResult, CeLoginRc::GetSevAuth_InvalidPublicKeyPtr == sRc, sRc);
+    DO_TEST(sResult, 2 == sKeyIndex, sKeyIndex);
+
+    sRc = getAcfAuthRecordV2(sAcf.data(), sAcf.size(), 0, sSecondMatches, 0,
+                             sSerial.c_str(), sSerial.length(), sRecord,
+                             sKeyIndex);
+    DO_TEST(sResult, CeLoginRc::GetSevAuth_InvalidPublicKeyPtr == sRc, sRc);
+    DO_TEST(sResult, 0 == sKeyIndex, sKeyIndex);
+
+    // The other multiple key interfaces
+    AcfVerifiedRecord sVerified;
+    sRc = getAcfVerifiedRecordV2(sAcf.data(), sAcf.size(), 0, sSecondMatches,
+                                 2, sSerial.c_str(), sSerial.length(), 0,
+                                 sVerified, sKeyIndex);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+    DO_TEST(sResult, 1 == sKeyIndex, sKeyIndex);
+    DO_TEST(sResult, AcfType_Service == sVerified.mType, sVerified.mType);
+
+    AcfType sType = AcfType_Invalid;
+    uint64_t sExp = 0;
+    CeLogin_Date sDate;
+    AcfVersion sVersion = CeLoginInvalidVersion;
+    bool sHasReplayId = false;
+    sRc = extractACFMetadataV2(sAcf.data(), sAcf.size(), 0, sSecondMatches, 2,
+                               sSerial.c_str(), sSerial.length(), sType, sExp,
+                               sDate, sVersion, sHasReplayId, sKeyIndex);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+    DO_TEST(sResult, 1 == sKeyIndex, sKeyIndex);
+    DO_TEST(sResult, sExp == sVerified.mExpirationTime, sExp);
+
+    sRc = extractACFMetadataV2(sAcf.data(), sAcf.size(), 0, sNoneMatch, 2,
+                               sSerial.c_str(), sSerial.length(), sType, sExp,
+                               sDate, sVersion, sHasReplayId, sKeyIndex);
+    DO_TEST(sResult, CeLoginRc::SignatureNotValid == sRc, sRc);
+    DO_TEST(sResult, 2 == sKeyIndex, sKeyIndex);
+
+    EVP_PKEY_free(sKey1);
+    EVP_PKEY_free(sKey2);
+#endif
+    return sResult;
+}
+
+UnitTestResult ut_acf_verifier_v2()
+{
+    UnitTestResult sResult;
+#ifndef CELOGIN_POWERVM_TARGET
+    CeLoginRc sRc = CeLoginRc::Success;
+
+    CeLoginCreateHsfArgsV1 sHsfArgs = GetDefaultHsfArgs();
+    CeLoginCreateHsfArgsV2 sHsfArgsV2;
+    std::vector<uint8_t> sAcf;
+
+    const std::string& sSerial = sHsfArgs.mMachines.front().mSerialNumber;
+
+    const uint8_t* sKey1Der = key1_pub_der;
+    const uint8_t* sKey2Der = key2_pub_der;
+    EVP_PKEY* sKey1 = d2i_PUBKEY(NULL, &sKey1Der, key1_pub_der_len);
+    EVP_PKEY* sKey2 = d2i_PUBKEY(NULL, &sKey2Der, key2_pub_der_len);
+    DO_TEST(sResult, NULL != sKey1, 0);
+    DO_TEST(sResult, NULL != sKey2, 0);
+
+    sHsfArgsV2.mV1Args = sHsfArgs;
+    sHsfArgsV2.mNoReplayId = false;
+    sHsfArgsV2.mType = "service";
+
+    sRc = createCeLoginAcfV2(sHsfArgsV2, sAcf);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+    EVP_PKEY* sKeys[] = {sKey2, sKey1};
+    EVP_PKEY* sWithNull[] = {sKey2, NULL};
+
+    // Invalid key lists leave the verifier without keys
+    CeLoginVerifier sVerifier;
+    sRc = sVerifier.setPublicKeys(sWithNull, 2);
+    DO_TEST(sResult, CeLoginRc::GetSevAuth_InvalidPublicKeyPtr == sRc, sRc);
+    DO_TEST(sResult, 0 == sVerifier.getPublicKeyCount(),
+            sVerifier.getPublicKeyCount());
+
+    uint64_t sKeyIndex = 0;
+    AcfAuthRecord sRecord;
+    sRc = getAcfAuthRecordV2(sAcf.data(), sAcf.size(), 0, sVerifier,
+                             sSerial.c_str(), sSerial.length(), sRecord,
+                             sKeyIndex);
+    DO_TEST(sResult, CeLoginRc::GetSevAuth_InvalidPublicKeyPtr == sRc, sRc);
+
+    sRc = sVerifier.setPublicKeys(sKeys, 0);
+    DO_TEST(sResult, CeLoginRc::GetSevAuth_InvalidPublicKeyPtr == sRc, sRc);
+
+    sRc = sVerifier.setPublicKeys(sKeys, 2);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+    DO_TEST(sResult, 2 == sVerifier.getPublicKeyCount(),
+            sVerifier.getPublicKeyCount());
+
+    // The same verifier can be used for every interface, any number of times
+    for (int sIdx = 0; sIdx < 3; sIdx++)
+    {
+        sRc = getAcfAuthRecordV2(sAcf.data(), sAcf.size(), 0, sVerifier,
+                                 sSerial.c_str(), sSerial.length(), sRecord,
+                                 sKeyIndex);
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+        DO_TEST(sResult, 1 == sKeyIndex, sKeyIndex);
+        DO_TEST(sResult, AcfType_Service == sRecord.mType, sRecord.mType);
+    }
+
+    AcfVerifiedRecord sVerified;
+    sRc = getAcfVerifiedRecordV2(sAcf.data(), sAcf.size(), 0, sVerifier,
+                                 sSerial.c_str(), sSerial.length(), 0,
+                                 sVerified, sKeyIndex);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+    DO_TEST(sResult, 1 == sKeyIndex, sKeyIndex);
+    DO_TEST(sResult, sRecord.mReplayId == sVerified.mReplayId,
+            sVerified.mReplayId);
+
+    AcfType sType = AcfType_Invalid;
+    uint64_t sExp = 0;
+    CeLogin_Date sDate;
+    AcfVersion sVersion = CeLoginInvalidVersion;
+    bool sHasReplayId = false;
+    sRc = extractACFMetadataV2(sAcf.data(), sAcf.size(), 0, sVerifier,
+                               sSerial.c_str(), sSerial.length(), sType, sExp,
+                               sDate, sVersion, sHasReplayId, sKeyIndex);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+    DO_TEST(sResult, 1 == sKeyIndex, sKeyIndex);
+    DO_TEST(sResult, sHasReplayId, sHasReplayId);
+
+    // A failed check does not leave state behind for the next ACF
+    sRc = getAcfAuthRecordV2(sAcf.data(), sAcf.size(), UINT64_MAX, sVerifier,
+                             sSerial.c_str(), sSerial.length(), sRecord,
+                             sKeyIndex);
+    DO_TEST(sResult, CeLoginRc::AcfExpired == sRc, sRc);
+    DO_TEST(sResult, AcfType_Invalid == sRecord.mType, sRecord.mType);
+
+    // Replacing the keys drops the contexts of the previous keys
+    sRc = sVerifier.setPublicKeys(sKeys, 1);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+    sRc = getAcfAuthRecordV2(sAcf.data(), sAcf.size(), 0, sVerifier,
+                             sSerial.c_str(), sSerial.length(), sRecord,
+                             sKeyIndex);
+    DO_TEST(sResult, CeLoginRc::SignatureNotValid == sRc, sRc);
+    DO_TEST(sResult, 1 == sKeyIndex, sKeyIndex);
+
+    sRc = sVerifier.setPublicKeys(sKeys, 2);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+    sRc = getAcfAuthRecordV2(sAcf.data(), sAcf.size(), 0, sVerifier,
+                             sSerial.c_str(), sSerial.length(), sRecord,
+                             sKeyIndex);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+    DO_TEST(sResult, 1 == sKeyIndex, sKeyIndex);
+
+    // Once warmed up, the only allocations left are the ones OpenSSL makes
+    // to check the signature with each key. Decoding the ACF and checking
+    // the expiration date do not allocate.
+    DO_TEST(sResult, sAllocationCounterInstalled, 0);
+
+    uint64_t sStart = sOpensslAllocations;
+    CELoginSequenceV1View sAsn;
+    DO_TEST(sResult,
+            decodeCELoginSequenceV1View(sAcf.data(), sAcf.size(), sAsn), 0);
+    DO_TEST(sResult, sStart == sOpensslAllocations, sOpensslAllocations);
+    uint8_t sDigest[SHA512_DIGEST_LENGTH];
+    SHA512(sAsn.sourceFileData.data, sAsn.sourceFileData.length, sDigest);
+    sRc = sVerifier.verifySignature(sAsn.signature.data, sAsn.signature.length,
+                                    sDigest, sizeof(sDigest), sKeyIndex);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+    CeLoginJsonData sJsonData;
+    sJsonData.mExpirationDate = sDate;
+    const uint64_t sBeforeExpiration = sOpensslAllocations;
+    sRc = isTimeExpired(&sJsonData, sExp, 0);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+    DO_TEST(sResult, sBeforeExpiration == sOpensslAllocations,
+            sOpensslAllocations);
+    const uint64_t sOpensslOnly = sOpensslAllocations - sStart;
+
+    sStart = sOpensslAllocations;
+    sRc = getAcfAuthRecordV2(sAcf.data(), sAcf.size(), 0, sVerifier,
+                             sSerial.c_str(), sSerial.length(), sRecord,
+                             sKeyIndex);
+    const uint64_t sWithVerifier = sOpensslAllocations - sStart;
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+    DO_TEST(sResult, sOpensslOnly == sWithVerifier, sWithVerifier);
+
+    sStart = sOpensslAllocations;
+    sRc = getAcfVerifiedRecordV2(sAcf.data(), sAcf.size(), 0, sVerifier,
+                                 sSerial.c_str(), sSerial.length(), 0,
+                                 sVerified, sKeyIndex);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+    DO_TEST(sResult, sOpensslOnly == sOpensslAllocations - sStart,
+            sOpensslAllocations - sStart);
+
+    // Without a verifier the contexts and scratch storage are set up again
+    // for every ACF
+    sStart = sOpensslAllocations;
+    sRc = getAcfAuthRecordV2(sAcf.data(), sAcf.size(), 0, sKeys, 2,
+                             sSerial.c_str(), sSerial.length(), sRecord,
+                             sKeyIndex);
+    const uint64_t sWithoutVerifier = sOpensslAllocations - sStart;
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+    DO_TEST(sResult, sWithVerifier < sWithoutVerifier, sWithoutVerifier);
+
+    EVP_PKEY_free(sKey1);
+    EVP_PKEY_free(sKey2);
+#endif
+    return sResult;
+}
+
+#ifndef CELOGIN_POWERVM_TARGET
+// Returns true if the view matches the string decoded by OpenSSL
+static bool isSameAsn(const CELoginAsnViewV1& viewParm,
+                      const ASN1_STRING* stringParm)
+{
+    return viewParm.length == (uint64_t)ASN1_STRING_length(stringParm) &&
+           0 == memcmp(viewParm.data, ASN1_STRING_get0_data(stringParm),
+                       viewParm.length);
+}
+
+// Decodes with both the in place decoder and the OpenSSL template decoder.
+// Anything the in place decoder accepts has to be decoded identically by
+// OpenSSL, which may accept more as it also allows BER.
+static bool isSameAsOpenssl(const std::vector<uint8_t>& acfParm,
+                            bool& acceptedParm)
+{
+    CELoginSequenceV1View sView;
+    acceptedParm =
+        decodeCELoginSequenceV1View(acfParm.data(), acfParm.size(), sView);
+
+    const uint8_t* sAcfPtr = acfParm.data();
+    CELoginSequenceV1* sAsn =
+        d2i_CELoginSequenceV1(NULL, &sAcfPtr, acfParm.size());
+
+    bool sSame = !acceptedParm;
+    if (acceptedParm && sAsn)
+    {
+        sSame = isSameAsn(sView.processingType, sAsn->processingType) &&
+                isSameAsn(sView.sourceFileName, sAsn->sourceFileName) &&
+                isSameAsn(sView.sourceFileData, sAsn->sourceFileData) &&
+                isSameAsn(sView.signature, sAsn->signature) &&
+                sView.algorithmId.length ==
+                    OBJ_length(sAsn->algorithm->id) &&
+                0 == memcmp(sView.algorithmId.data,
+                            OBJ_get0_data(sAsn->algorithm->id),
+                            sView.algorithmId.length);
+    }
+    CELoginSequenceV1_free(sAsn);
+
+    return sSame;
+}
+#endif
+
+UnitTestResult ut_asn_view_v1()
+{
+    UnitTestResult sResult;
+#ifndef CELOGIN_POWERVM_TARGET
+    CeLoginRc sRc = CeLoginRc::Success;
+
+    CeLoginCreateHsfArgsV1 sHsfArgs = GetDefaultHsfArgs();
+    CeLoginCreateHsfArgsV2 sHsfArgsV2;
+    std::vector<uint8_t> sAcfV1;
+    std::vector<uint8_t> sAcfV2;
+
+    sRc = createCeLoginAcfV1(sHsfArgs, sAcfV1);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+    sHsfArgsV2.mV1Args = sHsfArgs;
+    sHsfArgsV2.mNoReplayId = false;
+    sHsfArgsV2.mType = "service";
+    sRc = createCeLoginAcfV2(sHsfArgsV2, sAcfV2);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+    const std::vector<uint8_t>* sAcfs[] = {&sAcfV1, &sAcfV2};
+    for (uint64_t sAcfIdx = 0; sAcfIdx < 2; sAcfIdx++)
+    {
+        const std::vector<uint8_t>& sAcf = *sAcfs[sAcfIdx];
+        bool sAccepted = false;
+
+        // Both decoders accept a well formed ACF
+        DO_TEST(sResult, isSameAsOpenssl(sAcf, sAccepted), sAcfIdx);
+        DO_TEST(sResult, sAccepted, sAcfIdx);
+
+        CELoginSequenceV1View sView;
+        DO_TEST(sResult,
+                decodeCELoginSequenceV1View(sAcf.data(), sAcf.size(), sView),
+                sAcfIdx);
+        DO_TEST(sResult,
+                std::string(AcfProcessingType) ==
+                    std::string((const char*)sView.processingType.data,
+                                sView.processingType.length),
+                sAcfIdx);
+
+        // Any data after the sequence is ignored
+        std::vector<uint8_t> sTrailing = sAcf;
+        sTrailing.push_back(0x00);
+        DO_TEST(sResult, isSameAsOpenssl(sTrailing, sAccepted), sAcfIdx);
+        DO_TEST(sResult, sAccepted, sAcfIdx);
+
+        // No truncated ACF is accepted
+        for (uint64_t sLength = 0; sLength < sAcf.size(); sLength++)
+        {
+            std::vector<uint8_t> sTruncated(sAcf.begin(),
+                                            sAcf.begin() + sLength);
+            DO_TEST(sResult, isSameAsOpenssl(sTruncated, sAccepted), sLength);
+            DO_TEST(sResult, !sAccepted, sLength);
+        }
+
+        // Corrupting any byte either fails to decode or decodes the same as
+        // OpenSSL would
+        for (uint64_t sIdx = 0; sIdx < sAcf.size(); sIdx++)
+        {
+            const uint8_t sMasks[] = {0xFF, 0x01, 0x80};
+            for (uint64_t sMask = 0; sMask < sizeof(sMasks); sMask++)
+            {
+                std::vector<uint8_t> sCorrupted = sAcf;
+                sCorrupted[sIdx] ^= sMasks[sMask];
+                DO_TEST(sResult, isSameAsOpenssl(sCorrupted, sAccepted), sIdx);
+            }
+        }
+    }
+
+    // About half of the signatures end with a zero bit, which OpenSSL encodes
+    // as unused bits
+    for (uint64_t sIdx = 0; sIdx < 16; sIdx++)
+    {
+        std::vector<uint8_t> sAcf;
+        sRc = createCeLoginAcfV2(sHsfArgsV2, sAcf);
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+        bool sAccepted = false;
+        DO_TEST(sResult, isSameAsOpenssl(sAcf, sAccepted), sIdx);
+        DO_TEST(sResult, sAccepted, sIdx);
+    }
+
+    // Long form lengths that do not fit are rejected
+    const uint8_t sLongLength[] = {0x30, 0x85, 0x01, 0x00, 0x00, 0x00, 0x00};
+    CELoginSequenceV1View sView;
+    DO_TEST(sResult,
+            !decodeCELoginSequenceV1View(sLongLength, sizeof(sLongLength),
+                                         sView),
+            0);
+    DO_TEST(sResult, !decodeCELoginSequenceV1View(NULL, 0, sView), 0);
+#endif
+    return sResult;
+}
+
+UnitTestResult ut_json_root_fields()
+{
+    UnitTestResult sResult;
+#ifndef CELOGIN_POWERVM_TARGET
+    CeLoginRc sRc = CeLoginRc::Success;
+    const std::string sSerial = "SN0001";
+
+    const std::string sHead = "{\"version\":2,\"type\":\"service\","
+                              "\"machines\":[{\"serialNumber\":\"SN0001\","
+                              "\"frameworkEc\":\"PWR10S\"}],";
+    const std::string sSalt = "\"salt\":\"0011\",";
+    const std::string sTail = "\"hashedAuthCode\":\"00ff\","
+                              "\"iterations\":1000,"
+                              "\"expiration\":\"2030-01-01\","
+                              "\"requestId\":\"FACE0FF0\","
+                              "\"replayid\":5}";
+
+    const CeLoginRc sDuplicate(
+        CeLoginRc::JsmnUtils, JsmnUtils::ObjectGetValueByKey_DuplicateKeyFound);
+    const CeLoginRc sNotFound(CeLoginRc::JsmnUtils,
+                              JsmnUtils::ObjectGetValueByKey_KeyNotFound);
+
+    struct
+    {
+        std::string mJson;
+        uint16_t mRc;
+        bool mReplayIdPresent;
+    } sCases[] = {
+        {sHead + sSalt + sTail, CeLoginRc::Success, true},
+        // Unknown names, names of any length and nested names are ignored
+        {sHead + "\"unknown\":{\"version\":1,\"salt\":[1,2]}," +
+             "\"thisNameIsLongerThanAnyExpectedName\":0,\"\":0,\"s\":0," +
+             sSalt + sTail,
+         CeLoginRc::Success, true},
+        {sHead + sSalt + sSalt + sTail, sDuplicate, false},
+        {sHead + sTail, sNotFound, false},
+        {"{}", sNotFound, false},
+        {"{\"version\":2," + sHead.substr(1) + sSalt + sTail, sDuplicate,
+         false},
+        // A duplicate replay ID is treated as no replay ID
+        {sHead + sSalt + "\"replayid\":6," + sTail, CeLoginRc::Success, false},
+        // Fields are still reported in the order they are parsed in
+        {sHead + "\"machines\":[]," + sTail, sNotFound, false},
+        // Machine entries are only searched up to the end of the entry
+        {sHead + "\"serialNumber\":\"SN0001\"," + sSalt + sTail,
+         CeLoginRc::Success, true},
+    };
+
+    for (uint64_t sIdx = 0; sIdx < sizeof(sCases) / sizeof(sCases[0]); sIdx++)
+    {
+        CeLoginJsonData sJsonData;
+        sRc = decodeJson(sCases[sIdx].mJson.c_str(),
+                         sCases[sIdx].mJson.length(), sSerial.c_str(),
+                         sSerial.length(), sJsonData);
+        DO_TEST(sResult, sCases[sIdx].mRc == sRc, sIdx);
+        if (CeLoginRc::Success == sRc)
+        {
+            DO_TEST(sResult, CeLoginVersion2 == sJsonData.mVersion, sIdx);
+            DO_TEST(sResult, AcfType_Service == sJsonData.mType, sIdx);
+            DO_TEST(sResult, 1000 == sJsonData.mIterations, sIdx);
+            uint8_t sDecodedSalt[CeLogin_MaxHashedAuthCodeSaltLength];
+            uint64_t sDecodedSaltLength = 0;
+            DO_TEST(sResult,
+                    CeLoginRc::Success ==
+                        getJsonFieldFromHex(sJsonData, sJsonData.mAuthCodeSalt,
+                                            sDecodedSalt, sizeof(sDecodedSalt),
+                                            sDecodedSaltLength),
+                    sIdx);
+            DO_TEST(sResult, 2 == sDecodedSaltLength, sIdx);
+            DO_TEST(sResult,
+                    sCases[sIdx].mReplayIdPresent ==
+                        sJsonData.mReplayInfo.mReplayIdPresent,
+                    sIdx);
+        }
+    }
+#endif
+    return sResult;
+}
+
+UnitTestResult ut_json_many_machines()
+{
+    UnitTestResult sResult;
+#ifndef CELOGIN_POWERVM_TARGET
+    CeLoginRc sRc = CeLoginRc::Success;
+
+    // Each machine entry takes 5 tokens, so these need more tokens than fit
+    // on the stack, up to more than the upper bound
+    const uint64_t sMaxMachines = CeLogin_MaxNumberOfJsonTokens / 5;
+    const uint64_t sNumMachines[] = {30, 1000, sMaxMachines - 10,
+                                     sMaxMachines + 1};
+
+    for (uint64_t sIdx = 0; sIdx < sizeof(sNumMachines) / sizeof(uint64_t);
+         sIdx++)
+    {
+        std::string sJson = "{\"version\":2,\"type\":\"service\","
+                            "\"machines\":[";
+        for (uint64_t sMachine = 0; sMachine < sNumMachines[sIdx]; sMachine++)
+        {
+            sJson += (0 == sMachine) ? "{" : ",{";
+            sJson += "\"serialNumber\":\"SN";
+            sJson += std::to_string(sMachine);
+            sJson += "\",\"frameworkEc\":\"PWR10S\"}";
+        }
+        sJson += "],\"hashedAuthCode\":\"00ff\",\"salt\":\"0011\","
+                 "\"iterations\":1000,\"expiration\":\"2030-01-01\","
+                 "\"requestId\":\"FACE0FF0\",\"replayid\":5}";
+
+        // The first machine needs the shortest walk of the machines array
+        const std::string sSerial = "SN0";
+        CeLoginJsonData* sJsonData = new CeLoginJsonData();
+        sRc = decodeJson(sJson.c_str(), sJson.length(), sSerial.c_str(),
+                         sSerial.length(), *sJsonData);
+        if (sNumMachines[sIdx] <= sMaxMachines)
+        {
+            DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+            DO_TEST(sResult, ServiceAuth_CE == sJsonData->mRequestedAuthority,
+                    sNumMachines[sIdx]);
+            DO_TEST(sResult, 1000 == sJsonData->mIterations,
+                    sNumMachines[sIdx]);
+        }
+        else
+        {
+            // DecodeJson_TooManyTokens
+            DO_TEST(sResult, CeLoginRc(CeLoginRc::JsonUtils, 0x12) == sRc,
+                    sRc);
+        }
+        delete sJsonData;
+    }
+
+    // Malformed JSON is still rejected when it is too big for the stack
+    std::string sTruncated = "{\"machines\":[";
+    for (uint64_t sMachine = 0; sMachine < 100; sMachine++)
+    {
+        sTruncated += "{\"serialNumber\":\"SN\"},";
+    }
+    CeLoginJsonData* sJsonData = new CeLoginJsonData();
+    sRc = decodeJson(sTruncated.c_str(), sTruncated.length(), "SN", 2,
+                     *sJsonData);
+    DO_TEST(sResult, CeLoginRc::Success != sRc, sRc);
+    delete sJsonData;
+#endif
+    return sResult;
+}
+
+UnitTestResult ut_jsmn_subtree_ends()
+{
+    UnitTestResult sResult;
+#ifndef CELOGIN_POWERVM_TARGET
+    const std::string sJson =
+        "{\"a\":{\"b\":[1,{\"c\":[]},[[2,3],{}]],\"d\":\"e\"},"
+        "\"f\":[],\"g\":{\"h\":{\"i\":{\"j\":[true,null]}}},\"k\":7}";
+
+    jsmntok_t sTokens[64];
+    uint32_t sSubtreeEnds[64];
+    jsmn_parser sParser;
+    jsmn_init(&sParser);
+    const int sNumTokens = jsmn_parse(&sParser, sJson.c_str(), sJson.length(),
+                                      sTokens, 64);
+    DO_TEST(sResult, sNumTokens > 0, sNumTokens);
+
+    // Skipping entries with the index must give the same result as walking
+    // them, also when the tokens run out part way through an entry
+    for (int sLength = 1; sLength <= sNumTokens; sLength++)
+    {
+        JsmnUtils::JsmnState sWalkState;
+        sWalkState.mJsonString = sJson.c_str();
+        sWalkState.mJsonStringLength = sJson.length();
+        sWalkState.mTokenArray = sTokens;
+        sWalkState.mTokenArrayLength = sLength;
+
+        JsmnUtils::JsmnState sIndexState = sWalkState;
+        JsmnUtils::IndexSubtreeEnds(sIndexState, sSubtreeEnds);
+
+        for (uint64_t sIdx = 0; sIdx <= (uint64_t)sLength; sIdx++)
+        {
+            uint64_t sWalkNextIdx = 0;
+            uint64_t sIndexNextIdx = 0;
+            JsmnUtils::JsmnUtilRc sWalkRc =
+                JsmnUtils::GetNextJsonEntry(sWalkState, sIdx, sWalkNextIdx);
+            JsmnUtils::JsmnUtilRc sIndexRc =
+                JsmnUtils::GetNextJsonEntry(sIndexState, sIdx, sIndexNextIdx);
+            DO_TEST(sResult, sWalkRc == sIndexRc, sIdx);
+            if (JsmnUtils::Success == sWalkRc)
+            {
+                DO_TEST(sResult, sWalkNextIdx == sIndexNextIdx, sIdx);
+            }
+        }
+    }
+#endif
+    return sResult;
+}
+
+UnitTestResult ut_jsmn_find_string()
+{
+    UnitTestResult sResult;
+#ifndef CELOGIN_POWERVM_TARGET
+    // Cover every offset and tail length around the SIMD block sizes
+    std::string sData(100, 'a');
+    const std::string sStrings[] = {"b", "ab", "aab", "bab", "abcdefghij"};
+    for (uint64_t sStrIdx = 0; sStrIdx < sizeof(sStrings) / sizeof(sStrings[0]);
+         sStrIdx++)
+    {
+        const std::string& sString = sStrings[sStrIdx];
+        for (uint64_t sLength = 0; sLength <= sData.length(); sLength++)
+        {
+            for (uint64_t sPos = 0; sPos + sString.length() <= sLength; sPos++)
+            {
+                std::string sCopy = sData;
+                sCopy.replace(sPos, sString.length(), sString);
+                uint64_t sExpected = sCopy.substr(0, sLength).find(sString);
+                if (std::string::npos == sExpected)
+                {
+                    sExpected = sLength;
+                }
+                DO_TEST(sResult,
+                        sExpected == JsmnUtils::FindString(
+                                         sCopy.c_str(), sLength,
+                                         sString.c_str(), sString.length()),
+                        (sStrIdx << 16) | (sLength << 8) | sPos);
+            }
+        }
+    }
+
+    DO_TEST(sResult, 5 == JsmnUtils::FindString("abcde", 5, "", 0), 0);
+    DO_TEST(sResult, 0 == JsmnUtils::FindString(NULL, 0, "a", 1), 0);
+#endif
+    return sResult;
+}
+
+UnitTestResult ut_json_machine_prescan()
+{
+    UnitTestResult sResult;
+#ifndef CELOGIN_POWERVM_TARGET
+    const std::string sHead = "{\"version\":2,\"type\":\"service\","
+                              "\"machines\":[";
+    const std::string sTail = "],\"hashedAuthCode\":\"00ff\","
+                              "\"salt\":\"0011\",\"iterations\":1000,"
+                              "\"expiration\":\"2030-01-01\","
+                              "\"requestId\":\"FACE0FF0\",\"replayid\":5}";
+    const std::string sDevEntry = "{\"serialNumber\":\"SN0001\","
+                                  "\"frameworkEc\":\"PWR10D\"}";
+    std::string sManyEntries;
+    for (uint64_t sMachine = 0; sMachine < 1000; sMachine++)
+    {
+        sManyEntries += "{\"serialNumber\":\"SN00010\","
+                        "\"frameworkEc\":\"PWR10S\"},";
+    }
+
+    const CeLoginRc sNotFound(CeLoginRc::JsmnUtils,
+                              JsmnUtils::ObjectGetValueByKey_KeyNotFound);
+
+    struct
+    {
+        std::string mJson;
+        const char* mSerial;
+        uint16_t mRc;
+        ServiceAuthority mAuthority;
+    } sCases[] = {
+        // The serial number elsewhere in the array is not taken as a match
+        {sHead + "{\"serialNumber\":\"SN0002\",\"frameworkEc\":\"SN0001\"},"
+             "{\"serialNumber\":\"SN0002\",\"SN0001\":1,"
+             "\"frameworkEc\":\"PWR10S\"}," +
+             sDevEntry + sTail,
+         "SN0001", CeLoginRc::Success, ServiceAuth_Dev},
+        {sHead + sManyEntries + sDevEntry + sTail, "SN0001",
+         CeLoginRc::Success, ServiceAuth_Dev},
+        {sHead + sManyEntries + sDevEntry + sTail, "SN00010",
+         CeLoginRc::Success, ServiceAuth_CE},
+        // A serial number that is not a string is found by the walk
+        {sHead + "{\"serialNumber\":12345,\"frameworkEc\":\"PWR10D\"}" +
+             sTail,
+         "12345", CeLoginRc::Success, ServiceAuth_Dev},
+        {sHead + sManyEntries + sDevEntry + sTail, "SN0003",
+         CeLoginRc::SerialNumberMismatch, ServiceAuth_None},
+        // Without a match, malformed entries are still rejected
+        {sHead + sDevEntry + ",{\"frameworkEc\":\"PWR10S\"}" + sTail,
+         "SN0003", sNotFound, ServiceAuth_None},
+    };
+
+    for (uint64_t sIdx = 0; sIdx < sizeof(sCases) / sizeof(sCases[0]); sIdx++)
+    {
+        CeLoginJsonData* sJsonData = new CeLoginJsonData();
+        CeLoginRc sRc = decodeJson(
+            sCases[sIdx].mJson.c_str(), sCases[sIdx].mJson.length(),
+            sCases[sIdx].mSerial, strlen(sCases[sIdx].mSerial), *sJsonData);
+        DO_TEST(sResult, sCases[sIdx].mRc == sRc, sIdx);
+        if (CeLoginRc::Success == sRc)
+        {
+            DO_TEST(sResult,
+                    sCases[sIdx].mAuthority == sJsonData->mRequestedAuthority,
+                    sIdx);
+        }
+        delete sJsonData;
+    }
+#endif
+    return sResult;
+}
+
+// The expiration time as it was determined through ASN1_TIME
+static CeLoginRc getAsn1ExpirationTime(const CeLogin_Date& dateParm,
+                                       uint64_t& expirationTimeParm)
+{
+    CeLoginRc sRc = CeLoginRc::Success;
+    ASN1_TIME* sAsn1UnixEpoch = ASN1_TIME_new();
+    ASN1_TIME* sAsn1ExpirationTime = ASN1_TIME_new();
+    if (!sAsn1UnixEpoch || !sAsn1ExpirationTime ||
+        sAsn1UnixEpoch != ASN1_TIME_set(sAsn1UnixEpoch, 0))
+    {
+        sRc = CeLoginRc::Failure;
+    }
+
+    if (CeLoginRc::Success == sRc)
+    {
+        sRc = getAsn1TimeForExpiration(dateParm, sAsn1ExpirationTime);
+    }
+
+    if (CeLoginRc::Success == sRc)
+    {
+        int sDay = 0;
+        int sSec = 0;
+        if (1 != ASN1_TIME_diff(&sDay, &sSec, sAsn1UnixEpoch,
+                                sAsn1ExpirationTime))
+        {
+            sRc = CeLoginRc::DetermineAuth_Asn1ExpirationToUnixFailure;
+        }
+        else if (sDay < 0 || sSec < 0)
+        {
+            sRc = CeLoginRc::DetermineAuth_Asn1ExpirationToUnixOsslFailure;
+        }
+        else
+        {
+            expirationTimeParm = ((uint64_t)sDay * 24 * 60 * 60) + sSec;
+        }
+    }
+
+    ASN1_TIME_free(sAsn1UnixEpoch);
+    ASN1_TIME_free(sAsn1ExpirationTime);
+    return sRc;
+}
+
+UnitTestResult ut_expiration_days_from_civil()
+{
+    UnitTestResult sResult;
+#ifndef CELOGIN_POWERVM_TARGET
+    // Every day from 1970 to 2200, along with days and months out of range
+    for (uint16_t sYear = 1970; sYear <= 2200; sYear++)
+    {
+        for (uint8_t sMonth = 0; sMonth <= 13; sMonth++)
+        {
+            for (uint8_t sDay = 0; sDay <= 32; sDay++)
+            {
+                CeLogin_Date sDate;
+                sDate.mYear = sYear;
+                sDate.mMonth = sMonth;
+                sDate.mDay = sDay;
+
+                uint64_t sExpected = 0;
+                uint64_t sActual = 0;
+                CeLoginRc sExpectedRc = getAsn1ExpirationTime(sDate, sExpected);
+                CeLoginRc sRc = getExpirationTimeFromDate(sDate, sActual);
+                const uint64_t sTrace = (sYear << 16) | (sMonth << 8) | sDay;
+                DO_TEST(sResult, sExpectedRc == sRc, sTrace);
+                DO_TEST(sResult, sExpected == sActual, sTrace);
+            }
+        }
+    }
+
+    // Years outside of that range, and values the time string cannot hold
+    const CeLogin_Date sDates[] = {
+        {1, 1, 1},     {1600, 2, 29}, {1969, 12, 31}, {9999, 12, 31},
+        {10000, 1, 1}, {2024, 100, 1}, {2024, 1, 100}, {0, 3, 1},
+    };
+    for (uint64_t sIdx = 0; sIdx < sizeof(sDates) / sizeof(sDates[0]); sIdx++)
+    {
+        uint64_t sExpected = 0;
+        uint64_t sActual = 0;
+        CeLoginRc sExpectedRc = getAsn1ExpirationTime(sDates[sIdx], sExpected);
+        CeLoginRc sRc = getExpirationTimeFromDate(sDates[sIdx], sActual);
+        DO_TEST(sResult, sExpectedRc == sRc, sIdx);
+        DO_TEST(sResult, sExpected == sActual, sIdx);
+    }
+#endif
+    return sResult;
+}
+
+// Deterministic pseudo random numbers for the codec tests
+static uint32_t getNextRandom(uint32_t& stateParm)
+{
+    stateParm ^= stateParm << 13;
+    stateParm ^= stateParm >> 17;
+    stateParm ^= stateParm << 5;
+    return stateParm;
+}
+
+// Hex decoding as it was done with strtoul, one pair at a time
+static CeLoginRc getBinaryFromHexStrtoul(const char* hexStringParm,
+                                         const uint64_t hexStringLengthParm,
+                                         uint8_t* binaryParm,
+                                         uint64_t& binaryLengthParm)
+{
+    binaryLengthParm = 0;
+    for (uint64_t sIdx = 0; sIdx < hexStringLengthParm; sIdx += 2)
+    {
+        char sByteHexString[3] = {hexStringParm[sIdx],
+                                  hexStringParm[sIdx + 1], '\0'};
+        unsigned long int sVal = strtoul(sByteHexString, NULL, 16);
+        if (sVal > 0xFF)
+        {
+            return CeLoginRc::HexToBin_HexPairOverflow;
+        }
+        binaryParm[sIdx / 2] = sVal;
+        binaryLengthParm++;
+    }
+    return CeLoginRc::Success;
+}
+
+UnitTestResult ut_hex_codec()
+{
+    UnitTestResult sResult;
+#ifndef CELOGIN_POWERVM_TARGET
+    uint32_t sRandom = 0x2545F491;
+    const char sValidChars[] = "0123456789abcdefABCDEF";
+    const char sOtherChars[] = " +-xXgG:@`/\x00\x80\xff";
+
+    // Valid hex of every length around the block size, then with a character
+    // that is not a hex digit put in at each position
+    for (uint64_t sLength = 0; sLength <= 80; sLength += 2)
+    {
+        std::string sHex;
+        for (uint64_t sIdx = 0; sIdx < sLength; sIdx++)
+        {
+            sHex += sValidChars[getNextRandom(sRandom) % 22];
+        }
+
+        for (uint64_t sPos = 0; sPos <= sLength; sPos++)
+        {
+            std::string sInput = sHex;
+            if (sPos < sLength)
+            {
+                sInput[sPos] =
+                    sOtherChars[getNextRandom(sRandom) % (sizeof(sOtherChars) -
+                                                          1)];
+            }
+
+            uint8_t sExpected[40];
+            uint8_t sActual[40];
+            uint64_t sExpectedLength = 0;
+            uint64_t sActualLength = 0;
+            CeLoginRc sExpectedRc = getBinaryFromHexStrtoul(
+                sInput.data(), sLength, sExpected, sExpectedLength);
+            CeLoginRc sRc = getBinaryFromHex(sInput.data(), sLength, sActual,
+                                             sizeof(sActual), sActualLength);
+            DO_TEST(sResult, sExpectedRc == sRc, (sLength << 8) | sPos);
+            DO_TEST(sResult, sExpectedLength == sActualLength,
+                    (sLength << 8) | sPos);
+            DO_TEST(sResult,
+                    0 == memcmp(sExpected, sActual, sExpectedLength),
+                    (sLength << 8) | sPos);
+        }
+
+        // Encoding gives back the lower case digits
+        uint8_t sBinary[40];
+        uint64_t sBinaryLength = 0;
+        getBinaryFromHex(sHex.data(), sLength, sBinary, sizeof(sBinary),
+                         sBinaryLength);
+        char sEncoded[80];
+        uint64_t sEncodedLength = 0;
+        CeLoginRc sRc = getHexFromBinary(sBinary, sBinaryLength, sEncoded,
+                                         sizeof(sEncoded), sEncodedLength);
+        std::string sLower = sHex;
+        for (uint64_t sIdx = 0; sIdx < sLower.length(); sIdx++)
+        {
+            sLower[sIdx] = tolower(sLower[sIdx]);
+        }
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+        DO_TEST(sResult,
+                sLower == std::string(sEncoded, sEncodedLength), sLength);
+    }
+
+    uint64_t sLength = 0;
+    uint8_t sBinary[2];
+    char sHex[4];
+    DO_TEST(sResult,
+            CeLoginRc::HexToBin_InvalidHexString ==
+                getBinaryFromHex("abc", 3, sBinary, sizeof(sBinary), sLength),
+            0);
+    DO_TEST(sResult,
+            CeLoginRc::HexToBin_InvalidHexString ==
+                getBinaryFromHex("abcdef", 6, sBinary, sizeof(sBinary),
+                                 sLength),
+            0);
+    DO_TEST(sResult,
+            CeLoginRc::Success !=
+                getHexFromBinary(sBinary, 3, sHex, sizeof(sHex), sLength),
+            0);
+#endif
+    return sResult;
+}
+
+// Base64 decoding as it was done with EVP_DecodeBlock
+static bool base64DecodeEvp(const std::string& inputParm,
+                            std::vector<uint8_t>& decodedParm)
+{
+    decodedParm.resize(inputParm.length() / 4 * 3 + 1);
+    const int sDecoded =
+        EVP_DecodeBlock(decodedParm.data(),
+                        (const unsigned char*)inputParm.data(),
+                        inputParm.length());
+    if (sDecoded < 0 || (size_t)sDecoded != inputParm.length() / 4 * 3)
+    {
+        return false;
+    }
+
+    size_t sPadding = 0;
+    if (!inputParm.empty() && '=' == inputParm[inputParm.length() - 2])
+    {
+        sPadding = 2;
+    }
+    else if (!inputParm.empty() && '=' == inputParm[inputParm.length() - 1])
+    {
+        sPadding = 1;
+    }
+    decodedParm.resize(sDecoded - sPadding);
+    return true;
+}
+
+UnitTestResult ut_base64_codec()
+{
+    UnitTestResult sResult;
+#ifndef CELOGIN_POWERVM_TARGET
+    uint32_t sRandom = 0x9E3779B9;
+    const char sOtherChars[] = " =-_.:@[`{\n\x00\x80\xff";
+
+    // Every length around the block sizes, encoded and decoded again, then
+    // with a character that is not base64 put in at each position
+    for (uint64_t sLength = 0; sLength <= 64; sLength++)
+    {
+        std::vector<uint8_t> sBinary;
+        for (uint64_t sIdx = 0; sIdx < sLength; sIdx++)
+        {
+            sBinary.push_back(getNextRandom(sRandom));
+        }
+
+        std::string sEncoded(4 * ((sLength + 2) / 3) + 1, '\0');
+        const int sEvpLength =
+            EVP_EncodeBlock((unsigned char*)&sEncoded[0], sBinary.data(),
+                            sBinary.size());
+        sEncoded.resize(sEvpLength);
+
+        char sActual[96];
+        size_t sActualLength = 0;
+        CeLoginRc sRc = base64Encode(sBinary.data(), sBinary.size(), sActual,
+                                     sizeof(sActual), sActualLength);
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+        DO_TEST(sResult, sEncoded == std::string(sActual, sActualLength),
+                sLength);
+
+        for (uint64_t sPos = 0; sPos <= sEncoded.length(); sPos++)
+        {
+            std::string sInput = sEncoded;
+            if (sPos < sEncoded.length())
+            {
+                sInput[sPos] =
+                    sOtherChars[getNextRandom(sRandom) % (sizeof(sOtherChars) -
+                                                          1)];
+            }
+
+            std::vector<uint8_t> sExpected;
+            const bool sExpectedSuccess = base64DecodeEvp(sInput, sExpected);
+
+            uint8_t sDecoded[96];
+            size_t sDecodedLength = 0;
+            sRc = base64Decode(sInput.data(), sInput.length(), sDecoded,
+                               sizeof(sDecoded), sDecodedLength);
+            DO_TEST(sResult, sExpectedSuccess == (CeLoginRc::Success == sRc),
+                    (sLength << 8) | sPos);
+            if (sExpectedSuccess && CeLoginRc::Success == sRc)
+            {
+                DO_TEST(sResult,
+                        sExpected ==
+                            std::vector<uint8_t>(sDecoded,
+                                                 sDecoded + sDecodedLength),
+                        (sLength << 8) | sPos);
+            }
+            if (sPos == sEncoded.length())
+            {
+                DO_TEST(sResult, sBinary == sExpected, sLength);
+            }
+        }
+    }
+#endif
+    return sResult;
+}
+
+UnitTestResult ut_arena()
+{
+    UnitTestResult sResult;
+#ifndef CELOGIN_POWERVM_TARGET
+    // One byte extra so the arena can be handed a misaligned buffer
+    uint8_t* sBuffer = new uint8_t[1024 + 1];
+
+    for (uint64_t sOffset = 0; sOffset < 2; sOffset++)
+    {
+        CeLoginArena sArena(sBuffer + sOffset, 1024 + sOffset);
+        DO_TEST(sResult, 1024 >= sArena.getSize(), sArena.getSize());
+        DO_TEST(sResult, 1008 <= sArena.getSize(), sArena.getSize());
+
+        void* sFirst = sArena.allocate(1);
+        void* sSecond = sArena.allocate(100);
+        void* sThird = sArena.allocate(16);
+        DO_TEST(sResult, sFirst && sSecond && sThird, sOffset);
+        DO_TEST(sResult, 0 == (uintptr_t)sFirst % 16, (uintptr_t)sFirst);
+        DO_TEST(sResult, 0 == (uintptr_t)sSecond % 16, (uintptr_t)sSecond);
+        DO_TEST(sResult, 0 == (uintptr_t)sThird % 16, (uintptr_t)sThird);
+        DO_TEST(sResult, (uint8_t*)sSecond == (uint8_t*)sFirst + 16, sOffset);
+        DO_TEST(sResult, (uint8_t*)sThird == (uint8_t*)sSecond + 112, sOffset);
+        DO_TEST(sResult, sArena.contains(sSecond), sOffset);
+        DO_TEST(sResult, !sArena.contains(&sArena), sOffset);
+        DO_TEST(sResult, 144 == sArena.getUsed(), sArena.getUsed());
+        memset(sSecond, 0xA5, 100);
+
+        // Only the most recent allocation is given back
+        sArena.release(sSecond);
+        DO_TEST(sResult, 144 == sArena.getUsed(), sArena.getUsed());
+        sArena.release(sThird);
+        DO_TEST(sResult, 128 == sArena.getUsed(), sArena.getUsed());
+        sArena.release(sThird);
+        DO_TEST(sResult, 128 == sArena.getUsed(), sArena.getUsed());
+        DO_TEST(sResult, sThird == sArena.allocate(16), sOffset);
+        DO_TEST(sResult, 144 == sArena.getHighWater(), sArena.getHighWater());
+
+        DO_TEST(sResult, !sArena.isExhausted(), sOffset);
+        DO_TEST(sResult, NULL == sArena.allocate(sArena.getSize()), sOffset);
+        DO_TEST(sResult, NULL == sArena.allocate(UINT64_MAX), sOffset);
+        DO_TEST(sResult, sArena.isExhausted(), sOffset);
+
+        sArena.reset();
+        DO_TEST(sResult, !sArena.isExhausted(), sOffset);
+        DO_TEST(sResult, 0 == sArena.getUsed(), sArena.getUsed());
+        DO_TEST(sResult, 144 == sArena.getHighWater(), sArena.getHighWater());
+        DO_TEST(sResult,
+                sFirst == sArena.allocate(sArena.getSize() & ~(uint64_t)15),
+                sOffset);
+    }
+
+    CeLoginArena sEmpty(NULL, 1024);
+    DO_TEST(sResult, NULL == sEmpty.allocate(1), 0);
+    DO_TEST(sResult, sEmpty.isExhausted(), 0);
+
+    delete[] sBuffer;
+#endif
+    return sResult;
+}
+
+UnitTestResult ut_arena_v2()
+{
+    UnitTestResult sResult;
+#ifndef CELOGIN_POWERVM_TARGET
+    CeLoginRc sRc = CeLoginRc::Success;
+
+    DO_TEST(sResult, sAllocationCounterInstalled, 0);
+
+    CeLoginCreateHsfArgsV1 sHsfArgs = GetDefaultHsfArgs();
+    CeLoginCreateHsfArgsV2 sHsfArgsV2;
+    std::vector<uint8_t> sAcf;
+
+    const std::string sSerial = sHsfArgs.mMachines.front().mSerialNumber;
+
+    const char* sTypes[] = {"service", "adminreset", "resourcedump",
+                            "bmcshell"};
+
+    // Each ACF type, then a service ACF for enough machines that decoding it
+    // needs more JSON tokens than fit on the stack
+    for (size_t sTypeIdx = 0;
+         sTypeIdx <= sizeof(sTypes) / sizeof(sTypes[0]); sTypeIdx++)
+    {
+        sHsfArgsV2.mV1Args = sHsfArgs;
+        sHsfArgsV2.mNoReplayId = false;
+        sHsfArgsV2.mType = sTypes[sTypeIdx % 4];
+        sHsfArgsV2.mScript = "script command;";
+        sHsfArgsV2.mBmcTimeout = 60;
+        sHsfArgsV2.mIssueBmcDump = false;
+        if (4 == sTypeIdx)
+        {
+            for (int sMachine = 0; sMachine < 30; sMachine++)
+            {
+                sHsfArgsV2.mV1Args.mMachines.push_back(Machine(
+                    "SN" + std::to_string(sMachine), ServiceAuth_CE, P10));
+            }
+        }
+
+        sRc = createCeLoginAcfV2(sHsfArgsV2, sAcf);
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+        // The heap interfaces are the reference
+        uint64_t sUpdatedReplayId = 0;
+        AcfType sType = AcfType_Invalid;
+        uint64_t sExp = 0;
+        sRc = verifyACFForBMCUploadV2(sAcf.data(), sAcf.size(), 0,
+                                      key1_pub_der, key1_pub_der_len,
+                                      sSerial.c_str(), sSerial.length(), 0,
+                                      sUpdatedReplayId, sType, sExp);
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+        const bool sIsService = AcfType_Service == sType;
+        const char* sPassword = sIsService ? sHsfArgs.mPasswordPtr : NULL;
+        const uint64_t sPasswordLength =
+            sIsService ? sHsfArgs.mPasswordLength : 0;
+
+        AcfUserFields sFields;
+        sRc = checkAuthorizationAndGetAcfUserFieldsV2(
+            sAcf.data(), sAcf.size(), sPassword, sPasswordLength, 0,
+            key1_pub_der, key1_pub_der_len, sSerial.c_str(), sSerial.length(),
+            sUpdatedReplayId, sFields);
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+        std::vector<uint8_t> sBuffer(getArenaSizeV2(sAcf.size()));
+        CeLoginArena sArena(sBuffer.data(), sBuffer.size());
+
+        uint64_t sArenaReplayId = 0;
+        AcfType sArenaType = AcfType_Invalid;
+        uint64_t sArenaExp = 0;
+        sRc = verifyACFForBMCUploadV2(sAcf.data(), sAcf.size(), 0,
+                                      key1_pub_der, key1_pub_der_len,
+                                      sSerial.c_str(), sSerial.length(), 0,
+                                      sArenaReplayId, sArenaType, sArenaExp,
+                                      sArena);
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+        DO_TEST(sResult, sType == sArenaType, sArenaType);
+        DO_TEST(sResult, sExp == sArenaExp, sArenaExp);
+        DO_TEST(sResult, sUpdatedReplayId == sArenaReplayId, sArenaReplayId);
+
+        // The only allocation, the JSON tokens, is given back by the call
+        DO_TEST(sResult, 0 == sArena.getUsed(), sArena.getUsed());
+
+        AcfType sMetaType = AcfType_Invalid;
+        uint64_t sMetaExp = 0;
+        CeLogin_Date sDate;
+        AcfVersion sVersion = CeLoginInvalidVersion;
+        bool sHasReplayId = false;
+        sRc = extractACFMetadataV2(sAcf.data(), sAcf.size(), 0, key1_pub_der,
+                                   key1_pub_der_len, sSerial.c_str(),
+                                   sSerial.length(), sMetaType, sMetaExp,
+                                   sDate, sVersion, sHasReplayId, sArena);
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+        DO_TEST(sResult, sType == sMetaType, sMetaType);
+
+        AcfUserFields sArenaFields;
+        sRc = checkAuthorizationAndGetAcfUserFieldsV2(
+            sAcf.data(), sAcf.size(), sPassword, sPasswordLength, 0,
+            key1_pub_der, key1_pub_der_len, sSerial.c_str(), sSerial.length(),
+            sUpdatedReplayId, sArenaFields, sArena);
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+        DO_TEST(sResult, sFields.mType == sArenaFields.mType,
+                sArenaFields.mType);
+        DO_TEST(sResult,
+                sFields.mExpirationTime == sArenaFields.mExpirationTime,
+                sArenaFields.mExpirationTime);
+
+        AcfVerifiedRecord sRecord;
+        sRc = getAcfVerifiedRecordV2(sAcf.data(), sAcf.size(), 0,
+                                     key1_pub_der, key1_pub_der_len,
+                                     sSerial.c_str(), sSerial.length(), 0,
+                                     sRecord, sArena);
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+        DO_TEST(sResult, sType == sRecord.mType, sRecord.mType);
+        DO_TEST(sResult, sUpdatedReplayId == sRecord.mUpdatedReplayId,
+                sRecord.mUpdatedReplayId);
+
+        // Only service ACFs have an authorization record. It holds
+        // everything needed to check a password, so the smallest arena is
+        // enough for that.
+        if (sIsService)
+        {
+            AcfAuthRecord sAuthRecord;
+            sRc = getAcfAuthRecordV2(sAcf.data(), sAcf.size(), 0,
+                                     key1_pub_der, key1_pub_der_len,
+                                     sSerial.c_str(), sSerial.length(),
+                                     sAuthRecord, sArena);
+            DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+            std::vector<uint8_t> sRecordBuffer(getArenaSizeV2(0));
+            CeLoginArena sRecordArena(sRecordBuffer.data(),
+                                      sRecordBuffer.size());
+            AcfUserFields sRecordFields;
+            sRc = checkAuthorizationWithAcfAuthRecordV2(
+                sAuthRecord, sPassword, sPasswordLength, 0, sUpdatedReplayId,
+                sRecordFields, sRecordArena);
+            DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+            DO_TEST(sResult, sFields.mType == sRecordFields.mType,
+                    sRecordFields.mType);
+            DO_TEST(sResult, 0 == sRecordArena.getUsed(),
+                    sRecordArena.getUsed());
+        }
+
+        // Only the JSON tokens of an ACF that lists many machines need the
+        // arena, the rest of a call fits on the stack
+        CeLoginArena sMeasuredArena(sBuffer.data(), sBuffer.size());
+        uint64_t sStart = sOpensslAllocations;
+        sRc = getAcfVerifiedRecordV2(sAcf.data(), sAcf.size(), 0,
+                                     key1_pub_der, key1_pub_der_len,
+                                     sSerial.c_str(), sSerial.length(), 0,
+                                     sRecord, sMeasuredArena);
+        const uint64_t sArenaAllocations = sOpensslAllocations - sStart;
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+        const uint64_t sHighWater = sMeasuredArena.getHighWater();
+        DO_TEST(sResult, (4 == sTypeIdx) == (0 != sHighWater), sHighWater);
+        DO_TEST(sResult, sHighWater <= sBuffer.size(), sHighWater);
+
+        // ce-login took nothing from the heap. OpenSSL allocates the same
+        // way with or without an arena, so the call without one only makes
+        // an additional allocation for the JSON tokens.
+        sStart = sOpensslAllocations;
+        sRc = getAcfVerifiedRecordV2(sAcf.data(), sAcf.size(), 0,
+                                     key1_pub_der, key1_pub_der_len,
+                                     sSerial.c_str(), sSerial.length(), 0,
+                                     sRecord);
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+        DO_TEST(sResult,
+                sArenaAllocations + (0 != sHighWater ? 1 : 0) ==
+                    sOpensslAllocations - sStart,
+                sOpensslAllocations - sStart);
+
+        // An arena one byte short of what a call needs fails cleanly, and a
+        // call that needs none works without one
+        CeLoginArena sSmallArena(sBuffer.data(),
+                                 0 != sHighWater ? sHighWater - 1 : 0);
+        sRc = getAcfVerifiedRecordV2(sAcf.data(), sAcf.size(), 0,
+                                     key1_pub_der, key1_pub_der_len,
+                                     sSerial.c_str(), sSerial.length(), 0,
+                                     sRecord, sSmallArena);
+        DO_TEST(sResult,
+                (0 != sHighWater ? CeLoginRc::ArenaExhausted
+                                 : CeLoginRc::Success) == sRc,
+                sRc);
+
+        // The arena can be used again after running out
+        sRc = getAcfVerifiedRecordV2(sAcf.data(), sAcf.size(), 0,
+                                     key1_pub_der, key1_pub_der_len,
+                                     sSerial.c_str(), sSerial.length(), 0,
+                                     sRecord, sArena);
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+    }
+#endif
+    return sResult;
+}
+
+UnitTestResult ut_call_arena_v2()
+{
+    UnitTestResult sResult;
+#ifndef CELOGIN_POWERVM_TARGET
+    CeLoginRc sRc = CeLoginRc::Success;
+
+    DO_TEST(sResult, sAllocationCounterInstalled, 0);
+
+    CeLoginCreateHsfArgsV1 sHsfArgs = GetDefaultHsfArgs();
+    CeLoginCreateHsfArgsV2 sHsfArgsV2;
+    std::vector<uint8_t> sAcf;
+
+    const std::string sSerial = sHsfArgs.mMachines.front().mSerialNumber;
+
+    const char* sTypes[] = {"service", "adminreset", "resourcedump",
+                            "bmcshell"};
+
+    // Calls without an arena give the same results for each ACF type, and
+    // only allocate their arena once they need scratch memory
+    for (size_t sTypeIdx = 0;
+         sTypeIdx <= sizeof(sTypes) / sizeof(sTypes[0]); sTypeIdx++)
+    {
+        sHsfArgsV2.mV1Args = sHsfArgs;
+        sHsfArgsV2.mNoReplayId = false;
+        sHsfArgsV2.mType = sTypes[sTypeIdx % 4];
+        sHsfArgsV2.mScript = "script command;";
+        sHsfArgsV2.mBmcTimeout = 60;
+        sHsfArgsV2.mIssueBmcDump = false;
+        if (4 == sTypeIdx)
+        {
+            for (int sMachine = 0; sMachine < 30; sMachine++)
+            {
+                sHsfArgsV2.mV1Args.mMachines.push_back(Machine(
+                    "SN" + std::to_string(sMachine), ServiceAuth_CE, P10));
+            }
+        }
+
+        sRc = createCeLoginAcfV2(sHsfArgsV2, sAcf);
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+        std::vector<uint8_t> sBuffer(getArenaSizeV2(sAcf.size()));
+        CeLoginArena sArena(sBuffer.data(), sBuffer.size());
+        AcfVerifiedRecord sArenaRecord;
+        uint64_t sStart = sOpensslAllocations;
+        sRc = getAcfVerifiedRecordV2(sAcf.data(), sAcf.size(), 0,
+                                     key1_pub_der, key1_pub_der_len,
+                                     sSerial.c_str(), sSerial.length(), 0,
+                                     sArenaRecord, sArena);
+        const uint64_t sArenaAllocations = sOpensslAllocations - sStart;
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+        AcfVerifiedRecord sRecord;
+        sStart = sOpensslAllocations;
+        sRc = getAcfVerifiedRecordV2(sAcf.data(), sAcf.size(), 0,
+                                     key1_pub_der, key1_pub_der_len,
+                                     sSerial.c_str(), sSerial.length(), 0,
+                                     sRecord);
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+        DO_TEST(sResult, sArenaRecord.mType == sRecord.mType, sRecord.mType);
+        DO_TEST(sResult,
+                sArenaAllocations + (4 == sTypeIdx ? 1 : 0) ==
+                    sOpensslAllocations - sStart,
+                sOpensslAllocations - sStart);
+
+        const bool sIsService = AcfType_Service == sRecord.mType;
+        AcfUserFields sFields;
+        sRc = checkAuthorizationAndGetAcfUserFieldsV2(
+            sAcf.data(), sAcf.size(),
+            sIsService ? sHsfArgs.mPasswordPtr : NULL,
+            sIsService ? sHsfArgs.mPasswordLength : 0, 0, key1_pub_der,
+            key1_pub_der_len, sSerial.c_str(), sSerial.length(),
+            sRecord.mUpdatedReplayId, sFields);
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+    }
+
+    // With a secure heap the arena of a call comes from it, leaving the
+    // regular heap to OpenSSL, and is given back in full
+    if (CRYPTO_secure_malloc_init(128 * 1024, 16))
+    {
+        std::vector<uint8_t> sBuffer(getArenaSizeV2(sAcf.size()));
+        CeLoginArena sArena(sBuffer.data(), sBuffer.size());
+        AcfVerifiedRecord sRecord;
+        uint64_t sStart = sOpensslAllocations;
+        sRc = getAcfVerifiedRecordV2(sAcf.data(), sAcf.size(), 0,
+                                     key1_pub_der, key1_pub_der_len,
+                                     sSerial.c_str(), sSerial.length(), 0,
+                                     sRecord, sArena);
+        const uint64_t sArenaAllocations = sOpensslAllocations - sStart;
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+        sStart = sOpensslAllocations;
+        sRc = getAcfVerifiedRecordV2(sAcf.data(), sAcf.size(), 0,
+                                     key1_pub_der, key1_pub_der_len,
+                                     sSerial.c_str(), sSerial.length(), 0,
+                                     sRecord);
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+        DO_TEST(sResult,
+                sArenaAllocations == sOpensslAllocations - sStart,
+                sOpensslAllocations - sStart);
+        DO_TEST(sResult, 0 == CRYPTO_secure_used(), CRYPTO_secure_used());
+
+        AcfUserFields sFields;
+        sRc = checkAuthorizationAndGetAcfUserFieldsV2(
+            sAcf.data(), sAcf.size(), sHsfArgs.mPasswordPtr,
+            sHsfArgs.mPasswordLength, 0, key1_pub_der, key1_pub_der_len,
+            sSerial.c_str(), sSerial.length(), sRecord.mUpdatedReplayId,
+            sFields);
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+        DO_TEST(sResult, 0 == CRYPTO_secure_used(), CRYPTO_secure_used());
+
+        CRYPTO_secure_malloc_done();
+    }
+#endif
+    return sResult;
+}
+
+#ifndef CELOGIN_POWERVM_TARGET
+// Base64 encoding of a script, for placing in the JSON of an ACF directly
+static std::string getEncodedScript(const std::string& scriptParm)
+{
+    std::string sEncoded((scriptParm.length() + 2) / 3 * 4, '\0');
+    size_t sEncodedLength = 0;
+    CeLogin::base64Encode((const uint8_t*)scriptParm.data(),
+                          scriptParm.length(), &sEncoded[0], sEncoded.size(),
+                          sEncodedLength);
+    sEncoded.resize(sEncodedLength);
+    return sEncoded;
+}
+
+// Create a BMC shell ACF with an encoded script that the generator would not
+// accept, by swapping it into the JSON before signing
+static CeLoginRc
+    createAcfWithEncodedScript(const CeLoginCreateHsfArgsV2& argsParm,
+                               const std::string& encodedScriptParm,
+                               std::vector<uint8_t>& generatedAcfParm)
+{
+    CeLoginCreateHsfArgsV2 sArgs = argsParm;
+    sArgs.mType = "bmcshell";
+    sArgs.mScript = "placeholder";
+
+    std::string sJson;
+    std::vector<uint8_t> sDigest;
+    CeLoginRc sRc = createCeLoginAcfV2Payload(sArgs, sJson, sDigest);
+
+    const std::string sPlaceholder = getEncodedScript(sArgs.mScript);
+    const size_t sPosition = sJson.find(sPlaceholder);
+    if (CeLoginRc::Success == sRc && std::string::npos != sPosition)
+    {
+        sJson.replace(sPosition, sPlaceholder.length(), encodedScriptParm);
+        sDigest.assign(CeLogin::CeLogin_DigestLength, 0);
+        sRc = CeLogin::createDigest((const uint8_t*)sJson.data(),
+                                    sJson.length(), sDigest.data(),
+                                    sDigest.size());
+    }
+    else
+    {
+        sRc = CeLoginRc::Failure;
+    }
+
+    std::vector<uint8_t> sSignature;
+    if (CeLoginRc::Success == sRc)
+    {
+        sRc = createCeLoginAcfV2Signature(sArgs, sDigest, sSignature);
+    }
+    if (CeLoginRc::Success == sRc)
+    {
+        sRc = createCeLoginAcfV2Asn1(sArgs, sJson, sSignature,
+                                     generatedAcfParm);
+    }
+    return sRc;
+}
+#endif
+
+UnitTestResult ut_user_fields_view_v2()
+{
+    UnitTestResult sResult;
+#ifndef CELOGIN_POWERVM_TARGET
+    CeLoginRc sRc = CeLoginRc::Success;
+
+    CeLoginCreateHsfArgsV1 sHsfArgs = GetDefaultHsfArgs();
+    CeLoginCreateHsfArgsV2 sHsfArgsV2;
+    std::vector<uint8_t> sAcf;
+
+    const std::string sSerial = sHsfArgs.mMachines.front().mSerialNumber;
+
+    const char* sTypes[] = {"service", "adminreset", "resourcedump",
+                            "bmcshell"};
+
+    // The view holds the same fields as the copies, left encoded in the ACF
+    for (size_t sTypeIdx = 0; sTypeIdx < sizeof(sTypes) / sizeof(sTypes[0]);
+         sTypeIdx++)
+    {
+        sHsfArgsV2.mV1Args = sHsfArgs;
+        sHsfArgsV2.mNoReplayId = true;
+        sHsfArgsV2.mType = sTypes[sTypeIdx];
+        sHsfArgsV2.mScript = "script command1; script command2;";
+        sHsfArgsV2.mBmcTimeout = 60;
+        sHsfArgsV2.mIssueBmcDump = true;
+
+        sRc = createCeLoginAcfV2(sHsfArgsV2, sAcf);
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+        const bool sIsService = 0 == sTypeIdx;
+        AcfUserFields sFields;
+        sRc = checkAuthorizationAndGetAcfUserFieldsV2(
+            sAcf.data(), sAcf.size(),
+            sIsService ? sHsfArgs.mPasswordPtr : NULL,
+            sIsService ? sHsfArgs.mPasswordLength : 0, 0, key1_pub_der,
+            key1_pub_der_len, sSerial.c_str(), sSerial.length(), 0, sFields);
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+        AcfUserFieldsView sView;
+        sRc = checkAuthorizationAndGetAcfUserFieldsViewV2(
+            sAcf.data(), sAcf.size(),
+            sIsService ? sHsfArgs.mPasswordPtr : NULL,
+            sIsService ? sHsfArgs.mPasswordLength : 0, 0, key1_pub_der,
+            key1_pub_der_len, sSerial.c_str(), sSerial.length(), 0, sView);
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+        DO_TEST(sResult, sFields.mVersion == sView.mVersion, sView.mVersion);
+        DO_TEST(sResult, sFields.mType == sView.mType, sView.mType);
+        DO_TEST(sResult, sFields.mExpirationTime == sView.mExpirationTime,
+                sView.mExpirationTime);
+
+        std::vector<char> sDecoded(getAcfUserFieldDecodedSize(sView));
+        uint64_t sDecodedLength = 0;
+        CeLoginRc sDecodeRc = decodeAcfUserField(
+            sView, sDecoded.data(), sDecoded.size(), sDecodedLength);
+        const std::string sDecodedStr(sDecoded.data(), sDecodedLength);
+
+        if (sIsService)
+        {
+            DO_TEST(sResult, NULL == sView.mEncodedField.mData, 0);
+            DO_TEST(sResult, sDecoded.empty(), sDecoded.size());
+            DO_TEST(sResult, CeLoginRc::UnsupportedAcfType == sDecodeRc,
+                    sDecodeRc);
+            DO_TEST(sResult,
+                    sFields.mTypeSpecificFields.mServiceFields.mAuth ==
+                        sView.mAuth,
+                    sView.mAuth);
+            continue;
+        }
+
+        // Nothing is copied out of the ACF
+        DO_TEST(sResult,
+                (const uint8_t*)sView.mEncodedField.mData >= sAcf.data() &&
+                    (const uint8_t*)sView.mEncodedField.mData +
+                            sView.mEncodedField.mLength <=
+                        sAcf.data() + sAcf.size(),
+                sView.mEncodedField.mLength);
+        DO_TEST(sResult, CeLoginRc::Success == sDecodeRc, sDecodeRc);
+
+        if (AcfType_AdminReset == sView.mType)
+        {
+            const std::string sAdminAuthCode(
+                sFields.mTypeSpecificFields.mAdminResetFields.mAdminAuthCode,
+                sFields.mTypeSpecificFields.mAdminResetFields
+                    .mAdminAuthCodeLength);
+            DO_TEST(sResult, sAdminAuthCode == sDecodedStr, sDecodedLength);
+        }
+        else
+        {
+            DO_TEST(sResult, sHsfArgsV2.mScript == sDecodedStr, sDecodedLength);
+        }
+
+        if (AcfType_ResourceDump == sView.mType)
+        {
+            DO_TEST(sResult,
+                    sFields.mTypeSpecificFields.mResourceDumpFields.mAuth ==
+                        sView.mAuth,
+                    sView.mAuth);
+        }
+        else if (AcfType_BmcShell == sView.mType)
+        {
+            DO_TEST(sResult, 60 == sView.mBmcTimeout, sView.mBmcTimeout);
+            DO_TEST(sResult, sView.mIssueBmcDump, sView.mIssueBmcDump);
+        }
+
+        // A buffer that is too small is refused rather than overrun
+        sDecodeRc = decodeAcfUserField(sView, sDecoded.data(),
+                                       sDecodedLength / 2, sDecodedLength);
+        DO_TEST(sResult, CeLoginRc::Success != sDecodeRc, sDecodeRc);
+    }
+
+    // A script too large to be copied can still be viewed
+    std::string sLargeScript;
+    for (int sLine = 0;
+         sLargeScript.length() < 2 * CeLogin::MaxAsciiScriptFileLength;
+         sLine++)
+    {
+        sLargeScript += "bmcshell command" + std::to_string(sLine) + ";\n";
+    }
+
+    sHsfArgsV2.mV1Args = sHsfArgs;
+    sHsfArgsV2.mNoReplayId = true;
+    sHsfArgsV2.mBmcTimeout = 60;
+    sHsfArgsV2.mIssueBmcDump = false;
+    const std::string sLargeEncoded = getEncodedScript(sLargeScript);
+    sRc = createAcfWithEncodedScript(sHsfArgsV2, sLargeEncoded, sAcf);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+    uint64_t sReplayId = 0;
+    AcfType sType = AcfType_Invalid;
+    uint64_t sExpiration = 0;
+    sRc = verifyACFForBMCUploadV2(sAcf.data(), sAcf.size(), 0, key1_pub_der,
+                                  key1_pub_der_len, sSerial.c_str(),
+                                  sSerial.length(), 0, sReplayId, sType,
+                                  sExpiration);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+    AcfUserFields sFields;
+    sRc = checkAuthorizationAndGetAcfUserFieldsV2(
+        sAcf.data(), sAcf.size(), NULL, 0, 0, key1_pub_der, key1_pub_der_len,
+        sSerial.c_str(), sSerial.length(), 0, sFields);
+    DO_TEST(sResult, CeLoginRc::Success != sRc, sRc);
+
+    AcfUserFieldsView sView;
+    sRc = checkAuthorizationAndGetAcfUserFieldsViewV2(
+        sAcf.data(), sAcf.size(), NULL, 0, 0, key1_pub_der, key1_pub_der_len,
+        sSerial.c_str(), sSerial.length(), 0, sView);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+    DO_TEST(sResult, sLargeEncoded.length() == sView.mEncodedField.mLength,
+            sView.mEncodedField.mLength);
+
+    std::vector<char> sDecoded(getAcfUserFieldDecodedSize(sView));
+    uint64_t sDecodedLength = 0;
+    sRc = decodeAcfUserField(sView, sDecoded.data(), sDecoded.size(),
+                             sDecodedLength);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+    DO_TEST(sResult,
+            sLargeScript == std::string(sDecoded.data(), sDecodedLength),
+            sDecodedLength);
+
+    // The arena variant returns the same view
+    std::vector<uint8_t> sBuffer(getArenaSizeV2(sAcf.size()));
+    CeLoginArena sArena(sBuffer.data(), sBuffer.size());
+    sView.clear();
+    sRc = checkAuthorizationAndGetAcfUserFieldsViewV2(
+        sAcf.data(), sAcf.size(), NULL, 0, 0, key1_pub_der, key1_pub_der_len,
+        sSerial.c_str(), sSerial.length(), 0, sView, sArena);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+    DO_TEST(sResult, sLargeEncoded.length() == sView.mEncodedField.mLength,
+            sView.mEncodedField.mLength);
+
+    // Every piece of a large script is still checked while parsing, and
+    // only the last one may be padded
+    const size_t sPositions[] = {
+        0, CeLogin::MaxAsciiScriptFileLength / 3 * 4 - 1,
+        sLargeEncoded.length() - 5};
+    for (size_t sIdx = 0; sIdx < sizeof(sPositions) / sizeof(sPositions[0]);
+         sIdx++)
+    {
+        std::string sCorrupt = sLargeEncoded;
+        sCorrupt[sPositions[sIdx]] = (1 == sIdx) ? '=' : '!';
+        sRc = createAcfWithEncodedScript(sHsfArgsV2, sCorrupt, sAcf);
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+        sView.clear();
+        sRc = checkAuthorizationAndGetAcfUserFieldsViewV2(
+            sAcf.data(), sAcf.size(), NULL, 0, 0, key1_pub_der,
+            key1_pub_der_len, sSerial.c_str(), sSerial.length(), 0, sView);
+        DO_TEST(sResult, CeLoginRc::Success != sRc, sIdx);
+        DO_TEST(sResult, NULL == sView.mEncodedField.mData, sIdx);
+    }
+#endif
+    return sResult;
+}
+
+#ifndef CELOGIN_POWERVM_TARGET
+// Results of verifying an ACF at upload time
+struct UploadResult
+{
+    UploadResult() :
+        mRc(CeLoginRc::Success), mReplayId(0), mType(AcfType_Invalid),
+        mExpirationTime(0)
+    {}
+
+    bool operator==(const UploadResult& otherParm) const
+    {
+        return mRc == otherParm.mRc && mReplayId == otherParm.mReplayId &&
+               mType == otherParm.mType &&
+               mExpirationTime == otherParm.mExpirationTime;
+    }
+
+    CeLoginRc mRc;
+    uint64_t mReplayId;
+    AcfType mType;
+    uint64_t mExpirationTime;
+};
+
+static UploadResult uploadAcf(const std::vector<uint8_t>& acfParm,
+                              const std::string& serialParm)
+{
+    UploadResult sResult;
+    sResult.mRc = verifyACFForBMCUploadV2(
+        acfParm.data(), acfParm.size(), 0, key1_pub_der, key1_pub_der_len,
+        serialParm.c_str(), serialParm.length(), 0, sResult.mReplayId,
+        sResult.mType, sResult.mExpirationTime);
+    return sResult;
+}
+
+// Receives the ACF in pieces of the given size, up to the first error
+static UploadResult streamAcf(AcfUploadStream& streamParm,
+                              const std::vector<uint8_t>& acfParm,
+                              const uint64_t pieceLengthParm,
+                              std::vector<uint8_t>& jsonParm,
+                              const std::string& serialParm)
+{
+    UploadResult sResult;
+    CeLoginRc sRc = streamParm.begin(jsonParm.data(), jsonParm.size());
+    for (uint64_t sOffset = 0;
+         CeLoginRc::Success == sRc && sOffset < acfParm.size();
+         sOffset += pieceLengthParm)
+    {
+        uint64_t sLength = acfParm.size() - sOffset;
+        if (sLength > pieceLengthParm)
+        {
+            sLength = pieceLengthParm;
+        }
+        sRc = streamParm.update(acfParm.data() + sOffset, sLength);
+    }
+
+    sResult.mRc = streamParm.finish(
+        0, key1_pub_der, key1_pub_der_len, serialParm.c_str(),
+        serialParm.length(), 0, sResult.mReplayId, sResult.mType,
+        sResult.mExpirationTime);
+    return sResult;
+}
+#endif
+
+UnitTestResult ut_upload_stream_v2()
+{
+    UnitTestResult sResult;
+#ifndef CELOGIN_POWERVM_TARGET
+    CeLoginRc sRc = CeLoginRc::Success;
+
+    CeLoginCreateHsfArgsV1 sHsfArgs = GetDefaultHsfArgs();
+    CeLoginCreateHsfArgsV2 sHsfArgsV2;
+    std::vector<uint8_t> sAcf;
+
+    const std::string sSerial = sHsfArgs.mMachines.front().mSerialNumber;
+
+    sHsfArgsV2.mV1Args = sHsfArgs;
+    sHsfArgsV2.mNoReplayId = true;
+    sHsfArgsV2.mType = "bmcshell";
+    sHsfArgsV2.mScript = "bmcshell command1; bmcshell command2;";
+    sHsfArgsV2.mBmcTimeout = 60;
+    sHsfArgsV2.mIssueBmcDump = false;
+    sRc = createCeLoginAcfV2(sHsfArgsV2, sAcf);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+    AcfUploadStream sStream;
+    std::vector<uint8_t> sJson(sAcf.size());
+
+    // Any split of the ACF gives the same results as verifying it at once
+    const UploadResult sExpected = uploadAcf(sAcf, sSerial);
+    DO_TEST(sResult, CeLoginRc::Success == sExpected.mRc, sExpected.mRc);
+    DO_TEST(sResult, AcfType_BmcShell == sExpected.mType, sExpected.mType);
+
+    const uint64_t sPieceLengths[] = {1, 3, 64, 1000, sAcf.size()};
+    for (size_t sIdx = 0;
+         sIdx < sizeof(sPieceLengths) / sizeof(sPieceLengths[0]); sIdx++)
+    {
+        const UploadResult sStreamed =
+            streamAcf(sStream, sAcf, sPieceLengths[sIdx], sJson, sSerial);
+        DO_TEST(sResult, sExpected == sStreamed, sStreamed.mRc);
+        DO_TEST(sResult, sAcf.size() == sStream.getReceivedLength(),
+                sStream.getReceivedLength());
+    }
+
+    // Same with a parsed public key
+    {
+        const uint8_t* sKeyDer = key1_pub_der;
+        EVP_PKEY* sKey = d2i_PUBKEY(NULL, &sKeyDer, key1_pub_der_len);
+        UploadResult sStreamed;
+        sRc = sStream.begin(sJson.data(), sJson.size());
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+        sRc = sStream.update(sAcf.data(), sAcf.size());
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+        sStreamed.mRc = sStream.finish(
+            0, sKey, sSerial.c_str(), sSerial.length(), 0,
+            sStreamed.mReplayId, sStreamed.mType, sStreamed.mExpirationTime);
+        DO_TEST(sResult, sExpected == sStreamed, sStreamed.mRc);
+        EVP_PKEY_free(sKey);
+    }
+
+    // Anything after the ACF is ignored, as it is at once
+    std::vector<uint8_t> sPadded(sAcf);
+    sPadded.insert(sPadded.end(), 16, 0xFF);
+    {
+        const UploadResult sStreamed =
+            streamAcf(sStream, sPadded, 7, sJson, sSerial);
+        DO_TEST(sResult, uploadAcf(sPadded, sSerial) == sStreamed,
+                sStreamed.mRc);
+        DO_TEST(sResult, sPadded.size() == sStream.getReceivedLength(),
+                sStream.getReceivedLength());
+    }
+
+    // Every truncation and every changed byte gives the same results. Only
+    // the source file name is not covered by the signature.
+    for (uint64_t sLength = 1; sLength < sAcf.size(); sLength++)
+    {
+        const std::vector<uint8_t> sTruncated(sAcf.begin(),
+                                              sAcf.begin() + sLength);
+        const UploadResult sStreamed =
+            streamAcf(sStream, sTruncated, 17, sJson, sSerial);
+        DO_TEST(sResult, uploadAcf(sTruncated, sSerial) == sStreamed,
+                sLength);
+    }
+    for (uint64_t sPos = 0; sPos < sAcf.size(); sPos++)
+    {
+        std::vector<uint8_t> sCorrupt(sAcf);
+        sCorrupt[sPos] ^= 0x01;
+        const UploadResult sExpectedCorrupt = uploadAcf(sCorrupt, sSerial);
+        const UploadResult sStreamed =
+            streamAcf(sStream, sCorrupt, 29, sJson, sSerial);
+        DO_TEST(sResult, sExpectedCorrupt == sStreamed, sPos);
+    }
+
+    // Errors in the fields before the payload are found as soon as they
+    // arrive, including a payload larger than the buffer
+    {
+        std::vector<uint8_t> sCorrupt(sAcf);
+        sCorrupt[0] ^= 0x01;
+        sRc = sStream.begin(sJson.data(), sJson.size());
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+        sRc = sStream.update(sCorrupt.data(), 1);
+        DO_TEST(sResult, CeLoginRc::VerifyAcf_AsnDecodeFailure == sRc, sRc);
+
+        std::vector<uint8_t> sSmallJson(16);
+        sRc = sStream.begin(sSmallJson.data(), sSmallJson.size());
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+        sRc = sStream.update(sAcf.data(), 64);
+        DO_TEST(sResult, CeLoginRc::GetSevAuth_InvalidAcfLength == sRc, sRc);
+
+        UploadResult sStreamed;
+        sStreamed.mRc = sStream.finish(
+            0, key1_pub_der, key1_pub_der_len, sSerial.c_str(),
+            sSerial.length(), 0, sStreamed.mReplayId, sStreamed.mType,
+            sStreamed.mExpirationTime);
+        DO_TEST(sResult,
+                CeLoginRc::GetSevAuth_InvalidAcfLength == sStreamed.mRc,
+                sStreamed.mRc);
+        DO_TEST(sResult, AcfType_Invalid == sStreamed.mType, sStreamed.mType);
+    }
+
+    // Parameter checks, in the same order as verifying the ACF at once
+    {
+        UploadResult sStreamed;
+        sStreamed.mRc = sStream.finish(
+            0, key1_pub_der, key1_pub_der_len, sSerial.c_str(),
+            sSerial.length(), 0, sStreamed.mReplayId, sStreamed.mType,
+            sStreamed.mExpirationTime);
+        DO_TEST(sResult, CeLoginRc::GetSevAuth_InvalidAcfPtr == sStreamed.mRc,
+                sStreamed.mRc);
+
+        sRc = sStream.update(sAcf.data(), sAcf.size());
+        DO_TEST(sResult, CeLoginRc::GetSevAuth_InvalidAcfPtr == sRc, sRc);
+
+        sRc = sStream.begin(NULL, sJson.size());
+        DO_TEST(sResult, CeLoginRc::VerifyAcf_InvalidParm == sRc, sRc);
+
+        sRc = sStream.begin(sJson.data(), sJson.size());
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+        sStreamed.mRc = sStream.finish(
+            0, key1_pub_der, key1_pub_der_len, sSerial.c_str(),
+            sSerial.length(), 0, sStreamed.mReplayId, sStreamed.mType,
+            sStreamed.mExpirationTime);
+        DO_TEST(sResult,
+                CeLoginRc::GetSevAuth_InvalidAcfLength == sStreamed.mRc,
+                sStreamed.mRc);
+
+        sRc = sStream.begin(sJson.data(), sJson.size());
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+        sRc = sStream.update(sAcf.data(), sAcf.size());
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+        sStreamed.mRc = sStream.finish(
+            0, key1_pub_der, key1_pub_der_len, sSerial.c_str(), 0, 0,
+            sStreamed.mReplayId, sStreamed.mType, sStreamed.mExpirationTime);
+        DO_TEST(sResult,
+                CeLoginRc::GetSevAuth_InvalidSerialNumberLength ==
+                    sStreamed.mRc,
+                sStreamed.mRc);
+    }
+#endif
+    return sResult;
+}
+
+UnitTestResult ut_password_hashes()
+{
+    UnitTestResult sResult;
+#ifndef CELOGIN_POWERVM_TARGET
+    CeLoginRc sRc = CeLoginRc::Success;
+
+    // More requests than lanes, with keys longer than a SHA-512 block,
+    // outputs of several blocks and outputs too long for the lanes
+    const uint64_t sNumRequests = 19;
+    std::vector<std::string> sPasswords(sNumRequests);
+    std::vector<std::vector<uint8_t>> sSalts(sNumRequests);
+    std::vector<std::vector<uint8_t>> sExpected(sNumRequests);
+    std::vector<std::vector<uint8_t>> sOutputs(sNumRequests);
+    std::vector<PasswordHashRequest> sRequests(sNumRequests);
+    for (uint64_t sIdx = 0; sIdx < sNumRequests; sIdx++)
+    {
+        sPasswords[sIdx] = std::string(1 + sIdx * 11, 'a' + sIdx);
+        sSalts[sIdx].assign(1 + sIdx * 7, (uint8_t)(sIdx * 37));
+        const uint64_t sLength = 1 + (sIdx * 29) % 300;
+        sExpected[sIdx].assign(sLength, 0);
+        sOutputs[sIdx].assign(sLength, 0);
+
+        PasswordHashRequest& sRequest = sRequests[sIdx];
+        sRequest.mPassword = sPasswords[sIdx].c_str();
+        sRequest.mPasswordLength = sPasswords[sIdx].length();
+        sRequest.mSalt = sSalts[sIdx].data();
+        sRequest.mSaltLength = sSalts[sIdx].size();
+        sRequest.mIterations = 1 + (sIdx * 97) % 1000;
+        sRequest.mOutputHash = sOutputs[sIdx].data();
+        sRequest.mOutputHashSize = sLength;
+        sRequest.mRequestedOutputLength = sLength;
+    }
+
+    // Requests createPasswordHash rejects are rejected the same way, the
+    // rest of the batch is still derived
+    sRequests[3].mPassword = NULL;
+    sRequests[5].mIterations = 0;
+    sRequests[8].mIterations = (uint64_t)INT_MAX + 1;
+    sRequests[13].mOutputHashSize = sRequests[13].mRequestedOutputLength - 1;
+
+    std::vector<CeLoginRc> sExpectedRcs;
+    for (uint64_t sIdx = 0; sIdx < sNumRequests; sIdx++)
+    {
+        const PasswordHashRequest& sRequest = sRequests[sIdx];
+        sExpectedRcs.push_back(CeLogin::createPasswordHash(
+            sRequest.mPassword, sRequest.mPasswordLength, sRequest.mSalt,
+            sRequest.mSaltLength, sRequest.mIterations, sExpected[sIdx].data(),
+            sRequest.mOutputHashSize, sRequest.mRequestedOutputLength));
+    }
+
+    CeLogin::createPasswordHashes(sRequests.data(), sRequests.size());
+    for (uint64_t sIdx = 0; sIdx < sNumRequests; sIdx++)
+    {
+        DO_TEST(sResult, sExpectedRcs[sIdx] == sRequests[sIdx].mRc, sIdx);
+        if (CeLoginRc::Success == sExpectedRcs[sIdx])
+        {
+            DO_TEST(sResult, sExpected[sIdx] == sOutputs[sIdx], sIdx);
+        }
+    }
+    DO_TEST(sResult, CeLoginRc::Success != sExpectedRcs[3], sExpectedRcs[3]);
+    DO_TEST(sResult, CeLoginRc::Success != sExpectedRcs[13],
+            sExpectedRcs[13]);
+
+    CeLogin::createPasswordHashes(NULL, 0);
+
+    // ACFs made from a batch of payloads authenticate their own password
+    // and no other
+    const char* sAcfPasswords[] = {"password", "0penSesame", "x", "password2",
+                                   "correct horse battery staple"};
+    const uint64_t sNumAcfs = sizeof(sAcfPasswords) / sizeof(sAcfPasswords[0]);
+    std::vector<CeLoginCreateHsfArgsV2> sArgs(sNumAcfs);
+    for (uint64_t sIdx = 0; sIdx < sNumAcfs; sIdx++)
+    {
+        sArgs[sIdx].mV1Args = GetDefaultHsfArgs();
+        sArgs[sIdx].mV1Args.mPasswordPtr = sAcfPasswords[sIdx];
+        sArgs[sIdx].mV1Args.mPasswordLength = strlen(sAcfPasswords[sIdx]);
+        sArgs[sIdx].mV1Args.mIterations = 1000 + sIdx;
+        sArgs[sIdx].mNoReplayId = true;
+        sArgs[sIdx].mType = "service";
+        sArgs[sIdx].mBmcTimeout = 0;
+        sArgs[sIdx].mIssueBmcDump = false;
+    }
+
+    std::vector<std::string> sJsons;
+    std::vector<std::vector<uint8_t>> sDigests;
+    sRc = createCeLoginAcfV2Payloads(sArgs, sJsons, sDigests);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+    DO_TEST(sResult, sNumAcfs == sJsons.size(), sJsons.size());
+    DO_TEST(sResult, sNumAcfs == sDigests.size(), sDigests.size());
+
+    const std::string sSerial =
+        sArgs.front().mV1Args.mMachines.front().mSerialNumber;
+    for (uint64_t sIdx = 0; sIdx < sJsons.size() && sIdx < sNumAcfs; sIdx++)
+    {
+        std::vector<uint8_t> sSignature;
+        std::vector<uint8_t> sAcf;
+        sRc = createCeLoginAcfV2Signature(sArgs[sIdx], sDigests[sIdx],
+                                          sSignature);
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+        sRc = createCeLoginAcfV2Asn1(sArgs[sIdx], sJsons[sIdx], sSignature,
+                                     sAcf);
+        DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+        for (uint64_t sPassword = 0; sPassword < sNumAcfs; sPassword++)
+        {
+            AcfUserFields sFields;
+            sRc = checkAuthorizationAndGetAcfUserFieldsV2(
+                sAcf.data(), sAcf.size(), sAcfPasswords[sPassword],
+                strlen(sAcfPasswords[sPassword]), 0, key1_pub_der,
+                key1_pub_der_len, sSerial.c_str(), sSerial.length(), 0,
+                sFields);
+            DO_TEST(sResult, (sIdx == sPassword) == sRc.isSuccess(),
+                    sIdx * sNumAcfs + sPassword);
+        }
+    }
+
+    // An invalid ACF in the batch fails all of it
+    sArgs[2].mType = "invalid";
+    sRc = createCeLoginAcfV2Payloads(sArgs, sJsons, sDigests);
+    DO_TEST(sResult, CeLoginRc::Success != sRc, sRc);
+    DO_TEST(sResult, sJsons.empty(), sJsons.size());
+    DO_TEST(sResult, sDigests.empty(), sDigests.size());
+#endif
+    return sResult;
+}
+
+#ifndef CELOGIN_POWERVM_TARGET
+// Stops a password hash once it has been asked the given number of times
+struct StopAfter
+{
+    explicit StopAfter(const uint64_t callsParm) :
+        mCalls(0), mStopAt(callsParm)
+    {}
+
+    static bool shouldStop(void* contextParm)
+    {
+        StopAfter* sThis = static_cast<StopAfter*>(contextParm);
+        return ++sThis->mCalls >= sThis->mStopAt;
+    }
+
+    PasswordHashControl getControl()
+    {
+        PasswordHashControl sControl = {&StopAfter::shouldStop, this};
+        return sControl;
+    }
+
+    uint64_t mCalls;
+    uint64_t mStopAt;
+};
+#endif
+
+UnitTestResult ut_password_hash_control()
+{
+    UnitTestResult sResult;
+#ifndef CELOGIN_POWERVM_TARGET
+    CeLoginRc sRc = CeLoginRc::Success;
+
+    const uint64_t sIterations = 5000;
+    const std::string sPassword = "password";
+    const std::vector<uint8_t> sSalt(64, 0x5A);
+    std::vector<uint8_t> sExpected(64);
+    sRc = CeLogin::createPasswordHash(sPassword.c_str(), sPassword.length(),
+                                      sSalt.data(), sSalt.size(), sIterations,
+                                      sExpected.data(), sExpected.size(),
+                                      sExpected.size());
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+    // A control that never stops gives the same hash, asking between blocks
+    {
+        std::vector<uint8_t> sOutput(64);
+        PasswordHashRequest sRequest;
+        sRequest.mPassword = sPassword.c_str();
+        sRequest.mPasswordLength = sPassword.length();
+        sRequest.mSalt = sSalt.data();
+        sRequest.mSaltLength = sSalt.size();
+        sRequest.mIterations = sIterations;
+        sRequest.mOutputHash = sOutput.data();
+        sRequest.mOutputHashSize = sOutput.size();
+        sRequest.mRequestedOutputLength = sOutput.size();
+
+        StopAfter sNever(UINT64_MAX);
+        PasswordHashControl sControl = sNever.getControl();
+        CeLogin::createPasswordHashes(&sRequest, 1, &sControl);
+        DO_TEST(sResult, CeLoginRc::Success == sRequest.mRc, sRequest.mRc);
+        DO_TEST(sResult, sExpected == sOutput, 0);
+        DO_TEST(sResult,
+                sNever.mCalls >=
+                    sIterations /
+                        PasswordHashControl::PasswordHashCheckIterations,
+                sNever.mCalls);
+
+        // Stopped part way, every request still to be derived fails
+        std::vector<PasswordHashRequest> sRequests(5, sRequest);
+        StopAfter sSecond(2);
+        sControl = sSecond.getControl();
+        CeLogin::createPasswordHashes(sRequests.data(), sRequests.size(),
+                                      &sControl);
+        for (uint64_t sIdx = 0; sIdx < sRequests.size(); sIdx++)
+        {
+            DO_TEST(sResult,
+                    CeLoginRc::PasswordHashStopped == sRequests[sIdx].mRc,
+                    sIdx);
+        }
+        DO_TEST(sResult, 2 == sSecond.mCalls, sSecond.mCalls);
+    }
+
+    CeLoginCreateHsfArgsV2 sHsfArgsV2;
+    sHsfArgsV2.mV1Args = GetDefaultHsfArgs();
+    sHsfArgsV2.mV1Args.mIterations = sIterations;
+    sHsfArgsV2.mNoReplayId = true;
+    sHsfArgsV2.mType = "service";
+    sHsfArgsV2.mBmcTimeout = 0;
+    sHsfArgsV2.mIssueBmcDump = false;
+    const CeLoginCreateHsfArgsV1& sHsfArgs = sHsfArgsV2.mV1Args;
+    const std::string sSerial = sHsfArgs.mMachines.front().mSerialNumber;
+
+    std::vector<uint8_t> sAcf;
+    sRc = createCeLoginAcfV2(sHsfArgsV2, sAcf);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+    AcfAuthRecord sRecord;
+    sRc = getAcfAuthRecordV2(sAcf.data(), sAcf.size(), 0, key1_pub_der,
+                             key1_pub_der_len, sSerial.c_str(),
+                             sSerial.length(), sRecord);
+    DO_TEST(sResult, CeLoginRc::Success == sRc, sRc);
+
+    const uint8_t* sKeyDer = key1_pub_der;
+    EVP_PKEY* sKey = d2i_PUBKEY(NULL, &sKeyDer, key1_pub_der_len);
+
+    // The stoppable checks give the same results as the others when they
+    // are not stopped, and PasswordHashStopped when they are
+    const char* sPasswords[] = {sHsfArgs.mPasswordPtr, "wrong password"};
+    for (uint64_t sIdx = 0; sIdx < 2; sIdx++)
+    {
+        const uint64_t sLength = strlen(sPasswords[sIdx]);
+        AcfUserFields sFields;
+        const CeLoginRc sExpectedRc = checkAuthorizationWithAcfAuthRecordV2(
+            sRecord, sPasswords[sIdx], sLength, 0, 0, sFields);
+        DO_TEST(sResult, (0 == sIdx) == sExpectedRc.isSuccess(), sExpectedRc);
+
+        StopAfter sNever(UINT64_MAX);
+        sRc = checkAuthorizationWithAcfAuthRecordV2(
+            sRecord, sPasswords[sIdx], sLength, 0, 0, sFields,
+            sNever.getControl());
+        DO_TEST(sResult, sExpectedRc == sRc, sRc);
+
+        sRc = checkAuthorizationAndGetAcfUserFieldsV2(
+            sAcf.data(), sAcf.size(), sPasswords[sIdx], sLength, 0, sKey,
+            sSerial.c_str(), sSerial.length(), 0, sFields,
+            sNever.getControl());
+        DO_TEST(sResult, sExpectedRc == sRc, sRc);
+
+        StopAfter sFirst(1);
+        sRc = checkAuthorizationWithAcfAuthRecordV2(
+            sRecord, sPasswords[sIdx], sLength, 0, 0, sFields,
+            sFirst.getControl());
+        DO_TEST(sResult, CeLoginRc::PasswordHashStopped == sRc, sRc);
+        DO_TEST(sResult, AcfType_Invalid == sFields.mType, sFields.mType);
+
+        StopAfter sThird(3);
+        sRc = checkAuthorizationAndGetAcfUserFieldsV2(
+            sAcf.data(), sAcf.size(), sPasswords[sIdx], sLength, 0, sKey,
+            sSerial.c_str(), sSerial.length(), 0, sFields,
+            sThird.getControl());
+        DO_TEST(sResult, CeLoginRc::PasswordHashStopped == sRc, sRc);
+        DO_TEST(sResult, 3 == sThird.mCalls, sThird.mCalls);
+    }
+
+    // Checks that fail before the password is hashed never ask
+    {
+        StopAfter sFirst(1);
+        AcfUserFields sFields;
+        sRc = checkAuthorizationWithAcfAuthRecordV2(
+            sRecord, NULL, 0, 0, 0, sFields, sFirst.getControl());
+        DO_TEST(sResult, !sRc.isSuccess(), sRc);
+        DO_TEST(sResult, CeLoginRc::PasswordHashStopped != sRc, sRc);
+        DO_TEST(sResult, 0 == sFirst.mCalls, sFirst.mCalls);
+    }
+
+    EVP_PKEY_free(sKey);
+#endif
+    return sResult;
+}
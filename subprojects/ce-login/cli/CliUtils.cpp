@@ -1,5 +1,6 @@
 #include "CliUtils.h"
 
+#include "../celogin/src/CeLoginUtil.h"
 #include "CliCeLoginV1.h"
 
 #include <CeLogin.h>
@@ -100,15 +101,13 @@ bool cli::writeBinaryFile(const std::string fileNameParm,
 
 std::string cli::getHexStringFromBinary(const std::vector<uint8_t>& binaryParm)
 {
-    std::stringstream ss;
-
-    for (uint64_t sIdx = 0; sIdx < binaryParm.size(); sIdx++)
-    {
-        ss.fill('0');
-        ss.width(2);
-        ss << std::hex << (int)binaryParm[sIdx];
-    }
-    return ss.str();
+    std::string sHexString(2 * binaryParm.size(), '\0');
+    uint64_t sHexStringLength = 0;
+    CeLogin::getHexFromBinary(binaryParm.data(), binaryParm.size(),
+                              &sHexString[0], sHexString.size(),
+                              sHexStringLength);
+    sHexString.resize(sHexStringLength);
+    return sHexString;
 }
 
 std::string cli::generateReplayId()
@@ -339,22 +338,14 @@ CeLogin::CeLoginRc cli::base64Encode(const std::string& stringToEncodeParm,
         4 * ((stringToEncodeParm.length() + 2) / 3);
     base64EncodedStringParm.resize(sCalculatedEncodedLen);
 
-    // Perform Base64 encoding
-    const int sEncodeRc = EVP_EncodeBlock(
-        reinterpret_cast<unsigned char*>(&base64EncodedStringParm[0]),
-        reinterpret_cast<const unsigned char*>(stringToEncodeParm.data()),
-        stringToEncodeParm.length());
-    // EVP_EncodeBlock returns -1 on failure, otherwise, resize the string
-    // object to the actual string length of the encoded data
-    if (sEncodeRc < 0)
-    {
-        sRc = CeLogin::CeLoginRc::Failure;
-        base64EncodedStringParm.clear();
-    }
-    else
-    {
-        base64EncodedStringParm.resize(strlen(base64EncodedStringParm.c_str()));
-    }
+    // Perform Base64 encoding, then resize the string object to the actual
+    // string length of the encoded data
+    size_t sEncodedLen = 0;
+    sRc = CeLogin::base64Encode(
+        reinterpret_cast<const uint8_t*>(stringToEncodeParm.data()),
+        stringToEncodeParm.length(), &base64EncodedStringParm[0],
+        base64EncodedStringParm.size(), sEncodedLen);
+    base64EncodedStringParm.resize(sEncodedLen);
     return sRc;
 }
 
@@ -0,0 +1,606 @@
+
+#include "CeLoginCli.h"
+#include "CliUtils.h"
+
+#include <CeLogin.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <openssl/x509.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace CeLogin;
+
+// clang-format off
+struct VerifyBatchArguments
+{
+    std::string mHsfDirName;
+    std::string mHsfListFileName;
+    std::vector<std::string> mHsfFileNames;
+    std::vector<std::string> mPublicKeyFileNames;
+    std::string mPassword;
+    std::string mSerialNumber;
+    uint64_t mThreads;
+    bool mHelp;
+    VerifyBatchArguments()
+    {
+        mThreads = 0;
+        mHelp = false;
+    }
+};
+
+enum VerifyBatchOptOptions
+{
+    BatchHsfDirName,
+    BatchHsfListFileName,
+    BatchPublicKeyFileName,
+    BatchPassword,
+    BatchSerialNumber,
+    BatchThreads,
+    BatchHelp,
+    BatchNOptOptions
+};
+
+struct option verify_batch_long_options[BatchNOptOptions + 1] = {
+    {"hsfDir", required_argument, NULL, 'd'},
+    {"hsfList", required_argument, NULL, 'l'},
+    {"publicKeyFile", required_argument, NULL, 'k'},
+    {"password", required_argument, NULL, 'p'},
+    {"serialNumber", required_argument, NULL, 's'},
+    {"threads", required_argument, NULL, 't'},
+    {"help", no_argument, NULL, 'h'},
+    {0, 0, 0, 0}};
+
+std::string verify_batch_options_description[BatchNOptOptions] = {
+    "Directory of ACFs to verify",
+    "File listing the ACFs to verify, one path per line",
+    "PublicKeyFile, may be repeated",
+    "Password, checked against service ACFs",
+    "<7-char serial number|UNSET>",
+    "Number of threads, defaults to the number of cores",
+    "Help"};
+// clang-format on
+
+static void verifyBatchParseArgs(int argc, char** argv,
+                                 struct VerifyBatchArguments& args)
+{
+    std::string short_options = "";
+
+    for (int i = 0; i < BatchNOptOptions; i++)
+    {
+        short_options += verify_batch_long_options[i].val;
+        if (required_argument == verify_batch_long_options[i].has_arg)
+        {
+            short_options += ":";
+        }
+    }
+
+    int c;
+    while (1)
+    {
+        int option_index = 0;
+        c = getopt_long(argc, argv, short_options.c_str(),
+                        verify_batch_long_options, &option_index);
+        if (c == -1)
+            break;
+        switch (c)
+        {
+            case 'd':
+            {
+                args.mHsfDirName = std::string(optarg);
+                break;
+            }
+            case 'l':
+            {
+                args.mHsfListFileName = std::string(optarg);
+                break;
+            }
+            case 'k':
+            {
+                args.mPublicKeyFileNames.push_back(std::string(optarg));
+                break;
+            }
+            case 'p':
+            {
+                args.mPassword = std::string(optarg);
+                break;
+            }
+            case 's':
+            {
+                args.mSerialNumber = std::string(optarg);
+                break;
+            }
+            case 't':
+            {
+                args.mThreads = strtoull(optarg, NULL, 10);
+                break;
+            }
+            case 'h':
+            {
+                args.mHelp = true;
+                break;
+            }
+            default:
+            {
+            }
+        }
+    }
+
+    // The remaining arguments are ACFs, after the sub command itself
+    for (int i = optind + 1; i < argc; i++)
+    {
+        args.mHsfFileNames.push_back(std::string(argv[i]));
+    }
+}
+
+static bool verifyBatchValidateArgs(const VerifyBatchArguments& args)
+{
+    bool sIsValidArgs = true;
+    if (args.mHsfDirName.empty() && args.mHsfListFileName.empty() &&
+        args.mHsfFileNames.empty())
+    {
+        sIsValidArgs = false;
+        std::cout << "Error: Missing HsfDir, HsfList or hsf files"
+                  << std::endl;
+    }
+    if (args.mPublicKeyFileNames.empty())
+    {
+        sIsValidArgs = false;
+        std::cout << "Error: Missing Public Key File Path" << std::endl;
+    }
+    if (args.mSerialNumber.empty())
+    {
+        sIsValidArgs = false;
+        std::cout << "Error: Missing Serial Number" << std::endl;
+    }
+    return sIsValidArgs;
+}
+
+#ifndef CELOGIN_POWERVM_TARGET
+// Outcome of verifying one ACF
+struct BatchResult
+{
+    BatchResult()
+        : mRc(CeLoginRc::Failure), mPasswordRc(CeLoginRc::Success),
+          mPasswordChecked(false), mMapped(false), mType(AcfType_Invalid),
+          mExpirationTime(0), mKeyIndex(0), mMicroseconds(0)
+    {}
+
+    CeLoginRc mRc;
+    CeLoginRc mPasswordRc;
+    bool mPasswordChecked;
+    bool mMapped;
+    AcfType mType;
+    uint64_t mExpirationTime;
+    uint64_t mKeyIndex;
+    double mMicroseconds;
+};
+
+// Read-only mapping of a whole file, released when destroyed
+class MappedFile
+{
+  public:
+    explicit MappedFile(const std::string& fileNameParm)
+        : mData(NULL), mSize(0)
+    {
+        int sFd = open(fileNameParm.c_str(), O_RDONLY | O_CLOEXEC);
+        if (sFd < 0)
+        {
+            return;
+        }
+        struct stat sStat;
+        if (0 == fstat(sFd, &sStat) && S_ISREG(sStat.st_mode) &&
+            sStat.st_size > 0)
+        {
+            void* sAddr = mmap(NULL, sStat.st_size, PROT_READ, MAP_PRIVATE,
+                               sFd, 0);
+            if (MAP_FAILED != sAddr)
+            {
+                mData = static_cast<const uint8_t*>(sAddr);
+                mSize = sStat.st_size;
+            }
+        }
+        close(sFd);
+    }
+
+    ~MappedFile()
+    {
+        if (mData)
+        {
+            munmap(const_cast<uint8_t*>(mData), mSize);
+        }
+    }
+
+    const uint8_t* data() const
+    {
+        return mData;
+    }
+
+    uint64_t size() const
+    {
+        return mSize;
+    }
+
+  private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    const uint8_t* mData;
+    uint64_t mSize;
+};
+
+static bool listDirectory(const std::string& dirNameParm,
+                          std::vector<std::string>& fileNamesParm)
+{
+    DIR* sDir = opendir(dirNameParm.c_str());
+    if (!sDir)
+    {
+        return false;
+    }
+
+    std::vector<std::string> sFileNames;
+    for (struct dirent* sEntry = readdir(sDir); sEntry;
+         sEntry = readdir(sDir))
+    {
+        std::string sPath = dirNameParm + "/" + sEntry->d_name;
+        struct stat sStat;
+        if ('.' != sEntry->d_name[0] && 0 == stat(sPath.c_str(), &sStat) &&
+            S_ISREG(sStat.st_mode))
+        {
+            sFileNames.push_back(sPath);
+        }
+    }
+    closedir(sDir);
+
+    // Same order on every run, whatever order the directory returns
+    std::sort(sFileNames.begin(), sFileNames.end());
+    fileNamesParm.insert(fileNamesParm.end(), sFileNames.begin(),
+                         sFileNames.end());
+    return true;
+}
+
+static bool readFileList(const std::string& listFileNameParm,
+                         std::vector<std::string>& fileNamesParm)
+{
+    std::ifstream sList(listFileNameParm.c_str());
+    if (!sList)
+    {
+        return false;
+    }
+    std::string sLine;
+    while (std::getline(sList, sLine))
+    {
+        if (!sLine.empty())
+        {
+            fileNamesParm.push_back(sLine);
+        }
+    }
+    return true;
+}
+
+static const char* getAcfTypeName(const AcfType typeParm)
+{
+    switch (typeParm)
+    {
+        case AcfType_Service:
+            return "service";
+        case AcfType_AdminReset:
+            return "adminreset";
+        case AcfType_ResourceDump:
+            return "resourcedump";
+        case AcfType_BmcShell:
+            return "bmcshell";
+        default:
+            return "invalid";
+    }
+}
+
+static std::string escapeJsonString(const std::string& stringParm)
+{
+    std::string sEscaped;
+    for (size_t sIdx = 0; sIdx < stringParm.size(); sIdx++)
+    {
+        const unsigned char sChar = stringParm[sIdx];
+        if ('"' == sChar || '\\' == sChar)
+        {
+            sEscaped += '\\';
+            sEscaped += sChar;
+        }
+        else if (sChar < 0x20)
+        {
+            char sCode[8];
+            snprintf(sCode, sizeof(sCode), "\\u%04x", sChar);
+            sEscaped += sCode;
+        }
+        else
+        {
+            sEscaped += sChar;
+        }
+    }
+    return sEscaped;
+}
+
+static std::string formatRc(const CeLoginRc& rcParm)
+{
+    char sRc[16];
+    snprintf(sRc, sizeof(sRc), "0x%02x%02x", (unsigned)rcParm.mComponent,
+             (unsigned)rcParm.mReason);
+    return sRc;
+}
+
+// Verify one ACF, with the password as well for a service ACF if one was
+// given
+static void verifyOne(const std::string& fileNameParm,
+                      const VerifyBatchArguments& argsParm,
+                      const uint64_t timeParm, CeLoginVerifier& verifierParm,
+                      BatchResult& resultParm)
+{
+    const std::chrono::steady_clock::time_point sStart =
+        std::chrono::steady_clock::now();
+
+    MappedFile sFile(fileNameParm);
+    resultParm.mMapped = NULL != sFile.data();
+    if (resultParm.mMapped)
+    {
+        AcfVerifiedRecord sRecord;
+        uint64_t sKeyIndex = verifierParm.getPublicKeyCount();
+        resultParm.mRc = getAcfVerifiedRecordV2(
+            sFile.data(), sFile.size(), timeParm, verifierParm,
+            argsParm.mSerialNumber.data(), argsParm.mSerialNumber.size(), 0,
+            sRecord, sKeyIndex);
+        resultParm.mType = sRecord.mType;
+        resultParm.mExpirationTime = sRecord.mExpirationTime;
+        resultParm.mKeyIndex = sKeyIndex;
+
+        if (CeLoginRc::Success == resultParm.mRc &&
+            AcfType_Service == sRecord.mType && !argsParm.mPassword.empty())
+        {
+            AcfAuthRecord sAuthRecord;
+            resultParm.mPasswordChecked = true;
+            resultParm.mPasswordRc = getAcfAuthRecordV2(
+                sFile.data(), sFile.size(), timeParm, verifierParm,
+                argsParm.mSerialNumber.data(), argsParm.mSerialNumber.size(),
+                sAuthRecord, sKeyIndex);
+            if (CeLoginRc::Success == resultParm.mPasswordRc)
+            {
+                AcfUserFields sUserFields;
+                resultParm.mPasswordRc = checkAuthorizationWithAcfAuthRecordV2(
+                    sAuthRecord, argsParm.mPassword.data(),
+                    argsParm.mPassword.size(), timeParm, 0, sUserFields);
+            }
+        }
+    }
+
+    resultParm.mMicroseconds =
+        std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - sStart)
+            .count();
+}
+
+static void printResult(const std::string& fileNameParm,
+                        const BatchResult& resultParm)
+{
+    const bool sValid = resultParm.mMapped &&
+                        CeLoginRc::Success == resultParm.mRc &&
+                        CeLoginRc::Success == resultParm.mPasswordRc;
+    std::cout << "{\"file\":\"" << escapeJsonString(fileNameParm) << "\""
+              << ",\"valid\":" << (sValid ? "true" : "false");
+    if (!resultParm.mMapped)
+    {
+        std::cout << ",\"error\":\"unable to read file\"";
+    }
+    else
+    {
+        std::cout << ",\"rc\":\"" << formatRc(resultParm.mRc) << "\""
+                  << ",\"type\":\"" << getAcfTypeName(resultParm.mType)
+                  << "\",\"expiration\":" << resultParm.mExpirationTime
+                  << ",\"keyIndex\":" << resultParm.mKeyIndex;
+        if (resultParm.mPasswordChecked)
+        {
+            std::cout << ",\"passwordRc\":\""
+                      << formatRc(resultParm.mPasswordRc) << "\"";
+        }
+    }
+    std::cout << ",\"latencyUs\":" << (uint64_t)resultParm.mMicroseconds
+              << "}" << std::endl;
+}
+
+// Latency below which the given fraction of the sorted latencies fall
+static double getPercentile(const std::vector<double>& sortedParm,
+                            const double fractionParm)
+{
+    if (sortedParm.empty())
+    {
+        return 0;
+    }
+    uint64_t sRank = (uint64_t)(fractionParm * sortedParm.size() + 0.999999);
+    sRank = std::max<uint64_t>(sRank, 1);
+    sRank = std::min<uint64_t>(sRank, sortedParm.size());
+    return sortedParm[sRank - 1];
+}
+
+static bool readPublicKeys(const std::vector<std::string>& fileNamesParm,
+                           std::vector<EVP_PKEY*>& keysParm)
+{
+    for (size_t sIdx = 0; sIdx < fileNamesParm.size(); sIdx++)
+    {
+        std::vector<uint8_t> sDer;
+        if (!cli::readBinaryFile(fileNamesParm[sIdx], sDer) || sDer.empty())
+        {
+            std::cout << "ERROR: Unable to read public key file: \""
+                      << fileNamesParm[sIdx] << "\"" << std::endl;
+            return false;
+        }
+        const uint8_t* sDerPtr = sDer.data();
+        EVP_PKEY* sKey = d2i_PUBKEY(NULL, &sDerPtr, sDer.size());
+        if (!sKey)
+        {
+            std::cout << "ERROR: Unable to parse public key file: \""
+                      << fileNamesParm[sIdx] << "\"" << std::endl;
+            return false;
+        }
+        keysParm.push_back(sKey);
+    }
+    return true;
+}
+
+static CeLoginRc verifyFiles(const std::vector<std::string>& fileNamesParm,
+                             const std::vector<EVP_PKEY*>& keysParm,
+                             const VerifyBatchArguments& argsParm)
+{
+    uint64_t sThreads = argsParm.mThreads;
+    if (0 == sThreads)
+    {
+        sThreads = std::max<uint64_t>(std::thread::hardware_concurrency(), 1);
+    }
+    sThreads = std::min<uint64_t>(sThreads, fileNamesParm.size());
+    sThreads = std::max<uint64_t>(sThreads, 1);
+
+    const uint64_t sTime = std::time(NULL);
+    std::vector<BatchResult> sResults(fileNamesParm.size());
+    std::atomic<uint64_t> sNextFile(0);
+    std::atomic<bool> sVerifierFailed(false);
+
+    // Workers take the next file as they become free, so a slow file does
+    // not hold up the ones queued behind it. The parsed keys are shared, but
+    // each worker has its own verifier as verifiers are not thread safe.
+    const std::chrono::steady_clock::time_point sStart =
+        std::chrono::steady_clock::now();
+    std::vector<std::thread> sWorkers;
+    for (uint64_t sWorker = 0; sWorker < sThreads; sWorker++)
+    {
+        sWorkers.push_back(std::thread([&]() {
+            CeLoginVerifier sVerifier;
+            if (CeLoginRc::Success !=
+                sVerifier.setPublicKeys(keysParm.data(), keysParm.size()))
+            {
+                sVerifierFailed = true;
+                return;
+            }
+            for (uint64_t sIdx = sNextFile++; sIdx < fileNamesParm.size();
+                 sIdx = sNextFile++)
+            {
+                verifyOne(fileNamesParm[sIdx], argsParm, sTime, sVerifier,
+                          sResults[sIdx]);
+            }
+        }));
+    }
+    for (size_t sIdx = 0; sIdx < sWorkers.size(); sIdx++)
+    {
+        sWorkers[sIdx].join();
+    }
+    const double sSeconds = std::chrono::duration<double>(
+                                std::chrono::steady_clock::now() - sStart)
+                                .count();
+
+    if (sVerifierFailed)
+    {
+        std::cout << "ERROR: Unable to set up the verifier" << std::endl;
+        return CeLoginRc::Failure;
+    }
+
+    uint64_t sValid = 0;
+    std::vector<double> sLatencies;
+    for (size_t sIdx = 0; sIdx < fileNamesParm.size(); sIdx++)
+    {
+        const BatchResult& sResult = sResults[sIdx];
+        printResult(fileNamesParm[sIdx], sResult);
+        if (sResult.mMapped && CeLoginRc::Success == sResult.mRc &&
+            CeLoginRc::Success == sResult.mPasswordRc)
+        {
+            sValid++;
+        }
+        sLatencies.push_back(sResult.mMicroseconds);
+    }
+    std::sort(sLatencies.begin(), sLatencies.end());
+
+    char sSummary[256];
+    snprintf(sSummary, sizeof(sSummary),
+             "{\"summary\":{\"files\":%zu,\"valid\":%" PRIu64
+             ",\"threads\":%" PRIu64 ",\"seconds\":%.3f,"
+             "\"filesPerSecond\":%.1f,\"latencyUs\":{\"p50\":%.0f,"
+             "\"p90\":%.0f,\"p99\":%.0f}}}",
+             fileNamesParm.size(), sValid, sThreads, sSeconds,
+             sSeconds > 0 ? fileNamesParm.size() / sSeconds : 0.0,
+             getPercentile(sLatencies, 0.50), getPercentile(sLatencies, 0.90),
+             getPercentile(sLatencies, 0.99));
+    std::cout << sSummary << std::endl;
+
+    return sValid == fileNamesParm.size() ? CeLoginRc::Success
+                                          : CeLoginRc::Failure;
+}
+#endif
+
+CeLogin::CeLoginRc cli::verifyBatch(int argc, char** argv)
+{
+    VerifyBatchArguments sArgs;
+    verifyBatchParseArgs(argc, argv, sArgs);
+
+    CeLogin::CeLoginRc sRc = CeLogin::CeLoginRc::Failure;
+
+    if (sArgs.mHelp)
+    {
+        cli::printHelp(argv[0], argv[1],
+                       "Verify the ACFs given as arguments, in a directory "
+                       "or listed in a file, printing one JSON line per ACF "
+                       "followed by a summary line",
+                       verify_batch_long_options,
+                       verify_batch_options_description, BatchNOptOptions);
+    }
+    else if (verifyBatchValidateArgs(sArgs))
+    {
+#ifndef CELOGIN_POWERVM_TARGET
+        std::vector<std::string> sFileNames = sArgs.mHsfFileNames;
+        std::vector<EVP_PKEY*> sKeys;
+        if (!sArgs.mHsfDirName.empty() &&
+            !listDirectory(sArgs.mHsfDirName, sFileNames))
+        {
+            std::cout << "ERROR: Unable to read hsf directory: \""
+                      << sArgs.mHsfDirName << "\"" << std::endl;
+        }
+        else if (!sArgs.mHsfListFileName.empty() &&
+                 !readFileList(sArgs.mHsfListFileName, sFileNames))
+        {
+            std::cout << "ERROR: Unable to read hsf list file: \""
+                      << sArgs.mHsfListFileName << "\"" << std::endl;
+        }
+        else if (sFileNames.empty())
+        {
+            std::cout << "ERROR: No hsf files to verify" << std::endl;
+        }
+        else if (readPublicKeys(sArgs.mPublicKeyFileNames, sKeys))
+        {
+            sRc = verifyFiles(sFileNames, sKeys, sArgs);
+        }
+
+        for (size_t sIdx = 0; sIdx < sKeys.size(); sIdx++)
+        {
+            EVP_PKEY_free(sKeys[sIdx]);
+        }
+#else
+        std::cout << "ERROR: verify-batch is not available for PowerVM"
+                  << std::endl;
+#endif
+    }
+    else
+    {
+        std::cout << "Args failed to validate" << std::endl;
+    }
+
+    return sRc;
+}
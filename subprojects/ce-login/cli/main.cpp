@@ -1,5 +1,6 @@
 
 #include "CeLoginCli.h"
+#include "CliBenchmark.h"
 #include "CliUnitTest.h"
 
 #include <CeLogin.h>
@@ -65,23 +66,37 @@ int main(int argc, char** argv)
             sPrintHelp = false;
             sRc = cli::verifyHsf(argc, argv);
         }
+        else if (0 == strcmp(argv[1], "verify-batch"))
+        {
+            sPrintHelp = false;
+            sRc = cli::verifyBatch(argc, argv);
+        }
         else if (0 == strcmp(argv[1], "test"))
         {
             sPrintHelp = false;
             cli::unit_test_main(argc, argv);
         }
+        else if (0 == strcmp(argv[1], "bench"))
+        {
+            sPrintHelp = false;
+            cli::benchmark_main(argc, argv);
+        }
     }
 
     if (sPrintHelp)
     {
         std::cout << "Usage:" << std::endl;
         std::cout << "    " << argv[0]
-                  << " [create_prod|create|decode|verify|test] [-v2] <args>"
+                  << " [create_prod|create|decode|verify|verify-batch|test"
+                  << "|bench] [-v2]"
+                  << " <args>"
                   << std::endl;
         std::cout << std::endl;
         std::cout << "Command Help Text:" << std::endl;
         std::cout << "    " << argv[0]
-                  << " [create_prod|create|decode|verify|test] [-v2] [-h|--help]"
+                  << " [create_prod|create|decode|verify|verify-batch|test"
+                  << "|bench] [-v2]"
+                  << " [-h|--help]"
                   << std::endl;
     }
     return (int)sRc.mReason;
@@ -0,0 +1,219 @@
+#include "gtest/gtest.h"
+
+#include <sys/wait.h>
+
+#include <tacfAdmission.hpp>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+namespace {
+
+class Admission : public ::testing::Test
+{
+  protected:
+    std::string name;
+
+    void SetUp() override
+    {
+        name = "/ibmacf-admission-test-" + std::to_string(getpid());
+        shm_unlink(name.c_str());
+    }
+
+    void TearDown() override
+    {
+        shm_unlink(name.c_str());
+    }
+
+    TacfAdmission::Limits limits(unsigned concurrent, unsigned queued,
+                                 unsigned rate, unsigned burst)
+    {
+        TacfAdmission::Limits limits;
+        limits.concurrent = concurrent;
+        limits.queued     = queued;
+        limits.rate       = rate;
+        limits.burst      = burst;
+        limits.queueWait  = std::chrono::seconds(1);
+        return limits;
+    }
+
+    TacfAdmission::Counters counters()
+    {
+        TacfAdmission::Counters counters{};
+        TacfAdmission(limits(1, 0, 0, 1), name).readCounters(counters);
+        return counters;
+    }
+};
+
+TEST_F(Admission, SlotsBoundConcurrentChecks)
+{
+    auto bounded = limits(2, 0, 0, 1);
+    TacfAdmission first(bounded, name), second(bounded, name),
+        third(bounded, name);
+
+    EXPECT_EQ(TacfAdmission::admissionAdmitted, first.admit());
+    EXPECT_EQ(TacfAdmission::admissionAdmitted, second.admit());
+    EXPECT_EQ(TacfAdmission::admissionBusy, third.admit());
+
+    second.release();
+    EXPECT_EQ(TacfAdmission::admissionAdmitted, third.admit());
+
+    auto values = counters();
+    EXPECT_EQ(3u, values.admitted);
+    EXPECT_EQ(0u, values.queued);
+    EXPECT_EQ(1u, values.shedBusy);
+    EXPECT_EQ(0u, values.shedRate);
+}
+
+TEST_F(Admission, QueuedCheckWaitsForSlot)
+{
+    auto single = limits(1, 1, 0, 1);
+    TacfAdmission holder(single, name), rejected(single, name);
+    ASSERT_EQ(TacfAdmission::admissionAdmitted, holder.admit());
+
+    pid_t queued = fork();
+    ASSERT_LE(0, queued);
+    if (!queued)
+    {
+        TacfAdmission child(single, name);
+        _exit(child.admit());
+    }
+
+    // The child holds the only queue place until the slot is released.
+    usleep(100'000);
+    EXPECT_EQ(TacfAdmission::admissionBusy, rejected.admit());
+    holder.release();
+
+    int status = 0;
+    ASSERT_EQ(queued, waitpid(queued, &status, 0));
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(TacfAdmission::admissionAdmitted, WEXITSTATUS(status));
+
+    // The slot held by the exited child was given back by the kernel.
+    EXPECT_EQ(TacfAdmission::admissionAdmitted,
+              TacfAdmission(single, name).admit());
+
+    auto values = counters();
+    EXPECT_EQ(3u, values.admitted);
+    EXPECT_EQ(1u, values.queued);
+    EXPECT_EQ(1u, values.shedBusy);
+}
+
+TEST_F(Admission, QueuedCheckGivesUp)
+{
+    TacfAdmission holder(limits(1, 1, 0, 1), name),
+        waiter(limits(1, 1, 0, 1), name);
+    ASSERT_EQ(TacfAdmission::admissionAdmitted, holder.admit());
+
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(TacfAdmission::admissionBusy, waiter.admit());
+    EXPECT_LE(std::chrono::seconds(1),
+              std::chrono::steady_clock::now() - start);
+
+    auto values = counters();
+    EXPECT_EQ(1u, values.queued);
+    EXPECT_EQ(1u, values.shedBusy);
+}
+
+TEST_F(Admission, QueuedCheckEndsAtDeadline)
+{
+    auto single = limits(1, 1, 0, 1);
+    single.queueWait = std::chrono::seconds(10);
+    TacfAdmission holder(single, name), waiter(single, name);
+    ASSERT_EQ(TacfAdmission::admissionAdmitted, holder.admit());
+
+    // The wait ends at the deadline rather than after the queue wait.
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(TacfAdmission::admissionBusy,
+              waiter.admit(start + std::chrono::milliseconds(200)));
+    auto waited = std::chrono::steady_clock::now() - start;
+    EXPECT_LE(std::chrono::milliseconds(200), waited);
+    EXPECT_GT(std::chrono::seconds(2), waited);
+
+    // A deadline already passed does not wait or take a queue place.
+    EXPECT_EQ(TacfAdmission::admissionBusy,
+              waiter.admit(std::chrono::steady_clock::now()));
+
+    auto values = counters();
+    EXPECT_EQ(1u, values.queued);
+    EXPECT_EQ(2u, values.shedBusy);
+}
+
+TEST_F(Admission, QueuedCheckEndsWhenCancelled)
+{
+    auto single = limits(1, 1, 0, 1);
+    single.queueWait = std::chrono::seconds(10);
+    TacfAdmission holder(single, name), waiter(single, name);
+    ASSERT_EQ(TacfAdmission::admissionAdmitted, holder.admit());
+
+    TacfCancelToken cancel;
+    std::thread client([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        cancel.cancel();
+    });
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(TacfAdmission::admissionBusy,
+              waiter.admit(std::chrono::steady_clock::time_point::max(),
+                           &cancel));
+    EXPECT_GT(std::chrono::seconds(2),
+              std::chrono::steady_clock::now() - start);
+    client.join();
+
+    // A cancelled check is not admitted even with a free slot.
+    holder.release();
+    EXPECT_EQ(TacfAdmission::admissionBusy,
+              waiter.admit(std::chrono::steady_clock::time_point::max(),
+                           &cancel));
+    EXPECT_EQ(TacfAdmission::admissionAdmitted, waiter.admit());
+
+    auto values = counters();
+    EXPECT_EQ(1u, values.queued);
+    EXPECT_EQ(2u, values.shedBusy);
+}
+
+TEST_F(Admission, TokenBucketLimitsRate)
+{
+    // One token a second, three at most.
+    auto limited = limits(16, 0, 60, 3);
+    for (int i = 0; i < 3; i++)
+    {
+        TacfAdmission check(limited, name);
+        EXPECT_EQ(TacfAdmission::admissionAdmitted, check.admit());
+    }
+    EXPECT_EQ(TacfAdmission::admissionRateLimited,
+              TacfAdmission(limited, name).admit());
+
+    sleep(1);
+    EXPECT_EQ(TacfAdmission::admissionAdmitted,
+              TacfAdmission(limited, name).admit());
+
+    auto values = counters();
+    EXPECT_EQ(4u, values.admitted);
+    EXPECT_EQ(1u, values.shedRate);
+}
+
+TEST_F(Admission, ZeroRateDisablesBucket)
+{
+    auto unlimited = limits(16, 0, 0, 1);
+    for (int i = 0; i < 20; i++)
+    {
+        EXPECT_EQ(TacfAdmission::admissionAdmitted,
+                  TacfAdmission(unlimited, name).admit());
+    }
+    EXPECT_EQ(0u, counters().shedRate);
+}
+
+TEST_F(Admission, DefaultLimitsHaveNoRate)
+{
+    TacfAdmission::Limits defaults;
+    EXPECT_EQ(0u, defaults.rate);
+    for (int i = 0; i < 20; i++)
+    {
+        EXPECT_EQ(TacfAdmission::admissionAdmitted,
+                  TacfAdmission(defaults, name).admit());
+    }
+    EXPECT_EQ(0u, counters().shedRate);
+}
+
+} // namespace
@@ -0,0 +1,125 @@
+#include "gtest/gtest.h"
+
+#include <tacfBroker.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+namespace {
+
+class Broker : public ::testing::Test
+{
+  protected:
+    std::filesystem::path dir;
+    int fd = -1;
+
+    void SetUp() override
+    {
+        dir = std::filesystem::temp_directory_path() /
+              ("broker_test_" + std::to_string(getpid()));
+        std::filesystem::remove_all(dir);
+        ASSERT_EQ(0, TacfBroker(dir).listen(fd));
+    }
+
+    void TearDown() override
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        std::filesystem::remove_all(dir);
+    }
+};
+
+TEST_F(Broker, request_and_answer)
+{
+    TacfAdmission::Limits limits;
+    limits.concurrent = 3;
+    limits.queued     = 4;
+    limits.rate       = 5;
+    limits.burst      = 6;
+
+    std::string password;
+    std::chrono::seconds lifetime{0};
+    TacfAdmission::Limits received;
+    std::thread daemon([&]() {
+        EXPECT_EQ(0, TacfBroker(dir).serve(
+                         fd, [&](const char* value, std::chrono::seconds ttl,
+                                 const TacfAdmission::Limits& admission,
+                                 std::chrono::steady_clock::time_point,
+                                 const TacfCancelToken&) {
+                             password = value;
+                             lifetime = ttl;
+                             received = admission;
+                             return 0x10002;
+                         }));
+    });
+
+    int rc = 0;
+    EXPECT_EQ(0, TacfBroker(dir).authenticate("0penBmc",
+                                              std::chrono::seconds(60), limits,
+                                              rc));
+    daemon.join();
+
+    EXPECT_EQ(0x10002, rc);
+    EXPECT_EQ("0penBmc", password);
+    EXPECT_EQ(60, lifetime.count());
+    EXPECT_EQ(3u, received.concurrent);
+    EXPECT_EQ(4u, received.queued);
+    EXPECT_EQ(5u, received.rate);
+    EXPECT_EQ(6u, received.burst);
+}
+
+TEST_F(Broker, no_daemon)
+{
+    close(fd);
+    fd = -1;
+    std::filesystem::remove(dir / "broker.sock");
+
+    int rc = 0;
+    EXPECT_NE(0, TacfBroker(dir).authenticate(
+                     "0penBmc", std::chrono::seconds(0), {}, rc));
+}
+
+TEST_F(Broker, password_too_long)
+{
+    int rc = 0;
+    EXPECT_NE(0, TacfBroker(dir).authenticate(
+                     std::string(513, 'x').c_str(), std::chrono::seconds(0),
+                     {}, rc));
+}
+
+TEST_F(Broker, deadline_of_queued_client)
+{
+    // The client waits from the time it sent the request, not from the time
+    // the daemon got to it.
+    auto sent = std::chrono::steady_clock::now();
+    std::thread client([&]() {
+        int rc = 0;
+        EXPECT_EQ(0, TacfBroker(dir).authenticate(
+                         "0penBmc", std::chrono::seconds(0), {}, rc));
+        EXPECT_EQ(0, rc);
+    });
+    std::this_thread::sleep_for(std::chrono::seconds(2));
+
+    auto served = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point deadline;
+    EXPECT_EQ(0, TacfBroker(dir).serve(
+                     fd, [&](const char*, std::chrono::seconds,
+                             const TacfAdmission::Limits&,
+                             std::chrono::steady_clock::time_point limit,
+                             const TacfCancelToken&) {
+                         deadline = limit;
+                         return 0;
+                     }));
+    client.join();
+
+    EXPECT_LT(sent + std::chrono::seconds(8), deadline);
+    EXPECT_GE(sent + std::chrono::seconds(9) + std::chrono::milliseconds(100),
+              deadline);
+    EXPECT_GT(served + std::chrono::seconds(8), deadline);
+}
+
+} // namespace
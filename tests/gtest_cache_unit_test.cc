@@ -0,0 +1,261 @@
+#include "gtest/gtest.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <tacfCache.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+class Cache : public ::testing::Test
+{
+  protected:
+    std::filesystem::path dir;
+    std::string name;
+    std::string hintName;
+    std::string acfPath;
+    std::vector<std::string> keyring;
+    std::vector<uint8_t> acf{'a', 'c', 'f'};
+
+    void SetUp() override
+    {
+        dir = std::filesystem::temp_directory_path() /
+              ("cache_test_" + std::to_string(getpid()));
+        std::filesystem::create_directories(dir);
+        name = "/ibmacf-cache-test-" + std::to_string(getpid());
+        shm_unlink(name.c_str());
+        hintName = "/ibmacf-keyids-test-" + std::to_string(getpid());
+        shm_unlink(hintName.c_str());
+
+        acfPath = writeFile("service.acf", acf);
+        keyring = {writeFile("prod.key", {1, 2, 3}),
+                   writeFile("dev.key", {4, 5, 6})};
+    }
+
+    void TearDown() override
+    {
+        shm_unlink(name.c_str());
+        shm_unlink(hintName.c_str());
+        std::filesystem::remove_all(dir);
+    }
+
+    std::string writeFile(const std::string& file,
+                          const std::vector<uint8_t>& contents)
+    {
+        std::string path = dir / file;
+        std::ofstream(path, std::ios::binary | std::ios::trunc)
+            .write((const char*)contents.data(), contents.size());
+        return path;
+    }
+
+    TacfCache::Key makeKey(const std::string& serial = "UNSET")
+    {
+        TacfCache::Key key;
+        EXPECT_EQ(0, TacfCache(name).makeKey(acfPath, acf.data(), acf.size(),
+                                             serial, keyring, key));
+        return key;
+    }
+
+    static CeLogin::AcfAuthRecord makeRecord(uint64_t replayId)
+    {
+        CeLogin::AcfAuthRecord record;
+        record.mType           = CeLogin::AcfType_Service;
+        record.mExpirationTime = time(nullptr) + 3600;
+        record.mReplayId       = replayId;
+        return record;
+    }
+
+    static TacfKeyring::KeyId makeKeyId(uint8_t fill)
+    {
+        TacfKeyring::KeyId id;
+        id.fill(fill);
+        return id;
+    }
+};
+
+TEST_F(Cache, store_and_lookup)
+{
+    TacfCache cache(name);
+    auto key = makeKey();
+    CeLogin::AcfAuthRecord record;
+    EXPECT_NE(0, cache.lookup(key, record));
+
+    ASSERT_EQ(0, cache.store(key, makeRecord(42)));
+    EXPECT_EQ(0, cache.lookup(key, record));
+    EXPECT_EQ(42u, record.mReplayId);
+    EXPECT_EQ(CeLogin::AcfType_Service, record.mType);
+
+    // Another process sees the same entry.
+    EXPECT_EQ(0, TacfCache(name).lookup(key, record));
+
+    // The entry is replaced, not added to.
+    ASSERT_EQ(0, cache.store(key, makeRecord(43)));
+    EXPECT_EQ(0, cache.lookup(key, record));
+    EXPECT_EQ(43u, record.mReplayId);
+}
+
+TEST_F(Cache, miss_after_acf_change)
+{
+    TacfCache cache(name);
+    ASSERT_EQ(0, cache.store(makeKey(), makeRecord(1)));
+
+    // Same size contents, the digest differs.
+    acf     = {'f', 'c', 'a'};
+    acfPath = writeFile("service.acf", acf);
+    CeLogin::AcfAuthRecord record;
+    EXPECT_NE(0, cache.lookup(makeKey(), record));
+
+    // A different file with the same contents.
+    ASSERT_EQ(0, cache.store(makeKey(), makeRecord(1)));
+    acfPath = writeFile("other.acf", acf);
+    EXPECT_NE(0, cache.lookup(makeKey(), record));
+}
+
+TEST_F(Cache, miss_after_serial_change)
+{
+    TacfCache cache(name);
+    ASSERT_EQ(0, cache.store(makeKey("SN1"), makeRecord(1)));
+    CeLogin::AcfAuthRecord record;
+    EXPECT_EQ(0, cache.lookup(makeKey("SN1"), record));
+    EXPECT_NE(0, cache.lookup(makeKey("SN2"), record));
+}
+
+TEST_F(Cache, miss_after_key_file_change)
+{
+    TacfCache cache(name);
+    auto key = makeKey();
+    ASSERT_EQ(0, cache.store(key, makeRecord(1)));
+    CeLogin::AcfAuthRecord record;
+
+    // A replaced key file.
+    writeFile("dev.key", {4, 5, 6, 7});
+    EXPECT_NE(0, cache.lookup(makeKey(), record));
+
+    // A removed key file.
+    ASSERT_EQ(0, cache.store(makeKey(), makeRecord(1)));
+    std::filesystem::remove(keyring.back());
+    EXPECT_NE(0, cache.lookup(makeKey(), record));
+
+    // A different set of key files.
+    ASSERT_EQ(0, cache.store(makeKey(), makeRecord(1)));
+    keyring.pop_back();
+    EXPECT_NE(0, cache.lookup(makeKey(), record));
+}
+
+TEST_F(Cache, invalidate)
+{
+    // Installing or removing the ACF drops the entry.
+    TacfCache cache(name);
+    auto key = makeKey();
+    ASSERT_EQ(0, cache.store(key, makeRecord(1)));
+    cache.invalidate();
+    CeLogin::AcfAuthRecord record;
+    EXPECT_NE(0, cache.lookup(key, record));
+
+    // And a new entry can be stored afterwards.
+    EXPECT_EQ(0, cache.store(key, makeRecord(2)));
+    EXPECT_EQ(0, cache.lookup(key, record));
+    cache.invalidate();
+    cache.invalidate();
+}
+
+TEST_F(Cache, untrusted_mode)
+{
+    TacfCache cache(name);
+    auto key = makeKey();
+    ASSERT_EQ(0, cache.store(key, makeRecord(1)));
+
+    // An object others can write to is neither read nor written.
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    ASSERT_LE(0, fd);
+    ASSERT_EQ(0, fchmod(fd, S_IRUSR | S_IWUSR | S_IWGRP | S_IWOTH));
+    close(fd);
+
+    CeLogin::AcfAuthRecord record;
+    EXPECT_NE(0, cache.lookup(key, record));
+    EXPECT_NE(0, cache.store(key, makeRecord(2)));
+}
+
+TEST_F(Cache, untrusted_owner)
+{
+    if (geteuid())
+    {
+        GTEST_SKIP() << "changing the owner needs root";
+    }
+
+    TacfCache cache(name);
+    auto key = makeKey();
+    ASSERT_EQ(0, cache.store(key, makeRecord(1)));
+
+    // An object created by another user is neither read nor written.
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    ASSERT_LE(0, fd);
+    ASSERT_EQ(0, fchown(fd, 65534, 65534));
+    close(fd);
+
+    CeLogin::AcfAuthRecord record;
+    EXPECT_NE(0, cache.lookup(key, record));
+    EXPECT_NE(0, cache.store(key, makeRecord(2)));
+}
+
+TEST_F(Cache, key_hint)
+{
+    TacfCache cache(name, hintName);
+    const uint8_t acf[]   = "first";
+    const uint8_t other[] = "second";
+    TacfKeyring::KeyId id;
+    EXPECT_NE(0, cache.lookupKeyId(acf, sizeof(acf), id));
+
+    ASSERT_EQ(0, cache.storeKeyId(acf, sizeof(acf), makeKeyId(1)));
+    ASSERT_EQ(0, cache.storeKeyId(other, sizeof(other), makeKeyId(2)));
+    EXPECT_EQ(0, TacfCache(name, hintName).lookupKeyId(acf, sizeof(acf), id));
+    EXPECT_EQ(makeKeyId(1), id);
+    EXPECT_EQ(0, cache.lookupKeyId(other, sizeof(other), id));
+    EXPECT_EQ(makeKeyId(2), id);
+
+    // The hint of a known ACF is updated in place.
+    ASSERT_EQ(0, cache.storeKeyId(acf, sizeof(acf), makeKeyId(3)));
+    EXPECT_EQ(0, cache.lookupKeyId(acf, sizeof(acf), id));
+    EXPECT_EQ(makeKeyId(3), id);
+    EXPECT_EQ(0, cache.lookupKeyId(other, sizeof(other), id));
+    EXPECT_EQ(makeKeyId(2), id);
+
+    EXPECT_NE(0, cache.lookupKeyId(nullptr, 0, id));
+    EXPECT_NE(0, cache.storeKeyId(nullptr, 0, id));
+}
+
+TEST_F(Cache, key_hint_oldest_replaced)
+{
+    TacfCache cache(name, hintName);
+    std::vector<std::vector<uint8_t>> acfs;
+    for (uint8_t i = 0; i < 9; i++)
+    {
+        acfs.push_back({'a', 'c', 'f', i});
+    }
+
+    // Updating a known ACF does not take a new place.
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        ASSERT_EQ(0, cache.storeKeyId(acfs[i].data(), acfs[i].size(),
+                                      makeKeyId(i)));
+        ASSERT_EQ(0, cache.storeKeyId(acfs[0].data(), acfs[0].size(),
+                                      makeKeyId(0)));
+    }
+    ASSERT_EQ(0,
+              cache.storeKeyId(acfs[8].data(), acfs[8].size(), makeKeyId(8)));
+
+    TacfKeyring::KeyId id;
+    EXPECT_NE(0, cache.lookupKeyId(acfs[0].data(), acfs[0].size(), id));
+    for (uint8_t i = 1; i < 9; i++)
+    {
+        EXPECT_EQ(0, cache.lookupKeyId(acfs[i].data(), acfs[i].size(), id));
+        EXPECT_EQ(makeKeyId(i), id);
+    }
+}
+
+} // namespace
@@ -0,0 +1,300 @@
+#include "gtest/gtest.h"
+
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+
+#include <tacfKeyring.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+using PrivateKey = std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)>;
+
+class Keyring : public ::testing::Test
+{
+  protected:
+    std::filesystem::path dir;
+
+    // Generating keys is slow, so they are shared by all tests.
+    static inline std::vector<PrivateKey> privateKeys;
+
+    static void SetUpTestSuite()
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            privateKeys.emplace_back(EVP_RSA_gen(2048), EVP_PKEY_free);
+        }
+    }
+
+    static void TearDownTestSuite()
+    {
+        privateKeys.clear();
+    }
+
+    void SetUp() override
+    {
+        for (const auto& key : privateKeys)
+        {
+            ASSERT_TRUE(key);
+        }
+        dir = std::filesystem::temp_directory_path() /
+              ("keyring_test_" + std::to_string(getpid()));
+        std::filesystem::create_directories(dir);
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove_all(dir);
+    }
+
+    std::string writeKey(const std::string& file, size_t key)
+    {
+        unsigned char* der = nullptr;
+        int len            = i2d_PUBKEY(privateKeys[key].get(), &der);
+        EXPECT_LT(0, len);
+
+        std::string path = dir / file;
+        std::ofstream(path, std::ios::binary | std::ios::trunc)
+            .write((const char*)der, len);
+        OPENSSL_free(der);
+        return path;
+    }
+
+    static TacfKeyring::KeyId keyId(size_t key)
+    {
+        unsigned char* der = nullptr;
+        int len            = i2d_PUBKEY(privateKeys[key].get(), &der);
+        TacfKeyring::KeyId id;
+        SHA256(der, len, id.data());
+        OPENSSL_free(der);
+        return id;
+    }
+
+    // Sign a digest the way an ACF signature is made.
+    static std::vector<uint8_t> sign(size_t key, const uint8_t* digest,
+                                     size_t digestSize)
+    {
+        std::vector<uint8_t> signature(EVP_PKEY_get_size(
+            privateKeys[key].get()));
+        size_t len        = signature.size();
+        EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new(privateKeys[key].get(), nullptr);
+        EXPECT_TRUE(ctx && 1 == EVP_PKEY_sign_init(ctx) &&
+                    1 == EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_PADDING) &&
+                    1 == EVP_PKEY_CTX_set_signature_md(ctx, EVP_sha512()) &&
+                    1 == EVP_PKEY_sign(ctx, signature.data(), &len, digest,
+                                       digestSize));
+        EVP_PKEY_CTX_free(ctx);
+        signature.resize(len);
+        return signature;
+    }
+};
+
+TEST_F(Keyring, load)
+{
+    // Missing, empty and unparsable key files are skipped.
+    std::ofstream(dir / "empty.key");
+    std::ofstream(dir / "bad.key") << "not a key";
+    std::vector<std::string> pathnames{
+        writeKey("prod.key", 0), (dir / "missing.key").string(),
+        (dir / "empty.key").string(), (dir / "bad.key").string(),
+        writeKey("dev.key", 1)};
+
+    TacfKeyring keys;
+    ASSERT_EQ(0, keys.load(pathnames));
+    ASSERT_EQ(2u, keys.loaded().size());
+    EXPECT_EQ(pathnames[0], keys.loaded()[0].pathname);
+    EXPECT_EQ(keyId(0), keys.loaded()[0].id);
+    EXPECT_EQ(keyId(1), keys.loaded()[1].id);
+    EXPECT_EQ(2u, keys.verifier().getPublicKeyCount());
+}
+
+TEST_F(Keyring, duplicate_dropped)
+{
+    // The same key installed twice is only tried once, where it is first
+    // listed.
+    std::vector<std::string> pathnames{writeKey("prod.key", 0),
+                                       writeKey("dev.key", 1),
+                                       writeKey("backup.key", 0)};
+
+    TacfKeyring keys;
+    ASSERT_EQ(0, keys.load(pathnames));
+    ASSERT_EQ(2u, keys.loaded().size());
+    EXPECT_EQ(pathnames[0], keys.loaded()[0].pathname);
+    EXPECT_EQ(pathnames[1], keys.loaded()[1].pathname);
+    EXPECT_EQ(2u, keys.verifier().getPublicKeyCount());
+}
+
+TEST_F(Keyring, prefer)
+{
+    std::vector<std::string> pathnames{writeKey("prod.key", 0),
+                                       writeKey("backup.key", 1),
+                                       writeKey("dev.key", 2)};
+
+    TacfKeyring keys;
+    ASSERT_EQ(0, keys.load(pathnames));
+
+    // The hinted key is moved to the front, the others keep their order.
+    ASSERT_EQ(0, keys.prefer(keyId(2)));
+    ASSERT_EQ(3u, keys.loaded().size());
+    EXPECT_EQ(keyId(2), keys.loaded()[0].id);
+    EXPECT_EQ(keyId(0), keys.loaded()[1].id);
+    EXPECT_EQ(keyId(1), keys.loaded()[2].id);
+
+    ASSERT_EQ(0, keys.prefer(keyId(2)));
+    EXPECT_EQ(keyId(2), keys.loaded()[0].id);
+
+    // An unknown key changes nothing.
+    TacfKeyring::KeyId unknown{};
+    EXPECT_NE(0, keys.prefer(unknown));
+    EXPECT_EQ(keyId(2), keys.loaded()[0].id);
+    EXPECT_EQ(keyId(0), keys.loaded()[1].id);
+    EXPECT_EQ(keyId(1), keys.loaded()[2].id);
+
+    // The preference is dropped when the keys are read again.
+    ASSERT_EQ(0, keys.load({pathnames[0], pathnames[1]}));
+    EXPECT_EQ(keyId(0), keys.loaded()[0].id);
+}
+
+TEST_F(Keyring, hinted_key_tried_first)
+{
+    std::vector<std::string> pathnames{writeKey("prod.key", 0),
+                                       writeKey("backup.key", 1),
+                                       writeKey("dev.key", 2)};
+    uint8_t digest[SHA512_DIGEST_LENGTH];
+    SHA512((const uint8_t*)"acf", 3, digest);
+    auto signature = sign(2, digest, sizeof(digest));
+
+    TacfKeyring keys;
+    ASSERT_EQ(0, keys.load(pathnames));
+    uint64_t keyIndex = 0;
+    ASSERT_EQ(CeLogin::CeLoginRc::Success,
+              keys.verifier().verifySignature(signature.data(),
+                                              signature.size(), digest,
+                                              sizeof(digest), keyIndex));
+    EXPECT_EQ(2u, keyIndex);
+
+    ASSERT_EQ(0, keys.prefer(keyId(2)));
+    ASSERT_EQ(CeLogin::CeLoginRc::Success,
+              keys.verifier().verifySignature(signature.data(),
+                                              signature.size(), digest,
+                                              sizeof(digest), keyIndex));
+    EXPECT_EQ(0u, keyIndex);
+    EXPECT_EQ(keyId(2), keys.loaded()[keyIndex].id);
+}
+
+TEST_F(Keyring, stale_hint_falls_back)
+{
+    // A hint naming a key that did not sign the ACF still verifies it with
+    // one of the other keys.
+    std::vector<std::string> pathnames{writeKey("prod.key", 0),
+                                       writeKey("backup.key", 1),
+                                       writeKey("dev.key", 2)};
+    uint8_t digest[SHA512_DIGEST_LENGTH];
+    SHA512((const uint8_t*)"acf", 3, digest);
+    auto signature = sign(1, digest, sizeof(digest));
+
+    TacfKeyring keys;
+    ASSERT_EQ(0, keys.load(pathnames));
+    ASSERT_EQ(0, keys.prefer(keyId(2)));
+
+    uint64_t keyIndex = 0;
+    ASSERT_EQ(CeLogin::CeLoginRc::Success,
+              keys.verifier().verifySignature(signature.data(),
+                                              signature.size(), digest,
+                                              sizeof(digest), keyIndex));
+    ASSERT_GT(keys.loaded().size(), keyIndex);
+    EXPECT_EQ(keyId(1), keys.loaded()[keyIndex].id);
+
+    // Nor does it make a signature by an unknown key valid.
+    auto foreign = sign(2, digest, sizeof(digest));
+    ASSERT_EQ(0, keys.load({pathnames[0], pathnames[1]}));
+    EXPECT_NE(0, keys.prefer(keyId(2)));
+    EXPECT_NE(CeLogin::CeLoginRc::Success,
+              keys.verifier().verifySignature(foreign.data(), foreign.size(),
+                                              digest, sizeof(digest),
+                                              keyIndex));
+    EXPECT_EQ(keys.loaded().size(), keyIndex);
+}
+
+TEST_F(Keyring, key_rotation)
+{
+    std::vector<std::string> pathnames{writeKey("prod.key", 0),
+                                       (dir / "backup.key").string(),
+                                       writeKey("dev.key", 1)};
+
+    TacfKeyring keys;
+    ASSERT_EQ(0, keys.load(pathnames));
+    ASSERT_EQ(2u, keys.loaded().size());
+    EVP_PKEY* prod = keys.loaded()[0].pkey.get();
+    EVP_PKEY* dev  = keys.loaded()[1].pkey.get();
+
+    // Without a change the key files are not read again.
+    ASSERT_EQ(0, keys.load(pathnames));
+    ASSERT_EQ(2u, keys.loaded().size());
+    EXPECT_EQ(prod, keys.loaded()[0].pkey.get());
+    EXPECT_EQ(dev, keys.loaded()[1].pkey.get());
+
+    // A replaced key file.
+    writeKey("dev.key", 2);
+    ASSERT_EQ(0, keys.load(pathnames));
+    ASSERT_EQ(2u, keys.loaded().size());
+    EXPECT_EQ(keyId(0), keys.loaded()[0].id);
+    EXPECT_EQ(keyId(2), keys.loaded()[1].id);
+
+    // A key file moved into place.
+    std::filesystem::rename(writeKey("backup.tmp", 1), pathnames[1]);
+    ASSERT_EQ(0, keys.load(pathnames));
+    ASSERT_EQ(3u, keys.loaded().size());
+    EXPECT_EQ(keyId(1), keys.loaded()[1].id);
+    EXPECT_EQ(3u, keys.verifier().getPublicKeyCount());
+
+    // A removed key file.
+    std::filesystem::remove(pathnames[0]);
+    ASSERT_EQ(0, keys.load(pathnames));
+    ASSERT_EQ(2u, keys.loaded().size());
+    EXPECT_EQ(keyId(1), keys.loaded()[0].id);
+    EXPECT_EQ(keyId(2), keys.loaded()[1].id);
+    EXPECT_EQ(2u, keys.verifier().getPublicKeyCount());
+
+    // Every key file removed leaves no key to verify with.
+    std::filesystem::remove(pathnames[1]);
+    std::filesystem::remove(pathnames[2]);
+    ASSERT_EQ(0, keys.load(pathnames));
+    EXPECT_TRUE(keys.loaded().empty());
+    EXPECT_EQ(0u, keys.verifier().getPublicKeyCount());
+}
+
+TEST_F(Keyring, key_directory_replaced)
+{
+    // A removed directory is no longer watched, so it is watched again.
+    auto subdir = dir / "keys";
+    std::filesystem::create_directories(subdir);
+    std::vector<std::string> pathnames{writeKey("keys/prod.key", 0)};
+
+    TacfKeyring keys;
+    ASSERT_EQ(0, keys.load(pathnames));
+    ASSERT_EQ(1u, keys.loaded().size());
+
+    std::filesystem::remove_all(subdir);
+    ASSERT_EQ(0, keys.load(pathnames));
+    EXPECT_TRUE(keys.loaded().empty());
+
+    std::filesystem::create_directories(subdir);
+    writeKey("keys/prod.key", 1);
+    ASSERT_EQ(0, keys.load(pathnames));
+    ASSERT_EQ(1u, keys.loaded().size());
+    EXPECT_EQ(keyId(1), keys.loaded()[0].id);
+
+    writeKey("keys/prod.key", 2);
+    ASSERT_EQ(0, keys.load(pathnames));
+    ASSERT_EQ(1u, keys.loaded().size());
+    EXPECT_EQ(keyId(2), keys.loaded()[0].id);
+}
+
+} // namespace
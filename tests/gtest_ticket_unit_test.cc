@@ -0,0 +1,120 @@
+#include "gtest/gtest.h"
+
+#include <tacfTicket.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace {
+
+class Ticket : public ::testing::Test
+{
+  protected:
+    static constexpr auto password = "0penBmc";
+    static constexpr auto lifetime = std::chrono::seconds(60);
+
+    TacfCache::Key key = makeKey(1);
+    uint64_t expiration = time(nullptr) + 3600;
+
+    static TacfCache::Key makeKey(uint8_t fill)
+    {
+        TacfCache::Key key;
+        memset(&key, 0, sizeof(key));
+        key.ino = 7;
+        memset(key.digest, fill, sizeof(key.digest));
+        return key;
+    }
+};
+
+TEST_F(Ticket, issue_and_check)
+{
+    TacfTicket ticket;
+    EXPECT_NE(0, ticket.check(key, 5, password));
+
+    ASSERT_EQ(0, ticket.issue(key, 5, expiration, password, lifetime));
+    EXPECT_EQ(0, ticket.check(key, 5, password));
+    EXPECT_EQ(0, ticket.check(key, 5, password));
+    EXPECT_NE(0, ticket.check(key, 5, "0penBmC"));
+    EXPECT_NE(0, ticket.check(key, 5, ""));
+    EXPECT_NE(0, ticket.check(key, 5, nullptr));
+    EXPECT_NE(0, ticket.issue(key, 5, expiration, nullptr, lifetime));
+    EXPECT_NE(0, ticket.check(key, 5, password));
+}
+
+TEST_F(Ticket, replay)
+{
+    // A new replay id, as after an install or a replay protected ACF was
+    // used, ends the ticket.
+    TacfTicket ticket;
+    ASSERT_EQ(0, ticket.issue(key, 5, expiration, password, lifetime));
+    EXPECT_NE(0, ticket.check(key, 6, password));
+    EXPECT_NE(0, ticket.check(key, 4, password));
+    EXPECT_EQ(0, ticket.check(key, 5, password));
+}
+
+TEST_F(Ticket, lifetime_expiry)
+{
+    TacfTicket ticket;
+    ASSERT_EQ(0, ticket.issue(key, 5, expiration, password,
+                              std::chrono::seconds(1)));
+    EXPECT_EQ(0, ticket.check(key, 5, password));
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    EXPECT_NE(0, ticket.check(key, 5, password));
+
+    ASSERT_EQ(0, ticket.issue(key, 5, expiration, password,
+                              std::chrono::seconds(0)));
+    EXPECT_NE(0, ticket.check(key, 5, password));
+}
+
+TEST_F(Ticket, acf_expiry)
+{
+    // The ACF expiring ends the ticket before its lifetime does.
+    TacfTicket ticket;
+    ASSERT_EQ(0, ticket.issue(key, 5, time(nullptr) - 1, password, lifetime));
+    EXPECT_NE(0, ticket.check(key, 5, password));
+}
+
+TEST_F(Ticket, acf_replaced)
+{
+    TacfTicket ticket;
+    ASSERT_EQ(0, ticket.issue(key, 5, expiration, password, lifetime));
+
+    // Different contents, serial number or public keys.
+    EXPECT_NE(0, ticket.check(makeKey(2), 5, password));
+
+    // The same contents in a replaced file.
+    auto other = key;
+    other.mtimeNsec++;
+    EXPECT_NE(0, ticket.check(other, 5, password));
+
+    // A new ticket replaces the old one.
+    ASSERT_EQ(0,
+              ticket.issue(makeKey(2), 5, expiration, password, lifetime));
+    EXPECT_EQ(0, ticket.check(makeKey(2), 5, password));
+    EXPECT_NE(0, ticket.check(key, 5, password));
+}
+
+TEST_F(Ticket, invalidate)
+{
+    // Installing or removing the ACF drops the ticket.
+    TacfTicket ticket;
+    ASSERT_EQ(0, ticket.issue(key, 5, expiration, password, lifetime));
+    ticket.invalidate();
+    EXPECT_NE(0, ticket.check(key, 5, password));
+
+    ASSERT_EQ(0, ticket.issue(key, 5, expiration, password, lifetime));
+    EXPECT_EQ(0, ticket.check(key, 5, password));
+}
+
+TEST_F(Ticket, other_instance)
+{
+    // Every instance has its own key, so a ticket is only accepted by the
+    // process that issued it.
+    TacfTicket ticket;
+    TacfTicket other;
+    ASSERT_EQ(0, ticket.issue(key, 5, expiration, password, lifetime));
+    EXPECT_NE(0, other.check(key, 5, password));
+}
+
+} // namespace
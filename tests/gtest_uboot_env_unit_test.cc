@@ -0,0 +1,245 @@
+#include "gtest/gtest.h"
+
+#include <tacfUbootEnv.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr size_t envSize = 0x100;
+
+uint32_t crc32(const uint8_t* data, size_t size)
+{
+    uint32_t crc = 0xffffffff;
+    for (size_t i = 0; i < size; i++)
+    {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ ((crc & 1) ? 0xedb88320 : 0);
+        }
+    }
+    return crc ^ 0xffffffff;
+}
+
+// Build one environment copy in the layout written by U-Boot.
+std::vector<uint8_t> makeEnv(const std::vector<std::string>& vars,
+                             bool redundant, uint8_t flags = 0,
+                             bool corrupt = false)
+{
+    size_t header = redundant ? 5 : 4;
+    std::vector<uint8_t> env(envSize, 0);
+    size_t pos = header;
+    for (const auto& var : vars)
+    {
+        std::copy(var.begin(), var.end(), env.begin() + pos);
+        pos += var.size() + 1;
+    }
+    if (redundant)
+    {
+        env[4] = flags;
+    }
+    uint32_t crc = htole32(crc32(env.data() + header, env.size() - header));
+    if (corrupt)
+    {
+        crc ^= 1;
+    }
+    memcpy(env.data(), &crc, sizeof(crc));
+    return env;
+}
+
+class UbootEnv : public ::testing::Test
+{
+  protected:
+    std::filesystem::path dir;
+
+    void SetUp() override
+    {
+        dir = std::filesystem::temp_directory_path() /
+              ("uboot_env_test_" + std::to_string(getpid()));
+        std::filesystem::create_directories(dir);
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove_all(dir);
+    }
+
+    std::string writeImage(const std::string& name, size_t offset,
+                           const std::vector<uint8_t>& env)
+    {
+        std::string path = dir / name;
+        std::ofstream file(path, std::ios::binary);
+        std::string padding(offset, '\xff');
+        file.write(padding.data(), padding.size());
+        file.write((const char*)env.data(), env.size());
+        return path;
+    }
+
+    std::string writeConfig(const std::string& contents)
+    {
+        std::string path = dir / "fw_env.config";
+        std::ofstream(path) << contents;
+        return path;
+    }
+
+    int read(const std::string& config, const std::string& name,
+             std::string& value)
+    {
+        return TacfUbootEnv(config).readVariable(name, value);
+    }
+};
+
+TEST_F(UbootEnv, single_copy_variable)
+{
+    auto image = writeImage(
+        "env.bin", 0, makeEnv({"bootdelay=2", "fieldmode=true"}, false));
+    auto config = writeConfig(image + " 0x0 0x100\n");
+    std::string value;
+    EXPECT_EQ(TacfUbootEnv::envSuccess, read(config, "fieldmode", value));
+    EXPECT_EQ("true", value);
+    EXPECT_EQ(TacfUbootEnv::envSuccess, read(config, "bootdelay", value));
+    EXPECT_EQ("2", value);
+}
+
+TEST_F(UbootEnv, variable_not_defined)
+{
+    auto image = writeImage("env.bin", 0,
+                            makeEnv({"fieldmodex=true", "field=true"}, false));
+    auto config = writeConfig(image + " 0 256\n");
+    std::string value;
+    EXPECT_EQ(TacfUbootEnv::envNotDefined, read(config, "fieldmode", value));
+}
+
+TEST_F(UbootEnv, bad_crc)
+{
+    auto image = writeImage(
+        "env.bin", 0, makeEnv({"fieldmode=true"}, false, 0, true));
+    auto config = writeConfig(image + " 0x0 0x100\n");
+    std::string value;
+    EXPECT_EQ(TacfUbootEnv::envError, read(config, "fieldmode", value));
+}
+
+TEST_F(UbootEnv, config_errors)
+{
+    std::string value;
+    EXPECT_EQ(TacfUbootEnv::envError,
+              read((dir / "missing.config").string(), "fieldmode", value));
+    EXPECT_EQ(TacfUbootEnv::envError,
+              read(writeConfig("# only a comment\n"), "fieldmode", value));
+    EXPECT_EQ(TacfUbootEnv::envError,
+              read(writeConfig("/dev/null zero 0x100\n"), "fieldmode", value));
+    EXPECT_EQ(TacfUbootEnv::envError,
+              read(writeConfig((dir / "missing.bin").string() + " 0 0x100\n"),
+                   "fieldmode", value));
+}
+
+TEST_F(UbootEnv, offset_and_comments)
+{
+    auto image =
+        writeImage("env.bin", 0x40, makeEnv({"fieldmode=false"}, false));
+    auto config = writeConfig("# MTD device name Device offset Env. size\n"
+                              "\n" +
+                              image + "\t0x40\t0x100\t0x1000\n");
+    std::string value;
+    EXPECT_EQ(TacfUbootEnv::envSuccess, read(config, "fieldmode", value));
+    EXPECT_EQ("false", value);
+}
+
+TEST_F(UbootEnv, redundant_copies)
+{
+    std::string value;
+    auto older = makeEnv({"fieldmode=false"}, true, 1);
+    auto newer = makeEnv({"fieldmode=true"}, true, 2);
+
+    // Newest counter wins.
+    auto config = writeConfig(writeImage("a.bin", 0, older) + " 0 0x100\n" +
+                              writeImage("b.bin", 0, newer) + " 0 0x100\n");
+    EXPECT_EQ(TacfUbootEnv::envSuccess, read(config, "fieldmode", value));
+    EXPECT_EQ("true", value);
+
+    // Counter wrap around.
+    config = writeConfig(
+        writeImage("a.bin", 0, makeEnv({"fieldmode=false"}, true, 0xff)) +
+        " 0 0x100\n" +
+        writeImage("b.bin", 0, makeEnv({"fieldmode=true"}, true, 0)) +
+        " 0 0x100\n");
+    EXPECT_EQ(TacfUbootEnv::envSuccess, read(config, "fieldmode", value));
+    EXPECT_EQ("true", value);
+
+    // Only one copy valid.
+    config = writeConfig(
+        writeImage("a.bin", 0, makeEnv({"fieldmode=true"}, true, 1)) +
+        " 0 0x100\n" +
+        writeImage("b.bin", 0, makeEnv({"fieldmode=false"}, true, 9, true)) +
+        " 0 0x100\n");
+    EXPECT_EQ(TacfUbootEnv::envSuccess, read(config, "fieldmode", value));
+    EXPECT_EQ("true", value);
+
+    // Both copies in the same file.
+    std::vector<uint8_t> both(older);
+    both.insert(both.end(), newer.begin(), newer.end());
+    auto image = writeImage("both.bin", 0, both);
+    config     = writeConfig(image + " 0x0 0x100\n" + image + " 0x100 0x100\n");
+    EXPECT_EQ(TacfUbootEnv::envSuccess, read(config, "fieldmode", value));
+    EXPECT_EQ("true", value);
+}
+
+TEST_F(UbootEnv, redundant_copies_bad_crc)
+{
+    // No default environment to fall back to, unlike fw_printenv.
+    auto config = writeConfig(
+        writeImage("a.bin", 0, makeEnv({"fieldmode=true"}, true, 1, true)) +
+        " 0 0x100\n" +
+        writeImage("b.bin", 0, makeEnv({"fieldmode=true"}, true, 2, true)) +
+        " 0 0x100\n");
+    std::string value;
+    EXPECT_EQ(TacfUbootEnv::envError, read(config, "fieldmode", value));
+}
+
+TEST_F(UbootEnv, boolean_flags)
+{
+    // Same choices as the FLAG_BOOLEAN scheme of fw_env.c.
+    EXPECT_EQ(0u, TacfUbootEnv::selectCopy(1, 0, true));
+    EXPECT_EQ(1u, TacfUbootEnv::selectCopy(0, 1, true));
+    EXPECT_EQ(0u, TacfUbootEnv::selectCopy(1, 1, true));
+    EXPECT_EQ(0u, TacfUbootEnv::selectCopy(0, 0, true));
+    EXPECT_EQ(0u, TacfUbootEnv::selectCopy(0xff, 0, true));
+    EXPECT_EQ(0u, TacfUbootEnv::selectCopy(0xff, 1, true));
+    EXPECT_EQ(1u, TacfUbootEnv::selectCopy(0, 0xff, true));
+    EXPECT_EQ(1u, TacfUbootEnv::selectCopy(1, 0xff, true));
+    EXPECT_EQ(0u, TacfUbootEnv::selectCopy(0x12, 0x34, true));
+}
+
+TEST_F(UbootEnv, field_mode)
+{
+    bool enabled = false;
+    auto config  = writeConfig(
+        writeImage("on.bin", 0, makeEnv({"fieldmode=true"}, false)) +
+        " 0 0x100\n");
+    EXPECT_EQ(0, TacfUbootEnv(config).readFieldMode(enabled));
+    EXPECT_TRUE(enabled);
+
+    // Any other value or no value at all means disabled.
+    config = writeConfig(
+        writeImage("off.bin", 0, makeEnv({"fieldmode=TRUE"}, false)) +
+        " 0 0x100\n");
+    EXPECT_EQ(0, TacfUbootEnv(config).readFieldMode(enabled));
+    EXPECT_FALSE(enabled);
+
+    enabled = true;
+    config  = writeConfig(
+        writeImage("unset.bin", 0, makeEnv({"bootdelay=2"}, false)) +
+        " 0 0x100\n");
+    EXPECT_EQ(0, TacfUbootEnv(config).readFieldMode(enabled));
+    EXPECT_FALSE(enabled);
+
+    config = writeConfig(
+        writeImage("bad.bin", 0, makeEnv({"fieldmode=true"}, false, 0, true)) +
+        " 0 0x100\n");
+    EXPECT_NE(0, TacfUbootEnv(config).readFieldMode(enabled));
+}
+} // namespace